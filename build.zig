@@ -183,6 +183,27 @@ pub fn build(b: *std.Build) void {
 
     benchmark.dependOn(&bench_run_cmd.step);
 
+    // audio loop overhead on null PCMs, no audio hardware needed: `zig build bench-alsa -- --help`
+    const exe_bench_alsa = b.addExecutable(.{
+        .name = "audio_engine_proto_bench_alsa",
+        .root_source_file = b.path("src/bench_alsa.zig"),
+        .target = target,
+        .optimize = optimize,
+    });
+
+    exe_bench_alsa.addIncludePath(alsa_include_path);
+    exe_bench_alsa.addObjectFile(alsa_lib_path);
+    exe_bench_alsa.linkLibC();
+
+    const bench_alsa_run_cmd = b.addRunArtifact(exe_bench_alsa);
+
+    if (b.args) |args| {
+        bench_alsa_run_cmd.addArgs(args);
+    }
+
+    const bench_alsa = b.step("bench-alsa", "Measure the ALSA audio loop overhead on null PCMs");
+    bench_alsa.dependOn(&bench_alsa_run_cmd.step);
+
     //////////////// TESTS////////////////////////////////////////////////
 
     const exe_unit_tests = b.addTest(.{
@@ -16,6 +16,9 @@ const SampleRate = @import("../../common/audio_specs.zig").SampleRate;
 const ChannelCount = @import("settings.zig").ChannelCount;
 const settings = @import("settings.zig");
 const SupportedSettings = @import("SupportedSettings.zig");
+const CardCache = @import("CardCache.zig");
+
+const log = std.log.scoped(.alsa);
 
 const AudioCard = @This();
 
@@ -121,8 +124,13 @@ pub const AudioCardInfo = struct {
     /// - `stream_type`: The type of stream (playback or capture) for which to add supported formats.
     /// This function updates the `supported_settings` and `stream_type` fields of the `AudioCardInfo`.
     pub fn addSupportedFormats(self: *AudioCardInfo, stream_type: StreamType) void {
-        self.supported_settings = SupportedSettings.init(self.allocator, self.identifier, stream_type);
         self.stream_type = stream_type;
+        self.setSupportedSettings(SupportedSettings.init(self.allocator, self.identifier, stream_type));
+    }
+
+    /// Sets already known supported settings, e.g. from the `CardCache`, and selects their defaults.
+    pub fn setSupportedSettings(self: *AudioCardInfo, supported_settings: ?SupportedSettings) void {
+        self.supported_settings = supported_settings;
 
         const ss = self.supported_settings orelse return;
 
@@ -137,8 +145,8 @@ pub const AudioCardInfo = struct {
         _ = fmt;
         _ = options;
 
-        // null means the info is for a card, not a port, so we adjust indentation
-        if (self.supported_settings == null) {
+        // card details are printed with less indentation than ports
+        if (self.type == .card) {
             try writer.print("  │  Ident:       {s}\n", .{self.identifier});
             try writer.print("  │   ID:          {s}\n", .{self.id});
             try writer.print("  │   Name:        {s}\n", .{self.name});
@@ -159,6 +167,8 @@ pub const AudioCardInfo = struct {
 
         if (self.supported_settings) |ss| {
             try writer.print("{s}", .{ss});
+        } else {
+            try writer.print("  │    │   Settings:    not probed\n", .{});
         }
     }
 
@@ -185,6 +195,12 @@ captures: std.ArrayList(AudioCardInfo),
 /// List of playback stream ports available on this audio card.
 playbacks: std.ArrayList(AudioCardInfo),
 // default to playback
+/// ALSA driver name of the card, part of the `CardCache` key. Owned, set by `Hardware`.
+driver: []const u8 = "",
+/// The ports are listed but their supported settings are only probed on first use, see `probe`.
+probe_pending: bool = false,
+/// Control interface subscribed to the card's events, kept open by `Hardware` to notice hotplug.
+ctl: ?*c_alsa.snd_ctl_t = null,
 
 allocator: std.mem.Allocator,
 
@@ -211,7 +227,7 @@ pub fn init(allocator: std.mem.Allocator, details: AudioCardInfo) AudioCard {
 /// - Errors: Returns errors related to ALSA operations or memory allocations.
 pub fn addPlayback(self: *AudioCard, index: c_int, id: [*c]const u8, name: [*c]const u8) !void {
     var details = try AudioCardInfo.init(self.allocator, .{ .card = self.details.index, .device = index }, id, name);
-    details.addSupportedFormats(StreamType.playback);
+    details.stream_type = StreamType.playback;
 
     try self.playbacks.append(details);
 }
@@ -224,11 +240,45 @@ pub fn addPlayback(self: *AudioCard, index: c_int, id: [*c]const u8, name: [*c]c
 /// - Errors: Returns errors related to ALSA operations or memory allocations.
 pub fn addCapture(self: *AudioCard, index: c_int, id: [*c]const u8, name: [*c]const u8) !void {
     var details = try AudioCardInfo.init(self.allocator, .{ .card = self.details.index, .device = index }, id, name);
-    details.addSupportedFormats(StreamType.capture);
+    details.stream_type = StreamType.capture;
 
     try self.captures.append(details);
 }
 
+/// Fills the supported settings of every port not probed yet, from `cache` when it knows the port, otherwise by
+/// opening the PCM. Newly probed ports are added to `cache`.
+pub fn probe(self: *AudioCard, cache: ?*CardCache) void {
+    for (self.playbacks.items) |*playback| self.probePort(playback, cache);
+    for (self.captures.items) |*capture| self.probePort(capture, cache);
+
+    self.probe_pending = false;
+}
+
+fn probePort(self: AudioCard, port: *AudioCardInfo, cache: ?*CardCache) void {
+    if (port.supported_settings != null) return;
+
+    const stream_type = port.stream_type orelse return;
+    const c = cache orelse return port.addSupportedFormats(stream_type);
+
+    if (c.find(self.details.id, self.driver, stream_type, port.index, port.id)) |cached| {
+        if (CardCache.settingsOf(self.allocator, cached)) |ss| {
+            port.setSupportedSettings(ss);
+            return;
+        } else |err| {
+            log.warn("Failed to restore cached settings of {s}: {s}", .{ port.identifier, @errorName(err) });
+        }
+    }
+
+    port.addSupportedFormats(stream_type);
+
+    // a port that failed to open is not cached, it may just be busy
+    const ss = port.supported_settings orelse return;
+
+    c.put(self.details.id, self.driver, CardCache.portOf(stream_type, port.index, port.id, ss)) catch |err| {
+        log.warn("Failed to cache settings of {s}: {s}", .{ port.identifier, @errorName(err) });
+    };
+}
+
 /// Searches for a playback port based on the specified criteria.
 ///
 /// - `by`: The field to seach: `.name` for the name of the port or `.id` for the ALSA id.
@@ -445,6 +495,12 @@ pub fn format(self: AudioCard, comptime fmt: []const u8, options: std.fmt.Format
 
 pub fn deinit(self: *AudioCard) void {
     self.details.deinit();
+    self.allocator.free(self.driver);
+
+    if (self.ctl) |ctl| {
+        const res = c_alsa.snd_ctl_close(ctl);
+        if (res < 0) log.warn("Failed to close control interface of {s}: {s}", .{ self.details.identifier, c_alsa.snd_strerror(res) });
+    }
 
     for (self.playbacks.items) |*playback| {
         playback.*.deinit();
@@ -0,0 +1,268 @@
+//! `CardCache` keeps the supported settings of probed ports on disk, so the next start does not have to open
+//! every PCM again. Cards are keyed by their ALSA id and driver, another card showing up on the same index never
+//! matches. Ports are matched by stream type, device index and ALSA id, a port that changed is simply probed again.
+//!
+//! The file is plain JSON, deleting it is always safe.
+
+const std = @import("std");
+const log = std.log.scoped(.alsa);
+
+const settings = @import("settings.zig");
+const FormatType = settings.FormatType;
+const StreamType = settings.StreamType;
+const ChannelCount = settings.ChannelCount;
+const AccessType = settings.AccessType;
+const SampleRate = @import("../../common/audio_specs.zig").SampleRate;
+const SupportedSettings = @import("SupportedSettings.zig");
+const utils = @import("utils.zig");
+
+const CardCache = @This();
+
+// bumped whenever the layout changes, files of another version are ignored
+const version = 1;
+const max_file_bytes = 1024 * 1024;
+
+pub const Port = struct {
+    stream_type: StreamType,
+    device: i32,
+    id: []const u8,
+    formats: []const FormatType,
+    sample_rates: []const SampleRate,
+    channel_counts: []const ChannelCount,
+    access_types: []const AccessType,
+    sample_rate_min: u32,
+    sample_rate_max: u32,
+};
+
+pub const Card = struct {
+    id: []const u8,
+    driver: []const u8,
+    ports: []const Port,
+};
+
+const File = struct {
+    version: u32,
+    cards: []const Card,
+};
+
+/// Holds everything the cache refers to, replaced entries are only released by `deinit`.
+arena: std.heap.ArenaAllocator,
+cards: std.ArrayList(Card),
+/// `null` keeps the cache in memory only.
+path: ?[]const u8 = null,
+/// Changed since the last `save`.
+dirty: bool = false,
+
+/// Loads the cache at `path` when there is one. A missing, unreadable or outdated file is an empty cache.
+pub fn init(allocator: std.mem.Allocator, path: ?[]const u8) !CardCache {
+    var self = CardCache{
+        .arena = std.heap.ArenaAllocator.init(allocator),
+        .cards = std.ArrayList(Card).init(allocator),
+    };
+    errdefer self.deinit();
+
+    const p = path orelse return self;
+    self.path = try self.arena.allocator().dupe(u8, p);
+
+    self.load() catch |err| switch (err) {
+        error.OutOfMemory => return error.OutOfMemory,
+        error.FileNotFound => {},
+        else => log.warn("CardCache: Ignoring {s}: {s}", .{ p, @errorName(err) }),
+    };
+
+    return self;
+}
+
+/// `$XDG_CACHE_HOME/delia/alsa_cards.json`, falling back to `$HOME/.cache`. `null` when neither is set.
+pub fn defaultPath(allocator: std.mem.Allocator) !?[]u8 {
+    return utils.cachePath(allocator, "alsa_cards.json");
+}
+
+pub fn deinit(self: *CardCache) void {
+    self.cards.deinit();
+    self.arena.deinit();
+}
+
+/// The cached settings of a port, `null` when the card or the port was never probed.
+pub fn find(self: CardCache, card_id: []const u8, driver: []const u8, stream_type: StreamType, device: i32, port_id: []const u8) ?Port {
+    const card = self.cards.items[self.indexOf(card_id, driver) orelse return null];
+
+    for (card.ports) |port| {
+        if (port.stream_type == stream_type and port.device == device and std.mem.eql(u8, port.id, port_id)) {
+            return port;
+        }
+    }
+
+    return null;
+}
+
+/// Stores a copy of `port`, replacing the port of the same stream type and device.
+pub fn put(self: *CardCache, card_id: []const u8, driver: []const u8, port: Port) !void {
+    const arena = self.arena.allocator();
+
+    const copy = Port{
+        .stream_type = port.stream_type,
+        .device = port.device,
+        .id = try arena.dupe(u8, port.id),
+        .formats = try arena.dupe(FormatType, port.formats),
+        .sample_rates = try arena.dupe(SampleRate, port.sample_rates),
+        .channel_counts = try arena.dupe(ChannelCount, port.channel_counts),
+        .access_types = try arena.dupe(AccessType, port.access_types),
+        .sample_rate_min = port.sample_rate_min,
+        .sample_rate_max = port.sample_rate_max,
+    };
+
+    const at = self.indexOf(card_id, driver) orelse blk: {
+        try self.cards.append(.{
+            .id = try arena.dupe(u8, card_id),
+            .driver = try arena.dupe(u8, driver),
+            .ports = &.{},
+        });
+        break :blk self.cards.items.len - 1;
+    };
+
+    const card = &self.cards.items[at];
+    var ports = try std.ArrayList(Port).initCapacity(arena, card.ports.len + 1);
+
+    for (card.ports) |p| {
+        if (p.stream_type == copy.stream_type and p.device == copy.device) continue;
+        ports.appendAssumeCapacity(p);
+    }
+
+    ports.appendAssumeCapacity(copy);
+    card.ports = ports.items;
+    self.dirty = true;
+}
+
+/// Forgets a card, its ports are probed again on next use.
+pub fn invalidate(self: *CardCache, card_id: []const u8, driver: []const u8) void {
+    const at = self.indexOf(card_id, driver) orelse return;
+
+    _ = self.cards.orderedRemove(at);
+    self.dirty = true;
+}
+
+/// Writes the cache when it changed, atomically so a concurrent start never reads half a file.
+pub fn save(self: *CardCache) !void {
+    const path = self.path orelse return;
+    if (!self.dirty) return;
+
+    if (std.fs.path.dirname(path)) |dir| try std.fs.cwd().makePath(dir);
+
+    var atomic = try std.fs.cwd().atomicFile(path, .{});
+    defer atomic.deinit();
+
+    var buffered = std.io.bufferedWriter(atomic.file.writer());
+    try std.json.stringify(File{ .version = version, .cards = self.cards.items }, .{ .whitespace = .indent_2 }, buffered.writer());
+    try buffered.flush();
+    try atomic.finish();
+
+    self.dirty = false;
+}
+
+/// `SupportedSettings` owning copies of the cached lists.
+pub fn settingsOf(allocator: std.mem.Allocator, port: Port) !SupportedSettings {
+    var ss = SupportedSettings{
+        .formats = std.ArrayList(FormatType).init(allocator),
+        .sample_rates = std.ArrayList(SampleRate).init(allocator),
+        .channel_counts = std.ArrayList(ChannelCount).init(allocator),
+        .access_types = std.ArrayList(AccessType).init(allocator),
+        .sample_rate_min = port.sample_rate_min,
+        .sample_rate_max = port.sample_rate_max,
+    };
+    errdefer ss.deinit();
+
+    try ss.formats.appendSlice(port.formats);
+    try ss.sample_rates.appendSlice(port.sample_rates);
+    try ss.channel_counts.appendSlice(port.channel_counts);
+    try ss.access_types.appendSlice(port.access_types);
+
+    return ss;
+}
+
+/// A `Port` borrowing the lists of `ss`, for `put`.
+pub fn portOf(stream_type: StreamType, device: i32, port_id: []const u8, ss: SupportedSettings) Port {
+    return .{
+        .stream_type = stream_type,
+        .device = device,
+        .id = port_id,
+        .formats = ss.formats.items,
+        .sample_rates = ss.sample_rates.items,
+        .channel_counts = ss.channel_counts.items,
+        .access_types = ss.access_types.items,
+        .sample_rate_min = ss.sample_rate_min,
+        .sample_rate_max = ss.sample_rate_max,
+    };
+}
+
+fn load(self: *CardCache) !void {
+    const arena = self.arena.allocator();
+    // strings of the parsed file may point into the data, both live in the arena
+    const data = try std.fs.cwd().readFileAlloc(arena, self.path.?, max_file_bytes);
+
+    const file = try std.json.parseFromSliceLeaky(File, arena, data, .{ .ignore_unknown_fields = true });
+
+    if (file.version != version) {
+        log.info("CardCache: Dropping cache of version {d}", .{file.version});
+        return;
+    }
+
+    try self.cards.appendSlice(file.cards);
+}
+
+fn indexOf(self: CardCache, card_id: []const u8, driver: []const u8) ?usize {
+    for (self.cards.items, 0..) |card, i| {
+        if (std.mem.eql(u8, card.id, card_id) and std.mem.eql(u8, card.driver, driver)) return i;
+    }
+
+    return null;
+}
+
+test "CardCache survives a round trip through its file and drops invalidated cards" {
+    const allocator = std.testing.allocator;
+
+    var path_buffer: [64]u8 = undefined;
+    const path = try std.fmt.bufPrint(&path_buffer, "/tmp/delia-cards-{d}.json", .{std.os.linux.getpid()});
+    defer std.fs.cwd().deleteFile(path) catch {};
+
+    const port = Port{
+        .stream_type = .playback,
+        .device = 0,
+        .id = "USB Audio",
+        .formats = &.{ .signed_16bits_little_endian, .signed_32bits_little_endian },
+        .sample_rates = &.{ .sr_44100, .sr_48000 },
+        .channel_counts = &.{.stereo},
+        .access_types = &.{ .mmap_interleaved, .rw_interleaved },
+        .sample_rate_min = 44100,
+        .sample_rate_max = 48000,
+    };
+
+    {
+        var cache = try CardCache.init(allocator, path);
+        defer cache.deinit();
+
+        try cache.put("Device", "USB-Audio", port);
+        try cache.put("PCH", "HDA-Intel", port);
+        try cache.save();
+    }
+
+    var cache = try CardCache.init(allocator, path);
+    defer cache.deinit();
+
+    const found = cache.find("Device", "USB-Audio", .playback, 0, "USB Audio") orelse return error.TestUnexpectedResult;
+    try std.testing.expectEqualSlices(SampleRate, port.sample_rates, found.sample_rates);
+    try std.testing.expectEqualSlices(AccessType, port.access_types, found.access_types);
+    try std.testing.expectEqual(48000, found.sample_rate_max);
+
+    // same id, another driver: another card
+    try std.testing.expect(cache.find("Device", "snd-usb-other", .playback, 0, "USB Audio") == null);
+    try std.testing.expect(cache.find("Device", "USB-Audio", .capture, 0, "USB Audio") == null);
+
+    var ss = try settingsOf(allocator, found);
+    defer ss.deinit();
+    try std.testing.expectEqual(SampleRate.sr_44100, ss.default(SampleRate).?);
+
+    cache.invalidate("Device", "USB-Audio");
+    try std.testing.expect(cache.find("Device", "USB-Audio", .playback, 0, "USB Audio") == null);
+    try std.testing.expect(cache.find("PCH", "HDA-Intel", .playback, 0, "USB Audio") != null);
+}
@@ -3,6 +3,10 @@
 //! and ports. This struct interacts with the ALSA API to gather and manage
 //! information about available audio cards and their capabilities.
 //!
+//! Listing cards and ports only takes control interface queries. Probing the supported settings of a port means
+//! opening its PCM, which is slow and blocks on busy devices, so by default it happens per card on first use.
+//! With `HardwareOptions.cache` its result is kept in a `CardCache` across runs.
+//!
 const std = @import("std");
 const log = std.log.scoped(.alsa);
 const utils = @import("../../utils/utils.zig");
@@ -14,6 +18,7 @@ const SampleRate = @import("../../common/audio_specs.zig").SampleRate;
 const ChannelCount = @import("settings.zig").ChannelCount;
 
 pub const AudioCard = @import("AudioCard.zig");
+pub const CardCache = @import("CardCache.zig");
 
 const c_alsa = @cImport({
     @cInclude("asoundlib.h");
@@ -30,6 +35,23 @@ const HardwareError = error{
 
 const FindBy = AudioCard.FindBy;
 
+pub const HardwareOptions = struct {
+    /// Probe the supported settings of a card when it is first looked up or selected instead of during init.
+    lazy: bool = true,
+    /// Keep probed settings on disk, keyed by card id and driver.
+    cache: bool = false,
+    /// Cache file, `CardCache.defaultPath` when null.
+    cache_path: ?[]const u8 = null,
+    /// Keep the control interface of every card open and subscribed to its events, see `pollChanges`.
+    watch: bool = false,
+};
+
+const CardEvent = enum {
+    none,
+    changed,
+    removed,
+};
+
 /// A list of audio cards detected on the system.
 cards: std.ArrayList(AudioCard),
 /// Index of the currently selected audio card.
@@ -41,17 +63,54 @@ selected_stream_type: StreamType = StreamType.playback,
 /// The total number of audio cards detected on the system.
 card_count: usize = 0,
 
+/// Cards are probed on first use, see `HardwareOptions.lazy`.
+lazy: bool = false,
+/// Shared by every card, heap allocated so lookups through a copy of `Hardware` can still fill it.
+cache: ?*CardCache = null,
+/// Cards keep their control interface open, see `pollChanges`.
+watch: bool = false,
+/// All system cards were loaded, as opposed to a single one by `initCard`.
+enumerated: bool = false,
+
 allocator: std.mem.Allocator,
 
 /// Initializes the `Hardware` struct, gathering information about the
-/// available audio cards on the system.
+/// available audio cards on the system with the default `HardwareOptions`.
 ///
 /// - `allocator`: The memory allocator to be used for dynamic allocations.
 /// - Returns: An initialized `Hardware` struct.
 /// - Errors: Can return errors related to ALSA operations or memory allocations.
 pub fn init(allocator: std.mem.Allocator) !Hardware {
-    var alsa = Hardware{ .cards = std.ArrayList(AudioCard).init(allocator), .allocator = allocator };
+    return initWithOptions(allocator, .{});
+}
+
+/// Same as `init` with explicit `HardwareOptions`, e.g. `.{ .lazy = false }` to probe every port up front the way
+/// it used to be, or `.{ .cache = true, .watch = true }` for a long running host.
+pub fn initWithOptions(allocator: std.mem.Allocator, opts: HardwareOptions) !Hardware {
+    var alsa = try create(allocator, opts);
+    errdefer alsa.deinit();
+
     try loadSystemCards(&alsa);
+    alsa.enumerated = true;
+    alsa.saveCache();
+
+    return alsa;
+}
+
+/// Loads only the card of `ident`, e.g. `hw:1`, `hw:1,0` or `hw:CARD=USB,DEV=0`, and selects it. No other card is
+/// opened, the fastest way to a known device.
+///
+/// - Errors: Returns an error if the identifier is invalid or no such card exists.
+pub fn initCard(allocator: std.mem.Allocator, ident: []const u8, opts: HardwareOptions) !Hardware {
+    try validateIdentifier(ident);
+
+    var alsa = try create(allocator, opts);
+    errdefer alsa.deinit();
+
+    try alsa.loadCard(try cardIndexOf(ident));
+    try errWhenEmpty(alsa.cards.items.len);
+
+    alsa.probeAt(0);
     return alsa;
 }
 
@@ -61,6 +120,82 @@ pub fn deinit(self: *Hardware) void {
     }
 
     self.cards.deinit();
+
+    if (self.cache) |cache| {
+        cache.deinit();
+        self.allocator.destroy(cache);
+    }
+}
+
+/// Drains the pending control events of every card without blocking, and picks up cards plugged in since.
+/// A card that went away is dropped, a card whose controls were added or removed is listed again. Either way its
+/// cache entry is invalidated, so its ports are probed again. Needs `HardwareOptions.watch`.
+///
+/// - Returns: true when the card list changed, the selection is then reset if the selected card was removed.
+/// - Errors: Can return errors related to ALSA operations or memory allocations.
+pub fn pollChanges(self: *Hardware) !bool {
+    if (!self.watch) return false;
+
+    var changed = false;
+    var i: usize = 0;
+
+    while (i < self.cards.items.len) {
+        const card = &self.cards.items[i];
+
+        switch (readEvents(card.ctl)) {
+            .none => {
+                i += 1;
+            },
+            .changed => {
+                log.info("Hardware: Card {s} changed", .{card.details.identifier});
+
+                const index = card.details.index;
+                const len = self.cards.items.len;
+                self.removeCardAt(i);
+
+                // listed again in place, unless it can no longer be queried
+                self.loadCardAt(index, i) catch |err| {
+                    self.forgetSelection(i);
+                    return err;
+                };
+
+                if (self.cards.items.len == len) {
+                    if (i == self.selected_card) self.probeAt(i);
+                    i += 1;
+                } else {
+                    self.forgetSelection(i);
+                }
+
+                changed = true;
+            },
+            .removed => {
+                log.info("Hardware: Card {s} removed", .{card.details.identifier});
+
+                self.removeCardAt(i);
+                self.forgetSelection(i);
+                changed = true;
+            },
+        }
+    }
+
+    if (self.enumerated) {
+        var index: c_int = -1;
+
+        while (c_alsa.snd_card_next(&index) >= 0 and index >= 0) {
+            if (self.hasCard(index)) continue;
+
+            const before = self.cards.items.len;
+            try self.loadCard(index);
+
+            if (self.cards.items.len > before) {
+                log.info("Hardware: Card {s} added", .{self.cards.items[before].details.identifier});
+                changed = true;
+            }
+        }
+    }
+
+    self.saveCache();
+    return changed;
 }
 /// Retrieves an `AudioCard` by its index in the list of detected cards.
 ///
@@ -72,6 +207,7 @@ pub fn getAudioCardAt(self: Hardware, at: usize) HardwareError!AudioCard {
         return HardwareError.cards_out_of_bounds;
     }
 
+    self.probeAt(at);
     return self.cards.items[at];
 }
 
@@ -80,7 +216,7 @@ pub fn getAudioCardAt(self: Hardware, at: usize) HardwareError!AudioCard {
 ///  - `pattern`: The pattern to search for.
 ///  - Returns: The first `AudioCard` that matches the pattern or `null` if no match is found.
 pub fn findCardBy(self: Hardware, by: FindBy, pattern: []const u8) ?AudioCard {
-    for (self.cards.items) |card| {
+    for (self.cards.items, 0..) |card, i| {
         const haystack = switch (by) {
             FindBy.name => card.details.name,
             FindBy.id => card.details.id,
@@ -93,7 +229,10 @@ pub fn findCardBy(self: Hardware, by: FindBy, pattern: []const u8) ?AudioCard {
         );
 
         // return the first match
-        if (matches) |_| return card;
+        if (matches) |_| {
+            self.probeAt(i);
+            return self.cards.items[i];
+        }
     }
 
     return null;
@@ -107,20 +246,22 @@ pub fn findCardBy(self: Hardware, by: FindBy, pattern: []const u8) ?AudioCard {
 pub fn getAudioCardByIdent(self: Hardware, ident: []const u8) HardwareError!AudioCard {
     try validateIdentifier(ident);
 
-    for (self.cards.items) |card| {
+    for (self.cards.items, 0..) |card, at| {
 
         // first we try to match the identifier just with the card index e.g. hw:0
         var split = std.mem.split(u8, card.details.identifier, ",");
 
         if (split.next()) |i| {
             if (std.mem.eql(u8, ident, i)) {
-                return card;
+                self.probeAt(at);
+                return self.cards.items[at];
             }
         }
 
         // then, in case the user is trying to match with also the device/port identifier e.g. hw:0,0
         if (std.mem.eql(u8, card.details.identifier, ident)) {
-            return card;
+            self.probeAt(at);
+            return self.cards.items[at];
         }
     }
 
@@ -137,6 +278,7 @@ pub fn selectAudioCardAt(self: *Hardware, at: usize) !void {
     }
 
     self.selected_card = at;
+    self.probeAt(at);
 }
 
 /// Selects an audio card by matching a pattern to `.name` or `id`.
@@ -159,6 +301,7 @@ pub fn selectAudioCardBy(self: *Hardware, by: FindBy, pattern: []const u8) !void
 
         if (matches) |_| {
             self.selected_card = i;
+            self.probeAt(i);
             return;
         }
     }
@@ -176,6 +319,7 @@ pub fn selectAudioCardByIdent(self: *Hardware, ident: []const u8) HardwareError!
     for (0.., self.cards.items) |i, card| {
         if (std.mem.eql(u8, card.details.identifier, ident)) {
             self.selected_card = i;
+            self.probeAt(i);
             return;
         }
     }
@@ -190,6 +334,7 @@ pub fn selectAudioCardByIdent(self: *Hardware, ident: []const u8) HardwareError!
 /// - Errors: Returns an error if the index is out of bounds or if no cards are available.
 pub fn selectAudioPortAt(self: *Hardware, stream_type: StreamType, at: usize) !void {
     try errWhenEmpty(self.cards.items.len);
+    self.probeAt(self.selected_card);
 
     const selected_card = self.cards.items[self.selected_card];
 
@@ -217,6 +362,7 @@ pub fn selectAudioPortAt(self: *Hardware, stream_type: StreamType, at: usize) !v
 pub fn selectAudioPortByIdent(self: *Hardware, stream_type: StreamType, ident: []const u8) !void {
     try validateIdentifier(ident);
     try errWhenEmpty(self.cards.items.len);
+    self.probeAt(self.selected_card);
 
     const selected_card = self.cards.items[self.selected_card];
     self.selected_port = try selected_card.getIndexOf(stream_type, ident);
@@ -225,6 +371,7 @@ pub fn selectAudioPortByIdent(self: *Hardware, stream_type: StreamType, ident: [
 
 pub fn selectAudioPortBy(self: *Hardware, stream_type: StreamType, by: FindBy, pattern: []const u8) !void {
     try errWhenEmpty(self.cards.items.len);
+    self.probeAt(self.selected_card);
 
     const selected_card = self.cards.items[self.selected_card];
 
@@ -250,6 +397,7 @@ pub fn selectAudioPortBy(self: *Hardware, stream_type: StreamType, by: FindBy, p
 /// - Errors: Returns an error if no cards are available.
 pub fn getSelectedAudioCard(self: Hardware) HardwareError!AudioCard {
     try errWhenEmpty(self.cards.items.len);
+    self.probeAt(self.selected_card);
     return self.cards.items[self.selected_card];
 }
 
@@ -259,6 +407,7 @@ pub fn getSelectedAudioCard(self: Hardware) HardwareError!AudioCard {
 /// - Errors: Returns an error if no cards are available
 pub fn getSelectedAudioPort(self: Hardware) !AudioCard.AudioCardInfo {
     try errWhenEmpty(self.cards.items.len);
+    self.probeAt(self.selected_card);
 
     const card = self.cards.items[self.selected_card];
 
@@ -301,6 +450,7 @@ pub fn getSelectedAudioPortCounterpart(self: Hardware) !AudioCard.AudioCardInfo
 /// - Errors: Returns an error if no cards are available or if the channel count is invalid or not supported.
 pub fn setSelectedChannelCount(self: *Hardware, channel_count: ChannelCount) !void {
     try errWhenEmpty(self.cards.items.len);
+    self.probeAt(self.selected_card);
 
     var card = self.cards.items[self.selected_card];
     try card.setChannelCount(self.selected_stream_type, self.selected_port, channel_count);
@@ -312,6 +462,7 @@ pub fn setSelectedChannelCount(self: *Hardware, channel_count: ChannelCount) !vo
 /// - Errors: Returns an error if no cards are available or if the format is invalid or not supported.
 pub fn setSelectedFormat(self: *Hardware, fmt: FormatType) !void {
     try errWhenEmpty(self.cards.items.len);
+    self.probeAt(self.selected_card);
 
     var card = self.cards.items[self.selected_card];
     try card.setFormat(self.selected_stream_type, self.selected_port, fmt);
@@ -323,6 +474,7 @@ pub fn setSelectedFormat(self: *Hardware, fmt: FormatType) !void {
 /// - Errors: Returns an error if no cards are available or if the sample rate is invalid or not supported.
 pub fn setSelectedSampleRate(self: *Hardware, sample_rate: SampleRate) !void {
     try errWhenEmpty(self.cards.items.len);
+    self.probeAt(self.selected_card);
 
     var card = self.cards.items[self.selected_card];
     try card.setSampleRate(self.selected_stream_type, self.selected_port, sample_rate);
@@ -341,6 +493,16 @@ pub fn format(self: Hardware, comptime fmt: []const u8, options: std.fmt.FormatO
     }
 }
 
+/// Probes every card still pending, e.g. before printing the whole `Hardware`. Opens every PCM, so this is as slow
+/// as a `.lazy = false` init.
+pub fn probeAll(self: *Hardware) void {
+    for (self.cards.items) |*card| {
+        if (card.probe_pending) card.probe(self.cache);
+    }
+
+    self.saveCache();
+}
+
 // Private
 
 fn validateIdentifier(ident: []const u8) HardwareError!void {
@@ -357,51 +519,202 @@ fn addCard(self: *Hardware, card: AudioCard) !void {
     try self.cards.append(card);
 }
 
+fn create(allocator: std.mem.Allocator, opts: HardwareOptions) !Hardware {
+    var alsa = Hardware{
+        .cards = std.ArrayList(AudioCard).init(allocator),
+        .allocator = allocator,
+        .lazy = opts.lazy,
+        .watch = opts.watch,
+    };
+    errdefer alsa.deinit();
+
+    if (opts.cache) {
+        const default_path = if (opts.cache_path == null) try CardCache.defaultPath(allocator) else null;
+        defer if (default_path) |p| allocator.free(p);
+
+        const cache = try allocator.create(CardCache);
+        errdefer allocator.destroy(cache);
+
+        cache.* = try CardCache.init(allocator, opts.cache_path orelse default_path);
+        alsa.cache = cache;
+    }
+
+    return alsa;
+}
+
 fn loadSystemCards(self: *Hardware) !void {
     var card: c_int = -1;
 
     while (c_alsa.snd_card_next(&card) >= 0 and card >= 0) {
-        var ctl: ?*c_alsa.snd_ctl_t = null;
-        var buffer: [32]u8 = undefined;
+        try self.loadCard(card);
+    }
+}
 
-        const card_name = try std.fmt.bufPrintZ(&buffer, "hw:{d}", .{card});
-        var res = c_alsa.snd_ctl_open(&ctl, card_name, 0);
+fn loadCard(self: *Hardware, card: c_int) !void {
+    try self.loadCardAt(card, self.cards.items.len);
+}
 
-        if (res < 0) {
-            log.warn("Failed to open control interface for card {d}: {s}", .{ card, c_alsa.snd_strerror(res) });
-            continue;
-        }
+// lists the card and its ports at `at` in `cards`, a card that cannot be queried is skipped
+fn loadCardAt(self: *Hardware, card: c_int, at: usize) !void {
+    var ctl: ?*c_alsa.snd_ctl_t = null;
+    var buffer: [32]u8 = undefined;
 
-        var info: ?*c_alsa.snd_ctl_card_info_t = null;
-        res = c_alsa.snd_ctl_card_info_malloc(&info);
+    const card_name = try std.fmt.bufPrintZ(&buffer, "hw:{d}", .{card});
+    // events are drained by `pollChanges`, which must never block
+    var res = c_alsa.snd_ctl_open(&ctl, card_name, if (self.watch) @as(c_int, c_alsa.SND_CTL_NONBLOCK) else 0);
 
-        if (res < 0) {
-            log.warn("Failed to allocate card info for card {d}: {s}", .{ card, c_alsa.snd_strerror(res) });
-            continue;
-        }
+    if (res < 0) {
+        log.warn("Failed to open control interface for card {d}: {s}", .{ card, c_alsa.snd_strerror(res) });
+        return;
+    }
 
-        defer c_alsa.snd_ctl_card_info_free(info);
+    var keep_ctl = false;
 
-        res = c_alsa.snd_ctl_card_info(ctl, info);
+    defer if (!keep_ctl) {
+        res = c_alsa.snd_ctl_close(ctl);
 
         if (res < 0) {
-            log.warn("Failed to get card info for card {d}: {s}", .{ card, c_alsa.snd_strerror(res) });
-            continue;
+            log.warn("Failed to close control interface for card {d}: {s}", .{ card, c_alsa.snd_strerror(res) });
         }
+    };
 
-        const card_details = try AudioCard.AudioCardInfo.init(self.allocator, .{ .card = card, .device = -1 }, c_alsa.snd_ctl_card_info_get_id(info), c_alsa.snd_ctl_card_info_get_name(info));
-        var alsa_card = AudioCard.init(self.allocator, card_details);
+    var info: ?*c_alsa.snd_ctl_card_info_t = null;
+    res = c_alsa.snd_ctl_card_info_malloc(&info);
 
-        alsa_card = (try getCard(&alsa_card, ctl, StreamType.playback)).*;
-        alsa_card = (try getCard(&alsa_card, ctl, StreamType.capture)).*;
+    if (res < 0) {
+        log.warn("Failed to allocate card info for card {d}: {s}", .{ card, c_alsa.snd_strerror(res) });
+        return;
+    }
 
-        try self.addCard(alsa_card);
-        res = c_alsa.snd_ctl_close(ctl);
+    defer c_alsa.snd_ctl_card_info_free(info);
 
-        if (res < 0) {
-            log.warn("Failed to close control interface for card {d}: {s}", .{ card, c_alsa.snd_strerror(res) });
+    res = c_alsa.snd_ctl_card_info(ctl, info);
+
+    if (res < 0) {
+        log.warn("Failed to get card info for card {d}: {s}", .{ card, c_alsa.snd_strerror(res) });
+        return;
+    }
+
+    const card_details = try AudioCard.AudioCardInfo.init(self.allocator, .{ .card = card, .device = -1 }, c_alsa.snd_ctl_card_info_get_id(info), c_alsa.snd_ctl_card_info_get_name(info));
+    var alsa_card = AudioCard.init(self.allocator, card_details);
+    errdefer alsa_card.deinit();
+
+    alsa_card.driver = try self.allocator.dupe(u8, std.mem.span(c_alsa.snd_ctl_card_info_get_driver(info)));
+
+    _ = try getCard(&alsa_card, ctl, StreamType.playback);
+    _ = try getCard(&alsa_card, ctl, StreamType.capture);
+
+    if (self.lazy) {
+        alsa_card.probe_pending = true;
+    } else {
+        alsa_card.probe(self.cache);
+    }
+
+    try self.cards.insert(at, alsa_card);
+
+    if (!self.watch) return;
+
+    res = c_alsa.snd_ctl_subscribe_events(ctl, 1);
+
+    if (res < 0) {
+        log.warn("Failed to subscribe to events of card {d}: {s}", .{ card, c_alsa.snd_strerror(res) });
+        return;
+    }
+
+    // the card owns the control interface from here on
+    self.cards.items[at].ctl = ctl;
+    keep_ctl = true;
+}
+
+// probes the card at `at` when it is still pending. Through a copy of `Hardware` as well, the cards and the cache
+// are shared.
+fn probeAt(self: Hardware, at: usize) void {
+    if (at >= self.cards.items.len) return;
+
+    const card = &self.cards.items[at];
+    if (!card.probe_pending) return;
+
+    card.probe(self.cache);
+    self.saveCache();
+}
+
+fn saveCache(self: Hardware) void {
+    const cache = self.cache orelse return;
+
+    cache.save() catch |err| {
+        log.warn("Failed to save the card cache: {s}", .{@errorName(err)});
+    };
+}
+
+fn removeCardAt(self: *Hardware, at: usize) void {
+    var card = self.cards.orderedRemove(at);
+    if (self.cache) |cache| cache.invalidate(card.details.id, card.driver);
+
+    card.deinit();
+}
+
+// keeps the selection on the same card after the card at `removed` is gone
+fn forgetSelection(self: *Hardware, removed: usize) void {
+    if (removed == self.selected_card) {
+        self.selected_card = 0;
+        self.selected_port = 0;
+    } else if (removed < self.selected_card) {
+        self.selected_card -= 1;
+    }
+}
+
+fn hasCard(self: Hardware, index: c_int) bool {
+    for (self.cards.items) |card| {
+        if (card.details.index == index) return true;
+    }
+
+    return false;
+}
+
+fn readEvents(ctl: ?*c_alsa.snd_ctl_t) CardEvent {
+    const handle = ctl orelse return .none;
+
+    var event: ?*c_alsa.snd_ctl_event_t = null;
+    if (c_alsa.snd_ctl_event_malloc(&event) < 0) return .none;
+    defer c_alsa.snd_ctl_event_free(event);
+
+    var result = CardEvent.none;
+
+    while (true) {
+        const res = c_alsa.snd_ctl_read(handle, event);
+
+        // the card is gone, e.g. USB unplugged
+        if (res == -c_alsa.ENODEV) return .removed;
+        // -EAGAIN, nothing pending
+        if (res <= 0) break;
+
+        if (c_alsa.snd_ctl_event_get_type(event) != c_alsa.SND_CTL_EVENT_ELEM) continue;
+
+        // value and info changes are mixer activity, the card only changes when controls come or go
+        const mask = c_alsa.snd_ctl_event_elem_get_mask(event);
+
+        if (mask == c_alsa.SND_CTL_EVENT_MASK_REMOVE or (mask & c_alsa.SND_CTL_EVENT_MASK_ADD) != 0) {
+            result = .changed;
         }
     }
+
+    return result;
+}
+
+// the card part of an identifier, an index or an ALSA id, e.g. `hw:1,0` or `hw:CARD=USB,DEV=0`
+fn cardIndexOf(ident: []const u8) HardwareError!c_int {
+    var split = std.mem.splitScalar(u8, ident[3..], ',');
+    var name = split.first();
+
+    if (std.mem.startsWith(u8, name, "CARD=")) name = name["CARD=".len..];
+
+    var buffer: [64]u8 = undefined;
+    const name_z = std.fmt.bufPrintZ(&buffer, "{s}", .{name}) catch return HardwareError.invalid_identifier;
+
+    const index = c_alsa.snd_card_get_index(name_z);
+    if (index < 0) return HardwareError.card_not_found;
+
+    return index;
 }
 
 fn getCard(card: *AudioCard, ctl: ?*c_alsa.snd_ctl_t, stream_type: StreamType) !*AudioCard {
@@ -695,6 +1008,68 @@ test "getSelectedAudioPortCounterpart finds counterpart or returns error" {
     try std.testing.expectError(HardwareError.no_port_counterpart_available, result);
 }
 
+test "lazy cards are probed from the cache on first lookup" {
+    const allocator = std.testing.allocator;
+    const AudioCardInfo = AudioCard.AudioCardInfo;
+
+    var cache = try CardCache.init(allocator, null);
+
+    var hardware = Hardware{
+        .cards = std.ArrayList(AudioCard).init(allocator),
+        .allocator = allocator,
+        .lazy = true,
+        .cache = &cache,
+    };
+
+    defer {
+        // the cache is not owned here
+        hardware.cache = null;
+        hardware.deinit();
+        cache.deinit();
+    }
+
+    try cache.put("someid", "USB-Audio", .{
+        .stream_type = .playback,
+        .device = 0,
+        .id = "playback_id",
+        .formats = &.{.signed_16bits_little_endian},
+        .sample_rates = &.{.sr_48000},
+        .channel_counts = &.{.stereo},
+        .access_types = &.{.mmap_interleaved},
+        .sample_rate_min = 48000,
+        .sample_rate_max = 48000,
+    });
+
+    var card = AudioCard.init(allocator, try AudioCardInfo.init(allocator, .{ .card = 0, .device = -1 }, "someid", "Card 1"));
+    card.driver = try allocator.dupe(u8, "USB-Audio");
+    card.probe_pending = true;
+
+    var playback = try AudioCardInfo.init(allocator, .{ .card = 0, .device = 0 }, "playback_id", "Playback 1");
+    playback.stream_type = .playback;
+    try card.playbacks.append(playback);
+
+    try hardware.cards.append(card);
+
+    // listed, not probed yet
+    try std.testing.expect(hardware.cards.items[0].playbacks.items[0].supported_settings == null);
+
+    // printing shows the pending state without probing
+    const printed = try std.fmt.allocPrint(allocator, "{s}", .{hardware});
+    defer allocator.free(printed);
+    try std.testing.expect(std.mem.indexOf(u8, printed, "not probed") != null);
+    try std.testing.expect(hardware.cards.items[0].probe_pending);
+
+    const found = hardware.findCardBy(FindBy.name, "Card 1") orelse return error.TestUnexpectedResult;
+    const port = try found.getPlaybackAt(0);
+
+    try std.testing.expect(!hardware.cards.items[0].probe_pending);
+    try std.testing.expectEqual(SampleRate.sr_48000, port.selected_settings.sample_rate.?);
+    try std.testing.expectEqual(ChannelCount.stereo, port.selected_settings.channels.?);
+
+    try hardware.setSelectedSampleRate(.sr_48000);
+    try std.testing.expectError(AudioCard.CardError.invalid_settings, hardware.setSelectedSampleRate(.sr_44100));
+}
+
 // TOO: Maybe one day expose mixer info in alsa AudioCard, but to be honest
 // the information here is still limited other then knowing the the channel configuration names
 // For USB audio maybe we need udevlib to get more descriptive information
@@ -0,0 +1,766 @@
+//! One logical device over several PCMs, e.g. a rig of USB interfaces. The channels of every capture member and of
+//! every playback member are presented as two buffers to a single callback, serviced from one thread:
+//!
+//!     var aggregate = try AggregateDevice(Ctx, .{ .format = .signed_32bits_little_endian }).init(allocator, &.{ interface_a, interface_b, interface_c }, &ctx, onBlock, .{});
+//!     defer aggregate.deinit();
+//!     try aggregate.run();
+//!
+//! The cards run on their own crystals. The clock master paces the loop, every other member goes through a variable
+//! ratio resampler driven by a `DriftController`, the same compensation as unlinked full duplex devices.
+
+const std = @import("std");
+
+const c_alsa = @cImport({
+    @cInclude("asoundlib.h");
+});
+
+const driver = @import("driver.zig");
+const drift = @import("drift.zig");
+const resampler = @import("../../dsp/resampler.zig");
+const audio_buffer = @import("../../common/audio_buffer.zig");
+const realtime = @import("../../common/realtime.zig");
+const telemetry = @import("../../common/telemetry.zig");
+const null_config = @import("null_config.zig");
+const GenericAudioData = @import("audio_data.zig").GenericAudioData;
+
+const log = std.log.scoped(.alsa);
+
+const AudioLoopError = driver.AudioLoopError;
+
+pub const AggregateError = error{
+    no_members,
+    clock_master,
+    sample_rate,
+    buffer_size,
+    access_type,
+    poll_descriptors,
+} || std.mem.Allocator.Error;
+
+pub const AggregateOptions = struct {
+    /// Index in the members of the device whose clock paces the aggregate. The others are resampled to follow it.
+    clock_master: usize = 0,
+    /// Layout of the capture and playback buffers handed to the callback.
+    access: audio_buffer.AccessPattern = .non_interleaved,
+    /// Drift compensation of every member but the clock master, see `DriftOptions`.
+    drift: driver.DriftOptions = .{},
+    /// Poll timeout in milliseconds, negative waits for the clock master forever.
+    timeout: i32 = 1000,
+    /// Applied to the thread calling `run`, see `HalfDuplexDeviceOptions.realtime`.
+    realtime: ?driver.RealtimeOptions = null,
+    /// See `HalfDuplexDeviceOptions.telemetry`, cycles are timed on the clock master. Mirrors the health of every
+    /// member, which replaces the telemetry the members were initialized with.
+    telemetry: ?*driver.LoopTelemetry = null,
+};
+
+/// Members are prepared `HalfDuplexDevice`s owned by the caller, with the same sample rate and buffer size and an
+/// interleaved access type. Transfers copy through `snd_pcm_mmap_readi`/`snd_pcm_mmap_writei` for mmap members:
+/// every member is converted and possibly resampled on its way to the aggregate buffers anyway.
+pub fn AggregateDevice(ContextType: type, comptime comptime_opts: driver.DeviceComptimeOptions) type {
+    return struct {
+        const Self = @This();
+
+        pub const Device = driver.HalfDuplexDevice(ContextType, comptime_opts);
+        const AudioData = GenericAudioData(comptime_opts.format);
+        const Float = AudioData.FloatType();
+        const Resampler = resampler.Resampler(Float);
+        pub const View = audio_buffer.UnmanagedChannelView(Float);
+
+        /// `in` holds the channels of the capture members, `out` those of the playback members, in member order.
+        pub const AudioCallback = *const fn (ctx: *ContextType, in: View, out: View) void;
+
+        // silence queued on the playback members before they start, and frames left in the resampled capture members
+        // after each read: the margin for the period granularity of two unrelated clocks
+        const prime_periods = 2;
+
+        const Member = struct {
+            device: Device,
+            // first channel in the aggregate buffer of its stream type
+            first_channel: usize,
+            // encoded frames of the member, decoded or resampled frames
+            raw: []u8,
+            frames: []Float,
+            // one interleaved block at the rate of the clock master
+            block: []Float,
+            // null for the clock master
+            resampler: ?Resampler,
+            controller: drift.DriftController,
+            ratio: f64 = 1,
+            // resampled capture members are silent until `prime_periods` are captured
+            primed: bool = false,
+
+            fn frameBytes(self: Member) usize {
+                return AudioData.sample_bytes * self.device.channels;
+            }
+        };
+
+        allocator: std.mem.Allocator,
+        members: []Member,
+        master: usize,
+        block_size: usize,
+        access: audio_buffer.AccessPattern,
+        // aggregate channels, planar, copied to and from the interleaved buffers for interleaved callbacks
+        in_planar: []Float,
+        out_planar: []Float,
+        in_interleaved: []Float,
+        out_interleaved: []Float,
+        // descriptors of the clock master
+        fds: []std.posix.pollfd,
+        ctx: *ContextType,
+        callback: AudioCallback,
+        opts: AggregateOptions,
+        running: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+
+        pub fn init(allocator: std.mem.Allocator, devices: []const Device, ctx: *ContextType, callback: AudioCallback, opts: AggregateOptions) AggregateError!Self {
+            if (devices.len == 0) return AggregateError.no_members;
+            if (opts.clock_master >= devices.len) return AggregateError.clock_master;
+
+            const master = devices[opts.clock_master];
+            const block: usize = @intFromEnum(master.buffer_size);
+
+            var n_inputs: usize = 0;
+            var n_outputs: usize = 0;
+
+            for (devices) |device| {
+                if (device.sample_rate != master.sample_rate) {
+                    log.err("Aggregate members must share the sample rate: {d}hz and {d}hz", .{ device.sample_rate, master.sample_rate });
+                    return AggregateError.sample_rate;
+                }
+
+                if (device.buffer_size != master.buffer_size) {
+                    log.err("Aggregate members must share the buffer size", .{});
+                    return AggregateError.buffer_size;
+                }
+
+                switch (device.access_type) {
+                    .mmap_interleaved, .rw_interleaved => {},
+                    else => {
+                        log.err("Unsupported access type for an aggregate member: {s}", .{@tagName(device.access_type)});
+                        return AggregateError.access_type;
+                    },
+                }
+
+                if (device.stream_type == .capture) n_inputs += device.channels else n_outputs += device.channels;
+            }
+
+            const members = try allocator.alloc(Member, devices.len);
+            errdefer allocator.free(members);
+
+            var n_initialized: usize = 0;
+            errdefer for (members[0..n_initialized]) |*member| freeMember(allocator, member);
+
+            var next_input: usize = 0;
+            var next_output: usize = 0;
+
+            for (devices, 0..) |device, i| {
+                const is_master = i == opts.clock_master;
+                const channels: usize = device.channels;
+
+                var rs: ?Resampler = if (is_master) null else try Resampler.init(allocator, .{ .channels = channels, .max_block_frames = block });
+                errdefer if (rs) |*r| r.deinit();
+
+                const capacity = if (rs) |r| r.capacity else block;
+
+                const raw = try allocator.alloc(u8, capacity * AudioData.sample_bytes * channels);
+                errdefer allocator.free(raw);
+
+                const frames = try allocator.alloc(Float, capacity * channels);
+                errdefer allocator.free(frames);
+
+                const block_frames = try allocator.alloc(Float, block * channels);
+
+                const first_channel = if (device.stream_type == .capture) next_input else next_output;
+                if (device.stream_type == .capture) next_input += channels else next_output += channels;
+
+                members[i] = .{
+                    .device = device,
+                    .first_channel = first_channel,
+                    .raw = raw,
+                    .frames = frames,
+                    .block = block_frames,
+                    .resampler = rs,
+                    .controller = drift.DriftController.init(opts.drift, device.sample_rate),
+                };
+                n_initialized += 1;
+            }
+
+            const in_planar = try allocator.alloc(Float, n_inputs * block);
+            errdefer allocator.free(in_planar);
+
+            const out_planar = try allocator.alloc(Float, n_outputs * block);
+            errdefer allocator.free(out_planar);
+
+            const interleaved = opts.access == .interleaved;
+
+            const in_interleaved = try allocator.alloc(Float, if (interleaved) n_inputs * block else 0);
+            errdefer allocator.free(in_interleaved);
+
+            const out_interleaved = try allocator.alloc(Float, if (interleaved) n_outputs * block else 0);
+            errdefer allocator.free(out_interleaved);
+
+            @memset(in_planar, 0);
+            @memset(out_planar, 0);
+
+            const fds = try pollDescriptors(allocator, master.pcm_handle);
+
+            if (opts.telemetry) |t| for (devices) |device| {
+                device.health.mirror = &t.health;
+            };
+
+            return .{
+                .allocator = allocator,
+                .members = members,
+                .master = opts.clock_master,
+                .block_size = block,
+                .access = opts.access,
+                .in_planar = in_planar,
+                .out_planar = out_planar,
+                .in_interleaved = in_interleaved,
+                .out_interleaved = out_interleaved,
+                .fds = fds,
+                .ctx = ctx,
+                .callback = callback,
+                .opts = opts,
+            };
+        }
+
+        /// Frees the aggregate buffers, the member devices stay with the caller.
+        pub fn deinit(self: *Self) void {
+            for (self.members) |*member| freeMember(self.allocator, member);
+
+            self.allocator.free(self.members);
+            self.allocator.free(self.in_planar);
+            self.allocator.free(self.out_planar);
+            self.allocator.free(self.in_interleaved);
+            self.allocator.free(self.out_interleaved);
+            self.allocator.free(self.fds);
+        }
+
+        pub fn inputChannels(self: Self) usize {
+            return self.in_planar.len / self.block_size;
+        }
+
+        pub fn outputChannels(self: Self) usize {
+            return self.out_planar.len / self.block_size;
+        }
+
+        /// Starts every member and services them on the calling thread until `stop` or an unrecoverable error.
+        pub fn run(self: *Self) AudioLoopError!void {
+            const applied = if (self.opts.realtime) |opts| blk: {
+                for (self.members) |member| {
+                    realtime.prefault(member.raw);
+                    realtime.prefault(std.mem.sliceAsBytes(member.frames));
+                }
+                break :blk realtime.apply(opts);
+            } else null;
+            defer if (applied) |a| a.restore();
+
+            if (self.opts.telemetry) |t| {
+                const master = self.members[self.master].device;
+                t.setPeriod(self.block_size, master.sample_rate);
+                t.setLatency(master.latencyFrames(), master.sample_rate);
+            }
+
+            self.running.store(true, .release);
+
+            for (self.members) |*member| try self.restart(member);
+
+            while (self.running.load(.acquire)) {
+                const ready = std.posix.poll(self.fds, self.opts.timeout) catch |err| {
+                    log.err("Poll failed: {s}", .{@errorName(err)});
+                    return AudioLoopError.unexpected;
+                };
+
+                if (ready == 0) {
+                    log.warn("Clock master not ready after {d}ms", .{self.opts.timeout});
+                    continue;
+                }
+
+                if (!try self.masterReady()) continue;
+
+                try self.cycle();
+            }
+        }
+
+        /// Makes `run` return after the current cycle. Safe from any thread.
+        pub fn stop(self: *Self) void {
+            self.running.store(false, .release);
+        }
+
+        // a block is available on the clock master
+        fn masterReady(self: *Self) AudioLoopError!bool {
+            const master = &self.members[self.master];
+            var revents: c_ushort = 0;
+
+            const err = c_alsa.snd_pcm_poll_descriptors_revents(master.device.pcm_handle, @ptrCast(self.fds.ptr), @intCast(self.fds.len), &revents);
+
+            if (err < 0) {
+                log.err("Failed to get the poll events: {s}", .{c_alsa.snd_strerror(err)});
+                return AudioLoopError.unexpected;
+            }
+
+            if (revents == 0) return false;
+
+            const avail = c_alsa.snd_pcm_avail_update(master.device.pcm_handle);
+
+            if (avail < 0) {
+                try self.recover(master, avail);
+                return false;
+            }
+
+            return avail >= self.block_size;
+        }
+
+        fn cycle(self: *Self) AudioLoopError!void {
+            if (self.opts.telemetry) |t| t.wake(telemetry.monotonicNs());
+
+            for (self.members) |*member| {
+                if (member.device.stream_type == .capture) try self.capture(member);
+            }
+
+            const channels_in = self.inputChannels();
+            const channels_out = self.outputChannels();
+
+            const in = if (self.access == .interleaved) blk: {
+                gather(Float, self.in_planar, 0, self.in_interleaved, channels_in, self.block_size);
+                break :blk self.view(self.in_interleaved, channels_in);
+            } else self.view(self.in_planar, channels_in);
+
+            const out = self.view(if (self.access == .interleaved) self.out_interleaved else self.out_planar, channels_out);
+
+            if (self.opts.telemetry) |t| t.callbackStart();
+            self.callback(self.ctx, in, out);
+            if (self.opts.telemetry) |t| t.callbackEnd();
+
+            if (self.access == .interleaved) scatter(Float, self.out_interleaved, channels_out, self.out_planar, 0, self.block_size);
+
+            for (self.members) |*member| {
+                if (member.device.stream_type == .playback) try self.play(member);
+            }
+
+            for (self.members) |*member| self.track(member);
+        }
+
+        // one block of the member into its channels of the capture buffer, silence while it is not ready
+        fn capture(self: *Self, member: *Member) AudioLoopError!void {
+            const channels: usize = member.device.channels;
+            const frame_bytes = member.frameBytes();
+
+            if (member.resampler) |*rs| {
+                if (!member.primed) {
+                    const avail = c_alsa.snd_pcm_avail_update(member.device.pcm_handle);
+                    if (avail < 0) try self.recover(member, avail);
+
+                    member.primed = avail >= prime_periods * self.block_size;
+                }
+
+                if (!member.primed) return self.silence(member);
+
+                const needed = rs.inputFramesFor(self.block_size, member.ratio);
+                const raw = member.raw[0 .. needed * frame_bytes];
+
+                if (!try self.readFrames(member, raw, needed)) return self.silence(member);
+
+                var data = AudioData.init(raw, member.device.channels, member.device.sample_rate, member.device.audio_format);
+                const samples = data.readAll(member.frames[0 .. needed * channels]) catch return AudioLoopError.unexpected;
+
+                _ = rs.process(samples, member.block, member.ratio);
+            } else {
+                const raw = member.raw[0 .. self.block_size * frame_bytes];
+
+                if (!try self.readFrames(member, raw, self.block_size)) return self.silence(member);
+
+                var data = AudioData.init(raw, member.device.channels, member.device.sample_rate, member.device.audio_format);
+                _ = data.readAll(member.block) catch return AudioLoopError.unexpected;
+            }
+
+            scatter(Float, member.block, channels, self.in_planar, member.first_channel, self.block_size);
+        }
+
+        // the member channels of the playback buffer, resampled to the member clock
+        fn play(self: *Self, member: *Member) AudioLoopError!void {
+            const channels: usize = member.device.channels;
+
+            gather(Float, self.out_planar, member.first_channel, member.block, channels, self.block_size);
+
+            const samples = if (member.resampler) |*rs| blk: {
+                const result = rs.process(member.block, member.frames, member.ratio);
+                break :blk member.frames[0 .. result.produced * channels];
+            } else member.block;
+
+            const n_frames = samples.len / channels;
+            const raw = member.raw[0 .. n_frames * member.frameBytes()];
+
+            var data = AudioData.init(raw, member.device.channels, member.device.sample_rate, member.device.audio_format);
+            data.write(samples) catch return AudioLoopError.unexpected;
+
+            _ = try self.writeFrames(member, raw, n_frames);
+        }
+
+        // feeds the frames in flight of a resampled member to its controller
+        fn track(self: *Self, member: *Member) void {
+            const rs = member.resampler orelse return;
+            if (!member.primed) return;
+
+            const avail = c_alsa.snd_pcm_avail_update(member.device.pcm_handle);
+
+            // recovered by the next transfer
+            if (avail < 0) return;
+
+            const level = framesInFlight(member.device.stream_type, avail, member.device.hardware_buffer_size, rs.bufferedFrames());
+            member.ratio = member.controller.update(level, self.block_size);
+        }
+
+        fn silence(self: *Self, member: *Member) void {
+            const channels: usize = member.device.channels;
+            @memset(self.in_planar[member.first_channel * self.block_size ..][0 .. channels * self.block_size], 0);
+        }
+
+        // false after a recovered xrun
+        fn readFrames(self: *Self, member: *Member, buffer: []u8, frames: usize) AudioLoopError!bool {
+            const pcm_handle = member.device.pcm_handle;
+            const frame_bytes = member.frameBytes();
+            var done: usize = 0;
+
+            while (done < frames) {
+                const ptr = buffer[done * frame_bytes ..].ptr;
+                const f: c_alsa.snd_pcm_uframes_t = @intCast(frames - done);
+
+                const res = if (member.device.access_type == .mmap_interleaved)
+                    c_alsa.snd_pcm_mmap_readi(pcm_handle, ptr, f)
+                else
+                    c_alsa.snd_pcm_readi(pcm_handle, ptr, f);
+
+                if (res < 0) {
+                    try self.recover(member, res);
+                    return false;
+                }
+
+                if (res == 0) return false;
+
+                done += @intCast(res);
+            }
+
+            return true;
+        }
+
+        // false after a recovered xrun
+        fn writeFrames(self: *Self, member: *Member, buffer: []u8, frames: usize) AudioLoopError!bool {
+            const pcm_handle = member.device.pcm_handle;
+            const frame_bytes = member.frameBytes();
+            var done: usize = 0;
+
+            while (done < frames) {
+                const ptr = buffer[done * frame_bytes ..].ptr;
+                const f: c_alsa.snd_pcm_uframes_t = @intCast(frames - done);
+
+                const res = if (member.device.access_type == .mmap_interleaved)
+                    c_alsa.snd_pcm_mmap_writei(pcm_handle, ptr, f)
+                else
+                    c_alsa.snd_pcm_writei(pcm_handle, ptr, f);
+
+                if (res < 0) {
+                    try self.recover(member, res);
+                    return false;
+                }
+
+                if (res == 0) return false;
+
+                done += @intCast(res);
+            }
+
+            return true;
+        }
+
+        // counts the event in the member health and restarts the member, errors other than xruns and suspends
+        // are returned
+        fn recover(self: *Self, member: *Member, c_err: c_long) AudioLoopError!void {
+            const err: c_int = @intCast(c_err);
+            const health = member.device.health;
+
+            const kind = classify(c_err) orelse {
+                log.err("Aggregate member {s} failed: {s}", .{ @tagName(member.device.stream_type), c_alsa.snd_strerror(err) });
+                return AudioLoopError.unexpected;
+            };
+
+            switch (kind) {
+                .xrun => health.xrun(),
+                .suspended => health.suspended(),
+            }
+
+            log.debug("Recovering aggregate member {s}: {s}", .{ @tagName(member.device.stream_type), c_alsa.snd_strerror(err) });
+
+            const res = c_alsa.snd_pcm_recover(member.device.pcm_handle, err, 1);
+            health.recovered(res >= 0);
+
+            if (res < 0) {
+                log.err("Failed to recover aggregate member: {s}", .{c_alsa.snd_strerror(res)});
+                return AudioLoopError.xrun;
+            }
+
+            try self.restart(member);
+        }
+
+        // queues the playback silence and starts the member, its controller learns a new target
+        fn restart(self: *Self, member: *Member) AudioLoopError!void {
+            member.controller.reset();
+            member.primed = member.device.stream_type == .playback;
+
+            if (member.device.stream_type == .playback) {
+                const raw = member.raw[0 .. self.block_size * member.frameBytes()];
+                var data = AudioData.init(raw, member.device.channels, member.device.sample_rate, member.device.audio_format);
+
+                @memset(member.block, 0);
+                data.write(member.block) catch return AudioLoopError.unexpected;
+
+                for (0..prime_periods) |_| {
+                    if (!try self.writeFrames(member, raw, self.block_size)) return;
+                }
+            }
+
+            if (c_alsa.snd_pcm_state(member.device.pcm_handle) != c_alsa.SND_PCM_STATE_PREPARED) return;
+
+            const err = c_alsa.snd_pcm_start(member.device.pcm_handle);
+
+            if (err < 0) {
+                log.err("Failed to start aggregate member: {s}", .{c_alsa.snd_strerror(err)});
+                return AudioLoopError.start;
+            }
+        }
+
+        fn view(self: Self, buffer: []Float, n_channels: usize) View {
+            return .{
+                .buffer = buffer,
+                .n_channels = n_channels,
+                .block_size = self.block_size,
+                .access = self.access,
+                .channel_stride = self.block_size,
+            };
+        }
+
+        fn freeMember(allocator: std.mem.Allocator, member: *Member) void {
+            if (member.resampler) |*rs| rs.deinit();
+
+            allocator.free(member.raw);
+            allocator.free(member.frames);
+            allocator.free(member.block);
+        }
+    };
+}
+
+const Recovery = enum { xrun, suspended };
+
+// what a failed transfer means, null when `snd_pcm_recover` cannot handle it, e.g. -ENODEV of an unplugged card
+fn classify(c_err: c_long) ?Recovery {
+    if (c_err == -c_alsa.EPIPE) return .xrun;
+    if (c_err == -c_alsa.ESTRPIPE) return .suspended;
+    return null;
+}
+
+// frames between the member and the clock master: captured and not yet read, or written and not yet played, plus
+// the frames held by the resampler
+fn framesInFlight(stream_type: driver.StreamType, avail: c_long, hardware_buffer_size: u32, buffered: f64) f64 {
+    const level: f64 = switch (stream_type) {
+        .capture => @floatFromInt(avail),
+        .playback => @floatFromInt(@max(@as(i64, hardware_buffer_size) - @as(i64, avail), 0)),
+    };
+
+    return level + buffered;
+}
+
+fn pollDescriptors(allocator: std.mem.Allocator, pcm_handle: ?*c_alsa.snd_pcm_t) AggregateError![]std.posix.pollfd {
+    const count = c_alsa.snd_pcm_poll_descriptors_count(pcm_handle);
+
+    if (count <= 0) {
+        log.err("Failed to get the poll descriptors count: {s}", .{c_alsa.snd_strerror(count)});
+        return AggregateError.poll_descriptors;
+    }
+
+    const fds = try allocator.alloc(std.posix.pollfd, @intCast(count));
+    errdefer allocator.free(fds);
+
+    const filled = c_alsa.snd_pcm_poll_descriptors(pcm_handle, @ptrCast(fds.ptr), @intCast(count));
+
+    if (filled < 0) {
+        log.err("Failed to get the poll descriptors: {s}", .{c_alsa.snd_strerror(filled)});
+        return AggregateError.poll_descriptors;
+    }
+
+    if (filled == count) return fds;
+    return allocator.realloc(fds, @intCast(filled));
+}
+
+// interleaved frames of `channels` channels into the planar block, from `first_channel` on
+fn scatter(comptime T: type, interleaved: []const T, channels: usize, planar: []T, first_channel: usize, block: usize) void {
+    for (0..channels) |ch| {
+        const dst = planar[(first_channel + ch) * block ..][0..block];
+        for (dst, 0..) |*sample, frame| sample.* = interleaved[frame * channels + ch];
+    }
+}
+
+// `channels` channels of the planar block, from `first_channel` on, into interleaved frames
+fn gather(comptime T: type, planar: []const T, first_channel: usize, interleaved: []T, channels: usize, block: usize) void {
+    for (0..channels) |ch| {
+        const src = planar[(first_channel + ch) * block ..][0..block];
+        for (src, 0..) |sample, frame| interleaved[frame * channels + ch] = sample;
+    }
+}
+
+test "scatter and gather place members side by side" {
+    const block = 4;
+    // two members, stereo and mono
+    const a = [_]f32{ 1, 10, 2, 20, 3, 30, 4, 40 };
+    const b = [_]f32{ 5, 6, 7, 8 };
+
+    var planar: [3 * block]f32 = undefined;
+    scatter(f32, &a, 2, &planar, 0, block);
+    scatter(f32, &b, 1, &planar, 2, block);
+
+    try std.testing.expectEqualSlices(f32, &.{ 1, 2, 3, 4, 10, 20, 30, 40, 5, 6, 7, 8 }, &planar);
+
+    var interleaved: [3 * block]f32 = undefined;
+    gather(f32, &planar, 0, &interleaved, 3, block);
+
+    try std.testing.expectEqualSlices(f32, &.{ 1, 10, 5, 2, 20, 6, 3, 30, 7, 4, 40, 8 }, &interleaved);
+
+    var mono: [block]f32 = undefined;
+    gather(f32, &planar, 2, &mono, 1, block);
+
+    try std.testing.expectEqualSlices(f32, &b, &mono);
+}
+
+test "recover restarts xruns and suspends only" {
+    try std.testing.expectEqual(Recovery.xrun, classify(-c_alsa.EPIPE).?);
+    try std.testing.expectEqual(Recovery.suspended, classify(-c_alsa.ESTRPIPE).?);
+
+    // unplugged or closed under the loop, nothing to recover
+    try std.testing.expect(classify(-c_alsa.ENODEV) == null);
+    try std.testing.expect(classify(-c_alsa.EBADFD) == null);
+    try std.testing.expect(classify(-c_alsa.EIO) == null);
+}
+
+test "AggregateDevice - primes, tracks and restarts its members" {
+    const allocator = std.testing.allocator;
+    const View = audio_buffer.UnmanagedChannelView(f32);
+
+    const Ctx = struct {
+        const Self = @This();
+        const Aggregate = AggregateDevice(Self, .{ .format = .float_32bits_little_endian });
+
+        cycles: usize = 0,
+        in_channels: usize = 0,
+        out_channels: usize = 0,
+
+        fn onBlock(self: *Self, in: View, out: View) void {
+            self.cycles += 1;
+            self.in_channels = in.n_channels;
+            self.out_channels = out.n_channels;
+        }
+    };
+
+    var config = try null_config.TestConfig.init(allocator);
+    defer config.deinit();
+
+    // the stereo capture is the clock master, the mono capture and the playback are resampled
+    const idents = [_][:0]const u8{ null_config.null_capture, null_config.null_capture, null_config.null_playback };
+    const stream_types = [_]driver.StreamType{ .capture, .capture, .playback };
+    const channels = [_]driver.ChannelCount{ .stereo, .mono, .stereo };
+
+    var devices: [3]Ctx.Aggregate.Device = undefined;
+
+    for (&devices, idents, stream_types, channels, 0..) |*device, ident, stream_type, n_channels, i| {
+        errdefer for (devices[0..i]) |*opened| opened.deinit() catch {};
+
+        device.* = try Ctx.Aggregate.Device.init(allocator, .{
+            .ident = ident,
+            .stream_type = stream_type,
+            .channels = n_channels,
+            .buffer_size = .buf_256,
+            .n_periods = 4,
+        });
+    }
+
+    defer for (&devices) |*device| device.deinit() catch {};
+
+    for (&devices) |*device| try device.prepare();
+
+    var ctx = Ctx{};
+    var aggregate = try Ctx.Aggregate.init(allocator, &devices, &ctx, Ctx.onBlock, .{});
+    defer aggregate.deinit();
+
+    const members = aggregate.members;
+
+    for (members) |*member| try aggregate.restart(member);
+
+    // the playback queued its silence, the resampled capture waits for two periods
+    try std.testing.expect(members[2].primed);
+    try std.testing.expect(!members[1].primed);
+
+    for (0..8) |_| try aggregate.cycle();
+
+    try std.testing.expectEqual(8, ctx.cycles);
+    try std.testing.expectEqual(3, ctx.in_channels);
+    try std.testing.expectEqual(2, ctx.out_channels);
+
+    // a null capture always has its whole buffer available
+    try std.testing.expect(members[1].primed);
+
+    // every resampled member feeds its own controller, the clock master is not tracked
+    try std.testing.expect(members[0].controller.target == null);
+    try std.testing.expect(members[1].controller.target != null);
+    try std.testing.expect(members[2].controller.target != null);
+
+    // a restart realigns one member on a new fill level, the others keep theirs
+    const kept = members[2].controller.target;
+    try aggregate.restart(&members[1]);
+
+    try std.testing.expect(!members[1].primed);
+    try std.testing.expect(members[1].controller.target == null);
+
+    try aggregate.cycle();
+
+    try std.testing.expect(members[1].primed);
+    try std.testing.expect(members[1].controller.target != null);
+    try std.testing.expectEqual(kept, members[2].controller.target);
+}
+
+test "AggregateDevice - recoveries count on the member, mirrored to the telemetry" {
+    const allocator = std.testing.allocator;
+    const View = audio_buffer.UnmanagedChannelView(f32);
+
+    const Ctx = struct {
+        const Self = @This();
+        const Aggregate = AggregateDevice(Self, .{ .format = .float_32bits_little_endian });
+
+        fn onBlock(_: *Self, _: View, _: View) void {}
+    };
+
+    var config = try null_config.TestConfig.init(allocator);
+    defer config.deinit();
+
+    var devices = [_]Ctx.Aggregate.Device{try Ctx.Aggregate.Device.init(allocator, .{
+        .ident = null_config.null_capture,
+        .stream_type = .capture,
+        .channels = .stereo,
+        .buffer_size = .buf_256,
+        .n_periods = 4,
+    })};
+    defer devices[0].deinit() catch {};
+
+    try devices[0].prepare();
+
+    var loop_telemetry = driver.LoopTelemetry{};
+    var ctx = Ctx{};
+    var aggregate = try Ctx.Aggregate.init(allocator, &devices, &ctx, Ctx.onBlock, .{ .telemetry = &loop_telemetry });
+    defer aggregate.deinit();
+
+    try aggregate.recover(&aggregate.members[0], -c_alsa.EPIPE);
+
+    // the caller's device shares the counters of the member
+    const health = devices[0].health.snapshot();
+    try std.testing.expectEqual(1, health.xruns);
+    try std.testing.expectEqual(1, health.recoveries);
+
+    const mirrored = loop_telemetry.health.snapshot();
+    try std.testing.expectEqual(1, mirrored.xruns);
+    try std.testing.expectEqual(1, mirrored.recoveries);
+}
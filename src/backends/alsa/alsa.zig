@@ -3,3 +3,5 @@ pub const settings = @import("settings.zig");
 pub const Hardware = @import("Hardware.zig");
 pub const audio_data = @import("audio_data.zig");
 pub const examples = @import("examples/examples.zig");
+pub const aggregate = @import("aggregate.zig");
+pub const calibration = @import("calibration.zig");
@@ -3,6 +3,7 @@ const native_endian = @import("builtin").target.cpu.arch.endian();
 
 const FormatType = @import("settings.zig").FormatType;
 const Format = @import("format.zig").Format;
+const audio_buffer = @import("../../common/audio_buffer.zig");
 
 pub const AudioDataError = error{
     invalid_type,
@@ -10,26 +11,281 @@ pub const AudioDataError = error{
     invalid_float_range,
     out_of_bounds,
     unexpected_buffer_size,
+    invalid_layout,
 };
 
+/// Bulk conversion between float samples and raw sample bytes, specialized at comptime for the raw type `S`,
+/// the significant `bits` (20 and 24 bits formats are LSB justified in 32 bits words) and the byte order.
+/// Clamping, scaling and byte swaps run on native width vectors, the remaining samples go through the scalar path.
+/// Packed 3 bytes formats (`S` is `i24` or `u24`) are widened to 32 bits lanes with a byte shuffle and narrowed back the same way.
+/// Integer mapping is the same as `GenericAudioData.linearMapIn` and `linearMapOut`.
+pub fn SampleCodec(comptime S: type, comptime F: type, comptime bits: u16, comptime endian: std.builtin.Endian) type {
+    return struct {
+        const is_float = S == f32 or S == f64;
+        const is_signed = !is_float and @typeInfo(S).Int.signedness == .signed;
+        // 3 bytes samples, no padding byte in memory
+        const is_packed = !is_float and @bitSizeOf(S) == 24;
+        const needs_swap = endian != native_endian and @sizeOf(S) > 1;
+
+        const len = std.simd.suggestVectorLength(F) orelse 4;
+        /// Bytes per sample in the buffer.
+        pub const size = @divExact(@bitSizeOf(S), 8);
+
+        // arithmetic type, packed samples are processed in 32 bits lanes
+        const C = if (is_packed) std.meta.Int(@typeInfo(S).Int.signedness, 32) else S;
+
+        const VF = @Vector(len, F);
+        const VS = @Vector(len, C);
+        const VBytes = @Vector(len * size, u8);
+        // raw bits of one sample, byte swaps operate on it
+        const Raw = std.meta.Int(.unsigned, @bitSizeOf(S));
+        const VRaw = @Vector(len, Raw);
+
+        // padding bits above the significant bits of LSB justified formats
+        const pad_bits = if (is_float) 0 else @bitSizeOf(C) - bits;
+        const max: F = if (is_float) 1 else @floatFromInt((1 << (bits - @intFromBool(is_signed))) - 1);
+
+        // byte shuffles between packed samples and native 32 bits lanes, in buffer byte order.
+        // Unpacking takes the padding byte from the zero vector (negative index)
+        const unpack_mask: @Vector(len * 4, i32) = blk: {
+            var mask: [len * 4]i32 = undefined;
+            for (0..len) |k| {
+                for (0..4) |j| {
+                    const significance = if (native_endian == .little) j else 3 - j;
+                    const byte = if (endian == .little) significance else 2 -% significance;
+                    mask[k * 4 + j] = if (significance == 3) -1 else @intCast(k * 3 + byte);
+                }
+            }
+            break :blk mask;
+        };
+
+        const pack_mask: @Vector(len * 3, i32) = blk: {
+            var mask: [len * 3]i32 = undefined;
+            for (0..len) |k| {
+                for (0..3) |i| {
+                    const significance = if (endian == .little) i else 2 - i;
+                    const byte = if (native_endian == .little) significance else 3 - significance;
+                    mask[k * 3 + i] = @intCast(k * 4 + byte);
+                }
+            }
+            break :blk mask;
+        };
+
+        /// `dst` holds `src.len` raw samples.
+        pub fn encode(dst: []u8, src: []const F) void {
+            std.debug.assert(dst.len == src.len * size);
+
+            var i: usize = 0;
+
+            while (i + len <= src.len) : (i += len) {
+                dst[i * size ..][0 .. len * size].* = encodeBytes(src[i..][0..len].*);
+            }
+
+            while (i < src.len) : (i += 1) {
+                std.mem.writeInt(Raw, dst[i * size ..][0..size], @bitCast(encodeOne(src[i])), endian);
+            }
+        }
+
+        /// `src` holds `dst.len` raw samples.
+        pub fn decode(dst: []F, src: []const u8) void {
+            std.debug.assert(src.len == dst.len * size);
+
+            var i: usize = 0;
+
+            while (i + len <= dst.len) : (i += len) {
+                dst[i..][0..len].* = decodeBytes(src[i * size ..][0 .. len * size].*);
+            }
+
+            while (i < dst.len) : (i += 1) {
+                dst[i] = decodeOne(@bitCast(std.mem.readInt(Raw, src[i * size ..][0..size], endian)));
+            }
+        }
+
+        /// Interleaves one slice per channel into `dst`. Every channel holds the same number of frames.
+        pub fn encodeInterleaved(dst: []u8, channels: []const []const F) void {
+            const n_channels = channels.len;
+            if (n_channels == 0) return;
+
+            const n_frames = channels[0].len;
+            std.debug.assert(dst.len == n_frames * n_channels * size);
+
+            var frame: usize = 0;
+
+            while (frame + len <= n_frames) : (frame += len) {
+                for (channels, 0..) |channel, ch| {
+                    const bytes: [len * size]u8 = encodeBytes(channel[frame..][0..len].*);
+
+                    // converted as a vector, scattered with the channel stride
+                    for (0..len) |k| {
+                        @memcpy(dst[((frame + k) * n_channels + ch) * size ..][0..size], bytes[k * size ..][0..size]);
+                    }
+                }
+            }
+
+            while (frame < n_frames) : (frame += 1) {
+                for (channels, 0..) |channel, ch| {
+                    std.mem.writeInt(Raw, dst[(frame * n_channels + ch) * size ..][0..size], @bitCast(encodeOne(channel[frame])), endian);
+                }
+            }
+        }
+
+        /// Splits interleaved raw samples into one slice per channel.
+        pub fn decodeDeinterleaved(channels: []const []F, src: []const u8) void {
+            const n_channels = channels.len;
+            if (n_channels == 0) return;
+
+            const n_frames = channels[0].len;
+            std.debug.assert(src.len == n_frames * n_channels * size);
+
+            var frame: usize = 0;
+
+            while (frame + len <= n_frames) : (frame += len) {
+                for (channels, 0..) |channel, ch| {
+                    var bytes: [len * size]u8 = undefined;
+
+                    for (0..len) |k| {
+                        @memcpy(bytes[k * size ..][0..size], src[((frame + k) * n_channels + ch) * size ..][0..size]);
+                    }
+
+                    channel[frame..][0..len].* = decodeBytes(bytes);
+                }
+            }
+
+            while (frame < n_frames) : (frame += 1) {
+                for (channels, 0..) |channel, ch| {
+                    channel[frame] = decodeOne(@bitCast(std.mem.readInt(Raw, src[(frame * n_channels + ch) * size ..][0..size], endian)));
+                }
+            }
+        }
+
+        inline fn encodeVector(x: VF) VS {
+            if (is_float) return @floatCast(x);
+
+            const one: VF = @splat(1);
+            const zero: VF = @splat(0);
+            const clamped = @min(@max(x, -one), one);
+
+            if (is_signed) {
+                // asymmetric range, -1.0 maps to the minimum integer
+                const scale = @select(F, clamped > zero, @as(VF, @splat(max)), @as(VF, @splat(max + 1)));
+                return @intFromFloat(clamped * scale);
+            }
+
+            return @intFromFloat((clamped + one) / @as(VF, @splat(2)) * @as(VF, @splat(max)));
+        }
+
+        inline fn decodeVector(raw: VS) VF {
+            if (is_float) return @floatCast(raw);
+
+            var value = raw;
+
+            // drops whatever the padding bits hold, sign extending signed formats
+            if (pad_bits > 0) {
+                const shift: @Vector(len, std.math.Log2Int(C)) = @splat(pad_bits);
+                value = if (is_signed) (value << shift) >> shift else value & @as(VS, @splat((1 << bits) - 1));
+            }
+
+            const x: VF = @floatFromInt(value);
+
+            if (is_signed) {
+                const zero: VF = @splat(0);
+                return x / @select(F, x > zero, @as(VF, @splat(max)), @as(VF, @splat(max + 1)));
+            }
+
+            return x / @as(VF, @splat(max)) * @as(VF, @splat(2)) - @as(VF, @splat(1));
+        }
+
+        // vector of samples to buffer bytes
+        inline fn encodeBytes(x: VF) VBytes {
+            const value = encodeVector(x);
+
+            if (is_packed) {
+                const lanes: @Vector(len * 4, u8) = @bitCast(value);
+                return @shuffle(u8, lanes, undefined, pack_mask);
+            }
+
+            const raw: VRaw = @bitCast(value);
+            return @bitCast(if (needs_swap) @byteSwap(raw) else raw);
+        }
+
+        // buffer bytes to vector of samples
+        inline fn decodeBytes(bytes: VBytes) VF {
+            if (is_packed) {
+                const zero: @Vector(1, u8) = @splat(0);
+                return decodeVector(@bitCast(@shuffle(u8, bytes, zero, unpack_mask)));
+            }
+
+            const raw: VRaw = @bitCast(bytes);
+            return decodeVector(@bitCast(if (needs_swap) @byteSwap(raw) else raw));
+        }
+
+        pub inline fn encodeOne(x: F) S {
+            const vector: VF = @splat(x);
+            const value = encodeVector(vector)[0];
+
+            return if (is_packed) @truncate(value) else value;
+        }
+
+        pub inline fn decodeOne(raw: S) F {
+            // packed samples widen with zero or sign bits, dropped by the padding mask
+            const vector: VS = @splat(raw);
+            return decodeVector(vector)[0];
+        }
+    };
+}
+
 pub fn GenericAudioData(format_type: FormatType) type {
     return struct {
         const Self = @This();
 
         const T = format_type.ToType();
 
+        // significant bits of integer formats, 20 and 24 bits formats are LSB justified in 32 bits words
+        // or in 3 bytes for the packed formats
+        const sample_bits: u16 = switch (format_type) {
+            .signed_20bits_little_endian,
+            .signed_20bits_big_endian,
+            .unsigned_20bits_little_endian,
+            .unsigned_20bits_big_endian,
+            .signed_20bits_packed3_little_endian,
+            .signed_20bits_packed3_big_endian,
+            .unsigned_20bits_packed3_little_endian,
+            .unsigned_20bits_packed3_big_endian,
+            => 20,
+            .signed_24bits_little_endian,
+            .signed_24bits_big_endian,
+            .unsigned_24bits_little_endian,
+            .unsigned_24bits_big_endian,
+            => 24,
+            else => @bitSizeOf(T),
+        };
+
+        const LittleCodec = SampleCodec(T, FloatType(), sample_bits, .little);
+        const BigCodec = SampleCodec(T, FloatType(), sample_bits, .big);
+
+        /// Bytes per sample in the buffer, 3 for the packed formats where @sizeOf(T) is 4.
+        pub const sample_bytes = LittleCodec.size;
+
+        const View = audio_buffer.UnmanagedChannelView(FloatType());
+        // ChannelCount tops at 28
+        const max_channels = 32;
+
         format: Format(T),
         channels: u32,
         sample_rate: u32,
         data: []u8,
+        // in bytes. Offset in every channel run for non interleaved buffers
         position: usize,
         comptime T: type = T,
+        /// Non interleaved buffers hold one run of samples per channel, `channel_stride` bytes apart.
+        access: audio_buffer.AccessPattern = .interleaved,
+        channel_stride: usize = 0,
 
         // GenericAudioData will always expose sample as floats to the callers
         // We must be mindful of the precision loss, so for 24 and 32 bits audio, we use f64 precision.
         pub fn FloatType() type {
             return switch (T) {
-                f64, u32, i32 => f64,
+                f64, u32, i32, u24, i24 => f64,
                 else => f32,
             };
         }
@@ -44,16 +300,28 @@ pub fn GenericAudioData(format_type: FormatType) type {
             };
         }
 
+        /// `data` spans from the first sample of the first channel to the last sample of the last channel,
+        /// e.g. non interleaved mmap areas or the transfer buffer of `snd_pcm_writen`.
+        pub fn initNonInterleaved(data: []u8, channels: u32, sample_rate: u32, format: Format(T), channel_stride: usize) Self {
+            var self = init(data, channels, sample_rate, format);
+
+            self.access = .non_interleaved;
+            self.channel_stride = channel_stride;
+
+            return self;
+        }
+
+        /// Interleaved buffers only.
         pub inline fn writeSample(self: *Self, sample: FloatType()) AudioDataError!void {
-            const sample_size = @sizeOf(T);
+            if (self.access != .interleaved) return AudioDataError.invalid_layout;
 
-            if (sample_size != self.format.byte_rate) {
+            if (!self.containerMatches()) {
                 return AudioDataError.invalid_size;
             }
 
-            if (!self.hasSpace(sample_size)) return AudioDataError.out_of_bounds;
+            if (!self.hasSpace(sample_bytes)) return AudioDataError.out_of_bounds;
 
-            var bytes: [sample_size]u8 = undefined;
+            var bytes: [sample_bytes]u8 = undefined;
             const endianness: std.builtin.Endian = if (self.format.byte_order == .big_endian) .big else .little;
 
             switch (T) {
@@ -61,24 +329,189 @@ pub fn GenericAudioData(format_type: FormatType) type {
                 else => std.mem.writeInt(T, &bytes, linearMapIn(sample), endianness),
             }
 
-            @memcpy(self.data[self.position .. self.position + sample_size], &bytes);
-            self.position += sample_size;
+            @memcpy(self.data[self.position .. self.position + sample_bytes], &bytes);
+            self.position += sample_bytes;
+        }
+
+        /// Converts and writes `samples` in one pass. Writes what fits and returns `out_of_bounds` if not all did.
+        /// `samples` follow the buffer layout: interleaved frames, or channel after channel for non interleaved buffers.
+        pub fn write(self: *Self, samples: []const FloatType()) AudioDataError!void {
+            if (!self.containerMatches()) return AudioDataError.invalid_size;
+            if (self.access == .non_interleaved) return self.writeNonInterleaved(samples);
+
+            const n_samples = @min(samples.len, self.remainingSamples());
+            const bytes = self.data[self.position..][0 .. n_samples * sample_bytes];
+
+            self.encode(bytes, samples[0..n_samples]);
+            self.position += bytes.len;
+
+            if (n_samples < samples.len) return AudioDataError.out_of_bounds;
+        }
+
+        fn writeNonInterleaved(self: *Self, samples: []const FloatType()) AudioDataError!void {
+            if (samples.len % self.channels != 0) return AudioDataError.invalid_size;
+
+            const n_frames = samples.len / self.channels;
+            const fits = @min(n_frames, self.remainingFrames());
+
+            for (0..self.channels) |ch| {
+                self.encode(self.channelBytes(ch, 0, fits), samples[ch * n_frames ..][0..fits]);
+            }
+
+            self.position += fits * sample_bytes;
+
+            if (fits < n_frames) return AudioDataError.out_of_bounds;
         }
 
-        pub fn write(self: *Self, samples: []FloatType()) AudioDataError!void {
-            for (samples) |sample| {
-                try writeSample(self, sample);
+        /// Writes a graph block, converting between the block and buffer layouts when they differ.
+        pub fn writeView(self: *Self, view: View) AudioDataError!void {
+            if (!self.containerMatches()) return AudioDataError.invalid_size;
+            if (view.n_channels != self.channels) return AudioDataError.invalid_size;
+
+            if (view.access == self.access and view.isContiguous()) return self.write(view.samples());
+
+            if (view.access == .non_interleaved) {
+                if (self.channels > max_channels) return AudioDataError.invalid_size;
+
+                var channels: [max_channels][]const FloatType() = undefined;
+                for (0..self.channels) |ch| channels[ch] = view.channel(ch);
+
+                return self.writeChannels(channels[0..self.channels]);
             }
+
+            // interleaved block into a non interleaved buffer, gathered one channel at a time
+            if (view.block_size > self.remainingFrames()) return AudioDataError.out_of_bounds;
+
+            var chunk: [64]FloatType() = undefined;
+
+            for (0..self.channels) |ch| {
+                var frame: usize = 0;
+
+                while (frame < view.block_size) {
+                    const n = @min(chunk.len, view.block_size - frame);
+
+                    for (chunk[0..n], frame..) |*sample, at_frame| sample.* = view.readSample(ch, at_frame);
+                    self.encode(self.channelBytes(ch, frame, n), chunk[0..n]);
+
+                    frame += n;
+                }
+            }
+
+            self.position += view.block_size * sample_bytes;
+        }
+
+        /// Interleaves one slice per channel into the buffer, e.g. the channels of a non interleaved graph buffer.
+        /// Non interleaved buffers take every slice as is.
+        pub fn writeChannels(self: *Self, channels: []const []const FloatType()) AudioDataError!void {
+            if (!self.containerMatches()) return AudioDataError.invalid_size;
+            if (channels.len != self.channels) return AudioDataError.invalid_size;
+            if (channels.len == 0) return;
+
+            if (self.access == .non_interleaved) {
+                const n_frames = channels[0].len;
+                if (n_frames > self.remainingFrames()) return AudioDataError.out_of_bounds;
+
+                for (channels, 0..) |channel, ch| self.encode(self.channelBytes(ch, 0, n_frames), channel);
+
+                self.position += n_frames * sample_bytes;
+                return;
+            }
+
+            const n_samples = channels[0].len * channels.len;
+            if (n_samples > self.remainingSamples()) return AudioDataError.out_of_bounds;
+
+            const bytes = self.data[self.position..][0 .. n_samples * sample_bytes];
+
+            switch (self.format.byte_order) {
+                .big_endian => BigCodec.encodeInterleaved(bytes, channels),
+                else => LittleCodec.encodeInterleaved(bytes, channels),
+            }
+
+            self.position += bytes.len;
         }
 
+        /// Deinterleaves the buffer into one slice per channel. Every slice must hold the same number of frames.
+        pub fn readChannels(self: *Self, channels: []const []FloatType()) AudioDataError!void {
+            if (!self.containerMatches()) return AudioDataError.invalid_size;
+            if (channels.len != self.channels) return AudioDataError.invalid_size;
+            if (channels.len == 0) return;
+
+            if (self.access == .non_interleaved) {
+                const n_frames = channels[0].len;
+                if (n_frames > self.remainingFrames()) return AudioDataError.out_of_bounds;
+
+                for (channels, 0..) |channel, ch| self.decode(channel, self.channelBytes(ch, 0, n_frames));
+
+                self.position += n_frames * sample_bytes;
+                return;
+            }
+
+            const n_samples = channels[0].len * channels.len;
+            if (n_samples > self.remainingSamples()) return AudioDataError.out_of_bounds;
+
+            const bytes = self.data[self.position..][0 .. n_samples * sample_bytes];
+
+            switch (self.format.byte_order) {
+                .big_endian => BigCodec.decodeDeinterleaved(channels, bytes),
+                else => LittleCodec.decodeDeinterleaved(channels, bytes),
+            }
+
+            self.position += bytes.len;
+        }
+
+        // the raw type fills the sample container, the 24 bits formats use 4 bytes containers, the packed ones 3 bytes
+        inline fn containerMatches(self: Self) bool {
+            return sample_bytes == self.format.byte_rate or sample_bytes == self.format.physical_byte_rate;
+        }
+
+        inline fn remainingSamples(self: Self) usize {
+            if (self.access == .non_interleaved) return self.remainingFrames() * self.channels;
+
+            if (self.position >= self.data.len) return 0;
+            return (self.data.len - self.position) / sample_bytes;
+        }
+
+        pub fn remainingFrames(self: Self) usize {
+            if (self.access == .interleaved) return self.remainingSamples() / self.channels;
+
+            const at = self.position / sample_bytes;
+            const run = self.channelLength();
+
+            return if (at >= run) 0 else run - at;
+        }
+
+        // samples per channel run of non interleaved buffers
+        inline fn channelLength(self: Self) usize {
+            return (self.data.len - (self.channels - 1) * self.channel_stride) / sample_bytes;
+        }
+
+        // `n_samples` samples of one channel run, `frame` frames past the position
+        inline fn channelBytes(self: Self, ch: usize, frame: usize, n_samples: usize) []u8 {
+            return self.data[ch * self.channel_stride + self.position + frame * sample_bytes ..][0 .. n_samples * sample_bytes];
+        }
+
+        inline fn encode(self: Self, bytes: []u8, samples: []const FloatType()) void {
+            switch (self.format.byte_order) {
+                .big_endian => BigCodec.encode(bytes, samples),
+                else => LittleCodec.encode(bytes, samples),
+            }
+        }
+
+        inline fn decode(self: Self, samples: []FloatType(), bytes: []const u8) void {
+            switch (self.format.byte_order) {
+                .big_endian => BigCodec.decode(samples, bytes),
+                else => LittleCodec.decode(samples, bytes),
+            }
+        }
+
+        /// Interleaved buffers only.
         pub fn readSample(self: *Self) ?FloatType() {
+            if (self.access != .interleaved) return null;
             if (self.data.len == 0) return null;
             if (self.position >= self.data.len) return null;
 
-            const actual_sample_size: usize = @sizeOf(T);
-
-            var sample_buffer: [actual_sample_size]u8 = undefined;
-            @memcpy(&sample_buffer, self.data[self.position .. self.position + actual_sample_size]);
+            var sample_buffer: [sample_bytes]u8 = undefined;
+            @memcpy(&sample_buffer, self.data[self.position .. self.position + sample_bytes]);
 
             const endianness: std.builtin.Endian = if (self.format.byte_order == .big_endian) .big else .little;
 
@@ -87,7 +520,7 @@ pub fn GenericAudioData(format_type: FormatType) type {
                 else => linearMapOut(std.mem.readInt(T, &sample_buffer, endianness)),
             };
 
-            self.position += actual_sample_size;
+            self.position += sample_bytes;
 
             return sample;
         }
@@ -96,48 +529,110 @@ pub fn GenericAudioData(format_type: FormatType) type {
             if (self.data.len == 0) return null;
             if (self.position >= self.data.len) return null;
 
-            const sample_size_as_float = @sizeOf(FloatType());
-            const actual_sample_size = @sizeOf(T);
-
             // if the sample size is not a multiple of the data length, there is a bug. It should never happen
-            if (self.data.len % actual_sample_size != 0) {
+            if (self.data.len % sample_bytes != 0) {
                 return AudioDataError.unexpected_buffer_size;
             }
 
-            const samples_len = @divFloor(self.data.len, sample_size_as_float);
-            var samples = try allocator.alloc(FloatType(), samples_len);
-
-            for (0..samples_len) |sample_index| {
-                const sample: FloatType() = self.readSample() orelse return samples;
-                samples[sample_index] = sample;
-            }
-
-            return samples;
+            const samples = try allocator.alloc(FloatType(), self.remainingSamples());
+            return try self.readAll(samples);
         }
 
+        /// Samples come out in the buffer layout, channel after channel for non interleaved buffers.
         pub fn readAll(self: *Self, samples: []FloatType()) ![]FloatType() {
             if (self.data.len == 0) return samples;
 
-            const sample_size_as_float = @sizeOf(FloatType());
-            const actual_sample_size = @sizeOf(T);
+            if (self.access == .non_interleaved) {
+                const n_frames = self.remainingFrames();
+                if (samples.len < n_frames * self.channels) return AudioDataError.invalid_size;
+
+                for (0..self.channels) |ch| self.decode(samples[ch * n_frames ..][0..n_frames], self.channelBytes(ch, 0, n_frames));
+
+                self.position += n_frames * sample_bytes;
+                return samples[0 .. n_frames * self.channels];
+            }
 
             // if the sample size is not a multiple of the data length, there is a bug. It should never happen
-            if (self.data.len % actual_sample_size != 0) {
+            if (self.data.len % sample_bytes != 0) {
                 return AudioDataError.unexpected_buffer_size;
             }
 
-            const samples_len = @divFloor(self.data.len, sample_size_as_float);
+            const samples_len = self.remainingSamples();
 
             if (samples.len < samples_len) {
                 return AudioDataError.invalid_size;
             }
 
-            for (0..samples_len) |sample_index| {
-                const sample: FloatType() = self.readSample() orelse return samples;
-                samples[sample_index] = sample;
-            }
+            const bytes = self.data[self.position..][0 .. samples_len * sample_bytes];
+
+            self.decode(samples[0..samples_len], bytes);
+            self.position += bytes.len;
 
-            return samples;
+            return samples[0..samples_len];
+        }
+
+        /// The remaining buffer as samples that can be rendered in place, no conversion needed.
+        /// Only float formats in native byte order qualify, null otherwise: render elsewhere and `write` instead.
+        /// Call `advance` with the number of samples rendered.
+        pub fn nativeSamples(self: *Self) ?[]FloatType() {
+            if (T != FloatType()) return null;
+            if (self.access != .interleaved) return null;
+            if (!self.isNative()) return null;
+
+            const bytes = self.data[self.position..][0 .. self.remainingSamples() * sample_bytes];
+            if (!std.mem.isAligned(@intFromPtr(bytes.ptr), @alignOf(T))) return null;
+
+            return @as([*]FloatType(), @ptrCast(@alignCast(bytes.ptr)))[0..self.remainingSamples()];
+        }
+
+        /// The next `n_frames` frames as a channel view over the buffer, in the buffer layout.
+        /// Non interleaved buffers map to non interleaved views with the channel stride of the device,
+        /// so planar graphs render in place without any interleaving. Same conditions as `nativeSamples`.
+        /// Call `advance` with the number of samples rendered.
+        pub fn nativeView(self: *Self, n_frames: usize) ?View {
+            if (T != FloatType()) return null;
+            if (!self.isNative()) return null;
+            if (n_frames > self.remainingFrames()) return null;
+
+            const base = self.data[self.position..];
+            if (!std.mem.isAligned(@intFromPtr(base.ptr), @alignOf(T))) return null;
+
+            const samples: [*]FloatType() = @ptrCast(@alignCast(base.ptr));
+
+            return switch (self.access) {
+                .interleaved => View{
+                    .buffer = samples[0 .. n_frames * self.channels],
+                    .n_channels = self.channels,
+                    .block_size = n_frames,
+                    .access = .interleaved,
+                    .channel_stride = n_frames,
+                },
+                .non_interleaved => blk: {
+                    if (self.channel_stride % sample_bytes != 0) return null;
+                    const stride = self.channel_stride / sample_bytes;
+
+                    break :blk View{
+                        .buffer = samples[0 .. (self.channels - 1) * stride + n_frames],
+                        .n_channels = self.channels,
+                        .block_size = n_frames,
+                        .access = .non_interleaved,
+                        .channel_stride = stride,
+                    };
+                },
+            };
+        }
+
+        inline fn isNative(self: Self) bool {
+            const native_order: @TypeOf(self.format.byte_order) = if (native_endian == .little) .little_endian else .big_endian;
+            return self.containerMatches() and self.format.byte_order == native_order;
+        }
+
+        /// Moves past `n_samples` samples written through `nativeSamples` or `nativeView`.
+        pub fn advance(self: *Self, n_samples: usize) AudioDataError!void {
+            if (n_samples > self.remainingSamples()) return AudioDataError.out_of_bounds;
+
+            const n_positions = if (self.access == .non_interleaved) n_samples / self.channels else n_samples;
+            self.position += n_positions * sample_bytes;
         }
 
         pub fn rewind(self: *Self) void {
@@ -145,7 +640,8 @@ pub fn GenericAudioData(format_type: FormatType) type {
         }
 
         pub fn bufferSizeInSamples(self: Self) usize {
-            return @divFloor(self.data.len, @sizeOf(T));
+            if (self.access == .non_interleaved) return self.channelLength() * self.channels;
+            return @divFloor(self.data.len, sample_bytes);
         }
 
         pub fn bufferSizeInFrames(self: Self) usize {
@@ -156,9 +652,11 @@ pub fn GenericAudioData(format_type: FormatType) type {
             return self.bufferSizeInSamples() * self.channels;
         }
 
+        /// Interleaved buffers only.
         pub fn seek(self: *Self, sample_position: usize) !void {
-            const sample_size = @sizeOf(T);
-            const new_position = sample_position * sample_size;
+            if (self.access != .interleaved) return AudioDataError.invalid_layout;
+
+            const new_position = sample_position * sample_bytes;
 
             if (new_position >= self.data.len) {
                 return AudioDataError.out_of_bounds;
@@ -169,25 +667,25 @@ pub fn GenericAudioData(format_type: FormatType) type {
 
         // maps [-1.0 - 1.0] float to the format type value and range
         fn linearMapIn(sample: FloatType()) T {
-            const max: FloatType() = if (T != f32 and T != f64) @floatFromInt(std.math.maxInt(T)) else 0.0;
+            const max: FloatType() = if (T != f32 and T != f64) @floatFromInt(std.math.maxInt(std.meta.Int(@typeInfo(T).Int.signedness, sample_bits))) else 0.0;
             const signed_max = if (sample > 0) max else max + 1.0;
 
             return switch (T) {
                 f32, f64 => sample,
-                i8, i16, i32 => @as(T, @intFromFloat(sample * signed_max)),
-                u8, u16, u32 => @as(T, @intFromFloat((sample + 1.0) / 2.0 * max)),
+                i8, i16, i24, i32 => @as(T, @intFromFloat(sample * signed_max)),
+                u8, u16, u24, u32 => @as(T, @intFromFloat((sample + 1.0) / 2.0 * max)),
                 else => @compileError("Invalid AudioData Format Type"),
             };
         }
 
         fn linearMapOut(sample: T) FloatType() {
-            const max: FloatType() = if (T != f32 and T != f64) @floatFromInt(std.math.maxInt(T)) else 0.0;
+            const max: FloatType() = if (T != f32 and T != f64) @floatFromInt(std.math.maxInt(std.meta.Int(@typeInfo(T).Int.signedness, sample_bits))) else 0.0;
             const signed_max = if (sample > 0) max else max + 1.0;
 
             return switch (T) {
                 f32, f64 => sample,
-                i8, i16, i32 => return @as(FloatType(), @floatFromInt(sample)) / signed_max,
-                u8, u16, u32 => return (@as(FloatType(), @floatFromInt(sample)) / max * 2.0) - 1.0,
+                i8, i16, i24, i32 => return @as(FloatType(), @floatFromInt(sample)) / signed_max,
+                u8, u16, u24, u32 => return (@as(FloatType(), @floatFromInt(sample)) / max * 2.0) - 1.0,
                 else => @compileError("Invalid AudioData Format Type"),
             };
         }
@@ -203,7 +701,7 @@ pub fn GenericAudioData(format_type: FormatType) type {
             return remaning >= sample_size;
         }
 
-        fn readFloat(sample_buffer: *[@sizeOf(T)]u8, endianness: std.builtin.Endian) T {
+        fn readFloat(sample_buffer: *[sample_bytes]u8, endianness: std.builtin.Endian) T {
             const FT = switch (@sizeOf(T)) {
                 1 => u8,
                 2 => u16,
@@ -216,7 +714,7 @@ pub fn GenericAudioData(format_type: FormatType) type {
             return @bitCast(sample);
         }
 
-        fn writeFloat(buffer: *[@sizeOf(T)]u8, sample: T, endianness: std.builtin.Endian) void {
+        fn writeFloat(buffer: *[sample_bytes]u8, sample: T, endianness: std.builtin.Endian) void {
             const FT = switch (@sizeOf(T)) {
                 1 => u8,
                 2 => u16,
@@ -830,3 +1328,166 @@ test "AudioData.seek positions correctly" {
     // Seek out of bounds should return an error
     try testing.expectError(AudioDataError.out_of_bounds, data.seek(4));
 }
+
+test "SampleCodec matches the scalar mapping in both byte orders" {
+    const samples = [_]f32{ -1.0, -0.5, -0.25, 0.0, 0.25, 0.5, 0.75, 1.0, 0.1, -0.1, 2.0 };
+
+    inline for (.{ signed_16_int_le, signed_16_int_be }, .{ signed_16_int_format_le, signed_16_int_format_be }) |format_type, format| {
+        const AudioData = GenericAudioData(format_type);
+
+        var bulk_bytes: [samples.len * 2]u8 = undefined;
+        var scalar_bytes: [samples.len * 2]u8 = undefined;
+
+        var bulk = AudioData.init(&bulk_bytes, 1, 44100, format);
+        var scalar = AudioData.init(&scalar_bytes, 1, 44100, format);
+
+        try bulk.write(&samples);
+
+        // out of range samples are clamped by the bulk path only
+        for (samples[0 .. samples.len - 1]) |sample| try scalar.writeSample(sample);
+        try scalar.writeSample(1.0);
+
+        try testing.expectEqualSlices(u8, &scalar_bytes, &bulk_bytes);
+
+        bulk.rewind();
+        var decoded: [samples.len]f32 = undefined;
+        const read = try bulk.readAll(&decoded);
+
+        try testing.expectEqual(samples.len, read.len);
+        for (samples[0 .. samples.len - 1], read[0 .. samples.len - 1]) |expected, actual| {
+            try testing.expectApproxEqAbs(expected, actual, 1.0 / 32767.0);
+        }
+    }
+}
+
+test "SampleCodec handles 24 bits samples in 32 bits containers" {
+    const Codec = SampleCodec(i32, f64, 24, .little);
+
+    var bytes: [4 * 4]u8 = undefined;
+    Codec.encode(&bytes, &.{ 1.0, -1.0, 0.5, 0.0 });
+
+    try testing.expectEqual(8_388_607, std.mem.readInt(i32, bytes[0..4], .little));
+    try testing.expectEqual(-8_388_608, std.mem.readInt(i32, bytes[4..8], .little));
+
+    // garbage in the padding byte is ignored
+    bytes[11] = 0xAB;
+
+    var decoded: [4]f64 = undefined;
+    Codec.decode(&decoded, &bytes);
+
+    try testing.expectEqualSlices(f64, &.{ 1.0, -1.0 }, decoded[0..2]);
+    try testing.expectApproxEqAbs(0.5, decoded[2], 1e-6);
+}
+
+test "AudioData packs and unpacks 3 bytes samples" {
+    const samples = [_]f64{ 1.0, -1.0, 0.5, -0.5, 0.25, 0.0, -0.125, 0.75, 0.1, -0.1, 0.9 };
+
+    inline for (.{ FormatType.signed_24bits_packed3_little_endian, FormatType.signed_24bits_packed3_big_endian }) |format_type| {
+        const AudioData = GenericAudioData(format_type);
+        const endian: std.builtin.Endian = if (format_type == .signed_24bits_packed3_big_endian) .big else .little;
+
+        const format = Format(i24){
+            .format_type = format_type,
+            .signedness = .signed,
+            .byte_order = if (endian == .big) .big_endian else .little_endian,
+            .bit_depth = 24,
+            .byte_rate = 3,
+            .physical_width = 24,
+            .physical_byte_rate = 3,
+            .sample_type = 0,
+        };
+
+        var bulk_bytes: [samples.len * 3]u8 = undefined;
+        var scalar_bytes: [samples.len * 3]u8 = undefined;
+
+        var bulk = AudioData.init(&bulk_bytes, 1, 48000, format);
+        var scalar = AudioData.init(&scalar_bytes, 1, 48000, format);
+
+        try bulk.write(&samples);
+        for (samples) |sample| try scalar.writeSample(sample);
+
+        // the shuffled vectors and the scalar tail agree with the scalar path
+        try testing.expectEqualSlices(u8, &scalar_bytes, &bulk_bytes);
+        try testing.expectEqual(8_388_607, std.mem.readInt(i24, bulk_bytes[0..3], endian));
+        try testing.expectEqual(-8_388_608, std.mem.readInt(i24, bulk_bytes[3..6], endian));
+
+        bulk.rewind();
+        var decoded: [samples.len]f64 = undefined;
+        const read = try bulk.readAll(&decoded);
+
+        try testing.expectEqual(samples.len, read.len);
+        for (samples, read) |expected, actual| try testing.expectApproxEqAbs(expected, actual, 1.0 / 8_388_607.0);
+    }
+}
+
+test "SampleCodec interleaves and deinterleaves channels" {
+    const Codec = SampleCodec(i16, f32, 16, .big);
+
+    const left = [_]f32{ 0.5, -0.5, 0.25, 0.0, 1.0, -1.0, 0.5, 0.5, 0.25 };
+    const right = [_]f32{ -0.25, 0.25, 0.0, 1.0, -1.0, 0.5, -0.5, 0.0, 0.75 };
+
+    var bytes: [left.len * 2 * 2]u8 = undefined;
+    Codec.encodeInterleaved(&bytes, &.{ &left, &right });
+
+    try testing.expectEqual(Codec.encodeOne(right[3]), std.mem.readInt(i16, bytes[(3 * 2 + 1) * 2 ..][0..2], .big));
+
+    var out_left: [left.len]f32 = undefined;
+    var out_right: [right.len]f32 = undefined;
+    Codec.decodeDeinterleaved(&.{ &out_left, &out_right }, &bytes);
+
+    for (left, out_left) |expected, actual| try testing.expectApproxEqAbs(expected, actual, 1.0 / 32767.0);
+    for (right, out_right) |expected, actual| try testing.expectApproxEqAbs(expected, actual, 1.0 / 32767.0);
+}
+
+test "AudioData.nativeSamples exposes float buffers in native byte order only" {
+    if (native_endian != .little) return error.SkipZigTest;
+
+    var buffer: [8 * 4]u8 align(4) = undefined;
+
+    var float_data = GenericAudioData(float_32_le).init(&buffer, 2, 44100, float_32_format_le);
+    const samples = float_data.nativeSamples() orelse return error.TestUnexpectedResult;
+
+    try testing.expectEqual(8, samples.len);
+
+    samples[0] = 0.5;
+    try float_data.advance(1);
+    try testing.expectEqual(0.5, @as(f32, @bitCast(std.mem.readInt(u32, buffer[0..4], native_endian))));
+
+    var int_data = GenericAudioData(signed_16_int_le).init(&buffer, 2, 44100, signed_16_int_format_le);
+    try testing.expectEqual(null, int_data.nativeSamples());
+}
+
+test "AudioData non interleaved buffers map onto channel views" {
+    if (native_endian != .little) return error.SkipZigTest;
+
+    // two channel runs of 4 frames, 8 samples apart as in a non interleaved mmap buffer
+    var buffer: [12 * 4]u8 align(4) = [_]u8{0} ** (12 * 4);
+
+    var data = GenericAudioData(float_32_le).initNonInterleaved(&buffer, 2, 44100, float_32_format_le, 8 * 4);
+    try testing.expectEqual(4, data.remainingFrames());
+
+    const view = data.nativeView(2) orelse return error.TestUnexpectedResult;
+    try testing.expectEqual(.non_interleaved, view.access);
+    try testing.expectEqual(8, view.channel_stride);
+
+    view.writeSample(1, 1, 0.5);
+    try data.advance(2 * 2);
+    try testing.expectEqual(0.5, @as(f32, @bitCast(std.mem.readInt(u32, buffer[9 * 4 ..][0..4], .little))));
+
+    // an interleaved block is split into the channel runs
+    var frames = [_]f32{ 0.1, 0.2, 0.3, 0.4 };
+    const interleaved = audio_buffer.UnmanagedChannelView(f32){
+        .buffer = &frames,
+        .n_channels = 2,
+        .block_size = 2,
+        .access = .interleaved,
+        .channel_stride = 2,
+    };
+
+    try data.writeView(interleaved);
+    try testing.expectEqual(0, data.remainingFrames());
+
+    const samples: *const [12]f32 = @ptrCast(&buffer);
+    try testing.expectEqualSlices(f32, &.{ 0.1, 0.3 }, samples[2..4]);
+    try testing.expectEqualSlices(f32, &.{ 0.2, 0.4 }, samples[10..12]);
+}
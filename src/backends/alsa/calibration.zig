@@ -0,0 +1,396 @@
+//! Finds the lowest latency buffer configuration a device sustains with the real callback, instead of guessing
+//! `buffer_size` and `n_periods` per machine and graph.
+//!
+//! Candidates run one after the other, smallest `BufferSize` first and, for each, the fewest periods first. Each
+//! runs for a measurement window on a `PollLoop` with `LoopTelemetry`. It is rejected early when the p99.9 callback
+//! duration leaves too little headroom in the period, or as soon as it xruns more than allowed. The first candidate
+//! that lasts the whole window wins and is persisted, keyed by ident, stream type, sample rate and channels:
+//!
+//!     const Calibrate = alsa.calibration.Calibrator(Ctx, .{ .format = .float_32bits_little_endian });
+//!     const result = try Calibrate.run(allocator, device_opts, &ctx, Ctx.callback, .{});
+//!     var device = try Device.init(allocator, result.apply(device_opts));
+//!
+//! Later starts skip the measurement with `load`.
+
+const std = @import("std");
+const log = std.log.scoped(.alsa);
+
+const driver = @import("driver.zig");
+const utils = @import("utils.zig");
+const telemetry = @import("../../common/telemetry.zig");
+
+const BufferSize = driver.BufferSize;
+const StreamType = driver.StreamType;
+const SampleRate = driver.SampleRate;
+const ChannelCount = driver.ChannelCount;
+const HalfDuplexDeviceOptions = driver.HalfDuplexDeviceOptions;
+
+// bumped whenever the layout changes, files of another version are ignored
+const version = 1;
+const max_file_bytes = 1024 * 1024;
+// how often a running candidate is judged
+const check_interval_ms = 100;
+// lets `PollLoop.stop` return even when the device stalled
+const poll_timeout_ms = 500;
+
+pub const CalibrationError = error{
+    no_stable_configuration,
+};
+
+pub const CalibrationOptions = struct {
+    /// Time every candidate runs unless rejected earlier.
+    window_ms: u32 = 10_000,
+    /// Xruns tolerated over a window.
+    max_xruns: u64 = 0,
+    /// Largest p99.9 callback duration as a fraction of the period. The early signal, a callback this close to the
+    /// deadline xruns sooner or later.
+    max_load: f64 = 0.75,
+    /// Callbacks measured before the load is judged early, the tail means little before.
+    min_callbacks: u64 = 100,
+    /// Period counts tried for every buffer size, fewest first.
+    n_periods: []const u32 = &.{ 2, 3, 4 },
+    min_buffer_size: BufferSize = .buf_128,
+    max_buffer_size: BufferSize = .buf_4096,
+    /// Where results are kept, `defaultPath` when null.
+    path: ?[]const u8 = null,
+    /// Write the result to `path`.
+    persist: bool = true,
+};
+
+pub const Result = struct {
+    buffer_size: BufferSize,
+    n_periods: u32,
+    xruns: u64,
+    /// p99.9 callback duration over the window.
+    callback_p999_ns: u64,
+    /// Fraction of the period left to the callback at p99.9.
+    headroom: f64,
+
+    /// `opts` running at the calibrated configuration.
+    pub fn apply(self: Result, opts: HalfDuplexDeviceOptions) HalfDuplexDeviceOptions {
+        var calibrated = opts;
+        calibrated.buffer_size = self.buffer_size;
+        calibrated.n_periods = self.n_periods;
+
+        return calibrated;
+    }
+
+    pub fn latencyFrames(self: Result) u32 {
+        return @as(u32, @intCast(@intFromEnum(self.buffer_size))) * self.n_periods;
+    }
+};
+
+pub const Verdict = enum {
+    /// Keep measuring.
+    pending,
+    stable,
+    /// More xruns than allowed.
+    xruns,
+    /// Not enough headroom, more periods will not help.
+    load,
+};
+
+const Entry = struct {
+    ident: []const u8,
+    stream_type: StreamType,
+    sample_rate: SampleRate,
+    channels: ChannelCount,
+    result: Result,
+
+    fn matches(self: Entry, opts: HalfDuplexDeviceOptions) bool {
+        return std.mem.eql(u8, self.ident, opts.ident) and
+            self.stream_type == opts.stream_type and
+            self.sample_rate == opts.sample_rate and
+            self.channels == opts.channels;
+    }
+};
+
+const File = struct {
+    version: u32,
+    entries: []const Entry,
+};
+
+pub fn Calibrator(ContextType: type, comptime comptime_opts: driver.DeviceComptimeOptions) type {
+    return struct {
+        const Device = driver.HalfDuplexDevice(ContextType, comptime_opts);
+        const PollLoop = driver.PollLoop(ContextType, comptime_opts);
+
+        const Trial = struct {
+            verdict: Verdict,
+            snapshot: telemetry.LoopTelemetry.Snapshot,
+        };
+
+        /// Runs `callback` on every candidate configuration of `device_opts` until one is stable, see the module
+        /// documentation. `buffer_size`, `n_periods` and `telemetry` of `device_opts` are replaced.
+        ///
+        /// - Returns: The lowest stable configuration, also persisted unless `opts.persist` is false.
+        /// - Errors: `no_stable_configuration` when every candidate failed, or errors related to memory allocations.
+        pub fn run(allocator: std.mem.Allocator, device_opts: HalfDuplexDeviceOptions, ctx: *ContextType, callback: Device.AudioCallback, opts: CalibrationOptions) !Result {
+            for (std.enums.values(BufferSize)) |buffer_size| {
+                const frames = @intFromEnum(buffer_size);
+                if (frames < @intFromEnum(opts.min_buffer_size) or frames > @intFromEnum(opts.max_buffer_size)) continue;
+
+                for (opts.n_periods) |n_periods| {
+                    const trial = runTrial(allocator, device_opts, buffer_size, n_periods, ctx, callback, opts) catch |err| {
+                        log.info("Calibration: {d} x {d} frames not usable: {s}", .{ n_periods, frames, @errorName(err) });
+                        continue;
+                    };
+
+                    const s = trial.snapshot;
+                    const period_ns = periodNs(buffer_size, device_opts.sample_rate);
+
+                    log.info("Calibration: {d} x {d} frames {s}, {d} xruns, callback p99.9 {d}us of {d}us", .{
+                        n_periods,
+                        frames,
+                        @tagName(trial.verdict),
+                        s.health.xruns,
+                        s.callback_duration.p999 / std.time.ns_per_us,
+                        period_ns / std.time.ns_per_us,
+                    });
+
+                    switch (trial.verdict) {
+                        .stable => {
+                            const result = Result{
+                                .buffer_size = buffer_size,
+                                .n_periods = n_periods,
+                                .xruns = s.health.xruns,
+                                .callback_p999_ns = s.callback_duration.p999,
+                                .headroom = 1.0 - callbackLoad(s, period_ns),
+                            };
+
+                            if (opts.persist) {
+                                save(allocator, opts.path, device_opts, result) catch |err| {
+                                    log.warn("Calibration: Failed to persist the result: {s}", .{@errorName(err)});
+                                };
+                            }
+
+                            return result;
+                        },
+                        // the callback does not fit this period whatever the period count
+                        .load => break,
+                        .xruns, .pending => {},
+                    }
+                }
+            }
+
+            return CalibrationError.no_stable_configuration;
+        }
+
+        fn runTrial(
+            allocator: std.mem.Allocator,
+            device_opts: HalfDuplexDeviceOptions,
+            buffer_size: BufferSize,
+            n_periods: u32,
+            ctx: *ContextType,
+            callback: Device.AudioCallback,
+            opts: CalibrationOptions,
+        ) !Trial {
+            var loop_telemetry = telemetry.LoopTelemetry{};
+
+            var candidate = device_opts;
+            candidate.buffer_size = buffer_size;
+            candidate.n_periods = n_periods;
+            candidate.telemetry = &loop_telemetry;
+
+            var device = try Device.init(allocator, candidate);
+
+            defer device.deinit() catch |err| {
+                log.warn("Calibration: Failed to close the device: {s}", .{@errorName(err)});
+            };
+
+            try device.prepare();
+
+            var poll_loop = PollLoop.init(allocator, .{ .timeout = poll_timeout_ms, .realtime = candidate.realtime });
+            defer poll_loop.deinit();
+
+            try poll_loop.add(device, ctx, callback);
+
+            var failed = std.atomic.Value(bool).init(false);
+            const thread = try std.Thread.spawn(.{}, runLoop, .{ &poll_loop, &failed });
+
+            const period_ns = periodNs(buffer_size, device_opts.sample_rate);
+            const started = telemetry.monotonicNs();
+            var verdict = Verdict.pending;
+
+            while (verdict == .pending) {
+                std.time.sleep(check_interval_ms * std.time.ns_per_ms);
+
+                // an unrecoverable stream error
+                if (failed.load(.acquire)) {
+                    verdict = .xruns;
+                    break;
+                }
+
+                verdict = judge(loop_telemetry.snapshot(), period_ns, telemetry.monotonicNs() -| started, opts);
+            }
+
+            poll_loop.stop();
+            thread.join();
+
+            return .{ .verdict = verdict, .snapshot = loop_telemetry.snapshot() };
+        }
+
+        fn runLoop(poll_loop: *PollLoop, failed: *std.atomic.Value(bool)) void {
+            poll_loop.run() catch |err| {
+                log.info("Calibration: Loop stopped: {s}", .{@errorName(err)});
+                failed.store(true, .release);
+            };
+        }
+    };
+}
+
+/// Judges a candidate from its telemetry `elapsed_ns` into the window.
+pub fn judge(s: telemetry.LoopTelemetry.Snapshot, period_ns: u64, elapsed_ns: u64, opts: CalibrationOptions) Verdict {
+    if (s.health.xruns > opts.max_xruns) return .xruns;
+
+    const over_load = callbackLoad(s, period_ns) > opts.max_load;
+    if (s.callback_duration.count >= opts.min_callbacks and over_load) return .load;
+
+    if (elapsed_ns < @as(u64, opts.window_ms) * std.time.ns_per_ms) return .pending;
+
+    // a stalled loop never called back, large periods may not reach `min_callbacks` in a short window
+    if (s.callback_duration.count == 0) return .xruns;
+    return if (over_load) .load else .stable;
+}
+
+/// The calibration persisted for the device of `device_opts`, `null` when it was never calibrated.
+/// `path` is `defaultPath` when null.
+pub fn load(allocator: std.mem.Allocator, path: ?[]const u8, device_opts: HalfDuplexDeviceOptions) !?Result {
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    defer arena.deinit();
+
+    const file = (try readFile(arena.allocator(), path)) orelse return null;
+
+    for (file.entries) |entry| {
+        if (entry.matches(device_opts)) return entry.result;
+    }
+
+    return null;
+}
+
+/// Persists `result` for the device of `device_opts`, replacing its previous calibration.
+/// `path` is `defaultPath` when null.
+pub fn save(allocator: std.mem.Allocator, path: ?[]const u8, device_opts: HalfDuplexDeviceOptions, result: Result) !void {
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    defer arena.deinit();
+
+    const a = arena.allocator();
+    const file_path = (try resolvePath(a, path)) orelse return;
+
+    var entries = std.ArrayList(Entry).init(a);
+
+    if (try readFile(a, file_path)) |file| {
+        for (file.entries) |entry| {
+            if (!entry.matches(device_opts)) try entries.append(entry);
+        }
+    }
+
+    try entries.append(.{
+        .ident = device_opts.ident,
+        .stream_type = device_opts.stream_type,
+        .sample_rate = device_opts.sample_rate,
+        .channels = device_opts.channels,
+        .result = result,
+    });
+
+    if (std.fs.path.dirname(file_path)) |dir| try std.fs.cwd().makePath(dir);
+
+    var atomic = try std.fs.cwd().atomicFile(file_path, .{});
+    defer atomic.deinit();
+
+    var buffered = std.io.bufferedWriter(atomic.file.writer());
+    try std.json.stringify(File{ .version = version, .entries = entries.items }, .{ .whitespace = .indent_2 }, buffered.writer());
+    try buffered.flush();
+    try atomic.finish();
+}
+
+/// `$XDG_CACHE_HOME/delia/alsa_calibration.json`, falling back to `$HOME/.cache`. `null` when neither is set.
+pub fn defaultPath(allocator: std.mem.Allocator) !?[]u8 {
+    return utils.cachePath(allocator, "alsa_calibration.json");
+}
+
+fn resolvePath(allocator: std.mem.Allocator, path: ?[]const u8) !?[]const u8 {
+    if (path) |p| return p;
+    return try defaultPath(allocator);
+}
+
+// a missing, unreadable or outdated file is no calibration
+fn readFile(allocator: std.mem.Allocator, path: ?[]const u8) !?File {
+    const file_path = (try resolvePath(allocator, path)) orelse return null;
+
+    const data = std.fs.cwd().readFileAlloc(allocator, file_path, max_file_bytes) catch |err| switch (err) {
+        error.OutOfMemory => return error.OutOfMemory,
+        error.FileNotFound => return null,
+        else => {
+            log.warn("Calibration: Ignoring {s}: {s}", .{ file_path, @errorName(err) });
+            return null;
+        },
+    };
+
+    const file = std.json.parseFromSliceLeaky(File, allocator, data, .{ .ignore_unknown_fields = true }) catch |err| {
+        log.warn("Calibration: Ignoring {s}: {s}", .{ file_path, @errorName(err) });
+        return null;
+    };
+
+    if (file.version != version) return null;
+    return file;
+}
+
+fn periodNs(buffer_size: BufferSize, sample_rate: SampleRate) u64 {
+    return @intCast(@as(u128, @intFromEnum(buffer_size)) * std.time.ns_per_s / @intFromEnum(sample_rate));
+}
+
+// p99.9 callback duration over the period
+fn callbackLoad(s: telemetry.LoopTelemetry.Snapshot, period_ns: u64) f64 {
+    if (period_ns == 0) return 0;
+    return @as(f64, @floatFromInt(s.callback_duration.p999)) / @as(f64, @floatFromInt(period_ns));
+}
+
+test "judge rejects on xruns and on the callback tail, and waits for the window otherwise" {
+    var loop_telemetry = telemetry.LoopTelemetry{};
+    const period_ns = periodNs(.buf_128, .sr_48000);
+    const opts = CalibrationOptions{ .window_ms = 1000, .min_callbacks = 10 };
+    const window_ns = 1000 * std.time.ns_per_ms;
+
+    // a callback using 30% of the period
+    for (0..20) |_| loop_telemetry.callback_duration.record(period_ns * 3 / 10);
+
+    try std.testing.expectEqual(Verdict.pending, judge(loop_telemetry.snapshot(), period_ns, window_ns / 2, opts));
+    try std.testing.expectEqual(Verdict.stable, judge(loop_telemetry.snapshot(), period_ns, window_ns, opts));
+
+    // the tail reaches 90% of the period, rejected before the window ends
+    for (0..20) |_| loop_telemetry.callback_duration.record(period_ns * 9 / 10);
+    try std.testing.expectEqual(Verdict.load, judge(loop_telemetry.snapshot(), period_ns, window_ns / 2, opts));
+
+    loop_telemetry.callback_duration.reset();
+    for (0..20) |_| loop_telemetry.callback_duration.record(period_ns / 10);
+
+    loop_telemetry.health.xrun();
+    try std.testing.expectEqual(Verdict.xruns, judge(loop_telemetry.snapshot(), period_ns, window_ns / 2, opts));
+    try std.testing.expectEqual(Verdict.pending, judge(loop_telemetry.snapshot(), period_ns, window_ns / 2, .{ .window_ms = 1000, .max_xruns = 1 }));
+}
+
+test "save and load keep one calibration per device" {
+    const allocator = std.testing.allocator;
+
+    var path_buffer: [64]u8 = undefined;
+    const path = try std.fmt.bufPrint(&path_buffer, "/tmp/delia-calibration-{d}.json", .{std.os.linux.getpid()});
+    defer std.fs.cwd().deleteFile(path) catch {};
+
+    const playback = HalfDuplexDeviceOptions{ .ident = "hw:0,0", .sample_rate = .sr_48000 };
+    const capture = HalfDuplexDeviceOptions{ .ident = "hw:0,0", .sample_rate = .sr_48000, .stream_type = .capture };
+
+    try std.testing.expect(try load(allocator, path, playback) == null);
+
+    const first = Result{ .buffer_size = .buf_512, .n_periods = 3, .xruns = 0, .callback_p999_ns = 2_000_000, .headroom = 0.8 };
+    const second = Result{ .buffer_size = .buf_256, .n_periods = 2, .xruns = 0, .callback_p999_ns = 1_000_000, .headroom = 0.8 };
+
+    try save(allocator, path, playback, first);
+    try save(allocator, path, capture, first);
+    try save(allocator, path, playback, second);
+
+    try std.testing.expectEqual(second, (try load(allocator, path, playback)).?);
+    try std.testing.expectEqual(first, (try load(allocator, path, capture)).?);
+    try std.testing.expectEqual(BufferSize.buf_256, second.apply(playback).buffer_size);
+    try std.testing.expectEqual(512, second.latencyFrames());
+}
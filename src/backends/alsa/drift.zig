@@ -0,0 +1,110 @@
+const std = @import("std");
+
+/// Drift compensation of unlinked full duplex devices, see `FullDuplexDeviceOptions.drift`.
+/// Two cards run on two crystals, a few dozen ppm apart: without correction the frames in flight between capture
+/// and playback grow or shrink until one of the buffers runs out. The capture stream is resampled instead, by a ratio
+/// a PI controller derives from the fill levels of both buffers.
+pub const DriftOptions = struct {
+    /// Settling time of the controller. Shorter follows faster but lets more of the fill level jitter through.
+    time_constant_ms: u32 = 10_000,
+    /// Time constant of the moving average over the fill level measurements.
+    smoothing_ms: u32 = 500,
+    /// Largest ratio correction in parts per million, far above the tolerance of audio crystals.
+    max_correction_ppm: u32 = 1000,
+};
+
+/// Keeps the frames in flight, captured and not yet consumed plus written and not yet played, at the level measured
+/// on the first update. The proportional and integral gains put a double pole at the time constant, critically
+/// damped, and the integral settles on the drift itself.
+pub const DriftController = struct {
+    kp: f64,
+    ki: f64,
+    smoothing_frames: f64,
+    max_correction: f64,
+    // frames in flight to hold, learned on the first update after init or `reset`
+    target: ?f64 = null,
+    smoothed: f64 = 0,
+    // error integrated over frames
+    integral: f64 = 0,
+    correction: f64 = 0,
+
+    pub fn init(opts: DriftOptions, sample_rate: u32) DriftController {
+        const rate: f64 = @floatFromInt(sample_rate);
+        const time_constant = @as(f64, @floatFromInt(opts.time_constant_ms)) / std.time.ms_per_s * rate;
+        const kp = 2.0 / time_constant;
+
+        return .{
+            .kp = kp,
+            .ki = kp * kp / 4.0,
+            .smoothing_frames = @as(f64, @floatFromInt(opts.smoothing_ms)) / std.time.ms_per_s * rate,
+            .max_correction = @as(f64, @floatFromInt(opts.max_correction_ppm)) / 1e6,
+        };
+    }
+
+    /// Output over input frames for the capture resampler, below 1 when the capture clock runs fast.
+    pub fn ratio(self: DriftController) f64 {
+        return 1.0 - self.correction;
+    }
+
+    /// Capture clock relative to the playback clock as currently estimated, in parts per million.
+    pub fn driftPpm(self: DriftController) f64 {
+        return self.correction * 1e6;
+    }
+
+    /// Feeds the frames in flight measured `elapsed_frames` after the previous update, returns the new ratio.
+    pub fn update(self: *DriftController, level: f64, elapsed_frames: usize) f64 {
+        const target = self.target orelse {
+            self.target = level;
+            self.smoothed = level;
+            return self.ratio();
+        };
+
+        if (elapsed_frames == 0) return self.ratio();
+
+        const elapsed: f64 = @floatFromInt(elapsed_frames);
+        self.smoothed += (level - self.smoothed) * elapsed / (elapsed + self.smoothing_frames);
+
+        const err = self.smoothed - target;
+        const integral = self.integral + err * elapsed;
+        const unclamped = self.kp * err + self.ki * integral;
+
+        self.correction = std.math.clamp(unclamped, -self.max_correction, self.max_correction);
+
+        // anti windup, the integral holds while the correction is saturated
+        if (unclamped == self.correction) self.integral = integral;
+
+        return self.ratio();
+    }
+
+    /// After an xrun the buffers restart from a new fill level, it becomes the target. The drift estimate is kept.
+    pub fn reset(self: *DriftController) void {
+        self.target = null;
+        self.integral = if (self.ki == 0) 0 else self.correction / self.ki;
+    }
+};
+
+test "DriftController - the frames in flight stay bounded and the drift is found" {
+    const sample_rate = 48_000;
+    const block = 256;
+    // capture runs 200ppm fast
+    const drift = 200e-6;
+
+    var controller = DriftController.init(.{}, sample_rate);
+
+    const start: f64 = 2048;
+    var level = start;
+    var max_deviation: f64 = 0;
+
+    // 90 seconds
+    for (0..90 * sample_rate / block) |_| {
+        const r = controller.update(level, block);
+
+        // one block played, a block and the drift captured, block / ratio consumed by the resampler
+        level += block * (1.0 + drift) - block / r;
+        max_deviation = @max(max_deviation, @abs(level - start));
+    }
+
+    try std.testing.expect(max_deviation < 64);
+    try std.testing.expectApproxEqAbs(start, level, 4);
+    try std.testing.expectApproxEqAbs(200, controller.driftPpm(), 5);
+}
@@ -17,6 +17,11 @@ const c_alsa = @cImport({
 const log = std.log.scoped(.alsa);
 const latency = @import("latency.zig");
 const utils = @import("utils.zig");
+const realtime = @import("../../common/realtime.zig");
+const tsched = @import("tsched.zig");
+const telemetry = @import("../../common/telemetry.zig");
+const drift = @import("drift.zig");
+const resampler = @import("../../dsp/resampler.zig");
 
 pub const Hardware = @import("Hardware.zig");
 pub const Format = @import("format.zig").Format;
@@ -32,13 +37,17 @@ const GenericAudioData = @import("audio_data.zig").GenericAudioData;
 
 pub const SampleRate = @import("../../common/audio_specs.zig").SampleRate;
 pub const BufferSize = @import("../../common/audio_specs.zig").BufferSize;
+pub const RealtimeOptions = realtime.RealtimeOptions;
+pub const TschedOptions = tsched.TschedOptions;
+pub const LoopTelemetry = telemetry.LoopTelemetry;
+pub const DriftOptions = drift.DriftOptions;
 
 const ProbeOptions = struct {
     callback: latency.ProbeCallback,
     buffer_cycles: u32,
 };
 
-const HalfDuplexDeviceOptions = struct {
+pub const HalfDuplexDeviceOptions = struct {
     sample_rate: SampleRate = SampleRate.sr_44100,
     channels: ChannelCount = ChannelCount.stereo,
     stream_type: StreamType = StreamType.playback,
@@ -50,6 +59,17 @@ const HalfDuplexDeviceOptions = struct {
     start_thresh: StartThreshold = .disabled,
     must_prepare: bool = true,
     probe_options: ?ProbeOptions = null,
+    /// Tried first, the other access types are fallbacks. See `HalfDuplexDevice.init`.
+    access_type: AccessType = .mmap_interleaved,
+    /// Never falls back to a non interleaved access type, for loops that only transfer interleaved frames.
+    interleaved_only: bool = false,
+    /// Applied to the thread running the audio loop, see `start` and `spawn`. Null leaves the thread as is.
+    realtime: ?RealtimeOptions = null,
+    /// Playback only. Timer based scheduling instead of period wakeups, pair it with a large `n_periods`.
+    tsched: ?TschedOptions = null,
+    /// Timings of every loop cycle and a mirror of `HalfDuplexDevice.health`, owned by the caller and readable from
+    /// any thread. One per device.
+    telemetry: ?*LoopTelemetry = null,
 };
 
 pub const DeviceHardwareError = error{
@@ -87,6 +107,7 @@ pub const AudioLoopError = error{
     audio_buffer_nonalignment,
     poll_alloc,
     buffer_size,
+    timer,
 };
 
 pub const DeviceComptimeOptions = struct {
@@ -147,8 +168,8 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
         stop_thresh: u32,
         /// Timeout in milliseconds for ALSA to wait before returning an error during read/write operations.
         timeout: i32,
-        /// Currently only mmap interleaved is will be the default access type with automatic fallback to rw interleaved
-        /// Non-interleaved access types are not yet supported.
+        /// Negotiated in `init`, the preferred access type or the first fallback the hardware accepts.
+        /// Non interleaved access hands the callback non interleaved `GenericAudioData`.
         access_type: AccessType = AccessType.mmap_interleaved,
         /// Manages Audio sample format (e.g., 16-bit signed little-endian).
         audio_format: Format(T),
@@ -157,7 +178,10 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
         n_periods: u32,
 
         /// Used on RW transfers that require a buffer to read/write data
+        /// One period, interleaved frames or one run per channel for rw_noninterleaved.
         transfer_buffer: []u8 = undefined,
+        /// Channel pointers into `transfer_buffer` for `snd_pcm_readn`/`snd_pcm_writen`.
+        channel_buffers: []?*anyopaque = &.{},
         allocator: std.mem.Allocator,
 
         /// wether HalfDuplexDevice.prepare will explicitly call snd_pcm_prepare.
@@ -167,6 +191,23 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
         /// Probe for measuring latency
         probe: ?latency.Probe,
 
+        /// Latency in frames added by the processing graph (see `Scheduler.latency`).
+        /// Not applied to the stream, reported alongside the hardware latency.
+        processing_latency: u32 = 0,
+
+        /// Thread setup for the audio loop.
+        realtime_options: ?RealtimeOptions = null,
+
+        /// Timer based scheduling, playback only. See `TschedOptions`.
+        tsched: ?TschedOptions = null,
+
+        /// Recorded by the audio loop, see `LoopTelemetry`.
+        telemetry: ?*LoopTelemetry = null,
+
+        /// Xruns, suspends and short transfers of the audio loop, counted with or without `telemetry` and mirrored to
+        /// its health. Shared by the copies of the device, e.g. the one running the loop.
+        health: *telemetry.HealthCounters,
+
         const DeviceOptionsFromHardware = struct {
             mode: Mode = Mode.none,
             buffer_size: BufferSize = BufferSize.buf_1024,
@@ -174,6 +215,10 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
             timeout: i32 = -1,
             must_prepare: bool = true,
             probe_options: ?ProbeOptions = null,
+            access_type: AccessType = .mmap_interleaved,
+            realtime: ?RealtimeOptions = null,
+            tsched: ?TschedOptions = null,
+            telemetry: ?*LoopTelemetry = null,
         };
 
         // Initializes a `Device` using the provided `Hardware` configuration and additional options.
@@ -207,6 +252,10 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                 .timeout = inc_opts.timeout,
                 .must_prepare = inc_opts.must_prepare,
                 .probe_options = inc_opts.probe_options,
+                .access_type = inc_opts.access_type,
+                .realtime = inc_opts.realtime,
+                .tsched = inc_opts.tsched,
+                .telemetry = inc_opts.telemetry,
             };
 
             return try init(allocator, opts);
@@ -275,23 +324,28 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
 
             _ = c_alsa.snd_pcm_hw_params_any(pcm_handle, params);
 
-            // prefers mmap interleaved access type but will fallback to rw interleaved if not available
-            var access_type = AccessType.mmap_interleaved;
+            const access_order = accessOrder(opts.access_type, opts.interleaved_only);
+            var negotiated: ?AccessType = null;
 
-            err = c_alsa.snd_pcm_hw_params_set_access(pcm_handle, params, @intFromEnum(access_type));
+            for (access_order.constSlice()) |candidate| {
+                err = c_alsa.snd_pcm_hw_params_set_access(pcm_handle, params, @intFromEnum(candidate));
 
-            if (err < 0) {
-                log.warn("Failed to set access type '{s}': {s}", .{ @tagName(access_type), c_alsa.snd_strerror(err) });
+                if (err >= 0) {
+                    negotiated = candidate;
+                    break;
+                }
 
-                access_type = AccessType.rw_interleaved;
+                log.warn("Failed to set access type '{s}': {s}", .{ @tagName(candidate), c_alsa.snd_strerror(err) });
+            }
 
-                log.warn("Attempting fallback to '{s}' access type. Note this will increase latency", .{@tagName(access_type)});
-                err = c_alsa.snd_pcm_hw_params_set_access(pcm_handle, params, @intFromEnum(access_type));
+            const access_type = negotiated orelse {
+                log.err("The hardware accepts none of the access types", .{});
+                return DeviceHardwareError.access_type;
+            };
 
-                if (err < 0) {
-                    log.err("Failed to set access type '{s}': {s}", .{ @tagName(access_type), c_alsa.snd_strerror(err) });
-                    return DeviceHardwareError.access_type;
-                }
+            if (access_type != opts.access_type) {
+                const rw = access_type == .rw_interleaved or access_type == .rw_noninterleaved;
+                log.warn("Fell back to '{s}' access type.{s}", .{ @tagName(access_type), if (rw) " Note this will increase latency" else "" });
             }
 
             err = c_alsa.snd_pcm_hw_params_set_format(pcm_handle, params, @intFromEnum(FORMAT_TYPE));
@@ -342,6 +396,16 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                 return DeviceHardwareError.buffer_size;
             }
 
+            const use_tsched = opts.tsched != null and opts.stream_type == .playback;
+
+            if (opts.tsched != null and !use_tsched) log.warn("Timer based scheduling is only supported for playback, ignoring it", .{});
+
+            if (use_tsched) {
+                // the timer wakes the loop up, period interrupts are only needed by drivers that can not do without
+                err = c_alsa.snd_pcm_hw_params_set_period_wakeup(pcm_handle, params, 0);
+                if (err < 0) log.warn("Could not disable period wakeups: {s}", .{c_alsa.snd_strerror(err)});
+            }
+
             err = c_alsa.snd_pcm_hw_params(pcm_handle, params);
 
             if (err < 0) {
@@ -378,7 +442,8 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                 return DeviceHardwareError.buffer_size;
             }
 
-            const frame_size: usize = @intFromEnum(opts.channels) * @sizeOf(T);
+            // bit size, the packed 3 bytes formats use i24/u24 which are 4 bytes in memory
+            const frame_size: usize = @intFromEnum(opts.channels) * @divExact(@bitSizeOf(T), 8);
             const buffer_bytes: usize = frame_size * @intFromEnum(opts.buffer_size);
 
             // start with after filling one hardware buffer size, as soon as possible, or disabled
@@ -406,8 +471,17 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
 
             // used for rw transfers
             const transfer_buffer = try allocator.alloc(u8, buffer_bytes);
+            errdefer allocator.free(transfer_buffer);
+
             @memset(transfer_buffer, 0);
 
+            // filled by the rw non interleaved loop, allocated here to keep the loop allocation free
+            const channel_buffers = try allocator.alloc(?*anyopaque, @intFromEnum(opts.channels));
+            errdefer allocator.free(channel_buffers);
+
+            const health = try allocator.create(telemetry.HealthCounters);
+            health.* = telemetry.HealthCounters.mirroring(opts.telemetry);
+
             return Self{
                 .pcm_handle = pcm_handle,
                 .hw_params = params,
@@ -425,9 +499,14 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                 .audio_format = Format(T).init(FORMAT_TYPE),
                 .allocator = allocator,
                 .transfer_buffer = transfer_buffer,
+                .channel_buffers = channel_buffers,
                 .must_prepare = opts.must_prepare,
                 .probe = probe,
                 .access_type = access_type,
+                .realtime_options = opts.realtime,
+                .tsched = if (use_tsched) opts.tsched else null,
+                .telemetry = opts.telemetry,
+                .health = health,
             };
         }
 
@@ -527,9 +606,15 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                 return DeviceSoftwareError.set_period_event;
             }
 
-            if (err < 0) {
-                log.err("Failed to set software parameters: {s}", .{c_alsa.snd_strerror(err)});
-                return DeviceSoftwareError.software_params;
+            // installed for tsched only, the fill level extrapolation needs the monotonic timestamps,
+            // period driven devices keep running on the driver defaults
+            if (self.tsched != null) {
+                err = c_alsa.snd_pcm_sw_params(self.pcm_handle, self.sw_params);
+
+                if (err < 0) {
+                    log.err("Failed to set software parameters: {s}", .{c_alsa.snd_strerror(err)});
+                    return DeviceSoftwareError.software_params;
+                }
             }
 
             if (self.must_prepare) {
@@ -553,16 +638,29 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
             try writer.print("  Channels:           {d}\n", .{self.channels});
             try writer.print("  Buffer Size:        {d} frames\n", .{@intFromEnum(self.buffer_size)});
             try writer.print("  HW Buffer Size:     {d} frames\n", .{self.hardware_buffer_size});
+            try writer.print("  Graph Latency:      {d} frames\n", .{self.processing_latency});
             try writer.print("  Timeout:            {d}ms\n", .{if (self.timeout < 0) 0 else self.timeout});
+            try writer.print("  Timer Scheduling:   {s}\n", .{if (self.tsched != null) "on" else "off"});
             try writer.print("  Open Mode:          {s}\n", .{@tagName(self.mode)});
             try writer.print("  Transfer Buff Size: {d} bytes\n", .{self.transfer_buffer.len});
             try writer.print("{s}\n", .{self.audio_format});
         }
 
+        pub fn setProcessingLatency(self: *Self, frames: usize) void {
+            self.processing_latency = @intCast(frames);
+
+            if (self.probe) |*p| p.setProcessingLatency(self.processing_latency);
+        }
+
+        /// Hardware buffering plus processing latency in frames.
+        pub fn latencyFrames(self: Self) u32 {
+            return self.hardware_buffer_size + self.processing_latency;
+        }
+
         pub fn deinit(self: *Self) !void {
-            if (self.access_type == .rw_interleaved) {
-                self.allocator.free(self.transfer_buffer);
-            }
+            self.allocator.free(self.transfer_buffer);
+            self.allocator.free(self.channel_buffers);
+            self.allocator.destroy(self.health);
 
             c_alsa.snd_pcm_hw_params_free(self.hw_params);
             c_alsa.snd_pcm_sw_params_free(self.sw_params);
@@ -575,14 +673,51 @@ pub fn HalfDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
             }
         }
 
+        /// Runs the audio loop on the calling thread until it stops.
+        /// With `realtime` options the thread is set up first and the floating point state is restored on return,
+        /// the scheduling policy stays.
         pub fn start(self: Self, ctx: *ContextType, callback: AudioCallback) !void {
             var audio_loop = AudioLoop.init(self, ctx, callback);
 
+            const applied = if (self.realtime_options) |opts| self.applyRealtime(opts) else null;
+            defer if (applied) |a| a.restore();
+
             try audio_loop.start();
         }
+
+        /// Runs `start` on a dedicated thread, the `realtime` options only affect that thread.
+        /// Loop errors are logged when the thread ends.
+        pub fn spawn(self: Self, ctx: *ContextType, callback: AudioCallback) std.Thread.SpawnError!std.Thread {
+            return std.Thread.spawn(.{}, runThread, .{ self, ctx, callback });
+        }
+
+        fn runThread(self: Self, ctx: *ContextType, callback: AudioCallback) void {
+            self.start(ctx, callback) catch |err| log.err("Audio loop stopped: {s}", .{@errorName(err)});
+        }
+
+        // faults in the buffers touched by the loop before locking memory and raising the priority
+        fn applyRealtime(self: Self, opts: RealtimeOptions) realtime.Applied {
+            realtime.prefault(self.transfer_buffer);
+            return realtime.apply(opts);
+        }
     };
 }
 
+// the preferred access type first, then mmap before rw and interleaved before non interleaved
+fn accessOrder(preferred: AccessType, interleaved_only: bool) std.BoundedArray(AccessType, 4) {
+    const candidates = [_]AccessType{ preferred, .mmap_interleaved, .mmap_noninterleaved, .rw_interleaved, .rw_noninterleaved };
+    var order = std.BoundedArray(AccessType, 4){};
+
+    for (candidates, 0..) |candidate, i| {
+        if (i > 0 and candidate == preferred) continue;
+        if (interleaved_only and (candidate == .mmap_noninterleaved or candidate == .rw_noninterleaved)) continue;
+
+        order.appendAssumeCapacity(candidate);
+    }
+
+    return order;
+}
+
 const FullDuplexIdent = struct {
     playback: [:0]const u8 = "default",
     capture: [:0]const u8 = "default",
@@ -604,6 +739,13 @@ const FullDuplexDeviceOptions = struct {
     start_thresh: StartThreshold = .fill_one_period,
     master_device: StreamType = StreamType.playback,
     probe_options: ?ProbeOptions = null,
+    /// Applied to the thread running the audio loop, see `HalfDuplexDeviceOptions.realtime`.
+    realtime: ?RealtimeOptions = null,
+    /// See `HalfDuplexDeviceOptions.telemetry`, cycles are timed on the playback device.
+    telemetry: ?*LoopTelemetry = null,
+    /// Unlinked devices only, the capture stream is resampled to follow the playback clock. Null trusts both clocks
+    /// to run at the same rate.
+    drift: ?DriftOptions = .{},
 };
 
 pub fn FullDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptimeOptions) type {
@@ -635,8 +777,11 @@ pub fn FullDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
         master_device: StreamType,
         same_channel_config: bool,
         is_linked: bool,
+        realtime_options: ?RealtimeOptions = null,
+        telemetry: ?*LoopTelemetry = null,
+        drift_options: ?DriftOptions = null,
 
-        // note that the full duplex does not offer resampling capabilities
+        // note that the full duplex only resamples to compensate clock drift, the sample rates must match
         pub fn init(allocator: std.mem.Allocator, opts: FullDuplexDeviceOptions) DeviceHardwareError!Self {
             const Device = HalfDuplexDevice(ContextType, comptime_opts);
 
@@ -653,6 +798,8 @@ pub fn FullDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                 .n_periods = opts.n_periods,
                 .start_thresh = opts.start_thresh,
                 .probe_options = opts.probe_options,
+                // FullDuplexAudioLoop transfers interleaved frames only
+                .interleaved_only = true,
 
                 // we don't need to snd_pcm_prepare the slave device when linked linked
                 .must_prepare = !is_linked,
@@ -669,6 +816,7 @@ pub fn FullDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                 .start_thresh = opts.start_thresh,
 
                 .probe_options = opts.probe_options,
+                .interleaved_only = true,
             });
 
             if (is_linked) {
@@ -700,6 +848,7 @@ pub fn FullDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                     .n_periods = opts.n_periods,
                     .start_thresh = opts.start_thresh,
                     .probe_options = opts.probe_options,
+                    .interleaved_only = true,
                     .must_prepare = !is_linked,
                 });
 
@@ -726,6 +875,7 @@ pub fn FullDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                     .n_periods = opts.n_periods,
                     .start_thresh = opts.start_thresh,
                     .probe_options = opts.probe_options,
+                    .interleaved_only = true,
                 });
 
                 if (playback_device.sample_rate != capture_device.sample_rate) {
@@ -735,6 +885,10 @@ pub fn FullDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                 }
             }
 
+            // the members count the events of their stream, the telemetry of the full duplex sums both
+            playback_device.health.mirror = if (opts.telemetry) |t| &t.health else null;
+            capture_device.health.mirror = if (opts.telemetry) |t| &t.health else null;
+
             return .{
                 .playback_device = playback_device,
                 .capture_device = capture_device,
@@ -742,6 +896,9 @@ pub fn FullDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
                 .allocator = allocator,
                 .same_channel_config = playback_device.channels == capture_device.channels,
                 .master_device = opts.master_device,
+                .realtime_options = opts.realtime,
+                .telemetry = opts.telemetry,
+                .drift_options = if (is_linked) null else opts.drift,
             };
         }
 
@@ -750,11 +907,41 @@ pub fn FullDuplexDevice(ContextType: type, comptime comptime_opts: DeviceComptim
             try self.capture_device.prepare();
         }
 
+        /// The playback device is the one probing, the capture device only keeps it for reporting.
+        pub fn setProcessingLatency(self: *Self, frames: usize) void {
+            self.playback_device.setProcessingLatency(frames);
+            self.capture_device.setProcessingLatency(frames);
+        }
+
+        /// Capture buffering, processing and playback buffering in frames, plus the resampler when compensating drift.
+        pub fn roundTripLatencyFrames(self: Self) u32 {
+            const resampling: u32 = if (self.drift_options != null) FullDuplexAudioLoop(ContextType, comptime_opts).Resampler.latency_frames else 0;
+            return self.capture_device.hardware_buffer_size + self.playback_device.latencyFrames() + resampling;
+        }
+
+        /// Same as `HalfDuplexDevice.start`.
         pub fn start(self: Self, ctx: *ContextType, callback: AudioCallback) !void {
             var audio_loop = FullDuplexAudioLoop(ContextType, comptime_opts).init(self, ctx, callback);
+
+            const applied = if (self.realtime_options) |opts| blk: {
+                realtime.prefault(self.playback_device.transfer_buffer);
+                realtime.prefault(self.capture_device.transfer_buffer);
+                break :blk realtime.apply(opts);
+            } else null;
+            defer if (applied) |a| a.restore();
+
             try audio_loop.start();
         }
 
+        /// Same as `HalfDuplexDevice.spawn`.
+        pub fn spawn(self: Self, ctx: *ContextType, callback: AudioCallback) std.Thread.SpawnError!std.Thread {
+            return std.Thread.spawn(.{}, runThread, .{ self, ctx, callback });
+        }
+
+        fn runThread(self: Self, ctx: *ContextType, callback: AudioCallback) void {
+            self.start(ctx, callback) catch |err| log.err("Audio loop stopped: {s}", .{@errorName(err)});
+        }
+
         pub fn deinit(self: *Self) !void {
             if (self.is_linked) {
                 const err = c_alsa.snd_pcm_unlink(self.playback_device.pcm_handle);
@@ -799,8 +986,14 @@ fn HalfDuplexAudioLoop(ContextType: type, comptime comptime_opts: DeviceComptime
         running: bool = false,
         callback: AudioCallback(),
         ctx: *ContextType,
+        zero_transfers: usize = 0,
 
         pub fn init(device: HalfDuplexDevice(ContextType, comptime_opts), ctx: *ContextType, callback: AudioCallback()) Self {
+            if (device.telemetry) |t| {
+                t.setPeriod(@intFromEnum(device.buffer_size), device.sample_rate);
+                t.setLatency(device.latencyFrames(), device.sample_rate);
+            }
+
             return .{
                 .device = device,
                 .callback = callback,
@@ -808,27 +1001,306 @@ fn HalfDuplexAudioLoop(ContextType: type, comptime comptime_opts: DeviceComptime
             };
         }
 
+        const AudioData = GenericAudioData(format_type);
+
+        // the callback, timed when the device has telemetry
+        inline fn invokeCallback(self: *Self, audio_data: *AudioData) void {
+            const t = self.device.telemetry orelse return self.callback(self.ctx, audio_data);
+
+            t.callbackStart();
+            self.callback(self.ctx, audio_data);
+            t.callbackEnd();
+        }
+
+        // a new cycle for the telemetry, see `wakeTimestamp`
+        inline fn markWake(self: *Self) void {
+            const t = self.device.telemetry orelse return;
+            t.wake(wakeTimestamp(self.device.pcm_handle, t.period_ns));
+        }
+
         pub fn start(self: *Self) AudioLoopError!void {
             self.running = true;
 
+            if (self.device.tsched) |opts| return self.tschedTransfer(opts);
+
             switch (self.device.access_type) {
-                // this is the only access type currently supported at this point
-                AccessType.mmap_interleaved => try self.mmapTransfer(),
-                else => {
-                    log.err("Unsupported access type: {s}", .{@tagName(self.device.access_type)});
-                    return AudioLoopError.unsupported;
+                AccessType.mmap_interleaved, AccessType.mmap_noninterleaved => try self.mmapTransfer(),
+                AccessType.rw_interleaved, AccessType.rw_noninterleaved => try self.rwTransfer(),
+            }
+        }
+
+        // playback kept filled up to `levels.target`, sleeping on a timer until the estimated fill level reaches the watermark
+        fn tschedTransfer(self: *Self, opts: TschedOptions) AudioLoopError!void {
+            const block: usize = @intFromEnum(self.device.buffer_size);
+            var levels = tsched.Levels.init(opts, self.device.hardware_buffer_size, block);
+
+            const timer = tsched.Timer.init() catch return AudioLoopError.timer;
+            defer timer.deinit();
+
+            if (Device.PROBE_ENABLED) {
+                if (self.device.probe) |*p| p.start();
+            }
+
+            var last_wakeup = tsched.Timer.now();
+
+            while (self.running) {
+                if (c_alsa.snd_pcm_state(self.device.pcm_handle) == c_alsa.SND_PCM_STATE_XRUN) {
+                    levels.onUnderrun();
+                    log.warn("Underrun, watermark raised to {d} frames, latency {d} frames", .{ levels.watermark, levels.target });
+                }
+
+                try self.checkState();
+
+                var queued = (try self.queuedFrames()) orelse {
+                    levels.onUnderrun();
+                    continue;
+                };
+
+                self.markWake();
+
+                while (queued + block <= levels.target) : (queued += block) {
+                    if (!try self.transferBlock(block)) break;
+                }
+
+                try self.startIfPrepared();
+
+                timer.sleep(tsched.framesToNs(queued -| levels.watermark, self.device.sample_rate)) catch return AudioLoopError.timer;
+
+                const now = tsched.Timer.now();
+                levels.onStable(now -| last_wakeup);
+                last_wakeup = now;
+            }
+        }
+
+        // frames still queued for playback: the last hardware pointer timestamp extrapolated to now,
+        // snd_pcm_delay when the stream is not running or the driver has no timestamp. Null after an xrun recovery.
+        fn queuedFrames(self: *Self) AudioLoopError!?usize {
+            const pcm_handle = self.device.pcm_handle;
+            const updated = c_alsa.snd_pcm_avail_update(pcm_handle);
+
+            if (updated < 0) {
+                try self.xrunRecovery(@intCast(updated));
+                return null;
+            }
+
+            if (c_alsa.snd_pcm_state(pcm_handle) == c_alsa.SND_PCM_STATE_RUNNING) {
+                var avail: c_alsa.snd_pcm_uframes_t = 0;
+
+                if (hardwareTimestamp(pcm_handle, &avail)) |at| {
+                    const played = tsched.nsToFrames(tsched.Timer.now() -| at, self.device.sample_rate);
+
+                    return (@as(usize, self.device.hardware_buffer_size) -| @as(usize, @intCast(avail))) -| played;
+                }
+            }
+
+            var delay: c_alsa.snd_pcm_sframes_t = 0;
+            const err = c_alsa.snd_pcm_delay(pcm_handle, &delay);
+
+            if (err < 0) {
+                try self.xrunRecovery(err);
+                return null;
+            }
+
+            return @intCast(@max(delay, 0));
+        }
+
+        // one callback block through mmap or the transfer buffer. Returns false when an xrun had to be recovered.
+        fn transferBlock(self: *Self, frames: usize) AudioLoopError!bool {
+            switch (self.device.access_type) {
+                .mmap_interleaved, .mmap_noninterleaved => return self.mmapFrames(@intCast(frames)),
+                .rw_interleaved, .rw_noninterleaved => {
+                    var audio_data = self.rwAudioData();
+
+                    if (self.device.stream_type == .capture) {
+                        try self.rwFrames(frames);
+                        self.invokeCallback(&audio_data);
+                    } else {
+                        self.invokeCallback(&audio_data);
+                        try self.rwFrames(frames);
+                    }
+
+                    if (Device.PROBE_ENABLED) {
+                        if (self.device.probe) |*p| p.addFrames(@intCast(frames));
+                    }
+
+                    return true;
                 },
             }
         }
 
-        // TODO write a simple write loop for non-mmap access types
-        //    fn blockingWrite(self: *Self) !void {}
+        // blocking snd_pcm_readi/writei or readn/writen of one period per callback, through the transfer buffer
+        fn rwTransfer(self: *Self) AudioLoopError!void {
+            const buffer_size: usize = @intFromEnum(self.device.buffer_size);
+            const is_capture = self.device.stream_type == .capture;
+
+            var audio_data = self.rwAudioData();
+
+            if (Device.PROBE_ENABLED) {
+                if (self.device.probe) |*p| p.start();
+            }
+
+            while (self.running) {
+                try self.checkState();
+
+                audio_data.rewind();
+
+                if (is_capture) {
+                    // a prepared capture stream does not start on its own with the start threshold disabled
+                    try self.startIfPrepared();
+                    try self.rwFrames(buffer_size);
+
+                    self.markWake();
+                    self.invokeCallback(&audio_data);
+                } else {
+                    // woken by the previous blocking write
+                    self.markWake();
+                    self.invokeCallback(&audio_data);
+
+                    try self.rwFrames(buffer_size);
+                    try self.startIfPrepared();
+                }
+
+                if (Device.PROBE_ENABLED) {
+                    if (self.device.probe) |*p| p.addFrames(@intCast(buffer_size));
+                }
+            }
+        }
+
+        // the callback view of the transfer buffer, one period long
+        fn rwAudioData(self: *Self) AudioData {
+            const buffer_size: usize = @intFromEnum(self.device.buffer_size);
+
+            return switch (self.device.access_type) {
+                .rw_noninterleaved => AudioData.initNonInterleaved(
+                    self.device.transfer_buffer,
+                    self.device.channels,
+                    self.device.sample_rate,
+                    self.device.audio_format,
+                    buffer_size * AudioData.sample_bytes,
+                ),
+                else => AudioData.init(
+                    self.device.transfer_buffer,
+                    self.device.channels,
+                    self.device.sample_rate,
+                    self.device.audio_format,
+                ),
+            };
+        }
+
+        // transfers exactly `frames` frames of the transfer buffer, resuming after short transfers and xruns
+        fn rwFrames(self: *Self, frames: usize) AudioLoopError!void {
+            const frame_bytes: usize = self.device.channels * AudioData.sample_bytes;
+            const channel_bytes: usize = frames * AudioData.sample_bytes;
+            const pcm_handle = self.device.pcm_handle;
+
+            var done: usize = 0;
+            var zero_transfers: usize = 0;
+
+            while (done < frames) {
+                const remaining: c_alsa.snd_pcm_uframes_t = @intCast(frames - done);
+
+                const res: c_long = switch (self.device.access_type) {
+                    .rw_noninterleaved => blk: {
+                        for (self.device.channel_buffers, 0..) |*ptr, ch| {
+                            ptr.* = self.device.transfer_buffer[ch * channel_bytes + done * AudioData.sample_bytes ..].ptr;
+                        }
+
+                        const bufs: [*c]?*anyopaque = self.device.channel_buffers.ptr;
+
+                        break :blk if (self.device.stream_type == .capture)
+                            c_alsa.snd_pcm_readn(pcm_handle, bufs, remaining)
+                        else
+                            c_alsa.snd_pcm_writen(pcm_handle, bufs, remaining);
+                    },
+                    else => blk: {
+                        const ptr = self.device.transfer_buffer[done * frame_bytes ..].ptr;
+
+                        break :blk if (self.device.stream_type == .capture)
+                            c_alsa.snd_pcm_readi(pcm_handle, ptr, remaining)
+                        else
+                            c_alsa.snd_pcm_writei(pcm_handle, ptr, remaining);
+                    },
+                };
+
+                if (res == -c_alsa.EAGAIN) continue;
+
+                if (res < 0) {
+                    try self.xrunRecovery(@intCast(res));
+                    if (self.device.stream_type == .capture) try self.startIfPrepared();
+                    continue;
+                }
+
+                if (res == 0) zero_transfers += 1 else zero_transfers = 0;
+
+                if (res < remaining) {
+                    self.device.health.shortTransfer();
+                }
+
+                if (zero_transfers >= MAX_ZERO_TRANSFERS) {
+                    log.err("Too many consecutive zero transfers. Stopping device.", .{});
+                    return AudioLoopError.xrun;
+                }
+
+                done += @intCast(res);
+            }
+        }
+
+        fn checkState(self: *Self) AudioLoopError!void {
+            const state: c_uint = c_alsa.snd_pcm_state(self.device.pcm_handle);
+
+            switch (state) {
+                c_alsa.SND_PCM_STATE_XRUN => try self.xrunRecovery(-c_alsa.EPIPE),
+                c_alsa.SND_PCM_STATE_SUSPENDED => try self.xrunRecovery(-c_alsa.ESTRPIPE),
+                else => {},
+            }
+        }
+
+        fn startIfPrepared(self: *Self) AudioLoopError!void {
+            if (c_alsa.snd_pcm_state(self.device.pcm_handle) != c_alsa.SND_PCM_STATE_PREPARED) return;
+
+            const err = c_alsa.snd_pcm_start(self.device.pcm_handle);
+
+            if (err < 0) {
+                log.err("Failed to start pcm: {s}", .{c_alsa.snd_strerror(err)});
+                return AudioLoopError.start;
+            }
+        }
+
+        // the callback view of the areas returned by snd_pcm_mmap_begin
+        fn mmapAudioData(self: *Self, areas: *c_alsa.snd_pcm_channel_area_t, offset: c_ulong, frames: c_ulong) AudioLoopError!AudioData {
+            const addr = areas.addr orelse return AudioLoopError.unexpected;
+            const verifier = AlignmentVerifier(ContextType, comptime_opts){};
+
+            const step: usize = @divFloor(areas.step, 8);
+            const buf_start: usize = @divFloor(areas.first, 8) + @as(usize, offset) * step;
+
+            if (self.device.access_type == .mmap_noninterleaved) {
+                // one area per channel, a whole number of bytes apart
+                const channel_stride = try verifier.verifyNonInterleaved(self.device, areas);
+                const len = (self.device.channels - 1) * channel_stride + @as(usize, frames) * step;
+
+                return AudioData.initNonInterleaved(
+                    @as([*]u8, @ptrCast(addr))[buf_start .. buf_start + len],
+                    self.device.channels,
+                    self.device.sample_rate,
+                    self.device.audio_format,
+                    channel_stride,
+                );
+            }
+
+            try verifier.verifyAlignment(self.device, areas);
+
+            return AudioData.init(
+                @as([*]u8, @ptrCast(addr))[buf_start .. buf_start + @as(usize, frames) * step],
+                self.device.channels,
+                self.device.sample_rate,
+                self.device.audio_format,
+            );
+        }
 
         fn mmapTransfer(self: *Self) !void {
             const buffer_size: c_ulong = @intFromEnum(self.device.buffer_size);
-            var maybe_areas: ?*c_alsa.snd_pcm_channel_area_t = null;
             var stopped: bool = true;
-            var zero_transfers: usize = 0;
 
             if (Device.PROBE_ENABLED) {
                 if (self.device.probe) |*p| p.start();
@@ -883,67 +1355,107 @@ fn HalfDuplexAudioLoop(ContextType: type, comptime comptime_opts: DeviceComptime
                     }
                 }
 
-                // in frames
-                var to_transfer = buffer_size;
-                var offset: c_ulong = 0;
+                self.markWake();
 
-                while (to_transfer > 0) {
-                    // we request for a transfer_size frames from begin but it may return less
-                    var expected_to_transfer = to_transfer;
-                    const res = c_alsa.snd_pcm_mmap_begin(self.device.pcm_handle, &maybe_areas, &offset, &expected_to_transfer);
+                if (!try self.mmapFrames(buffer_size)) stopped = true;
+            }
+        }
 
-                    if (res < 0) {
-                        try self.xrunRecovery(res);
-                        stopped = true;
-                    }
+        // maps, fills and commits `frames` frames, in several chunks when the mapping wraps around the ring buffer.
+        // Returns false when an xrun had to be recovered, the stream then needs to be started again.
+        fn mmapFrames(self: *Self, frames: c_ulong) AudioLoopError!bool {
+            var maybe_areas: ?*c_alsa.snd_pcm_channel_area_t = null;
+            var to_transfer = frames;
+            var offset: c_ulong = 0;
 
-                    const areas = maybe_areas orelse return AudioLoopError.unexpected;
-                    const addr = areas.addr orelse return AudioLoopError.unexpected;
+            while (to_transfer > 0) {
+                // we request for a transfer_size frames from begin but it may return less
+                var expected_to_transfer = to_transfer;
+                const res = c_alsa.snd_pcm_mmap_begin(self.device.pcm_handle, &maybe_areas, &offset, &expected_to_transfer);
 
-                    const verifier = AlignmentVerifier(ContextType, comptime_opts){};
-                    try verifier.verifyAlignment(self.device, areas);
+                if (res < 0) {
+                    try self.xrunRecovery(res);
+                    return false;
+                }
 
-                    const step: c_ulong = @divFloor(areas.step, 8);
-                    const buf_start: c_ulong = (@divFloor(areas.first, 8)) + (offset * step);
+                const areas = maybe_areas orelse return AudioLoopError.unexpected;
+                var audio_data = try self.mmapAudioData(areas, offset, expected_to_transfer);
 
-                    const buffer: []u8 = @as([*]u8, @ptrCast(addr))[buf_start .. buf_start + expected_to_transfer * step];
+                self.invokeCallback(&audio_data);
 
-                    var audio_data =
-                        GenericAudioData(format_type)
-                        .init(
-                        buffer,
-                        self.device.channels,
-                        self.device.sample_rate,
-                        self.device.audio_format,
-                    );
+                const frames_actually_transfered = c_alsa.snd_pcm_mmap_commit(self.device.pcm_handle, offset, expected_to_transfer);
 
-                    self.callback(self.ctx, &audio_data);
+                if (frames_actually_transfered < 0) {
+                    try self.xrunRecovery(@intCast(frames_actually_transfered));
+                    return false;
+                } else if (frames_actually_transfered != expected_to_transfer) {
+                    self.device.health.shortTransfer();
+                    try self.xrunRecovery(-c_alsa.EPIPE);
+                }
 
-                    const frames_actually_transfered = c_alsa.snd_pcm_mmap_commit(self.device.pcm_handle, offset, expected_to_transfer);
+                if (frames_actually_transfered == 0) self.zero_transfers += 1 else self.zero_transfers = 0;
 
-                    if (frames_actually_transfered < 0) {
-                        try self.xrunRecovery(@intCast(frames_actually_transfered));
-                    } else if (frames_actually_transfered != expected_to_transfer) try self.xrunRecovery(-c_alsa.EPIPE);
+                if (self.zero_transfers >= MAX_ZERO_TRANSFERS) {
+                    log.err("Too many consecutive zero transfers. Stopping device.", .{});
+                    return AudioLoopError.xrun;
+                }
 
-                    if (frames_actually_transfered == 0) zero_transfers += 1 else zero_transfers = 0;
+                // comptime conditional evaluation
+                if (Device.PROBE_ENABLED) {
+                    if (self.device.probe) |*p| p.addFrames(@intCast(frames_actually_transfered));
+                }
 
-                    if (zero_transfers >= MAX_ZERO_TRANSFERS) {
-                        log.err("Too many consecutive zero transfers. Stopping device.", .{});
-                        stopped = true;
-                        return AudioLoopError.xrun;
-                    }
+                to_transfer -= @as(c_ulong, @intCast(frames_actually_transfered));
+            }
 
-                    // comptime conditional evaluation
-                    if (Device.PROBE_ENABLED) {
-                        if (self.device.probe) |*p| p.addFrames(@intCast(frames_actually_transfered));
-                    }
+            return true;
+        }
 
-                    to_transfer -= @as(c_ulong, @intCast(frames_actually_transfered));
-                }
+        /// One non blocking pass, used by `PollLoop` once the stream descriptors are ready.
+        /// Recovers xruns, transfers every whole period available and starts a prepared stream.
+        /// Returns the frames transferred.
+        pub fn service(self: *Self) AudioLoopError!usize {
+            const period: usize = @intFromEnum(self.device.buffer_size);
+
+            try self.checkState();
+
+            const avail = c_alsa.snd_pcm_avail_update(self.device.pcm_handle);
+
+            if (avail < 0) {
+                try self.xrunRecovery(@intCast(avail));
+                return 0;
             }
+
+            const periods = @as(usize, @intCast(avail)) / period;
+            var transferred: usize = 0;
+
+            if (periods > 0) self.markWake();
+
+            for (0..periods) |_| {
+                if (!try self.transferBlock(period)) break;
+
+                transferred += period;
+            }
+
+            // playback starts once its buffer is filled above, capture right away since it never becomes ready on its own
+            try self.startIfPrepared();
+
+            return transferred;
         }
 
+        // counts the event and its outcome in the device health, see `recover`
         fn xrunRecovery(self: *Self, c_err: c_int) AudioLoopError!void {
+            countEvent(self.device.health, c_err);
+
+            self.recover(c_err) catch |err| {
+                self.device.health.recovered(false);
+                return err;
+            };
+
+            self.device.health.recovered(true);
+        }
+
+        fn recover(self: *Self, c_err: c_int) AudioLoopError!void {
             const err = if (c_err == -c_alsa.EPIPE) AudioLoopError.xrun else AudioLoopError.suspended;
 
             std.debug.print("Xrun recovery: {s}\n", .{c_alsa.snd_strerror(c_err)});
@@ -1005,6 +1517,9 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
 
         const Device = FullDuplexDevice(ContextType, comptime_opts);
         const HalfDevice = HalfDuplexDevice(ContextType, comptime_opts);
+        const AudioData = GenericAudioData(format_type);
+        const Float = AudioData.FloatType();
+        pub const Resampler = resampler.Resampler(Float);
 
         const AvailStatus = enum {
             skip,
@@ -1044,6 +1559,11 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
         total_frames: i64 = 0,
 
         pub fn init(device: Device, ctx: *ContextType, callback: AudioCallback()) Self {
+            if (device.telemetry) |t| {
+                t.setPeriod(@intFromEnum(device.playback_device.buffer_size), device.playback_device.sample_rate);
+                t.setLatency(device.roundTripLatencyFrames(), device.playback_device.sample_rate);
+            }
+
             return .{
                 .device = device,
                 .ctx = ctx,
@@ -1051,6 +1571,21 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
             };
         }
 
+        // the callback, timed when the device has telemetry
+        inline fn invokeCallback(self: *Self, in: *GenericAudioData(format_type), out: *GenericAudioData(format_type)) void {
+            const t = self.device.telemetry orelse return self.callback(self.ctx, in, out);
+
+            t.callbackStart();
+            self.callback(self.ctx, in, out);
+            t.callbackEnd();
+        }
+
+        // a new cycle for the telemetry, timed on the playback device
+        inline fn markWake(self: *Self) void {
+            const t = self.device.telemetry orelse return;
+            t.wake(wakeTimestamp(self.device.playback_device.pcm_handle, t.period_ns));
+        }
+
         pub fn start(self: *Self) !void {
             self.running = true;
 
@@ -1059,6 +1594,21 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
                 return AudioLoopError.buffer_size;
             }
 
+            if (self.device.playback_device.access_type != self.device.capture_device.access_type) {
+                log.err("Capture and playback negotiated different access types: {s} and {s}", .{
+                    @tagName(self.device.capture_device.access_type),
+                    @tagName(self.device.playback_device.access_type),
+                });
+                return AudioLoopError.unsupported;
+            }
+
+            if (self.device.drift_options) |opts| {
+                switch (self.device.capture_device.access_type) {
+                    AccessType.mmap_interleaved, AccessType.rw_interleaved => return self.driftTransfer(opts),
+                    else => {},
+                }
+            }
+
             switch (self.device.capture_device.access_type) {
                 AccessType.mmap_interleaved => {
                     if (self.device.is_linked) try self.mmapTransferLinked() else try self.mmapTransfer();
@@ -1091,6 +1641,8 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
 
                 if (status == .skip) continue;
 
+                self.markWake();
+
                 var to_transfer: c_ulong = buffer_size;
                 var playback_offset: c_ulong = 0;
                 var capture_offset: c_ulong = 0;
@@ -1120,7 +1672,7 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
                         self.device.playback_device.audio_format,
                     );
 
-                    self.callback(self.ctx, &capture_data, &playback_data);
+                    self.invokeCallback(&capture_data, &playback_data);
 
                     const playback_transferred = try self.commit(playback_offset, playback_expected_transfer, .playback);
                     const capture_transferred = try self.commit(capture_offset, capture_expected_transfer, .capture);
@@ -1155,6 +1707,8 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
                 const status = try self.checkLinkedAvailability(buffer_size);
                 if (status == .skip) continue;
 
+                self.markWake();
+
                 // in frames
                 var to_transfer = buffer_size;
                 var playback_offset: c_ulong = 0;
@@ -1185,7 +1739,7 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
                         self.device.playback_device.audio_format,
                     );
 
-                    self.callback(self.ctx, &capture_data, &playback_data);
+                    self.invokeCallback(&capture_data, &playback_data);
                     const playback_frames_transferred = try self.commit(playback_offset, playback_expected_transfer, .playback);
 
                     // we don't care about the capture frames transferred for snd_pcm_link devices
@@ -1216,6 +1770,8 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
 
                 if (status == .skip) continue;
 
+                self.markWake();
+
                 var to_transfer = buffer_size;
 
                 while (to_transfer > 0) {
@@ -1235,7 +1791,7 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
                         self.device.playback_device.audio_format,
                     );
 
-                    self.callback(self.ctx, &capture_data, &playback_data);
+                    self.invokeCallback(&capture_data, &playback_data);
 
                     const frames_written = try self.write(to_transfer);
 
@@ -1262,6 +1818,175 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
             }
         }
 
+        // unlinked devices, every block of capture is resampled to follow the playback clock, see `DriftOptions`
+        fn driftTransfer(self: *Self, opts: DriftOptions) !void {
+            const capture = self.device.capture_device;
+            const allocator = self.device.allocator;
+
+            const block: usize = @intFromEnum(self.device.playback_device.buffer_size);
+            const channels: usize = capture.channels;
+            const frame_bytes = AudioData.sample_bytes * channels;
+
+            var rs = try Resampler.init(allocator, .{ .channels = channels, .max_block_frames = block });
+            defer rs.deinit();
+
+            // the most input a block can take, at the lowest ratio
+            const raw = try allocator.alloc(u8, rs.capacity * frame_bytes);
+            defer allocator.free(raw);
+
+            const input = try allocator.alloc(Float, rs.capacity * channels);
+            defer allocator.free(input);
+
+            const output = try allocator.alloc(Float, block * channels);
+            defer allocator.free(output);
+
+            var controller = drift.DriftController.init(opts, capture.sample_rate);
+            var ratio: f64 = 1;
+
+            if (capture.access_type == .mmap_interleaved) try self.silencePlayback();
+
+            if (Device.PROBE_ENABLED) {
+                if (self.device.playback_device.probe) |*p| p.start();
+            }
+
+            while (self.running) {
+                try self.checkState(.playback);
+                try self.checkState(.capture);
+
+                const status = try self.checkUnlinkedAvailability(@intCast(block));
+                if (status == .skip) continue;
+
+                self.markWake();
+
+                const needed = rs.inputFramesFor(block, ratio);
+
+                if (!(try self.captureFrames(raw[0 .. needed * frame_bytes], needed))) {
+                    controller.reset();
+                    continue;
+                }
+
+                var captured = AudioData.init(raw[0 .. needed * frame_bytes], capture.channels, capture.sample_rate, capture.audio_format);
+                const samples = try captured.readAll(input[0 .. needed * channels]);
+
+                // exactly one block, `needed` was computed for it
+                const result = rs.process(samples, output, ratio);
+
+                var staged = AudioData.init(capture.transfer_buffer, capture.channels, capture.sample_rate, capture.audio_format);
+                try staged.write(output[0 .. result.produced * channels]);
+
+                if (!(try self.playResampled(block))) {
+                    controller.reset();
+                    continue;
+                }
+
+                const level = self.framesInFlight() orelse {
+                    controller.reset();
+                    continue;
+                };
+
+                ratio = controller.update(level + rs.bufferedFrames(), block);
+            }
+        }
+
+        // blocks until `frames` are captured into `buffer`, false after a recovered xrun
+        fn captureFrames(self: *Self, buffer: []u8, frames: usize) !bool {
+            const pcm_handle = self.device.capture_device.pcm_handle;
+            const frame_bytes = buffer.len / @max(frames, 1);
+            var done: usize = 0;
+
+            while (done < frames) {
+                const ptr = buffer[done * frame_bytes ..].ptr;
+                const f: c_alsa.snd_pcm_uframes_t = @intCast(frames - done);
+
+                const res = if (self.device.capture_device.access_type == .mmap_interleaved)
+                    c_alsa.snd_pcm_mmap_readi(pcm_handle, ptr, f)
+                else
+                    c_alsa.snd_pcm_readi(pcm_handle, ptr, f);
+
+                if (res < 0) {
+                    log.warn("Read error: {s}", .{c_alsa.snd_strerror(@intCast(res))});
+                    try self.xrunRecovery(@intCast(res), .capture);
+                    self.capture_stopped = true;
+                    return false;
+                }
+
+                if (res == 0) {
+                    self.zero_transfers.increment(.capture);
+                    if (self.zero_transfers.reachedMax()) return AudioLoopError.xrun;
+                } else self.zero_transfers.zero(.capture);
+
+                done += @intCast(res);
+            }
+
+            return true;
+        }
+
+        // runs the callback on the resampled capture block staged in the capture transfer buffer
+        fn playResampled(self: *Self, frames: usize) !bool {
+            const capture = self.device.capture_device;
+            const playback = self.device.playback_device;
+            const capture_frame_bytes = AudioData.sample_bytes * capture.channels;
+
+            if (playback.access_type == .rw_interleaved) {
+                var capture_data = AudioData.init(capture.transfer_buffer, capture.channels, capture.sample_rate, capture.audio_format);
+                var playback_data = AudioData.init(playback.transfer_buffer, playback.channels, playback.sample_rate, playback.audio_format);
+
+                self.invokeCallback(&capture_data, &playback_data);
+
+                const written = try self.write(@intCast(frames));
+                if (written <= 0) return false;
+
+                if (Device.PROBE_ENABLED) {
+                    if (self.device.playback_device.probe) |*p| p.addFrames(written);
+                }
+
+                return true;
+            }
+
+            var done: usize = 0;
+
+            while (done < frames) {
+                var offset: c_ulong = 0;
+                var expected: c_ulong = @intCast(frames - done);
+
+                const playback_buffer = try self.begin(&offset, &expected, .playback);
+                const n: usize = @intCast(expected);
+
+                var capture_data = AudioData.init(
+                    capture.transfer_buffer[done * capture_frame_bytes ..][0 .. n * capture_frame_bytes],
+                    capture.channels,
+                    capture.sample_rate,
+                    capture.audio_format,
+                );
+                var playback_data = AudioData.init(playback_buffer, playback.channels, playback.sample_rate, playback.audio_format);
+
+                self.invokeCallback(&capture_data, &playback_data);
+
+                const written = try self.commit(offset, expected, .playback);
+                if (written <= 0) return false;
+
+                if (Device.PROBE_ENABLED) {
+                    if (self.device.playback_device.probe) |*p| p.addFrames(written);
+                }
+
+                done += @intCast(written);
+            }
+
+            return true;
+        }
+
+        // captured and not yet read plus written and not yet played, null when either stream is in error
+        fn framesInFlight(self: *Self) ?f64 {
+            const capture_avail = c_alsa.snd_pcm_avail_update(self.device.capture_device.pcm_handle);
+            const playback_avail = c_alsa.snd_pcm_avail_update(self.device.playback_device.pcm_handle);
+
+            // the xrun itself is recovered by `checkState` on the next cycle
+            if (capture_avail < 0 or playback_avail < 0) return null;
+
+            const queued = @as(i64, self.device.playback_device.hardware_buffer_size) - @as(i64, playback_avail);
+            return @floatFromInt(@as(i64, capture_avail) + @max(queued, 0));
+        }
+
         fn read(self: *Self, frames: c_ulong) !c_long {
             const pcm_handle = self.device.capture_device.pcm_handle;
             const buffer = self.device.capture_device.transfer_buffer;
@@ -1505,7 +2230,10 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
 
             if (frames_actually_transfered < 0) {
                 try self.xrunRecovery(@intCast(frames_actually_transfered), .playback);
-            } else if (frames_actually_transfered != expected_to_transfer) try self.xrunRecovery(-c_alsa.EPIPE, .playback);
+            } else if (frames_actually_transfered != expected_to_transfer) {
+                self.streamHealth(stream_type).shortTransfer();
+                try self.xrunRecovery(-c_alsa.EPIPE, .playback);
+            }
 
             if (frames_actually_transfered == 0) {
                 const state = c_alsa.snd_pcm_state(pcm_handle);
@@ -1530,7 +2258,24 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
             return frames_actually_transfered;
         }
 
-        inline fn xrunRecovery(self: Self, c_err: c_int, stream_type: StreamType) AudioLoopError!void {
+        // counts the event and its outcome in the health of the stream, see `recover`
+        fn xrunRecovery(self: Self, c_err: c_int, stream_type: StreamType) AudioLoopError!void {
+            const health = self.streamHealth(stream_type);
+            countEvent(health, c_err);
+
+            self.recover(c_err, stream_type) catch |err| {
+                health.recovered(false);
+                return err;
+            };
+
+            health.recovered(true);
+        }
+
+        fn streamHealth(self: Self, stream_type: StreamType) *telemetry.HealthCounters {
+            return if (stream_type == .capture) self.device.capture_device.health else self.device.playback_device.health;
+        }
+
+        inline fn recover(self: Self, c_err: c_int, stream_type: StreamType) AudioLoopError!void {
             const err = if (c_err == -c_alsa.EPIPE) AudioLoopError.xrun else AudioLoopError.suspended;
 
             const pcm_handle = if (stream_type == .capture) self.device.capture_device.pcm_handle else self.device.playback_device.pcm_handle;
@@ -1585,6 +2330,172 @@ fn FullDuplexAudioLoop(ContextType: type, comptime_opts: DeviceComptimeOptions)
     };
 }
 
+// xrun (EPIPE) or suspend (ESTRPIPE) about to be recovered
+fn countEvent(health: *telemetry.HealthCounters, c_err: c_int) void {
+    if (c_err == -c_alsa.EPIPE) health.xrun() else if (c_err == -c_alsa.ESTRPIPE) health.suspended();
+}
+
+// last hardware pointer update in `telemetry.monotonicNs` time, the monotonic timestamp type is set in `prepare`.
+// Null when the driver gives no timestamp.
+fn hardwareTimestamp(pcm_handle: ?*c_alsa.snd_pcm_t, avail: *c_alsa.snd_pcm_uframes_t) ?u64 {
+    var tstamp: c_alsa.snd_htimestamp_t = undefined;
+
+    if (c_alsa.snd_pcm_htimestamp(pcm_handle, avail, &tstamp) != 0) return null;
+    if (tstamp.tv_sec == 0 and tstamp.tv_nsec == 0) return null;
+
+    return @as(u64, @intCast(tstamp.tv_sec)) * std.time.ns_per_s + @as(u64, @intCast(tstamp.tv_nsec));
+}
+
+// when the cycle started: the hardware pointer update (the interrupt that woke the loop up) when it is recent,
+// otherwise now. Includes the scheduling delay in `LoopTelemetry.wakeup_delay`.
+fn wakeTimestamp(pcm_handle: ?*c_alsa.snd_pcm_t, period_ns: u64) u64 {
+    const now = telemetry.monotonicNs();
+    var avail: c_alsa.snd_pcm_uframes_t = 0;
+
+    const at = hardwareTimestamp(pcm_handle, &avail) orelse return now;
+    if (at > now or now - at > period_ns) return now;
+
+    return at;
+}
+
+pub const PollLoopOptions = struct {
+    /// Milliseconds without any ready stream before every stream is serviced anyway, e.g. to recover a stalled device.
+    /// Negative waits forever.
+    timeout: i32 = -1,
+    /// Applied to the thread calling `run`, see `HalfDuplexDeviceOptions.realtime`.
+    realtime: ?RealtimeOptions = null,
+};
+
+/// Drives several half duplex devices, on any card and in any direction, from a single thread.
+/// The poll descriptors of every PCM are gathered into one `poll` set and only the streams that are ready get serviced,
+/// instead of one blocking loop (and one thread) per device:
+///
+///     var poll_loop = PollLoop(Ctx, .{ .format = .float_32bits_little_endian }).init(allocator, .{});
+///     defer poll_loop.deinit();
+///     try poll_loop.add(capture, &ctx, onCapture);
+///     try poll_loop.add(playback, &ctx, onPlayback);
+///     try poll_loop.run();
+///
+/// Every device needs its `buffer_size` as avail min (the default), so a descriptor wakes up once per period.
+pub fn PollLoop(ContextType: type, comptime comptime_opts: DeviceComptimeOptions) type {
+    return struct {
+        const Self = @This();
+
+        const Device = HalfDuplexDevice(ContextType, comptime_opts);
+        const AudioLoop = HalfDuplexAudioLoop(ContextType, comptime_opts);
+
+        const Stream = struct {
+            loop: AudioLoop,
+            // range of the stream descriptors in `fds`
+            first_fd: usize,
+            n_fds: usize,
+        };
+
+        streams: std.ArrayList(Stream),
+        fds: std.ArrayList(std.posix.pollfd),
+        running: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+        opts: PollLoopOptions,
+
+        pub fn init(allocator: std.mem.Allocator, opts: PollLoopOptions) Self {
+            return .{
+                .streams = std.ArrayList(Stream).init(allocator),
+                .fds = std.ArrayList(std.posix.pollfd).init(allocator),
+                .opts = opts,
+            };
+        }
+
+        /// Adds a prepared device. Not allowed while `run` is running.
+        pub fn add(self: *Self, device: Device, ctx: *ContextType, callback: Device.AudioCallback) AudioLoopError!void {
+            std.debug.assert(!self.running.load(.acquire));
+
+            const count = c_alsa.snd_pcm_poll_descriptors_count(device.pcm_handle);
+
+            if (count <= 0) {
+                log.err("Failed to get the poll descriptors count: {s}", .{c_alsa.snd_strerror(count)});
+                return AudioLoopError.unexpected;
+            }
+
+            const first_fd = self.fds.items.len;
+            const new_fds = self.fds.addManyAsSlice(@intCast(count)) catch return AudioLoopError.poll_alloc;
+            errdefer self.fds.shrinkRetainingCapacity(first_fd);
+
+            const filled = c_alsa.snd_pcm_poll_descriptors(device.pcm_handle, @ptrCast(new_fds.ptr), @intCast(count));
+
+            if (filled < 0) {
+                log.err("Failed to get the poll descriptors: {s}", .{c_alsa.snd_strerror(filled)});
+                return AudioLoopError.unexpected;
+            }
+
+            self.fds.shrinkRetainingCapacity(first_fd + @as(usize, @intCast(filled)));
+
+            self.streams.append(.{
+                .loop = AudioLoop.init(device, ctx, callback),
+                .first_fd = first_fd,
+                .n_fds = @intCast(filled),
+            }) catch return AudioLoopError.poll_alloc;
+        }
+
+        /// Services the streams on the calling thread until `stop` or an unrecoverable stream error.
+        pub fn run(self: *Self) AudioLoopError!void {
+            const applied = if (self.opts.realtime) |opts| blk: {
+                for (self.streams.items) |stream| realtime.prefault(stream.loop.device.transfer_buffer);
+                break :blk realtime.apply(opts);
+            } else null;
+            defer if (applied) |a| a.restore();
+
+            self.running.store(true, .release);
+
+            if (Device.PROBE_ENABLED) {
+                for (self.streams.items) |*stream| {
+                    if (stream.loop.device.probe) |*p| p.start();
+                }
+            }
+
+            // fills the playback buffers and starts every stream, a prepared stream never becomes ready by itself
+            for (self.streams.items) |*stream| _ = try stream.loop.service();
+
+            while (self.running.load(.acquire)) {
+                const ready = std.posix.poll(self.fds.items, self.opts.timeout) catch |err| {
+                    log.err("Poll failed: {s}", .{@errorName(err)});
+                    return AudioLoopError.unexpected;
+                };
+
+                for (self.streams.items) |*stream| {
+                    if (ready > 0 and !try self.isReady(stream.*)) continue;
+
+                    _ = try stream.loop.service();
+                }
+            }
+        }
+
+        /// Makes `run` return after the current wakeup. Safe from any thread.
+        pub fn stop(self: *Self) void {
+            self.running.store(false, .release);
+        }
+
+        // demangles the revents of the stream descriptors, plugins like dmix may poll on unrelated fds
+        fn isReady(self: *Self, stream: Stream) AudioLoopError!bool {
+            const fds = self.fds.items[stream.first_fd..][0..stream.n_fds];
+            var revents: c_ushort = 0;
+
+            const err = c_alsa.snd_pcm_poll_descriptors_revents(stream.loop.device.pcm_handle, @ptrCast(fds.ptr), @intCast(fds.len), &revents);
+
+            if (err < 0) {
+                log.err("Failed to get the poll events: {s}", .{c_alsa.snd_strerror(err)});
+                return AudioLoopError.unexpected;
+            }
+
+            // POLLERR on xrun or suspend, service recovers the stream
+            return revents != 0;
+        }
+
+        pub fn deinit(self: *Self) void {
+            self.streams.deinit();
+            self.fds.deinit();
+        }
+    };
+}
+
 fn AlignmentVerifier(ContextType: type, comptime comptime_opts: DeviceComptimeOptions) type {
     return struct {
         pub inline fn verifyAlignment(_: @This(), device: HalfDuplexDevice(ContextType, comptime_opts), area: *c_alsa.snd_pcm_channel_area_t) !void {
@@ -1593,7 +2504,8 @@ fn AlignmentVerifier(ContextType: type, comptime comptime_opts: DeviceComptimeOp
                 return AudioLoopError.audio_buffer_nonalignment;
             }
 
-            const bit_depth: c_uint = @intCast(device.audio_format.bit_depth);
+            // the container width, 32 bits for S24_LE
+            const bit_depth: c_uint = @intCast(device.audio_format.physical_width);
 
             if (area.step % bit_depth != 0) {
                 log.err("Area.step is non-aligned with audio_format.bit_depth. area.step == {d} bits && audio_format.bit_depth == {d} bits", .{ area.step, bit_depth });
@@ -1612,5 +2524,68 @@ fn AlignmentVerifier(ContextType: type, comptime comptime_opts: DeviceComptimeOp
                 return AudioLoopError.audio_buffer_nonalignment;
             }
         }
+
+        /// Checks the areas of a non interleaved device, one per channel, and returns the byte distance
+        /// between two consecutive channels. Channels must be evenly spaced to map onto one channel view.
+        pub inline fn verifyNonInterleaved(_: @This(), device: HalfDuplexDevice(ContextType, comptime_opts), area: *c_alsa.snd_pcm_channel_area_t) !usize {
+            const areas: [*]const c_alsa.snd_pcm_channel_area_t = @ptrCast(area);
+            const physical_width: c_uint = @intCast(device.audio_format.physical_width);
+
+            var channel_stride: usize = 0;
+
+            const first_addr = areas[0].addr orelse return AudioLoopError.unexpected;
+            const first_start = @intFromPtr(first_addr) + areas[0].first / 8;
+
+            for (0..device.channels) |ch| {
+                const channel_area = areas[ch];
+                const addr = channel_area.addr orelse return AudioLoopError.unexpected;
+
+                if (channel_area.first % BYTE_ALIGN != 0) {
+                    log.err("Area.first of channel {d} not byte(8) aligned. area.first == {d}", .{ ch, channel_area.first });
+                    return AudioLoopError.audio_buffer_nonalignment;
+                }
+
+                if (channel_area.step != physical_width) {
+                    log.err("Area.step of channel {d} is not the sample width. area.step == {d} bits && audio_format.physical_width == {d} bits", .{ ch, channel_area.step, physical_width });
+                    return AudioLoopError.audio_buffer_nonalignment;
+                }
+
+                const start = @intFromPtr(addr) + channel_area.first / 8;
+
+                if (ch == 1) {
+                    if (start <= first_start) {
+                        log.err("Non interleaved channels are not in ascending order", .{});
+                        return AudioLoopError.audio_buffer_nonalignment;
+                    }
+
+                    channel_stride = start - first_start;
+                }
+
+                if (start != first_start + ch * channel_stride) {
+                    log.err("Non interleaved channel {d} is not evenly spaced from the previous ones", .{ch});
+                    return AudioLoopError.audio_buffer_nonalignment;
+                }
+            }
+
+            return channel_stride;
+        }
     };
 }
+
+test "accessOrder tries the preferred access type, then mmap before rw and interleaved first" {
+    try std.testing.expectEqualSlices(
+        AccessType,
+        &.{ .mmap_interleaved, .mmap_noninterleaved, .rw_interleaved, .rw_noninterleaved },
+        accessOrder(.mmap_interleaved, false).constSlice(),
+    );
+    try std.testing.expectEqualSlices(
+        AccessType,
+        &.{ .rw_noninterleaved, .mmap_interleaved, .mmap_noninterleaved, .rw_interleaved },
+        accessOrder(.rw_noninterleaved, false).constSlice(),
+    );
+
+    // what full duplex devices negotiate, FullDuplexAudioLoop has no non interleaved transfers
+    try std.testing.expectEqualSlices(AccessType, &.{ .mmap_interleaved, .rw_interleaved }, accessOrder(.mmap_interleaved, true).constSlice());
+    try std.testing.expectEqualSlices(AccessType, &.{ .rw_interleaved, .mmap_interleaved }, accessOrder(.rw_interleaved, true).constSlice());
+    try std.testing.expectEqualSlices(AccessType, &.{ .mmap_interleaved, .rw_interleaved }, accessOrder(.mmap_noninterleaved, true).constSlice());
+}
@@ -2,6 +2,7 @@ const std = @import("std");
 const alsa = @import("../alsa.zig");
 const wave = @import("../../../dsp/waves.zig");
 const latency = @import("../latency.zig");
+const audio_ring = @import("../../../common/audio_ring.zig");
 
 const log = std.log.scoped(.alsa);
 
@@ -15,6 +16,10 @@ const HalfDuplexCaptureDevice = alsa.driver.HalfDuplexDevice(HalfDuplexCaptureCo
     .format = .signed_16bits_little_endian,
 });
 
+const HalfDuplexRingCaptureDevice = alsa.driver.HalfDuplexDevice(HalfDuplexRingCaptureContext, .{
+    .format = .signed_16bits_little_endian,
+});
+
 //enabling latency probing at comptime
 // you mut provide a callback (see below) other will call a noop callback
 const FullDuplexDeviceWithProbe = alsa.driver.FullDuplexDevice(FullDuplexContext, .{
@@ -58,6 +63,52 @@ const HalfDuplexCaptureContext = struct {
     }
 };
 
+// hands the captured samples to a worker thread, the callback never blocks or allocates
+const HalfDuplexRingCaptureContext = struct {
+    const Self = @This();
+    const T = HalfDuplexRingCaptureDevice.FloatType();
+
+    ring: *audio_ring.AudioRing(T),
+    dropped_frames: usize = 0,
+
+    pub fn callback(self: *Self, data: HalfDuplexRingCaptureDevice.AudioDataType()) void {
+        const n_frames = data.bufferSizeInFrames();
+        const regions = self.ring.writeRegions(n_frames);
+
+        // the worker fell behind, frames that do not fit are dropped
+        self.dropped_frames += n_frames - regions.frames;
+
+        for (regions.first) |*sample| sample.* = data.readSample() orelse 0;
+        for (regions.second) |*sample| sample.* = data.readSample() orelse 0;
+
+        self.ring.commitWrite(regions.frames);
+    }
+
+    // runs on the worker thread, logs the level of each second of audio
+    fn worker(ring: *audio_ring.AudioRing(T), sample_rate: usize, running: *std.atomic.Value(bool)) void {
+        var sum: f64 = 0;
+        var frames: usize = 0;
+
+        while (running.load(.acquire)) {
+            if (ring.wait(1, 100 * std.time.ns_per_ms) == 0) continue;
+
+            const regions = ring.readRegions(ring.readAvailable());
+
+            for (regions.first) |sample| sum += sample * sample;
+            for (regions.second) |sample| sum += sample * sample;
+
+            frames += regions.frames;
+            ring.commitRead(regions.frames);
+
+            if (frames >= sample_rate) {
+                log.info("capture rms: {d:.4}", .{@sqrt(sum / @as(f64, @floatFromInt(frames * ring.n_channels)))});
+                sum = 0;
+                frames = 0;
+            }
+        }
+    }
+};
+
 const FullDuplexContext = struct {
     const Self = @This();
 
@@ -154,6 +205,65 @@ pub fn halfDuplexCapture() void {
     };
 }
 
+pub fn halfDuplexCaptureToWorker() void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer if (gpa.deinit() != .ok) std.debug.print("Failed to deinit allocator.", .{});
+
+    const allocator = gpa.allocator();
+    const T = HalfDuplexRingCaptureContext.T;
+
+    var dev = HalfDuplexRingCaptureDevice.init(allocator, .{
+        .sample_rate = .sr_44100,
+        .channels = .stereo,
+        .stream_type = .capture,
+        .buffer_size = .buf_512,
+        .ident = "hw:3,0",
+    }) catch |err| {
+        log.err("Failed to init device: {}", .{err});
+        return;
+    };
+
+    defer dev.deinit() catch |err| {
+        log.err("Failed to deinit device: {}", .{err});
+    };
+
+    // a few periods of slack for the worker
+    var ring = audio_ring.AudioRing(T).init(allocator, .{
+        .n_channels = 2,
+        .capacity_frames = 512 * 8,
+        .notify = .futex,
+    }) catch |err| {
+        log.err("Failed to init ring buffer: {}", .{err});
+        return;
+    };
+
+    defer ring.deinit();
+
+    dev.prepare() catch |err| {
+        log.err("Failed to prepare device: {}", .{err});
+    };
+
+    var running = std.atomic.Value(bool).init(true);
+
+    const worker = std.Thread.spawn(.{}, HalfDuplexRingCaptureContext.worker, .{ &ring, 44_100, &running }) catch |err| {
+        log.err("Failed to spawn worker: {}", .{err});
+        return;
+    };
+
+    defer {
+        running.store(false, .release);
+        worker.join();
+    }
+
+    var ctx = HalfDuplexRingCaptureContext{ .ring = &ring };
+
+    dev.start(&ctx, @field(HalfDuplexRingCaptureContext, "callback")) catch |err| {
+        log.err("Failed to start device: {}", .{err});
+    };
+
+    if (ctx.dropped_frames > 0) log.warn("Dropped {d} frames", .{ctx.dropped_frames});
+}
+
 // create a callback to probe the latency of the device
 // the data argument will hold the latency information
 fn probeCallback(data: latency.LatencyData) void {
@@ -363,7 +473,8 @@ pub fn printingHardwareInfo() void {
     defer hardware.deinit();
 
     // To have an overview of the available audio cards, ports as well as their supported settings
-    // you can just print the hardware object
+    // you can just print the hardware object, once every card is probed
+    hardware.probeAll();
     std.debug.print("{s}", .{hardware});
 }
 
@@ -600,3 +711,60 @@ pub fn manuallyInitializingDevice() void {
         std.debug.print("Failed to prepare device: {}", .{err});
     };
 }
+
+// This example finds the smallest buffer configuration the device sustains with this callback and keeps it for the
+// next runs. Calibrate with the real processing graph, the headroom of the callback decides the result.
+pub fn calibratingBufferSize() void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer if (gpa.deinit() != .ok) log.err("Failed to deinit allocator.", .{});
+
+    const allocator = gpa.allocator();
+
+    const Calibrate = alsa.calibration.Calibrator(HalfDuplexPlaybackContext, .{
+        .format = .signed_16bits_little_endian,
+    });
+
+    const device_opts = alsa.driver.HalfDuplexDeviceOptions{
+        .sample_rate = .sr_44100,
+        .channels = .stereo,
+        .stream_type = .playback,
+        .ident = "hw:3,0",
+    };
+
+    var ctx = HalfDuplexPlaybackContext{ .w = wave.Wave(f32).init(100.0, 0.2, device_opts.sample_rate.toFloat(f32)) };
+
+    // calibrated once, later runs just load the persisted result
+    const maybe_result = alsa.calibration.load(allocator, null, device_opts) catch null;
+
+    const result = if (maybe_result) |r| r else Calibrate.run(allocator, device_opts, &ctx, @field(HalfDuplexPlaybackContext, "callback"), .{
+        // every candidate runs 5 seconds unless it fails earlier
+        .window_ms = 5_000,
+    }) catch |err| {
+        log.err("Failed to calibrate: {}", .{err});
+        return;
+    };
+
+    std.debug.print("Calibrated: {d} periods of {d} frames, {d:.0}% headroom\n", .{
+        result.n_periods,
+        @intFromEnum(result.buffer_size),
+        result.headroom * 100,
+    });
+
+    var device = HalfDuplexDevice.init(allocator, result.apply(device_opts)) catch |err| {
+        log.err("Failed to init device: {}", .{err});
+        return;
+    };
+
+    defer device.deinit() catch |err| {
+        log.err("Failed to deinit device: {}", .{err});
+    };
+
+    device.prepare() catch |err| {
+        log.err("Failed to prepare device: {}", .{err});
+        return;
+    };
+
+    device.start(&ctx, @field(HalfDuplexPlaybackContext, "callback")) catch |err| {
+        log.err("Failed to start device: {}", .{err});
+    };
+}
@@ -31,7 +31,7 @@ pub fn Format(comptime T: type) type {
         bit_depth: i32,
         // The number of bytes per sample: 1, 2, 3, 4 bytes. Negative if not applicable
         byte_rate: i32,
-        // This is the same as bit_depth but also includes any padding bits. Relevant for formats like S24_3LE that are not packed
+        // This is the same as bit_depth but also includes any padding bits: 32 for S24_LE, 24 for the packed S24_3LE
         // Negative if not applicable
         physical_width: i32,
         // same as byte_rate but for physical width. Negative if not applicable
@@ -57,7 +57,7 @@ pub fn Format(comptime T: type) type {
                 .bit_depth = bit_depth,
                 .byte_rate = if (bit_depth >= 0) @divFloor(bit_depth, 8) else -1,
                 .physical_byte_rate = if (physical_width >= 0) @divFloor(physical_width, 8) else -1,
-                .physical_width = bit_depth,
+                .physical_width = physical_width,
                 // TODO: this could be an array so type check
                 .sample_type = 0, // dummy value, this field is use only to get the underlying type of the format
             };
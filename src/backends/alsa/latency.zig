@@ -27,6 +27,8 @@ pub const LatencyData = struct {
     total_latency: TimestampDiff,
     average_latency: TimestampDiff,
     buffer_latency: TimestampDiff,
+    /// latency added by the processing graph, see `Probe.setProcessingLatency`
+    processing_latency: TimestampDiff,
     frames_processed: usize,
     cycles: u32,
 };
@@ -51,6 +53,8 @@ pub const Probe = struct {
     callback: ProbeCallback,
     /// The latency introduced by the hardware buffering
     buffer_latency: TimestampDiff,
+    /// The latency introduced by the processing graph
+    processing_latency: TimestampDiff = TimestampDiff.fromMicros(0),
 
     pub fn init(callback: ProbeCallback, opts: ProbeOptions) Probe {
         const buff_latency_micros = opts.hardware_buffer_size * s_to_us / opts.sample_rate;
@@ -66,6 +70,12 @@ pub const Probe = struct {
         };
     }
 
+    /// Set the latency in frames introduced by the processing graph
+    pub fn setProcessingLatency(self: *Probe, frames: u32) void {
+        const micros = @divTrunc(@as(i64, frames) * s_to_us, @as(i64, self.sample_rate));
+        self.processing_latency = TimestampDiff.fromMicros(micros);
+    }
+
     /// Start the probe
     pub fn start(self: *Probe) void {
         self.start_time = getMonotonicTime() catch {
@@ -117,6 +127,7 @@ pub const Probe = struct {
             .total_latency = latency,
             .average_latency = latency.div(@as(i64, @intCast(self.buffer_cycles))),
             .buffer_latency = self.buffer_latency,
+            .processing_latency = self.processing_latency,
             .frames_processed = self.frames_processed,
             .cycles = self.buffer_cycles,
         };
@@ -0,0 +1,73 @@
+//! ALSA configuration of `null` PCMs, and of `file` PCMs writing into /dev/null, to run the audio loops without audio
+//! hardware: `bench-alsa` and the loop tests. The streams are always ready, the loops never wait on a clock.
+
+const std = @import("std");
+
+const c_alsa = @cImport({
+    @cInclude("asoundlib.h");
+});
+
+// `file` writes every period through a `null` slave into /dev/null. Capture gets its own definitions so full duplex
+// devices are not linked: the null plugin does not link.
+pub const asoundrc =
+    \\pcm.delia_bench_null_playback {
+    \\    type null
+    \\}
+    \\pcm.delia_bench_null_capture {
+    \\    type null
+    \\}
+    \\pcm.delia_bench_file_playback {
+    \\    type file
+    \\    slave.pcm "delia_bench_null_playback"
+    \\    file "/dev/null"
+    \\    format "raw"
+    \\}
+    \\pcm.delia_bench_file_capture {
+    \\    type file
+    \\    slave.pcm "delia_bench_null_capture"
+    \\    file "/dev/null"
+    \\    format "raw"
+    \\}
+    \\
+;
+
+pub const null_playback = "delia_bench_null_playback";
+pub const null_capture = "delia_bench_null_capture";
+
+/// Writes `asoundrc` and points `ALSA_CONFIG_PATH` at it. It replaces the system configuration, nothing else is
+/// reachable and the run does not depend on the box. Returns the path of the written file.
+pub fn install(path_buffer: *[64]u8) ![:0]const u8 {
+    const path = try std.fmt.bufPrintZ(path_buffer, "/tmp/delia-bench-alsa-{d}.conf", .{std.os.linux.getpid()});
+
+    try std.fs.cwd().writeFile(.{ .sub_path = path, .data = asoundrc });
+
+    if (c_alsa.setenv("ALSA_CONFIG_PATH", path.ptr, 1) != 0) return error.Environment;
+    return path;
+}
+
+/// `install` for the duration of a test, `deinit` removes the file and restores the previous configuration.
+pub const TestConfig = struct {
+    allocator: std.mem.Allocator,
+    previous: ?[:0]u8,
+    path_buffer: [64]u8 = undefined,
+    path_len: usize = 0,
+
+    pub fn init(allocator: std.mem.Allocator) !TestConfig {
+        const previous = if (std.posix.getenv("ALSA_CONFIG_PATH")) |value| try allocator.dupeZ(u8, value) else null;
+
+        var self = TestConfig{ .allocator = allocator, .previous = previous };
+        errdefer self.deinit();
+
+        self.path_len = (try install(&self.path_buffer)).len;
+        return self;
+    }
+
+    pub fn deinit(self: *TestConfig) void {
+        if (self.path_len > 0) std.fs.cwd().deleteFile(self.path_buffer[0..self.path_len]) catch {};
+
+        if (self.previous) |value| {
+            _ = c_alsa.setenv("ALSA_CONFIG_PATH", value.ptr, 1);
+            self.allocator.free(value);
+        } else _ = c_alsa.unsetenv("ALSA_CONFIG_PATH");
+    }
+};
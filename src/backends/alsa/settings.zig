@@ -188,19 +188,19 @@ pub const FormatType = enum(c_int) {
     // 3-byte per sample formats
     // These formats use 3 bytes per sample instead of 4, making them more compact than the regular 24-bit formats
 
-    // CURRENTLY NOT SUPPORTING packed formats until we have hardware to test it
-    // 24-bit packed formats (3 bytes per sample)
-    // signed_24bits_packed3_little_endian = c_alsa.SND_PCM_FORMAT_S24_3LE,
-    // signed_24bits_packed3_big_endian = c_alsa.SND_PCM_FORMAT_S24_3BE,
-    // unsigned_24bits_packed3_little_endian = c_alsa.SND_PCM_FORMAT_U24_3LE,
-    // unsigned_24bits_packed3_big_endian = c_alsa.SND_PCM_FORMAT_U24_3BE,
-
-    // // 20-bit packed formats (3 bytes per sample)
-    // signed_20bits_packed3_little_endian = c_alsa.SND_PCM_FORMAT_S20_3LE,
-    // signed_20bits_packed3_big_endian = c_alsa.SND_PCM_FORMAT_S20_3BE,
-    // unsigned_20bits_packed3_little_endian = c_alsa.SND_PCM_FORMAT_U20_3LE,
-    // unsigned_20bits_packed3_big_endian = c_alsa.SND_PCM_FORMAT_U20_3BE,
-
+    // 24-bit packed formats (3 bytes per sample), the only 24 bits format of many USB interfaces
+    signed_24bits_packed3_little_endian = c_alsa.SND_PCM_FORMAT_S24_3LE,
+    signed_24bits_packed3_big_endian = c_alsa.SND_PCM_FORMAT_S24_3BE,
+    unsigned_24bits_packed3_little_endian = c_alsa.SND_PCM_FORMAT_U24_3LE,
+    unsigned_24bits_packed3_big_endian = c_alsa.SND_PCM_FORMAT_U24_3BE,
+
+    // 20-bit packed formats (3 bytes per sample, LSB justified)
+    signed_20bits_packed3_little_endian = c_alsa.SND_PCM_FORMAT_S20_3LE,
+    signed_20bits_packed3_big_endian = c_alsa.SND_PCM_FORMAT_S20_3BE,
+    unsigned_20bits_packed3_little_endian = c_alsa.SND_PCM_FORMAT_U20_3LE,
+    unsigned_20bits_packed3_big_endian = c_alsa.SND_PCM_FORMAT_U20_3BE,
+
+    // NOT SUPPORTED: no hardware to test it
     // // 18-bit packed formats (3 bytes per sample)
     // signed_18bits_packed3_little_endian = c_alsa.SND_PCM_FORMAT_S18_3LE,
     // signed_18bits_packed3_big_endian = c_alsa.SND_PCM_FORMAT_S18_3BE,
@@ -296,15 +296,13 @@ pub const FormatType = enum(c_int) {
             .float_32bits_little_endian, .float_32bits_big_endian => .t_f32,
             .float64_little_endian, .float64_big_endian => .t_f64,
 
+            // 3 bytes per sample, no padding byte
+            .signed_24bits_packed3_little_endian, .signed_24bits_packed3_big_endian => .t_i24,
+            .unsigned_24bits_packed3_little_endian, .unsigned_24bits_packed3_big_endian => .t_u24,
+            .signed_20bits_packed3_little_endian, .signed_20bits_packed3_big_endian => .t_i20,
+            .unsigned_20bits_packed3_little_endian, .unsigned_20bits_packed3_big_endian => .t_u20,
+
             // NOT SUPPORTED (for now)
-            //.signed_24bits_packed3_little_endian,
-            //.signed_24bits_packed3_big_endian,
-            //.unsigned_24bits_packed3_little_endian,
-            //.unsigned_24bits_packed3_big_endian,
-            //.signed_20bits_packed3_little_endian,
-            //.signed_20bits_packed3_big_endian,
-            //.unsigned_20bits_packed3_little_endian,
-            //.unsigned_20bits_packed3_big_endian,
             //.signed_18bits_packed3_little_endian,
             //.signed_18bits_packed3_big_endian,
             //.unsigned_18bits_packed3_little_endian,
@@ -345,15 +343,14 @@ pub const FormatType = enum(c_int) {
             .float_32bits_little_endian, .float_32bits_big_endian => f32,
             .float64_little_endian, .float64_big_endian => f64,
 
+            // 3 bytes per sample: @bitSizeOf is 24 while @sizeOf is 4, buffer offsets must use the bit size.
+            // The 20 bits formats are LSB justified like their 32 bits counterpart
+            .signed_24bits_packed3_little_endian, .signed_24bits_packed3_big_endian => i24,
+            .unsigned_24bits_packed3_little_endian, .unsigned_24bits_packed3_big_endian => u24,
+            .signed_20bits_packed3_little_endian, .signed_20bits_packed3_big_endian => i24,
+            .unsigned_20bits_packed3_little_endian, .unsigned_20bits_packed3_big_endian => u24,
+
             // NOT SUPPORTED (for now)
-            // .signed_24bits_packed3_little_endian,
-            // .signed_24bits_packed3_big_endian,
-            // .unsigned_24bits_packed3_little_endian,
-            // .unsigned_24bits_packed3_big_endian,
-            // .signed_20bits_packed3_little_endian,
-            // .signed_20bits_packed3_big_endian,
-            // .unsigned_20bits_packed3_little_endian,
-            // .unsigned_20bits_packed3_big_endian,
             // .signed_18bits_packed3_little_endian,
             // .signed_18bits_packed3_big_endian,
             // .unsigned_18bits_packed3_little_endian,
@@ -501,16 +498,16 @@ test "FormatType.toSampleType works correctly" {
     try expectEqual(SampleType.t_f64, FormatType.float64_big_endian.toSampleType());
 
     // 24-bit packed formats (3 bytes per sample)
-    // try expectEqual(SampleType.t_u8_3, FormatType.signed_24bits_packed3_little_endian.toSampleType());
-    // try expectEqual(SampleType.t_u8_3, FormatType.signed_24bits_packed3_big_endian.toSampleType());
-    // try expectEqual(SampleType.t_u8_3, FormatType.unsigned_24bits_packed3_little_endian.toSampleType());
-    // try expectEqual(SampleType.t_u8_3, FormatType.unsigned_24bits_packed3_big_endian.toSampleType());
+    try expectEqual(SampleType.t_i24, FormatType.signed_24bits_packed3_little_endian.toSampleType());
+    try expectEqual(SampleType.t_i24, FormatType.signed_24bits_packed3_big_endian.toSampleType());
+    try expectEqual(SampleType.t_u24, FormatType.unsigned_24bits_packed3_little_endian.toSampleType());
+    try expectEqual(SampleType.t_u24, FormatType.unsigned_24bits_packed3_big_endian.toSampleType());
 
     // 20-bit packed formats (3 bytes per sample)
-    // try expectEqual(SampleType.t_u8_3, FormatType.signed_20bits_packed3_little_endian.toSampleType());
-    // try expectEqual(SampleType.t_u8_3, FormatType.signed_20bits_packed3_big_endian.toSampleType());
-    // try expectEqual(SampleType.t_u8_3, FormatType.unsigned_20bits_packed3_little_endian.toSampleType());
-    // try expectEqual(SampleType.t_u8_3, FormatType.unsigned_20bits_packed3_big_endian.toSampleType());
+    try expectEqual(SampleType.t_i20, FormatType.signed_20bits_packed3_little_endian.toSampleType());
+    try expectEqual(SampleType.t_i20, FormatType.signed_20bits_packed3_big_endian.toSampleType());
+    try expectEqual(SampleType.t_u20, FormatType.unsigned_20bits_packed3_little_endian.toSampleType());
+    try expectEqual(SampleType.t_u20, FormatType.unsigned_20bits_packed3_big_endian.toSampleType());
 
     // 18-bit packed formats (3 bytes per sample)
     // try expectEqual(SampleType.t_u8_3, FormatType.signed_18bits_packed3_little_endian.toSampleType());
@@ -553,23 +550,23 @@ test "formats array contains correct values" {
     try expectEqual(c_alsa.SND_PCM_FORMAT_FLOAT_BE, formats[19]);
     try expectEqual(c_alsa.SND_PCM_FORMAT_FLOAT64_LE, formats[20]);
     try expectEqual(c_alsa.SND_PCM_FORMAT_FLOAT64_BE, formats[21]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_S24_3LE, formats[23]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_S24_3BE, formats[24]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_U24_3LE, formats[25]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_U24_3BE, formats[26]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_S20_3LE, formats[27]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_S20_3BE, formats[28]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_U20_3LE, formats[29]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_U20_3BE, formats[30]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_S18_3LE, formats[31]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_S18_3BE, formats[32]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_U18_3LE, formats[33]);
-    //try expectEqual(c_alsa.SND_PCM_FORMAT_U18_3BE, formats[34]);
-    try expectEqual(c_alsa.SND_PCM_FORMAT_MU_LAW, formats[22]);
-    try expectEqual(c_alsa.SND_PCM_FORMAT_A_LAW, formats[23]);
-    try expectEqual(c_alsa.SND_PCM_FORMAT_IMA_ADPCM, formats[24]);
-    try expectEqual(c_alsa.SND_PCM_FORMAT_MPEG, formats[25]);
-    try expectEqual(c_alsa.SND_PCM_FORMAT_GSM, formats[26]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_S24_3LE, formats[22]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_S24_3BE, formats[23]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_U24_3LE, formats[24]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_U24_3BE, formats[25]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_S20_3LE, formats[26]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_S20_3BE, formats[27]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_U20_3LE, formats[28]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_U20_3BE, formats[29]);
+    //try expectEqual(c_alsa.SND_PCM_FORMAT_S18_3LE, formats[30]);
+    //try expectEqual(c_alsa.SND_PCM_FORMAT_S18_3BE, formats[31]);
+    //try expectEqual(c_alsa.SND_PCM_FORMAT_U18_3LE, formats[32]);
+    //try expectEqual(c_alsa.SND_PCM_FORMAT_U18_3BE, formats[33]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_MU_LAW, formats[30]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_A_LAW, formats[31]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_IMA_ADPCM, formats[32]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_MPEG, formats[33]);
+    try expectEqual(c_alsa.SND_PCM_FORMAT_GSM, formats[34]);
     //   try expectEqual(c_alsa.SND_PCM_FORMAT_IEC958_SUBFRAME_LE, formats[40]);
 }
 
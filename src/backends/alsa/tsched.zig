@@ -0,0 +1,177 @@
+const std = @import("std");
+const telemetry = @import("../../common/telemetry.zig");
+
+const linux = std.os.linux;
+
+pub const TschedError = error{
+    timer_create,
+    timer_set,
+    timer_read,
+};
+
+/// Timer based scheduling for playback, see `HalfDuplexDeviceOptions.tsched`.
+/// The hardware buffer is filled up to `latency_frames` and the loop sleeps on a timer until only `watermark_frames`
+/// are left, instead of waking up on every period interrupt. Latency and wakeup rate no longer depend on the period size.
+pub const TschedOptions = struct {
+    /// Frames queued in the hardware buffer after each wakeup, the output latency. Capped to the hardware buffer.
+    latency_frames: u32 = 4096,
+    /// Frames left when the timer fires, the margin for wakeup jitter and the callback. Doubles on every underrun.
+    watermark_frames: u32 = 512,
+    /// Lower bound of the watermark when it shrinks back.
+    min_watermark_frames: u32 = 128,
+    /// Underrun free time before the watermark shrinks by a quarter.
+    decrease_after_ms: u32 = 10_000,
+};
+
+/// Fill level and watermark of a tsched loop, adapted to the underruns.
+pub const Levels = struct {
+    /// Fill level written up to on each wakeup.
+    target: usize,
+    /// Fill level the timer wakes up at.
+    watermark: usize,
+    min_watermark: usize,
+    // requested latency, the target never shrinks below it
+    min_target: usize,
+    // hardware buffer size
+    max_target: usize,
+    // callback block, at least two of them fit between the watermark and the target
+    block: usize,
+    decrease_after_ns: u64,
+    stable_ns: u64 = 0,
+
+    pub fn init(opts: TschedOptions, hardware_buffer: usize, block: usize) Levels {
+        // a hardware buffer of a single period leaves no room for two blocks, the target is then the whole buffer
+        const target = std.math.clamp(opts.latency_frames, @min(2 * block, hardware_buffer), hardware_buffer);
+
+        var levels = Levels{
+            .target = target,
+            .watermark = opts.watermark_frames,
+            .min_watermark = @min(opts.min_watermark_frames, opts.watermark_frames),
+            .min_target = target,
+            .max_target = hardware_buffer,
+            .block = block,
+            .decrease_after_ns = @as(u64, opts.decrease_after_ms) * std.time.ns_per_ms,
+        };
+
+        levels.fit();
+        return levels;
+    }
+
+    /// Doubles the watermark, growing the target when the watermark no longer fits under it.
+    pub fn onUnderrun(self: *Levels) void {
+        self.watermark = @max(self.watermark * 2, self.block);
+        self.stable_ns = 0;
+        self.fit();
+    }
+
+    /// Shrinks the watermark back after `decrease_after_ms` without underruns.
+    pub fn onStable(self: *Levels, elapsed_ns: u64) void {
+        self.stable_ns += elapsed_ns;
+        if (self.stable_ns < self.decrease_after_ns) return;
+
+        self.stable_ns = 0;
+        self.watermark = @max(self.watermark - self.watermark / 4, self.min_watermark);
+        self.fit();
+    }
+
+    // keeps two blocks between watermark and target, within the hardware buffer
+    fn fit(self: *Levels) void {
+        self.watermark = @min(self.watermark, self.max_target -| 2 * self.block);
+        self.target = std.math.clamp(self.watermark + 2 * self.block, self.min_target, self.max_target);
+    }
+};
+
+/// One shot monotonic timerfd. Blocking in `sleep` is the only wakeup of a tsched loop.
+pub const Timer = struct {
+    fd: std.posix.fd_t,
+
+    pub fn init() TschedError!Timer {
+        const fd = std.posix.timerfd_create(std.posix.CLOCK.MONOTONIC, linux.TFD.CLOEXEC) catch return TschedError.timer_create;
+        return .{ .fd = fd };
+    }
+
+    /// Blocks for `ns` nanoseconds, returns right away for zero.
+    pub fn sleep(self: Timer, ns: u64) TschedError!void {
+        if (ns == 0) return;
+
+        const spec = linux.itimerspec{
+            .it_interval = .{ .tv_sec = 0, .tv_nsec = 0 },
+            .it_value = .{ .tv_sec = @intCast(ns / std.time.ns_per_s), .tv_nsec = @intCast(ns % std.time.ns_per_s) },
+        };
+
+        std.posix.timerfd_settime(self.fd, 0, &spec, null) catch return TschedError.timer_set;
+
+        var expirations: u64 = 0;
+        _ = std.posix.read(self.fd, std.mem.asBytes(&expirations)) catch return TschedError.timer_read;
+    }
+
+    pub fn deinit(self: Timer) void {
+        std.posix.close(self.fd);
+    }
+
+    /// CLOCK_MONOTONIC in nanoseconds, the clock of ALSA monotonic timestamps.
+    pub const now = telemetry.monotonicNs;
+};
+
+pub fn framesToNs(frames: usize, sample_rate: u32) u64 {
+    return @intCast(@as(u128, frames) * std.time.ns_per_s / sample_rate);
+}
+
+pub fn nsToFrames(ns: u64, sample_rate: u32) usize {
+    return @intCast(@as(u128, ns) * sample_rate / std.time.ns_per_s);
+}
+
+test "Levels - the watermark grows on underruns and shrinks back when stable" {
+    var levels = Levels.init(.{ .latency_frames = 4096, .watermark_frames = 512, .min_watermark_frames = 256, .decrease_after_ms = 1000 }, 8192, 256);
+
+    try std.testing.expectEqual(4096, levels.target);
+    try std.testing.expectEqual(512, levels.watermark);
+
+    levels.onUnderrun();
+    levels.onUnderrun();
+    levels.onUnderrun();
+
+    // the target grows to keep two blocks above the watermark
+    try std.testing.expectEqual(4096, levels.watermark);
+    try std.testing.expectEqual(4608, levels.target);
+
+    levels.onUnderrun();
+    levels.onUnderrun();
+
+    // capped by the hardware buffer
+    try std.testing.expectEqual(7680, levels.watermark);
+    try std.testing.expectEqual(8192, levels.target);
+
+    levels.onStable(999 * std.time.ns_per_ms);
+    try std.testing.expectEqual(7680, levels.watermark);
+
+    levels.onStable(std.time.ns_per_ms);
+    try std.testing.expectEqual(5760, levels.watermark);
+
+    for (0..20) |_| levels.onStable(std.time.ns_per_s);
+
+    try std.testing.expectEqual(256, levels.watermark);
+    try std.testing.expectEqual(4096, levels.target);
+}
+
+test "Levels - a single period hardware buffer is used whole" {
+    const levels = Levels.init(.{}, 256, 256);
+
+    try std.testing.expectEqual(256, levels.target);
+    try std.testing.expectEqual(0, levels.watermark);
+}
+
+test "Timer - sleeps at least the requested time" {
+    const timer = try Timer.init();
+    defer timer.deinit();
+
+    const start = Timer.now();
+    try timer.sleep(2 * std.time.ns_per_ms);
+
+    try std.testing.expect(Timer.now() - start >= 2 * std.time.ns_per_ms);
+}
+
+test "frames and nanoseconds" {
+    try std.testing.expectEqual(std.time.ns_per_s, framesToNs(48_000, 48_000));
+    try std.testing.expectEqual(441, nsToFrames(10 * std.time.ns_per_ms, 44_100));
+}
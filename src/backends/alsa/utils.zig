@@ -4,6 +4,19 @@ const c_alsa = @cImport({
     @cInclude("asoundlib.h");
 });
 
+/// `$XDG_CACHE_HOME/delia/{file_name}`, falling back to `$HOME/.cache`. `null` when neither is set.
+pub fn cachePath(allocator: std.mem.Allocator, file_name: []const u8) !?[]u8 {
+    if (std.posix.getenv("XDG_CACHE_HOME")) |dir| {
+        return try std.fs.path.join(allocator, &.{ dir, "delia", file_name });
+    }
+
+    if (std.posix.getenv("HOME")) |home| {
+        return try std.fs.path.join(allocator, &.{ home, ".cache", "delia", file_name });
+    }
+
+    return null;
+}
+
 pub fn stateToStr(state: c_uint) []const u8 {
     return switch (state) {
         c_alsa.SND_PCM_STATE_OPEN => "OPEN",
@@ -12,6 +12,9 @@ const log = std.log.scoped(.jack);
 const Hardware = @import("Hardware.zig");
 const port_names = @import("port_names.zig");
 const audio_data = @import("audio_data.zig");
+const telemetry = @import("../../common/telemetry.zig");
+
+pub const LoopTelemetry = telemetry.LoopTelemetry;
 
 // jack defaults to float32
 const audio_type = c_jack.JACK_DEFAULT_AUDIO_TYPE;
@@ -103,6 +106,13 @@ pub fn JackClient(comptime Context: type, comptime comptime_opts: JackComptimeOp
         on_shutdown: ?*fn (arg: ?*anyopaque) void = null,
         // working on setting the callback for jack
         context: *Context,
+        // handed to the process callback, heap allocated so it outlives moves of the client
+        process_state: *ProcessState,
+
+        const ProcessState = struct {
+            client: *c_jack.jack_client_t,
+            telemetry: ?*LoopTelemetry,
+        };
 
         //   connectedPorts: [port_names.max_n_ports * 2]?*c_jack.jack_port_t = null_init,
 
@@ -158,7 +168,12 @@ pub fn JackClient(comptime Context: type, comptime comptime_opts: JackComptimeOp
                 maybe_new_name = std.mem.span(new_name);
             }
 
-            const err = c_jack.jack_set_process_callback(client, &Self.processCallback, null);
+            const process_state = try allocator.create(ProcessState);
+            errdefer allocator.destroy(process_state);
+
+            process_state.* = .{ .client = client, .telemetry = opts.telemetry };
+
+            const err = c_jack.jack_set_process_callback(client, &Self.processCallback, process_state);
 
             if (err != 0) {
                 log.err("Failed to set process callback: {d}", .{err});
@@ -172,6 +187,7 @@ pub fn JackClient(comptime Context: type, comptime comptime_opts: JackComptimeOp
                 .allocator = allocator,
                 .hardware = try Hardware.init(allocator, client),
                 .context = context,
+                .process_state = process_state,
             };
         }
 
@@ -257,11 +273,30 @@ pub fn JackClient(comptime Context: type, comptime comptime_opts: JackComptimeOp
             if (err != 0) {
                 std.log.err("Failed to close JACK client: {d}", .{err});
             }
+
+            // the process callback can no longer run once the client is closed
+            self.allocator.destroy(self.process_state);
         }
 
         fn processCallback(n_frames: c_jack.jack_nframes_t, arg: ?*anyopaque) callconv(.C) c_int {
             _ = n_frames;
-            _ = arg;
+
+            const state: *ProcessState = @ptrCast(@alignCast(arg orelse return 0));
+            const t = state.telemetry orelse return 0;
+
+            var current_frames: c_jack.jack_nframes_t = 0;
+            var current_usecs: c_jack.jack_time_t = 0;
+            var next_usecs: c_jack.jack_time_t = 0;
+            var period_usecs: f32 = 0;
+
+            // jack_get_time is CLOCK_MONOTONIC on linux, the clock of the telemetry
+            if (c_jack.jack_get_cycle_times(state.client, &current_frames, &current_usecs, &next_usecs, &period_usecs) == 0) {
+                t.period_ns = (next_usecs -| current_usecs) * std.time.ns_per_us;
+                t.wake(current_usecs * std.time.ns_per_us);
+            } else t.wake(telemetry.monotonicNs());
+
+            // the processing happens in the other clients of the graph, only the wakeup delay is known here
+            t.recordWakeup(telemetry.monotonicNs());
 
             return 0;
         }
@@ -339,6 +374,8 @@ const JackClientOptions = struct {
     client_name: []const u8 = "device",
     server_name: ?[]const u8 = null,
     jack_options: JackOpenOptions = JackOpenOptions.initEmpty(),
+    /// Timings of every process cycle, owned by the caller and readable from any thread.
+    telemetry: ?*LoopTelemetry = null,
 };
 
 const JackLogLevel = enum {
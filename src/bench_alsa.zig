@@ -0,0 +1,380 @@
+//! Audio loop overhead without audio hardware: `zig build bench-alsa -- --mode full --format s24_3 --buffer 128`
+//!
+//! The devices open `null` (or `file` into /dev/null) PCMs defined in `null_config.asoundrc`, so the loop never
+//! waits on a clock and spins through state checks, `avail_update`, `mmap_begin`/`commit` and the format conversion
+//! done by the callback. Reported per callback: the time spent in the loop between two callbacks, and in the conversion.
+
+const std = @import("std");
+
+const alsa = @import("backends/alsa/alsa.zig");
+const null_config = @import("backends/alsa/null_config.zig");
+const telemetry = @import("common/telemetry.zig");
+
+const log = std.log.scoped(.bench_alsa);
+
+const Mode = enum { playback, capture, full };
+const Plugin = enum { @"null", file };
+const Access = enum { mmap, rw };
+
+// the formats worth comparing, one conversion path each
+const BenchFormat = enum {
+    s16,
+    s24,
+    s24_3,
+    s32,
+    f32,
+
+    fn formatType(comptime self: BenchFormat) alsa.settings.FormatType {
+        return switch (self) {
+            .s16 => .signed_16bits_little_endian,
+            .s24 => .signed_24bits_little_endian,
+            .s24_3 => .signed_24bits_packed3_little_endian,
+            .s32 => .signed_32bits_little_endian,
+            .f32 => .float_32bits_little_endian,
+        };
+    }
+};
+
+const Options = struct {
+    mode: Mode = .playback,
+    plugin: Plugin = .@"null",
+    format: BenchFormat = .s16,
+    /// Half duplex only, full duplex devices negotiate an interleaved access type on their own.
+    access: ?Access = null,
+    buffer_size: alsa.driver.BufferSize = .buf_256,
+    n_periods: u32 = 4,
+    channels: alsa.driver.ChannelCount = .stereo,
+    cycles: usize = 100_000,
+    /// Full duplex only, see `FullDuplexDeviceOptions.drift`.
+    drift: bool = false,
+};
+
+const usage =
+    \\Usage: bench-alsa [options]
+    \\  --mode playback|capture|full   (playback)
+    \\  --plugin null|file             (null)
+    \\  --format s16|s24|s24_3|s32|f32 (s16)
+    \\  --access mmap|rw               (mmap) playback and capture only
+    \\  --buffer 128..4096             (256) frames per period
+    \\  --periods N                    (4)
+    \\  --channels N                   (2)
+    \\  --cycles N                     (100000) callbacks measured
+    \\  --drift                        resample the capture of full duplex devices
+    \\
+;
+
+// the loops never return, the main thread reports once `cycles` callbacks ran, or gives up after this long
+const timeout_ns = 120 * std.time.ns_per_s;
+
+fn Bench(comptime format: alsa.settings.FormatType) type {
+    return struct {
+        const Self = @This();
+
+        const HalfDevice = alsa.driver.HalfDuplexDevice(Self, .{ .format = format });
+        const FullDevice = alsa.driver.FullDuplexDevice(Self, .{ .format = format });
+        const AudioData = HalfDevice.AudioDataType();
+        const Float = HalfDevice.FloatType();
+
+        // one period of interleaved samples, rendered once
+        samples: []Float,
+        target: usize,
+        cycles: usize = 0,
+        frames: usize = 0,
+        last_end: u64 = 0,
+        started_at: u64 = 0,
+        /// Between the end of a callback and the start of the next one, the loop itself.
+        overhead: telemetry.Histogram = .{},
+        /// Encoding or decoding one callback worth of samples.
+        conversion: telemetry.Histogram = .{},
+        /// What the devices negotiated, playback first.
+        access_types: std.BoundedArray(alsa.settings.AccessType, 2) = .{},
+        done: std.Thread.ResetEvent = .{},
+
+        fn onPlayback(self: *Self, data: AudioData) void {
+            const start = self.begin();
+            data.write(self.samples[0 .. data.bufferSizeInFrames() * data.channels]) catch {};
+            self.end(start, data.bufferSizeInFrames());
+        }
+
+        fn onCapture(self: *Self, data: AudioData) void {
+            const start = self.begin();
+            _ = data.readAll(self.samples) catch {};
+            self.end(start, data.bufferSizeInFrames());
+        }
+
+        fn onFullDuplex(self: *Self, in: AudioData, out: AudioData) void {
+            const start = self.begin();
+            const in_samples = in.readAll(self.samples) catch self.samples[0..0];
+            out.write(in_samples[0..@min(in_samples.len, out.bufferSizeInFrames() * out.channels)]) catch {};
+            self.end(start, out.bufferSizeInFrames());
+        }
+
+        inline fn begin(self: *Self) u64 {
+            const now = telemetry.monotonicNs();
+            if (self.cycles == self.target) return now;
+
+            if (self.last_end != 0) self.overhead.record(now - self.last_end) else self.started_at = now;
+            return now;
+        }
+
+        inline fn end(self: *Self, start: u64, frames: usize) void {
+            if (self.cycles == self.target) return;
+
+            self.last_end = telemetry.monotonicNs();
+            self.conversion.record(self.last_end - start);
+
+            self.cycles += 1;
+            self.frames += frames;
+
+            if (self.cycles == self.target) self.done.set();
+        }
+
+        fn run(allocator: std.mem.Allocator, opts: Options) !void {
+            const period: usize = @intFromEnum(opts.buffer_size);
+            const channels: usize = @intFromEnum(opts.channels);
+
+            // never freed, the loop thread uses them until the process exits
+            const samples = try allocator.alloc(Float, period * channels);
+
+            for (samples, 0..) |*sample, i| sample.* = @floatCast(0.5 * @sin(@as(f64, @floatFromInt(i / channels)) * 0.05));
+
+            const self = try allocator.create(Self);
+
+            self.* = .{ .samples = samples, .target = opts.cycles };
+
+            const access_type: alsa.settings.AccessType = switch (opts.access orelse .mmap) {
+                .mmap => .mmap_interleaved,
+                .rw => .rw_interleaved,
+            };
+
+            var ident_buffer: [2][64]u8 = undefined;
+            const playback_ident = try std.fmt.bufPrintZ(&ident_buffer[0], "delia_bench_{s}_playback", .{@tagName(opts.plugin)});
+            const capture_ident = try std.fmt.bufPrintZ(&ident_buffer[1], "delia_bench_{s}_capture", .{@tagName(opts.plugin)});
+
+            const thread = switch (opts.mode) {
+                .playback, .capture => blk: {
+                    var device = try HalfDevice.init(allocator, .{
+                        .ident = if (opts.mode == .playback) playback_ident else capture_ident,
+                        .stream_type = if (opts.mode == .playback) .playback else .capture,
+                        .channels = opts.channels,
+                        .buffer_size = opts.buffer_size,
+                        .n_periods = opts.n_periods,
+                        .access_type = access_type,
+                    });
+
+                    self.access_types.appendAssumeCapacity(device.access_type);
+                    try device.prepare();
+
+                    break :blk try device.spawn(self, if (opts.mode == .playback) onPlayback else onCapture);
+                },
+
+                .full => blk: {
+                    var device = try FullDevice.init(allocator, .{
+                        .ident = .{ .playback = playback_ident, .capture = capture_ident },
+                        .channels = .{ .playback = opts.channels, .capture = opts.channels },
+                        .buffer_size = opts.buffer_size,
+                        .n_periods = opts.n_periods,
+                        .drift = if (opts.drift) .{} else null,
+                    });
+
+                    self.access_types.appendAssumeCapacity(device.playback_device.access_type);
+                    self.access_types.appendAssumeCapacity(device.capture_device.access_type);
+                    try device.prepare();
+
+                    break :blk try device.spawn(self, onFullDuplex);
+                },
+            };
+
+            // the loop thread is left running, the process exits after the report
+            thread.detach();
+
+            self.done.timedWait(timeout_ns) catch {
+                log.err("Only {d} of {d} callbacks after {d}s, the loop stopped or stalled", .{ self.cycles, self.target, timeout_ns / std.time.ns_per_s });
+                return error.Timeout;
+            };
+
+            try self.report(opts, std.io.getStdOut().writer());
+        }
+
+        fn report(self: *Self, opts: Options, writer: anytype) !void {
+            const elapsed = self.last_end - self.started_at;
+            const frames_per_cycle = @as(f64, @floatFromInt(self.frames)) / @as(f64, @floatFromInt(self.cycles));
+
+            try writer.print("{s} {s} {s}", .{ @tagName(opts.mode), @tagName(opts.plugin), @tagName(opts.format) });
+
+            for (self.access_types.constSlice(), 0..) |access_type, i| {
+                try writer.print("{s}{s}", .{ if (i == 0) " " else "/", @tagName(access_type) });
+            }
+
+            try writer.print(", {d} frames x {d} periods, {d} channels\n", .{
+                @intFromEnum(opts.buffer_size),
+                opts.n_periods,
+                @intFromEnum(opts.channels),
+            });
+
+            try writer.print("  {d} callbacks, {d:.1} frames each, {d} frames in {d:.3}s ({d:.1}x realtime at 48kHz)\n", .{
+                self.cycles,
+                frames_per_cycle,
+                self.frames,
+                @as(f64, @floatFromInt(elapsed)) / std.time.ns_per_s,
+                @as(f64, @floatFromInt(self.frames)) / 48_000.0 / (@as(f64, @floatFromInt(elapsed)) / std.time.ns_per_s),
+            });
+
+            try writeRow(writer, "loop overhead", self.overhead.snapshot());
+            try writeRow(writer, "conversion   ", self.conversion.snapshot());
+        }
+
+        fn writeRow(writer: anytype, name: []const u8, s: telemetry.Histogram.Snapshot) !void {
+            try writer.print("  {s}  p50 {d}ns  p99 {d}ns  p99.9 {d}ns  max {d}ns\n", .{ name, s.p50, s.p99, s.p999, s.max });
+        }
+    };
+}
+
+fn parseOptions(args: []const []const u8) !Options {
+    var opts = Options{};
+    var i: usize = 1;
+
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+
+        if (std.mem.eql(u8, arg, "--drift")) {
+            opts.drift = true;
+            continue;
+        }
+
+        if (std.mem.eql(u8, arg, "--help")) return error.Help;
+        if (i + 1 >= args.len) return error.MissingValue;
+
+        i += 1;
+        const value = args[i];
+
+        if (std.mem.eql(u8, arg, "--mode")) {
+            opts.mode = std.meta.stringToEnum(Mode, value) orelse return error.InvalidValue;
+        } else if (std.mem.eql(u8, arg, "--plugin")) {
+            opts.plugin = std.meta.stringToEnum(Plugin, value) orelse return error.InvalidValue;
+        } else if (std.mem.eql(u8, arg, "--format")) {
+            opts.format = std.meta.stringToEnum(BenchFormat, value) orelse return error.InvalidValue;
+        } else if (std.mem.eql(u8, arg, "--access")) {
+            opts.access = std.meta.stringToEnum(Access, value) orelse return error.InvalidValue;
+        } else if (std.mem.eql(u8, arg, "--buffer")) {
+            opts.buffer_size = std.meta.intToEnum(alsa.driver.BufferSize, try std.fmt.parseInt(usize, value, 10)) catch return error.InvalidValue;
+        } else if (std.mem.eql(u8, arg, "--periods")) {
+            opts.n_periods = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, arg, "--channels")) {
+            opts.channels = std.meta.intToEnum(alsa.driver.ChannelCount, try std.fmt.parseInt(u32, value, 10)) catch return error.InvalidValue;
+        } else if (std.mem.eql(u8, arg, "--cycles")) {
+            opts.cycles = try std.fmt.parseInt(usize, value, 10);
+        } else return error.InvalidOption;
+    }
+
+    // full duplex devices have no access type option, it would be silently ignored
+    if (opts.mode == .full and opts.access != null) return error.AccessInFullMode;
+
+    return opts;
+}
+
+pub fn main() !void {
+    const allocator = std.heap.page_allocator;
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+
+    const opts = parseOptions(args) catch |err| {
+        if (err != error.Help) log.err("{s}", .{@errorName(err)});
+        try std.io.getStdErr().writeAll(usage);
+        std.process.exit(if (err == error.Help) 0 else 2);
+    };
+
+    var path_buffer: [64]u8 = undefined;
+    _ = try null_config.install(&path_buffer);
+
+    switch (opts.format) {
+        inline else => |format| try Bench(comptime format.formatType()).run(allocator, opts),
+    }
+
+    // the audio thread is still spinning
+    std.process.exit(0);
+}
+
+test "PollLoop - services a playback and a capture device from one thread" {
+    const allocator = std.testing.allocator;
+    const format = alsa.settings.FormatType.float_32bits_little_endian;
+
+    const Counter = struct {
+        const Self = @This();
+        const Device = alsa.driver.HalfDuplexDevice(Self, .{ .format = format });
+        const PollLoop = alsa.driver.PollLoop(Self, .{ .format = format });
+
+        playback: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+        capture: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+
+        fn onPlayback(self: *Self, _: Device.AudioDataType()) void {
+            _ = self.playback.fetchAdd(1, .monotonic);
+        }
+
+        fn onCapture(self: *Self, _: Device.AudioDataType()) void {
+            _ = self.capture.fetchAdd(1, .monotonic);
+        }
+
+        fn runLoop(poll_loop: *PollLoop, failed: *std.atomic.Value(bool)) void {
+            poll_loop.run() catch {
+                failed.store(true, .release);
+            };
+        }
+    };
+
+    var config = try null_config.TestConfig.init(allocator);
+    defer config.deinit();
+
+    var devices: [2]Counter.Device = undefined;
+    const idents = [_][:0]const u8{ null_config.null_playback, null_config.null_capture };
+    const stream_types = [_]alsa.settings.StreamType{ .playback, .capture };
+
+    for (&devices, idents, stream_types, 0..) |*device, ident, stream_type, i| {
+        errdefer for (devices[0..i]) |*opened| opened.deinit() catch {};
+
+        device.* = try Counter.Device.init(allocator, .{
+            .ident = ident,
+            .stream_type = stream_type,
+            .channels = .stereo,
+            .buffer_size = .buf_256,
+            .n_periods = 4,
+        });
+    }
+
+    defer for (&devices) |*device| device.deinit() catch {};
+
+    for (&devices) |*device| try device.prepare();
+
+    const timeout_ms = 100;
+
+    var counter = Counter{};
+    var poll_loop = Counter.PollLoop.init(allocator, .{ .timeout = timeout_ms });
+    defer poll_loop.deinit();
+
+    try poll_loop.add(devices[0], &counter, Counter.onPlayback);
+    try poll_loop.add(devices[1], &counter, Counter.onCapture);
+
+    var failed = std.atomic.Value(bool).init(false);
+    const thread = try std.Thread.spawn(.{}, Counter.runLoop, .{ &poll_loop, &failed });
+
+    // the null plugin is always ready, a few periods each come quickly
+    const cycles = 16;
+    const deadline = telemetry.monotonicNs() + 5 * std.time.ns_per_s;
+
+    while (counter.playback.load(.monotonic) < cycles or counter.capture.load(.monotonic) < cycles) {
+        if (failed.load(.acquire) or telemetry.monotonicNs() > deadline) break;
+        std.time.sleep(std.time.ns_per_ms);
+    }
+
+    const stopped_at = telemetry.monotonicNs();
+    poll_loop.stop();
+    thread.join();
+
+    try std.testing.expect(!failed.load(.acquire));
+    try std.testing.expect(counter.playback.load(.monotonic) >= cycles);
+    try std.testing.expect(counter.capture.load(.monotonic) >= cycles);
+
+    // run returns after the current wakeup, at the latest once the poll times out
+    try std.testing.expect(telemetry.monotonicNs() - stopped_at < timeout_ms * std.time.ns_per_ms);
+}
@@ -1,6 +1,7 @@
 const std = @import("std");
 const dsp = @import("dsp/dsp.zig");
 const zbench = @import("zbench");
+const audio_buffer = @import("common/audio_buffer.zig");
 
 fn fftPowerOfTwo(allocator: std.mem.Allocator) void {
     const transform = dsp.transforms.FourierDynamic(f32);
@@ -83,6 +84,38 @@ fn vectorizedSineWave(_: std.mem.Allocator) void {
     _ = sine;
 }
 
+fn gainViewSetup(data: []f32) audio_buffer.UnmanagedChannelView(f32) {
+    @memset(data, 0.5);
+
+    return audio_buffer.UnmanagedChannelView(f32).init(data, .{
+        .n_channels = 2,
+        .block_size = .blk_2048,
+        .access = .non_interleaved,
+    }) catch unreachable;
+}
+
+fn gainSampleBySample(_: std.mem.Allocator) void {
+    var data: [4096]f32 = undefined;
+    const view = gainViewSetup(&data);
+
+    for (0..view.block_size) |frame| {
+        for (0..view.n_channels) |ch| {
+            view.writeSample(ch, frame, view.readSample(ch, frame) * 0.5);
+        }
+    }
+
+    std.mem.doNotOptimizeAway(&data);
+}
+
+fn gainContiguous(_: std.mem.Allocator) void {
+    var data: [4096]f32 = undefined;
+    const view = gainViewSetup(&data);
+
+    view.scale(0.5);
+
+    std.mem.doNotOptimizeAway(&data);
+}
+
 pub fn main() !void {
     const stdout = std.io.getStdOut().writer();
     const allocator = std.heap.page_allocator;
@@ -96,5 +129,7 @@ pub fn main() !void {
     try bench.add("sin", sineWave, .{});
     try bench.add("sin smpl by smpl", sineWaveSampleBySample, .{});
     try bench.add("vec sine", vectorizedSineWave, .{});
+    try bench.add("gain smpl by smpl", gainSampleBySample, .{});
+    try bench.add("gain contiguous", gainContiguous, .{});
     try bench.run(stdout);
 }
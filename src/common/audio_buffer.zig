@@ -1,5 +1,6 @@
 const std = @import("std");
 const specs = @import("../common/audio_specs.zig");
+const simd = @import("simd.zig");
 
 pub const AccessPattern = enum {
     interleaved,
@@ -23,6 +24,15 @@ pub const ChannelViewError = error{
     invalid_buffer_length,
 };
 
+/// Alignment of the buffers allocated here. Covers every SIMD width up to AVX-512
+/// and keeps buffers written by different threads on separate cache lines.
+pub const buffer_alignment = @max(std.atomic.cache_line, 64);
+
+// rounds a sample count up so the next view or channel starts on a `buffer_alignment` boundary
+fn paddedLength(comptime T: type, n_samples: usize) usize {
+    return std.mem.alignForward(usize, n_samples, buffer_alignment / @sizeOf(T));
+}
+
 pub fn ChannelView(comptime T: type) type {
     if (T != f32 and T != f64) {
         @compileError("ChannelView only supports f32 and f64");
@@ -31,21 +41,33 @@ pub fn ChannelView(comptime T: type) type {
     return struct {
         const Self = @This();
 
-        buffer: []T,
+        buffer: []align(buffer_alignment) T,
         n_channels: usize,
         block_size: usize,
         access: AccessPattern,
         allocator: std.mem.Allocator,
+        // distance between two channels of a non interleaved view, block size rounded up to the alignment
+        channel_stride: usize,
 
         pub fn init(allocator: std.mem.Allocator, opts: ViewOption) !Self {
-            const buffer_len = @as(usize, @intFromEnum(opts.block_size) * opts.n_channels);
+            const block_size: usize = @intFromEnum(opts.block_size);
+
+            const channel_stride = switch (opts.access) {
+                .interleaved => block_size,
+                .non_interleaved => paddedLength(T, block_size),
+            };
+
+            const buffer = try allocator.alignedAlloc(T, buffer_alignment, channel_stride * opts.n_channels);
+            // padding is never read, zeroed so it never holds garbage either
+            @memset(buffer, 0);
 
             return Self{
-                .buffer = try allocator.alloc(T, buffer_len),
-                .block_size = @intFromEnum(opts.block_size),
+                .buffer = buffer,
+                .block_size = block_size,
                 .n_channels = opts.n_channels,
                 .access = opts.access,
                 .allocator = allocator,
+                .channel_stride = channel_stride,
             };
         }
 
@@ -53,14 +75,14 @@ pub fn ChannelView(comptime T: type) type {
         pub inline fn readSample(self: Self, at_channel: usize, at_frame: usize) T {
             return switch (self.access) {
                 .interleaved => self.buffer[at_frame * self.n_channels + at_channel],
-                .non_interleaved => self.buffer[at_channel * self.block_size + at_frame],
+                .non_interleaved => self.buffer[at_channel * self.channel_stride + at_frame],
             };
         }
 
         pub inline fn writeSample(self: Self, at_channel: usize, at_frame: usize, sample: T) void {
             switch (self.access) {
                 .interleaved => self.buffer[at_frame * self.n_channels + at_channel] = sample,
-                .non_interleaved => self.buffer[at_channel * self.block_size + at_frame] = sample,
+                .non_interleaved => self.buffer[at_channel * self.channel_stride + at_frame] = sample,
             }
         }
 
@@ -73,7 +95,7 @@ pub fn ChannelView(comptime T: type) type {
         }
 
         pub inline fn totalSampleCount(self: Self) usize {
-            return self.buffer.len;
+            return self.n_channels * self.block_size;
         }
 
         pub inline fn zero(self: Self) void {
@@ -98,6 +120,10 @@ pub fn UnmanagedChannelView(comptime T: type) type {
         n_channels: usize,
         block_size: usize,
         access: AccessPattern,
+        // distance between the first sample of two consecutive channels in non_interleaved views.
+        // block_size for views over packed buffers (`init`), larger for the views of `UniformChannelViews`, whose
+        // channels are padded to `buffer_alignment`, and for subViews of a larger block
+        channel_stride: usize,
 
         pub fn init(buffer: []T, opts: ViewOption) ChannelViewError!Self {
             const block_size: usize = @intFromEnum(opts.block_size);
@@ -111,6 +137,7 @@ pub fn UnmanagedChannelView(comptime T: type) type {
                 .n_channels = opts.n_channels,
                 .block_size = block_size,
                 .access = opts.access,
+                .channel_stride = block_size,
             };
         }
 
@@ -118,33 +145,148 @@ pub fn UnmanagedChannelView(comptime T: type) type {
         pub inline fn readSample(self: Self, at_channel: usize, at_frame: usize) T {
             return switch (self.access) {
                 .interleaved => self.buffer[at_frame * self.n_channels + at_channel],
-                .non_interleaved => self.buffer[at_channel * self.block_size + at_frame],
+                .non_interleaved => self.buffer[at_channel * self.channel_stride + at_frame],
             };
         }
 
         pub inline fn writeSample(self: Self, at_channel: usize, at_frame: usize, sample: T) void {
             switch (self.access) {
                 .interleaved => self.buffer[at_frame * self.n_channels + at_channel] = sample,
-                .non_interleaved => self.buffer[at_channel * self.block_size + at_frame] = sample,
+                .non_interleaved => self.buffer[at_channel * self.channel_stride + at_frame] = sample,
             }
         }
 
+        /// True when all samples of the view are packed one after the other.
+        /// False for non interleaved sub views, and for the non interleaved views of `UniformChannelViews` when the
+        /// block size is not a multiple of the alignment: channels are padded there. `scale`, `addFrom` and `zero`
+        /// then run once per channel.
+        pub inline fn isContiguous(self: Self) bool {
+            return self.access == .interleaved or self.n_channels <= 1 or self.channel_stride == self.block_size;
+        }
+
+        /// All samples of the view as one slice, in the view's access order.
+        /// For kernels that apply the same operation to every sample. Asserts `isContiguous`.
+        pub inline fn samples(self: Self) []T {
+            std.debug.assert(self.isContiguous());
+            return self.buffer[0 .. self.n_channels * self.block_size];
+        }
+
+        /// One channel as a contiguous slice. Non interleaved views only.
+        pub inline fn channel(self: Self, at_channel: usize) []T {
+            std.debug.assert(self.access == .non_interleaved);
+            return self.buffer[at_channel * self.channel_stride ..][0..self.block_size];
+        }
+
+        /// True when the view and every channel start on a `buffer_alignment` boundary,
+        /// e.g. views from `UniformChannelViews`. Sub views usually are not.
+        pub inline fn isAligned(self: Self) bool {
+            const stride_aligned = self.access == .interleaved or (self.channel_stride * @sizeOf(T)) % buffer_alignment == 0;
+            return stride_aligned and std.mem.isAligned(@intFromPtr(self.buffer.ptr), buffer_alignment);
+        }
+
+        /// Same as `samples` with the alignment in the type, for aligned vector loads. Asserts `isAligned`.
+        pub inline fn alignedSamples(self: Self) []align(buffer_alignment) T {
+            std.debug.assert(self.isAligned());
+            return @alignCast(self.samples());
+        }
+
+        /// Same as `channel` with the alignment in the type, for aligned vector loads. Asserts `isAligned`.
+        pub inline fn alignedChannel(self: Self, at_channel: usize) []align(buffer_alignment) T {
+            std.debug.assert(self.isAligned());
+            return @alignCast(self.channel(at_channel));
+        }
+
+        /// All channels of one frame as a contiguous slice. Interleaved views only.
+        pub inline fn frame(self: Self, at_frame: usize) []T {
+            std.debug.assert(self.access == .interleaved);
+            return self.buffer[at_frame * self.n_channels ..][0..self.n_channels];
+        }
+
+        /// Returns a view over frames [start_frame, start_frame + n_frames) sharing the same memory.
+        /// Used by the scheduler to split a block at event boundaries.
+        pub fn subView(self: Self, start_frame: usize, n_frames: usize) Self {
+            std.debug.assert(start_frame + n_frames <= self.block_size);
+
+            const buffer = switch (self.access) {
+                .interleaved => self.buffer[start_frame * self.n_channels .. (start_frame + n_frames) * self.n_channels],
+                .non_interleaved => self.buffer[start_frame .. start_frame + (self.n_channels - 1) * self.channel_stride + n_frames],
+            };
+
+            return Self{
+                .buffer = buffer,
+                .n_channels = self.n_channels,
+                .block_size = n_frames,
+                .access = self.access,
+                .channel_stride = self.channel_stride,
+            };
+        }
+
         // we don't need pointers self, we are chaning the inner memory in buffer
         pub inline fn copyFrom(self: Self, other: Self) !void {
-            if (self.buffer.len != other.buffer.len) {
+            if (self.n_channels != other.n_channels or self.block_size != other.block_size) {
                 return ChannelViewError.invalid_buffer_length;
             }
 
-            @memcpy(self.buffer, other.buffer);
+            if (self.access != other.access) {
+                for (0..self.block_size) |at_frame| {
+                    for (0..self.n_channels) |ch| self.writeSample(ch, at_frame, other.readSample(ch, at_frame));
+                }
+
+                return;
+            }
+
+            switch (self.access) {
+                .interleaved => @memcpy(self.samples(), other.samples()),
+                .non_interleaved => for (0..self.n_channels) |ch| @memcpy(self.channel(ch), other.channel(ch)),
+            }
+        }
+
+        /// Mixes `other` into this view. Views must have the same shape.
+        pub fn addFrom(self: Self, other: Self) ChannelViewError!void {
+            if (self.n_channels != other.n_channels or self.block_size != other.block_size) {
+                return ChannelViewError.invalid_buffer_length;
+            }
+
+            if (self.access != other.access) {
+                for (0..self.block_size) |at_frame| {
+                    for (0..self.n_channels) |ch| {
+                        self.writeSample(ch, at_frame, self.readSample(ch, at_frame) + other.readSample(ch, at_frame));
+                    }
+                }
+
+                return;
+            }
+
+            if (self.isContiguous() and other.isContiguous()) {
+                simd.add(T, self.samples(), other.samples());
+                return;
+            }
+
+            for (0..self.n_channels) |ch| simd.add(T, self.channel(ch), other.channel(ch));
+        }
+
+        /// Multiplies every sample by `factor`.
+        pub fn scale(self: Self, factor: T) void {
+            if (self.isContiguous()) {
+                simd.scale(T, self.samples(), factor);
+                return;
+            }
+
+            for (0..self.n_channels) |ch| simd.scale(T, self.channel(ch), factor);
         }
 
         pub inline fn totalSampleCount(self: Self) usize {
-            return self.buffer.len;
+            return self.n_channels * self.block_size;
         }
 
         // we don't need pointers self, we are chaning the inner memory in buffer
         pub inline fn zero(self: Self) void {
-            @memset(self.buffer, 0);
+            if (self.isContiguous()) {
+                @memset(self.samples(), 0);
+                return;
+            }
+
+            for (0..self.n_channels) |ch| @memset(self.channel(ch), 0);
         }
     };
 }
@@ -157,32 +299,58 @@ pub fn UniformChannelViews(T: type) type {
     return struct {
         const Self = @This();
 
-        buffer: []T,
+        // every view, and every channel of non interleaved views, starts on a `buffer_alignment` boundary
+        buffer: []align(buffer_alignment) T,
         opts: ViewsOptions,
         allocator: std.mem.Allocator,
+        // distance between two channels of a non interleaved view, block size rounded up to the alignment
+        channel_stride: usize,
+        // distance between two views, padded so views never share a cache line
+        view_stride: usize,
 
         pub fn init(allocator: std.mem.Allocator, opts: ViewsOptions) !Self {
-            const samples_per_view = @as(usize, @intFromEnum(opts.block_size) * opts.n_channels);
+            const block_size: usize = @intFromEnum(opts.block_size);
+
+            const channel_stride = switch (opts.access) {
+                .interleaved => block_size,
+                .non_interleaved => paddedLength(T, block_size),
+            };
+
+            const view_stride = switch (opts.access) {
+                .interleaved => paddedLength(T, block_size * opts.n_channels),
+                .non_interleaved => channel_stride * opts.n_channels,
+            };
+
+            const buffer = try allocator.alignedAlloc(T, buffer_alignment, opts.n_views * view_stride);
+            // padding is never read, zeroed so it never holds garbage either
+            @memset(buffer, 0);
 
             return .{
-                .buffer = try allocator.alloc(T, opts.n_views * samples_per_view),
+                .buffer = buffer,
                 .opts = opts,
                 .allocator = allocator,
+                .channel_stride = channel_stride,
+                .view_stride = view_stride,
             };
         }
 
         pub fn getView(self: *Self, index: usize) UnmanagedChannelView(T) {
-            const samples_per_view = self.opts.n_channels * @as(usize, @intFromEnum(self.opts.block_size));
-            const start = index * samples_per_view;
+            const block_size: usize = @intFromEnum(self.opts.block_size);
+            const start = index * self.view_stride;
 
-            const buffer = self.buffer[start .. start + samples_per_view];
+            // the last channel is not padded in the view
+            const view_len = switch (self.opts.access) {
+                .interleaved => block_size * self.opts.n_channels,
+                .non_interleaved => (self.opts.n_channels -| 1) * self.channel_stride + block_size,
+            };
 
-            return UnmanagedChannelView(T).init(buffer, .{
+            return .{
+                .buffer = self.buffer[start .. start + view_len],
                 .n_channels = self.opts.n_channels,
-                .block_size = self.opts.block_size,
+                .block_size = block_size,
                 .access = self.opts.access,
-                // should never happen
-            }) catch unreachable;
+                .channel_stride = self.channel_stride,
+            };
         }
 
         pub fn deinit(self: *Self) void {
@@ -255,6 +423,85 @@ test "UniformChannelViews - basic operations" {
     try expectEqual(view1.readSample(1, 0), 4.0);
 }
 
+test "UniformChannelViews - views and channels are aligned" {
+    const allocator = std.testing.allocator;
+    var views = try UniformChannelViews(f32).init(allocator, .{
+        .n_views = 3,
+        .n_channels = 3,
+        .block_size = .blk_4,
+        .access = .non_interleaved,
+    });
+    defer views.deinit();
+
+    for (0..3) |i| {
+        const view = views.getView(i);
+        try expect(view.isAligned());
+
+        for (0..3) |ch| {
+            try expect(std.mem.isAligned(@intFromPtr(view.alignedChannel(ch).ptr), buffer_alignment));
+        }
+    }
+
+    var interleaved = try UniformChannelViews(f64).init(allocator, .{
+        .n_views = 2,
+        .n_channels = 3,
+        .block_size = .blk_4,
+        .access = .interleaved,
+    });
+    defer interleaved.deinit();
+
+    // 12 samples padded to the next alignment boundary
+    try expectEqual(std.mem.alignForward(usize, 12, buffer_alignment / @sizeOf(f64)), interleaved.view_stride);
+    try expect(interleaved.getView(1).isAligned());
+}
+
+test "ChannelView - non interleaved channels are padded to the alignment" {
+    const allocator = std.testing.allocator;
+    var view = try ChannelView(f32).init(allocator, .{
+        .n_channels = 3,
+        .block_size = .blk_4,
+        .access = .non_interleaved,
+    });
+    defer view.deinit();
+
+    try expectEqual(buffer_alignment / @sizeOf(f32), view.channel_stride);
+    try expectEqual(12, view.totalSampleCount());
+
+    for (0..3) |ch| {
+        try expect(std.mem.isAligned(@intFromPtr(&view.buffer[ch * view.channel_stride]), buffer_alignment));
+
+        for (0..4) |frame| view.writeSample(ch, frame, @floatFromInt(ch * 4 + frame));
+    }
+
+    for (0..3) |ch| {
+        for (0..4) |frame| try expectEqual(@as(f32, @floatFromInt(ch * 4 + frame)), view.readSample(ch, frame));
+    }
+}
+
+test "UnmanagedChannelView - padded channels are not contiguous" {
+    const allocator = std.testing.allocator;
+    var views = try UniformChannelViews(f32).init(allocator, .{
+        .n_views = 1,
+        .n_channels = 2,
+        .block_size = .blk_4,
+        .access = .non_interleaved,
+    });
+    defer views.deinit();
+
+    const view = views.getView(0);
+    try expect(!view.isContiguous());
+
+    // the per channel path leaves the padding alone
+    for (0..2) |ch| @memset(view.channel(ch), 2);
+    view.scale(0.5);
+
+    for (0..2) |ch| {
+        for (view.channel(ch)) |sample| try expectEqual(1, sample);
+    }
+
+    for (view.buffer[4..view.channel_stride]) |padding| try expectEqual(0, padding);
+}
+
 test "ChannelView - interleaved read/write f32" {
     const allocator = std.testing.allocator;
     var view = try ChannelView(f32).init(allocator, .{
@@ -323,3 +570,64 @@ test "ChannelView - large non-interleaved buffer" {
         }
     }
 }
+
+test "UnmanagedChannelView - subView shares memory with parent" {
+    var data = [_]f32{0} ** 16;
+
+    inline for (.{ AccessPattern.interleaved, AccessPattern.non_interleaved }) |access| {
+        @memset(&data, 0);
+
+        const view = try UnmanagedChannelView(f32).init(&data, .{
+            .n_channels = 2,
+            .block_size = .blk_8,
+            .access = access,
+        });
+
+        const sub = view.subView(3, 4);
+        try expectEqual(4, sub.block_size);
+        try expectEqual(8, sub.totalSampleCount());
+
+        sub.writeSample(0, 0, 1.0);
+        sub.writeSample(1, 3, 2.0);
+
+        try expectEqual(1.0, view.readSample(0, 3));
+        try expectEqual(2.0, view.readSample(1, 6));
+
+        // zeroing a sub view must not touch frames outside of it
+        view.writeSample(1, 7, 5.0);
+        sub.zero();
+
+        try expectEqual(0.0, view.readSample(0, 3));
+        try expectEqual(0.0, view.readSample(1, 6));
+        try expectEqual(5.0, view.readSample(1, 7));
+    }
+}
+
+test "UnmanagedChannelView - contiguous accessors" {
+    var data = [_]f32{ 1, 2, 3, 4, 5, 6, 7, 8 };
+
+    const non_interleaved = try UnmanagedChannelView(f32).init(&data, .{
+        .n_channels = 2,
+        .block_size = .blk_4,
+        .access = .non_interleaved,
+    });
+
+    try std.testing.expectEqualSlices(f32, &.{ 5, 6, 7, 8 }, non_interleaved.channel(1));
+    try expect(non_interleaved.isContiguous());
+
+    const sub = non_interleaved.subView(1, 2);
+    try expect(!sub.isContiguous());
+    try std.testing.expectEqualSlices(f32, &.{ 6, 7 }, sub.channel(1));
+
+    sub.scale(2);
+    try std.testing.expectEqualSlices(f32, &.{ 1, 4, 6, 4, 5, 12, 14, 8 }, &data);
+
+    const interleaved = try UnmanagedChannelView(f32).init(&data, .{
+        .n_channels = 2,
+        .block_size = .blk_4,
+        .access = .interleaved,
+    });
+
+    try std.testing.expectEqualSlices(f32, &.{ 6, 4 }, interleaved.frame(1));
+    try expectEqual(8, interleaved.samples().len);
+}
@@ -0,0 +1,325 @@
+const std = @import("std");
+const audio_buffer = @import("audio_buffer.zig");
+
+const linux = std.os.linux;
+
+pub const AudioRingError = error{
+    invalid_capacity,
+    eventfd_failed,
+} || std.mem.Allocator.Error;
+
+/// How the producer wakes a consumer waiting for frames.
+pub const Notify = enum {
+    /// The consumer polls `readAvailable`.
+    none,
+    /// The consumer blocks in `wait`.
+    futex,
+    /// Like futex, and `eventFd` can be added to a poll/epoll loop. Costs a non blocking write per commit.
+    eventfd,
+};
+
+pub const AudioRingOptions = struct {
+    n_channels: usize,
+    /// Rounded up to the next power of two.
+    capacity_frames: usize,
+    notify: Notify = .none,
+};
+
+/// Wait-free single-producer/single-consumer ring of interleaved multichannel frames.
+/// The standard bridge between a real-time callback (e.g. `HalfDuplexAudioLoop`) and a background thread
+/// doing disk writes, analysis or networking.
+///
+/// Memory is allocated once in `init`. The producer side never allocates, locks or blocks.
+/// Regions expose the ring memory directly, up to two slices when the requested range wraps:
+///
+///     const regions = ring.writeRegions(n_frames);
+///     fill(regions.first); fill(regions.second);
+///     ring.commitWrite(regions.frames);
+///
+/// Exactly one thread may write and exactly one (other) thread may read.
+pub fn AudioRing(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        /// Interleaved frames, `second` is empty unless the range wraps around the end of the ring.
+        pub const Regions = struct {
+            first: []T,
+            second: []T,
+            frames: usize,
+        };
+
+        pub const ConstRegions = struct {
+            first: []const T,
+            second: []const T,
+            frames: usize,
+        };
+
+        samples: []align(audio_buffer.buffer_alignment) T,
+        n_channels: usize,
+        capacity_frames: usize,
+        mask: usize,
+        allocator: std.mem.Allocator,
+        notify: Notify,
+        event_fd: ?i32 = null,
+
+        /// Next frame to read, in frames since init. Written by the consumer only.
+        head: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+        /// Next frame to write, in frames since init. Written by the producer only.
+        tail: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+
+        // bumped on every commit when notifying, the consumer futex waits on it
+        wake_seq: std.atomic.Value(u32) align(std.atomic.cache_line) = std.atomic.Value(u32).init(0),
+        consumer_waiting: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+
+        pub fn init(allocator: std.mem.Allocator, opts: AudioRingOptions) AudioRingError!Self {
+            if (opts.capacity_frames == 0 or opts.n_channels == 0) return AudioRingError.invalid_capacity;
+
+            const capacity_frames = std.math.ceilPowerOfTwo(usize, opts.capacity_frames) catch {
+                return AudioRingError.invalid_capacity;
+            };
+
+            const samples = try allocator.alignedAlloc(T, audio_buffer.buffer_alignment, capacity_frames * opts.n_channels);
+            errdefer allocator.free(samples);
+
+            @memset(samples, 0);
+
+            var self = Self{
+                .samples = samples,
+                .n_channels = opts.n_channels,
+                .capacity_frames = capacity_frames,
+                .mask = capacity_frames - 1,
+                .allocator = allocator,
+                .notify = opts.notify,
+            };
+
+            if (opts.notify == .eventfd) {
+                const rc = linux.eventfd(0, linux.EFD.NONBLOCK | linux.EFD.CLOEXEC);
+                if (linux.E.init(rc) != .SUCCESS) return AudioRingError.eventfd_failed;
+
+                self.event_fd = @intCast(rc);
+            }
+
+            return self;
+        }
+
+        /// Producer side. Frames that can be written without overwriting unread frames.
+        pub fn writeAvailable(self: *Self) usize {
+            return self.capacity_frames - (self.tail.load(.monotonic) -% self.head.load(.acquire));
+        }
+
+        /// Consumer side. Frames ready to be read.
+        pub fn readAvailable(self: *Self) usize {
+            return self.tail.load(.acquire) -% self.head.load(.monotonic);
+        }
+
+        /// Producer side. Ring memory for up to `n_frames` frames, fewer when the ring is nearly full.
+        /// Nothing is visible to the consumer until `commitWrite`.
+        pub fn writeRegions(self: *Self, n_frames: usize) Regions {
+            const tail = self.tail.load(.monotonic);
+            const frames = @min(n_frames, self.writeAvailable());
+
+            return self.regionsAt(tail, frames);
+        }
+
+        /// Producer side. Publishes `n_frames` frames written through `writeRegions`.
+        pub fn commitWrite(self: *Self, n_frames: usize) void {
+            std.debug.assert(n_frames <= self.writeAvailable());
+
+            self.tail.store(self.tail.load(.monotonic) +% n_frames, .release);
+
+            if (self.notify != .none) self.wakeConsumer();
+        }
+
+        /// Consumer side. Up to `n_frames` readable frames, the memory stays valid until `commitRead`.
+        pub fn readRegions(self: *Self, n_frames: usize) ConstRegions {
+            const head = self.head.load(.monotonic);
+            const frames = @min(n_frames, self.readAvailable());
+            const regions = self.regionsAt(head, frames);
+
+            return .{ .first = regions.first, .second = regions.second, .frames = frames };
+        }
+
+        /// Consumer side. Releases `n_frames` frames back to the producer.
+        pub fn commitRead(self: *Self, n_frames: usize) void {
+            std.debug.assert(n_frames <= self.readAvailable());
+
+            self.head.store(self.head.load(.monotonic) +% n_frames, .release);
+        }
+
+        /// Producer side. Copies interleaved frames, returns the number of frames written.
+        pub fn write(self: *Self, interleaved: []const T) usize {
+            const regions = self.writeRegions(interleaved.len / self.n_channels);
+            const split = regions.first.len;
+
+            @memcpy(regions.first, interleaved[0..split]);
+            @memcpy(regions.second, interleaved[split..][0..regions.second.len]);
+
+            self.commitWrite(regions.frames);
+            return regions.frames;
+        }
+
+        /// Producer side. Copies a block from the graph, any access pattern. Returns the number of frames written.
+        pub fn writeView(self: *Self, view: audio_buffer.UnmanagedChannelView(T)) usize {
+            std.debug.assert(view.n_channels == self.n_channels);
+
+            const regions = self.writeRegions(view.block_size);
+            const first_frames = regions.first.len / self.n_channels;
+
+            for (0..regions.frames) |at_frame| {
+                const slice = if (at_frame < first_frames) regions.first else regions.second;
+                const offset = (if (at_frame < first_frames) at_frame else at_frame - first_frames) * self.n_channels;
+
+                for (0..self.n_channels) |ch| slice[offset + ch] = view.readSample(ch, at_frame);
+            }
+
+            self.commitWrite(regions.frames);
+            return regions.frames;
+        }
+
+        /// Consumer side. Copies up to `interleaved.len / n_channels` frames out, returns the number of frames read.
+        pub fn read(self: *Self, interleaved: []T) usize {
+            const regions = self.readRegions(interleaved.len / self.n_channels);
+            const split = regions.first.len;
+
+            @memcpy(interleaved[0..split], regions.first);
+            @memcpy(interleaved[split..][0..regions.second.len], regions.second);
+
+            self.commitRead(regions.frames);
+            return regions.frames;
+        }
+
+        /// Consumer side. Blocks until at least `min_frames` are readable or `timeout_ns` elapses.
+        /// Returns the readable frames. Requires `.futex` or `.eventfd` notification.
+        pub fn wait(self: *Self, min_frames: usize, timeout_ns: u64) usize {
+            std.debug.assert(self.notify != .none);
+
+            self.consumer_waiting.store(true, .seq_cst);
+            defer self.consumer_waiting.store(false, .monotonic);
+
+            var timer = std.time.Timer.start() catch unreachable;
+
+            while (true) {
+                const seq = self.wake_seq.load(.seq_cst);
+
+                const available = self.readAvailable();
+                if (available >= min_frames) return available;
+
+                const elapsed = timer.read();
+                if (elapsed >= timeout_ns) return available;
+
+                // returns early when a commit bumps the sequence
+                std.Thread.Futex.timedWait(&self.wake_seq, seq, timeout_ns - elapsed) catch {};
+            }
+        }
+
+        /// Readable with poll/epoll after a commit. Only with `.eventfd` notification.
+        pub fn eventFd(self: Self) ?i32 {
+            return self.event_fd;
+        }
+
+        /// Consumer side. Resets the eventfd counter once woken up by poll.
+        pub fn clearEvent(self: *Self) void {
+            const fd = self.event_fd orelse return;
+            var count: u64 = 0;
+
+            _ = std.posix.read(fd, std.mem.asBytes(&count)) catch {};
+        }
+
+        fn wakeConsumer(self: *Self) void {
+            _ = self.wake_seq.fetchAdd(1, .seq_cst);
+
+            // no syscall unless the consumer sleeps, see wait
+            if (self.consumer_waiting.load(.seq_cst)) std.Thread.Futex.wake(&self.wake_seq, 1);
+
+            if (self.event_fd) |fd| {
+                const one: u64 = 1;
+                // non blocking, a full counter already signals the consumer
+                _ = std.posix.write(fd, std.mem.asBytes(&one)) catch {};
+            }
+        }
+
+        fn regionsAt(self: *Self, position: usize, frames: usize) Regions {
+            const start = position & self.mask;
+            const first_frames = @min(frames, self.capacity_frames - start);
+
+            return .{
+                .first = self.samples[start * self.n_channels ..][0 .. first_frames * self.n_channels],
+                .second = self.samples[0 .. (frames - first_frames) * self.n_channels],
+                .frames = frames,
+            };
+        }
+
+        pub fn deinit(self: *Self) void {
+            if (self.event_fd) |fd| std.posix.close(fd);
+            self.allocator.free(self.samples);
+        }
+    };
+}
+
+const expectEqual = std.testing.expectEqual;
+
+test "AudioRing - wrapping regions and bulk copies" {
+    var ring = try AudioRing(f32).init(std.testing.allocator, .{ .n_channels = 2, .capacity_frames = 3 });
+    defer ring.deinit();
+
+    try expectEqual(4, ring.capacity_frames);
+
+    try expectEqual(3, ring.write(&.{ 1, 1, 2, 2, 3, 3 }));
+
+    var out: [4]f32 = undefined;
+    try expectEqual(2, ring.read(&out));
+    try std.testing.expectEqualSlices(f32, &.{ 1, 1, 2, 2 }, &out);
+
+    // 3 frames fit, the range wraps after one frame
+    const regions = ring.writeRegions(5);
+    try expectEqual(3, regions.frames);
+    try expectEqual(2, regions.first.len);
+    try expectEqual(4, regions.second.len);
+
+    @memcpy(regions.first, &[_]f32{ 4, 4 });
+    @memcpy(regions.second, &[_]f32{ 5, 5, 6, 6 });
+    ring.commitWrite(regions.frames);
+
+    var all: [8]f32 = undefined;
+    try expectEqual(4, ring.read(&all));
+    try std.testing.expectEqualSlices(f32, &.{ 3, 3, 4, 4, 5, 5, 6, 6 }, &all);
+}
+
+test "AudioRing - consumer wakes up on commit" {
+    const n_blocks = 200;
+    const block = 16;
+
+    var ring = try AudioRing(f32).init(std.testing.allocator, .{ .n_channels = 1, .capacity_frames = 64, .notify = .futex });
+    defer ring.deinit();
+
+    const producer = try std.Thread.spawn(.{}, struct {
+        fn run(r: *AudioRing(f32)) void {
+            var data: [block]f32 = undefined;
+            var sent: usize = 0;
+
+            while (sent < n_blocks * block) {
+                for (&data, 0..) |*sample, i| sample.* = @floatFromInt(sent + i);
+
+                const written = r.write(data[0..@min(block, r.writeAvailable())]);
+                if (written == 0) std.Thread.yield() catch {};
+
+                sent += written;
+            }
+        }
+    }.run, .{&ring});
+
+    var expected: usize = 0;
+    var out: [block]f32 = undefined;
+
+    while (expected < n_blocks * block) {
+        _ = ring.wait(1, std.time.ns_per_s);
+
+        const n = ring.read(&out);
+        for (out[0..n]) |sample| {
+            try expectEqual(@as(f32, @floatFromInt(expected)), sample);
+            expected += 1;
+        }
+    }
+
+    producer.join();
+}
@@ -0,0 +1,284 @@
+const std = @import("std");
+const telemetry = @import("telemetry.zig");
+
+const log = std.log.scoped(.metrics);
+
+pub const ExporterError = error{
+    too_many_sources,
+    path_too_long,
+    already_running,
+} || std.net.Address.ListenError || std.Thread.SpawnError;
+
+/// Serves a text snapshot of every registered `LoopTelemetry` on a Unix domain socket, e.g.
+///
+///     socat - UNIX-CONNECT:/run/user/1000/delia.sock
+///
+/// Each connection gets one snapshot in the Prometheus text format and is closed. The exporter runs on its own
+/// thread and only loads atomics, the audio threads are never touched, locked or woken up.
+/// Fixed capacity, nothing is allocated after `start`.
+pub const Exporter = struct {
+    pub const max_sources = 16;
+    const snapshot_bytes = 16 * 1024;
+    // how often the serving thread checks `stop`
+    const poll_ms = 200;
+
+    const Source = struct {
+        name: []const u8,
+        telemetry: *const telemetry.LoopTelemetry,
+        // exporter thread only, the DSP load is measured between two requests
+        last_busy_ns: u64 = 0,
+        last_ns: u64 = 0,
+    };
+
+    sources: [max_sources]Source = undefined,
+    n_sources: usize = 0,
+    server: ?std.net.Server = null,
+    thread: ?std.Thread = null,
+    path: []const u8 = "",
+    running: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+
+    /// Before `start`. `name` labels the metrics and must outlive the exporter.
+    pub fn register(self: *Exporter, name: []const u8, loop_telemetry: *const telemetry.LoopTelemetry) ExporterError!void {
+        if (self.running.load(.acquire)) return ExporterError.already_running;
+        if (self.n_sources == max_sources) return ExporterError.too_many_sources;
+
+        self.sources[self.n_sources] = .{
+            .name = name,
+            .telemetry = loop_telemetry,
+            .last_busy_ns = loop_telemetry.busy_ns.load(.monotonic),
+            .last_ns = telemetry.monotonicNs(),
+        };
+        self.n_sources += 1;
+    }
+
+    /// Binds `path`, replacing a stale socket file, and serves it on a new thread. `path` must outlive the exporter.
+    pub fn start(self: *Exporter, path: []const u8) ExporterError!void {
+        if (self.running.load(.acquire)) return ExporterError.already_running;
+
+        const address = std.net.Address.initUnix(path) catch return ExporterError.path_too_long;
+        std.fs.cwd().deleteFile(path) catch {};
+
+        self.server = try address.listen(.{});
+        errdefer self.closeServer();
+
+        self.path = path;
+        self.running.store(true, .release);
+        errdefer self.running.store(false, .release);
+
+        self.thread = try std.Thread.spawn(.{}, serve, .{self});
+    }
+
+    /// Stops serving and removes the socket file.
+    pub fn stop(self: *Exporter) void {
+        if (!self.running.swap(false, .acq_rel)) return;
+
+        if (self.thread) |thread| thread.join();
+        self.thread = null;
+
+        self.closeServer();
+    }
+
+    /// The text served to each connection. Also usable without a socket, e.g. to log it.
+    /// Every family has its `# HELP` and `# TYPE` lines followed by the samples of each device.
+    pub fn writeSnapshot(self: *Exporter, writer: anytype) !void {
+        const now = telemetry.monotonicNs();
+        const sources = self.sources[0..self.n_sources];
+
+        var snapshots: [max_sources]telemetry.LoopTelemetry.Snapshot = undefined;
+        var loads: [max_sources]f64 = undefined;
+
+        for (sources, snapshots[0..sources.len], loads[0..sources.len]) |*source, *s, *load| {
+            s.* = source.telemetry.snapshot();
+
+            // busy time over wall time since the previous request
+            const elapsed = now -| source.last_ns;
+            load.* = if (elapsed == 0) 0.0 else @as(f64, @floatFromInt(s.busy_ns -| source.last_busy_ns)) / @as(f64, @floatFromInt(elapsed));
+
+            source.last_busy_ns = s.busy_ns;
+            source.last_ns = now;
+        }
+
+        const health_counters = .{
+            .{ "delia_xruns_total", "xruns", "Buffer overruns and underruns." },
+            .{ "delia_suspends_total", "suspends", "Suspends of the stream, e.g. on system sleep." },
+            .{ "delia_short_transfers_total", "short_transfers", "Transfers that moved fewer frames than requested." },
+            .{ "delia_recoveries_total", "recoveries", "Xruns and suspends the stream came back from." },
+            .{ "delia_failed_recoveries_total", "failed_recoveries", "Xruns and suspends the stream did not come back from." },
+        };
+
+        inline for (health_counters) |counter| {
+            try writeHeader(writer, counter[0], "counter", counter[2]);
+
+            for (sources, snapshots[0..sources.len]) |source, s| {
+                try writer.print("{s}{{device=\"{s}\"}} {d}\n", .{ counter[0], source.name, @field(s.health, counter[1]) });
+            }
+        }
+
+        try writeHeader(writer, "delia_last_xrun_age_seconds", "gauge", "Time since the last xrun, absent before the first.");
+        for (sources, snapshots[0..sources.len]) |source, s| try writeAge(writer, "delia_last_xrun_age_seconds", source.name, now, s.health.last_xrun_ns);
+
+        try writeHeader(writer, "delia_last_suspend_age_seconds", "gauge", "Time since the last suspend, absent before the first.");
+        for (sources, snapshots[0..sources.len]) |source, s| try writeAge(writer, "delia_last_suspend_age_seconds", source.name, now, s.health.last_suspend_ns);
+
+        try writeHeader(writer, "delia_missed_deadlines_total", "counter", "Callbacks that returned after the end of their cycle.");
+        for (sources, snapshots[0..sources.len]) |source, s| {
+            try writer.print("delia_missed_deadlines_total{{device=\"{s}\"}} {d}\n", .{ source.name, s.missed_deadlines });
+        }
+
+        try writeHeader(writer, "delia_dsp_load", "gauge", "Time spent in the callback over wall time since the previous request.");
+        for (sources, loads[0..sources.len]) |source, load| {
+            try writer.print("delia_dsp_load{{device=\"{s}\"}} {d:.4}\n", .{ source.name, load });
+        }
+
+        try writeHeader(writer, "delia_latency_seconds", "gauge", "Hardware buffering plus processing latency.");
+        for (sources, snapshots[0..sources.len]) |source, s| {
+            try writer.print("delia_latency_seconds{{device=\"{s}\"}} {d:.6}\n", .{ source.name, seconds(s.latency_ns) });
+        }
+
+        try writeHeader(writer, "delia_wakeup_delay_seconds", "summary", "From the period boundary to the callback.");
+        for (sources, snapshots[0..sources.len]) |source, s| try writeSummary(writer, "delia_wakeup_delay_seconds", source.name, s.wakeup_delay);
+
+        try writeHeader(writer, "delia_callback_seconds", "summary", "Time spent in the callback.");
+        for (sources, snapshots[0..sources.len]) |source, s| try writeSummary(writer, "delia_callback_seconds", source.name, s.callback_duration);
+
+        try writeHeader(writer, "delia_deadline_slack_seconds", "summary", "Time left before the cycle deadline when the callback returns.");
+        for (sources, snapshots[0..sources.len]) |source, s| try writeSummary(writer, "delia_deadline_slack_seconds", source.name, s.deadline_slack);
+    }
+
+    fn serve(self: *Exporter) void {
+        const server = if (self.server) |*s| s else return;
+        var fds = [_]std.posix.pollfd{.{ .fd = server.stream.handle, .events = std.posix.POLL.IN, .revents = 0 }};
+
+        while (self.running.load(.acquire)) {
+            const ready = std.posix.poll(&fds, poll_ms) catch |err| {
+                log.err("Metrics exporter stopped: {s}", .{@errorName(err)});
+                return;
+            };
+
+            if (ready == 0) continue;
+
+            const connection = server.accept() catch |err| {
+                log.warn("Failed to accept a metrics connection: {s}", .{@errorName(err)});
+                continue;
+            };
+            defer connection.stream.close();
+
+            var buffer: [snapshot_bytes]u8 = undefined;
+            var stream = std.io.fixedBufferStream(&buffer);
+
+            self.writeSnapshot(stream.writer()) catch log.warn("Metrics snapshot truncated to {d} bytes", .{snapshot_bytes});
+
+            connection.stream.writeAll(stream.getWritten()) catch |err| {
+                log.warn("Failed to send metrics: {s}", .{@errorName(err)});
+            };
+        }
+    }
+
+    fn closeServer(self: *Exporter) void {
+        if (self.server) |*server| server.deinit();
+        self.server = null;
+
+        if (self.path.len > 0) std.fs.cwd().deleteFile(self.path) catch {};
+    }
+
+    fn writeHeader(writer: anytype, metric: []const u8, kind: []const u8, help: []const u8) !void {
+        try writer.print("# HELP {s} {s}\n# TYPE {s} {s}\n", .{ metric, help, metric, kind });
+    }
+
+    fn writeAge(writer: anytype, metric: []const u8, name: []const u8, now: u64, at: u64) !void {
+        // no event yet
+        if (at == 0) return;
+
+        try writer.print("{s}{{device=\"{s}\"}} {d:.3}\n", .{ metric, name, seconds(now -| at) });
+    }
+
+    fn writeSummary(writer: anytype, metric: []const u8, name: []const u8, s: telemetry.Histogram.Snapshot) !void {
+        try writer.print("{s}{{device=\"{s}\",quantile=\"0.5\"}} {d:.6}\n", .{ metric, name, seconds(s.p50) });
+        try writer.print("{s}{{device=\"{s}\",quantile=\"0.99\"}} {d:.6}\n", .{ metric, name, seconds(s.p99) });
+        try writer.print("{s}{{device=\"{s}\",quantile=\"0.999\"}} {d:.6}\n", .{ metric, name, seconds(s.p999) });
+        try writer.print("{s}{{device=\"{s}\",quantile=\"1\"}} {d:.6}\n", .{ metric, name, seconds(s.max) });
+        try writer.print("{s}_count{{device=\"{s}\"}} {d}\n", .{ metric, name, s.count });
+    }
+
+    fn seconds(ns: u64) f64 {
+        return @as(f64, @floatFromInt(ns)) / std.time.ns_per_s;
+    }
+};
+
+test "Exporter serves the counters over a Unix socket" {
+    var loop_telemetry = telemetry.LoopTelemetry{};
+    loop_telemetry.health.xrun();
+    loop_telemetry.health.recovered(true);
+    loop_telemetry.callback_duration.record(250 * std.time.ns_per_us);
+
+    var exporter = Exporter{};
+    try exporter.register("playback", &loop_telemetry);
+
+    var path_buffer: [64]u8 = undefined;
+    const path = try std.fmt.bufPrint(&path_buffer, "/tmp/delia-metrics-{d}.sock", .{std.os.linux.getpid()});
+
+    try exporter.start(path);
+    defer exporter.stop();
+
+    const stream = try std.net.connectUnixSocket(path);
+    defer stream.close();
+
+    var response: [Exporter.snapshot_bytes]u8 = undefined;
+    var len: usize = 0;
+
+    while (true) {
+        const n = try stream.read(response[len..]);
+        if (n == 0) break;
+        len += n;
+    }
+
+    const text = response[0..len];
+
+    try std.testing.expect(std.mem.indexOf(u8, text, "delia_xruns_total{device=\"playback\"} 1\n") != null);
+    try std.testing.expect(std.mem.indexOf(u8, text, "delia_recoveries_total{device=\"playback\"} 1\n") != null);
+    try std.testing.expect(std.mem.indexOf(u8, text, "delia_callback_seconds_count{device=\"playback\"} 1\n") != null);
+}
+
+test "Exporter - every family is described once, ahead of its samples" {
+    var playback = telemetry.LoopTelemetry{};
+    var capture = telemetry.LoopTelemetry{};
+    capture.health.suspended();
+
+    var exporter = Exporter{};
+    try exporter.register("playback", &playback);
+    try exporter.register("capture", &capture);
+
+    var buffer: [Exporter.snapshot_bytes]u8 = undefined;
+    var stream = std.io.fixedBufferStream(&buffer);
+    try exporter.writeSnapshot(stream.writer());
+
+    const text = stream.getWritten();
+
+    try std.testing.expect(std.mem.indexOf(u8, text, "# TYPE delia_suspends_total counter\n") != null);
+    try std.testing.expect(std.mem.indexOf(u8, text, "# TYPE delia_missed_deadlines_total counter\n") != null);
+    try std.testing.expect(std.mem.indexOf(u8, text, "# TYPE delia_dsp_load gauge\n") != null);
+    try std.testing.expect(std.mem.indexOf(u8, text, "# TYPE delia_deadline_slack_seconds summary\n") != null);
+
+    // one header per family, the samples of both devices follow it
+    try std.testing.expectEqual(1, std.mem.count(u8, text, "# HELP delia_suspends_total "));
+
+    const header = std.mem.indexOf(u8, text, "# TYPE delia_suspends_total counter\n").?;
+    const playback_sample = std.mem.indexOf(u8, text, "delia_suspends_total{device=\"playback\"} 0\n").?;
+    const capture_sample = std.mem.indexOf(u8, text, "delia_suspends_total{device=\"capture\"} 1\n").?;
+    const next_header = std.mem.indexOf(u8, text, "# HELP delia_short_transfers_total ").?;
+
+    try std.testing.expect(header < playback_sample and playback_sample < capture_sample and capture_sample < next_header);
+
+    // every sample line belongs to a described family
+    var lines = std.mem.tokenizeScalar(u8, text, '\n');
+    while (lines.next()) |line| {
+        if (line[0] == '#') continue;
+
+        const name = line[0..std.mem.indexOfScalar(u8, line, '{').?];
+        const family = if (std.mem.endsWith(u8, name, "_count")) name[0 .. name.len - "_count".len] else name;
+        var type_line: [128]u8 = undefined;
+
+        const needle = try std.fmt.bufPrint(&type_line, "# TYPE {s} ", .{family});
+        try std.testing.expect(std.mem.indexOf(u8, text, needle) != null);
+    }
+}
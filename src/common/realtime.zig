@@ -0,0 +1,328 @@
+const std = @import("std");
+const builtin = @import("builtin");
+
+const linux = std.os.linux;
+const log = std.log.scoped(.realtime);
+
+pub const RealtimeError = error{
+    invalid_priority,
+    invalid_cpu,
+    permission_denied,
+    unsupported,
+    unexpected,
+};
+
+/// Scheduling and memory setup of the thread running an audio loop.
+/// Every step is optional and a failing step only logs a warning, e.g. SCHED_FIFO without root or rtprio limits.
+pub const RealtimeOptions = struct {
+    /// SCHED_FIFO priority, 1 to 99. Null keeps the default scheduling policy.
+    priority: ?u8 = null,
+    /// CPUs the thread may run on. Null keeps the inherited affinity.
+    cpus: ?[]const usize = null,
+    /// `mlockall` current and future pages, so the loop never waits on a page fault.
+    lock_memory: bool = false,
+    /// Stack touched up front, on top of locked memory pages are only faulted in on first use.
+    prefault_stack_bytes: usize = 0,
+    /// Flush denormals to zero (FTZ/DAZ on x86, FZ on arm) while the loop runs.
+    flush_denormals: bool = true,
+    /// Touches the memory of the callback once memory is locked, the backends only prefault their own transfer
+    /// buffers. E.g. `PrefaultHook.of(&scheduler)` for the graph buffers, see `Scheduler.prefault`.
+    prefault: ?PrefaultHook = null,
+
+    /// Type erased `prefault` method of the object owning the memory the callback works on.
+    pub const PrefaultHook = struct {
+        context: *anyopaque,
+        touch: *const fn (context: *anyopaque) void,
+
+        /// Calls `ptr.prefault()`, `ptr` must outlive the audio loop.
+        pub fn of(ptr: anytype) PrefaultHook {
+            const Ptr = @TypeOf(ptr);
+
+            const erased = struct {
+                fn touch(context: *anyopaque) void {
+                    const self: Ptr = @ptrCast(@alignCast(context));
+                    self.prefault();
+                }
+            };
+
+            return .{ .context = ptr, .touch = erased.touch };
+        }
+    };
+};
+
+/// What `apply` managed to set up.
+pub const Applied = struct {
+    fifo: bool = false,
+    affinity: bool = false,
+    memory_locked: bool = false,
+    denormals: DenormalGuard = .{},
+
+    /// Restores the floating point state, scheduling and memory locks are left as is.
+    pub fn restore(self: Applied) void {
+        self.denormals.restore();
+    }
+};
+
+// largest affinity set handled, in CPUs
+const max_cpus = @bitSizeOf(linux.cpu_set_t);
+
+const MCL_CURRENT = 1;
+const MCL_FUTURE = 2;
+
+// not wrapped by std, libc is always linked
+extern "c" fn mlockall(flags: c_int) c_int;
+extern "c" fn munlockall() c_int;
+
+// stack touched per frame by `prefaultStack`
+const stack_chunk = 16 * 1024;
+
+/// Applies `opts` to the calling thread, degrading to whatever is permitted.
+pub fn apply(opts: RealtimeOptions) Applied {
+    var applied = Applied{};
+
+    if (opts.lock_memory) {
+        if (lockMemory()) {
+            applied.memory_locked = true;
+        } else |err| log.warn("Could not lock memory: {s}. Page faults may cause xruns", .{@errorName(err)});
+    }
+
+    if (opts.prefault) |hook| hook.touch(hook.context);
+    if (opts.prefault_stack_bytes > 0) prefaultStack(opts.prefault_stack_bytes);
+
+    if (opts.cpus) |cpus| {
+        if (setAffinity(cpus)) {
+            applied.affinity = true;
+        } else |err| log.warn("Could not set the CPU affinity: {s}", .{@errorName(err)});
+    }
+
+    if (opts.priority) |priority| {
+        if (setFifoPriority(priority)) {
+            applied.fifo = true;
+        } else |err| log.warn("Could not set SCHED_FIFO priority {d}: {s}. Running with the default policy", .{ priority, @errorName(err) });
+    }
+
+    if (opts.flush_denormals) applied.denormals = DenormalGuard.enable();
+
+    return applied;
+}
+
+/// SCHED_FIFO for the calling thread. Needs CAP_SYS_NICE or an rtprio limit.
+pub fn setFifoPriority(priority: u8) RealtimeError!void {
+    if (priority < 1 or priority > 99) return RealtimeError.invalid_priority;
+
+    const param = linux.sched_param{ .priority = priority };
+    return check(linux.E.init(linux.sched_setscheduler(0, .{ .mode = .FIFO }, &param)));
+}
+
+/// Back to the default time sharing policy.
+pub fn setDefaultPolicy() RealtimeError!void {
+    const param = linux.sched_param{ .priority = 0 };
+    return check(linux.E.init(linux.sched_setscheduler(0, .{ .mode = .OTHER }, &param)));
+}
+
+/// Pins the calling thread to `cpus`.
+pub fn setAffinity(cpus: []const usize) RealtimeError!void {
+    const bits = @bitSizeOf(usize);
+    var mask = std.mem.zeroes(linux.cpu_set_t);
+
+    for (cpus) |cpu| {
+        if (cpu >= max_cpus) return RealtimeError.invalid_cpu;
+        mask[cpu / bits] |= @as(usize, 1) << @intCast(cpu % bits);
+    }
+
+    linux.sched_setaffinity(0, &mask) catch return RealtimeError.unexpected;
+}
+
+/// Locks current and future pages in RAM. Needs CAP_IPC_LOCK or a large enough memlock limit.
+pub fn lockMemory() RealtimeError!void {
+    return check(std.posix.errno(mlockall(MCL_CURRENT | MCL_FUTURE)));
+}
+
+/// Releases the locks of `lockMemory`.
+pub fn unlockMemory() void {
+    _ = munlockall();
+}
+
+/// Touches every page of `memory` so the first access from the loop does not fault.
+pub fn prefault(memory: []u8) void {
+    const page = std.mem.page_size;
+    var at: usize = 0;
+
+    while (at < memory.len) : (at += page) {
+        const byte: *volatile u8 = &memory[at];
+        byte.* = byte.*;
+    }
+}
+
+/// Grows the stack by `bytes` up front.
+pub fn prefaultStack(bytes: usize) void {
+    if (bytes > 0) _ = touchStack(bytes);
+}
+
+// one frame of `stack_chunk` per call, each below the previous one until `bytes` are covered. Returns the lowest
+// address touched.
+noinline fn touchStack(bytes: usize) usize {
+    var buffer: [stack_chunk]u8 = undefined;
+    const volatile_buffer: *volatile [stack_chunk]u8 = &buffer;
+
+    // top down, every page lands next to one already mapped
+    var at: usize = stack_chunk;
+    while (at > 0) {
+        at -|= std.mem.page_size;
+        volatile_buffer[at] = 0;
+    }
+
+    const lowest = if (bytes > stack_chunk) touchStack(bytes - stack_chunk) else @intFromPtr(volatile_buffer);
+
+    // read after the call, so this frame stays allocated while the deeper ones are touched
+    _ = volatile_buffer[0];
+    return @min(lowest, @intFromPtr(volatile_buffer));
+}
+
+/// Floating point control state with denormals flushed to zero, restored by `restore`.
+/// Denormals show up in decaying filters and reverb tails and cost up to a hundred times a normal operation on x86.
+pub const DenormalGuard = struct {
+    saved: ?usize = null,
+
+    const x86_ftz = 1 << 15;
+    const x86_daz = 1 << 6;
+    const arm_fz = 1 << 24;
+
+    pub fn enable() DenormalGuard {
+        switch (builtin.cpu.arch) {
+            .x86_64 => {
+                const csr = readMxcsr();
+                writeMxcsr(csr | x86_ftz | x86_daz);
+                return .{ .saved = csr };
+            },
+            .aarch64 => {
+                const fpcr = readFpcr();
+                writeFpcr(fpcr | arm_fz);
+                return .{ .saved = fpcr };
+            },
+            else => return .{},
+        }
+    }
+
+    pub fn restore(self: DenormalGuard) void {
+        const saved = self.saved orelse return;
+
+        switch (builtin.cpu.arch) {
+            .x86_64 => writeMxcsr(@intCast(saved)),
+            .aarch64 => writeFpcr(saved),
+            else => {},
+        }
+    }
+
+    fn readMxcsr() u32 {
+        var csr: u32 = 0;
+        asm volatile ("stmxcsr (%[csr])"
+            :
+            : [csr] "r" (&csr),
+            : "memory"
+        );
+        return csr;
+    }
+
+    fn writeMxcsr(csr: u32) void {
+        asm volatile ("ldmxcsr (%[csr])"
+            :
+            : [csr] "r" (&csr),
+            : "memory"
+        );
+    }
+
+    fn readFpcr() usize {
+        return asm volatile ("mrs %[fpcr], fpcr"
+            : [fpcr] "=r" (-> usize),
+        );
+    }
+
+    fn writeFpcr(fpcr: usize) void {
+        asm volatile ("msr fpcr, %[fpcr]"
+            :
+            : [fpcr] "r" (fpcr),
+        );
+    }
+};
+
+fn check(err: linux.E) RealtimeError!void {
+    return switch (err) {
+        .SUCCESS => {},
+        .PERM, .ACCES => RealtimeError.permission_denied,
+        .NOMEM, .AGAIN => RealtimeError.permission_denied,
+        .NOSYS => RealtimeError.unsupported,
+        else => RealtimeError.unexpected,
+    };
+}
+
+test "DenormalGuard flushes denormals and restores the previous state" {
+    if (builtin.cpu.arch != .x86_64 and builtin.cpu.arch != .aarch64) return error.SkipZigTest;
+
+    var tiny: f32 = std.math.floatMin(f32);
+    var flushed: f32 = 1;
+    var kept: f32 = 0;
+
+    // volatile accesses keep the divisions at run time, on each side of the guard
+    const volatile_tiny: *volatile f32 = &tiny;
+    const volatile_flushed: *volatile f32 = &flushed;
+    const volatile_kept: *volatile f32 = &kept;
+
+    const guard = DenormalGuard.enable();
+    volatile_flushed.* = volatile_tiny.* / 4.0;
+    guard.restore();
+
+    volatile_kept.* = volatile_tiny.* / 4.0;
+
+    try std.testing.expectEqual(0.0, flushed);
+    try std.testing.expect(kept > 0.0);
+}
+
+test "apply degrades gracefully" {
+    try std.testing.expectError(RealtimeError.invalid_priority, setFifoPriority(0));
+    try std.testing.expectError(RealtimeError.invalid_cpu, setAffinity(&.{max_cpus}));
+
+    // may or may not be permitted where the tests run, either way nothing fails
+    const applied = apply(.{ .priority = 10, .lock_memory = true, .prefault_stack_bytes = 64 * 1024 });
+    defer applied.restore();
+
+    // the test runner should not stay locked nor real-time
+    defer if (applied.fifo) setDefaultPolicy() catch {};
+
+    if (applied.memory_locked) {
+        unlockMemory();
+    } else {
+        // reported as not locked because locking really fails here
+        if (lockMemory()) |_| {
+            unlockMemory();
+            return error.TestUnexpectedResult;
+        } else |_| {}
+    }
+}
+
+test "prefaultStack covers the requested depth" {
+    var top: u8 = 0;
+    const volatile_top: *volatile u8 = &top;
+
+    const bytes = 256 * 1024;
+    const lowest = touchStack(bytes);
+
+    try std.testing.expect(@intFromPtr(volatile_top) - lowest >= bytes);
+}
+
+test "apply runs the prefault hook" {
+    const Memory = struct {
+        touched: usize = 0,
+
+        pub fn prefault(self: *@This()) void {
+            self.touched += 1;
+        }
+    };
+
+    var memory = Memory{};
+
+    const applied = apply(.{ .prefault = RealtimeOptions.PrefaultHook.of(&memory), .flush_denormals = false });
+    defer applied.restore();
+
+    try std.testing.expectEqual(1, memory.touched);
+}
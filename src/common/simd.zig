@@ -0,0 +1,87 @@
+const std = @import("std");
+
+// Contiguous block kernels shared by the buffer views and the graph nodes.
+// Loops run on native width vectors with a scalar tail.
+
+pub fn vectorLength(comptime T: type) comptime_int {
+    return std.simd.suggestVectorLength(T) orelse 4;
+}
+
+// whether `ptr` can be read as a run of `V`, i.e. it starts on a vector boundary
+inline fn isVectorAligned(comptime V: type, ptr: anytype) bool {
+    return std.mem.isAligned(@intFromPtr(ptr), @alignOf(V));
+}
+
+/// dst[i] *= factor
+/// Uses aligned vector loads when `dst` starts on a vector boundary, e.g. channels of `UniformChannelViews`.
+pub fn scale(comptime T: type, dst: []T, factor: T) void {
+    const len = vectorLength(T);
+    const V = @Vector(len, T);
+
+    const factor_vec: V = @splat(factor);
+    var i: usize = 0;
+
+    if (isVectorAligned(V, dst.ptr)) {
+        const vectors: [*]V = @ptrCast(@alignCast(dst.ptr));
+
+        for (vectors[0 .. dst.len / len]) |*vector| vector.* *= factor_vec;
+        i = dst.len / len * len;
+    }
+
+    while (i + len <= dst.len) : (i += len) {
+        const chunk: V = dst[i..][0..len].*;
+        dst[i..][0..len].* = chunk * factor_vec;
+    }
+
+    while (i < dst.len) : (i += 1) dst[i] *= factor;
+}
+
+/// dst[i] += src[i]
+/// Uses aligned vector loads when both slices start on a vector boundary.
+pub fn add(comptime T: type, dst: []T, src: []const T) void {
+    std.debug.assert(dst.len == src.len);
+
+    const len = vectorLength(T);
+    const V = @Vector(len, T);
+
+    var i: usize = 0;
+
+    if (isVectorAligned(V, dst.ptr) and isVectorAligned(V, src.ptr)) {
+        const dst_vectors: [*]V = @ptrCast(@alignCast(dst.ptr));
+        const src_vectors: [*]const V = @ptrCast(@alignCast(src.ptr));
+        const n_vectors = dst.len / len;
+
+        for (dst_vectors[0..n_vectors], src_vectors[0..n_vectors]) |*a, b| a.* += b;
+        i = n_vectors * len;
+    }
+
+    while (i + len <= dst.len) : (i += len) {
+        const a: V = dst[i..][0..len].*;
+        const b: V = src[i..][0..len].*;
+        dst[i..][0..len].* = a + b;
+    }
+
+    while (i < dst.len) : (i += 1) dst[i] += src[i];
+}
+
+test "simd: scale and add handle the scalar tail" {
+    var dst = [_]f32{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+    const src = [_]f32{1} ** 11;
+
+    scale(f32, &dst, 2);
+    add(f32, &dst, &src);
+
+    try std.testing.expectEqualSlices(f32, &.{ 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23 }, &dst);
+}
+
+test "simd: aligned and unaligned slices give the same result" {
+    var data: [33]f64 align(64) = undefined;
+    for (&data, 0..) |*sample, i| sample.* = @floatFromInt(i);
+
+    // starts one sample past the vector boundary
+    scale(f64, data[1..], 2);
+    scale(f64, data[0..32], 0.5);
+
+    for (data[1..32], 1..) |sample, i| try std.testing.expectEqual(@as(f64, @floatFromInt(i)), sample);
+    try std.testing.expectEqual(64, data[32]);
+}
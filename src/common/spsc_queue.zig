@@ -0,0 +1,138 @@
+const std = @import("std");
+
+pub const SpscQueueError = error{
+    invalid_capacity,
+} || std.mem.Allocator.Error;
+
+/// Wait-free single-producer/single-consumer queue with a fixed capacity.
+/// Memory is allocated once in `init`; `push`, `peek` and `pop` never allocate, lock or block.
+/// Exactly one thread may push and exactly one (other) thread may peek/pop.
+pub fn SpscQueue(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        items: []T,
+        mask: usize,
+        allocator: std.mem.Allocator,
+
+        /// Next slot to read. Written by the consumer only.
+        head: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+        /// Next slot to write. Written by the producer only.
+        tail: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+
+        /// Capacity is rounded up to the next power of two.
+        pub fn init(allocator: std.mem.Allocator, capacity: usize) SpscQueueError!Self {
+            if (capacity == 0) return SpscQueueError.invalid_capacity;
+
+            const actual_capacity = std.math.ceilPowerOfTwo(usize, capacity) catch {
+                return SpscQueueError.invalid_capacity;
+            };
+
+            return .{
+                .items = try allocator.alloc(T, actual_capacity),
+                .mask = actual_capacity - 1,
+                .allocator = allocator,
+            };
+        }
+
+        /// Producer side. Returns false when the queue is full.
+        pub fn push(self: *Self, item: T) bool {
+            const tail = self.tail.load(.monotonic);
+            const head = self.head.load(.acquire);
+
+            if (tail -% head == self.items.len) return false;
+
+            self.items[tail & self.mask] = item;
+            self.tail.store(tail +% 1, .release);
+
+            return true;
+        }
+
+        /// Consumer side. Returns the oldest item without removing it.
+        pub fn peek(self: *Self) ?T {
+            const head = self.head.load(.monotonic);
+            if (head == self.tail.load(.acquire)) return null;
+
+            return self.items[head & self.mask];
+        }
+
+        /// Consumer side. Removes and returns the oldest item.
+        pub fn pop(self: *Self) ?T {
+            const head = self.head.load(.monotonic);
+            if (head == self.tail.load(.acquire)) return null;
+
+            const item = self.items[head & self.mask];
+            self.head.store(head +% 1, .release);
+
+            return item;
+        }
+
+        /// Approximate when called concurrently with push/pop.
+        pub fn len(self: *Self) usize {
+            return self.tail.load(.acquire) -% self.head.load(.acquire);
+        }
+
+        pub fn capacity(self: Self) usize {
+            return self.items.len;
+        }
+
+        pub fn deinit(self: *Self) void {
+            self.allocator.free(self.items);
+        }
+    };
+}
+
+const expectEqual = std.testing.expectEqual;
+
+test "SpscQueue - push and pop preserve order" {
+    var queue = try SpscQueue(u32).init(std.testing.allocator, 3);
+    defer queue.deinit();
+
+    // rounded up to a power of two
+    try expectEqual(4, queue.capacity());
+
+    try std.testing.expect(queue.push(1));
+    try std.testing.expect(queue.push(2));
+    try std.testing.expect(queue.push(3));
+    try std.testing.expect(queue.push(4));
+    try std.testing.expect(!queue.push(5));
+
+    try expectEqual(1, queue.peek().?);
+    try expectEqual(1, queue.pop().?);
+    try expectEqual(2, queue.pop().?);
+
+    // wraps around
+    try std.testing.expect(queue.push(5));
+    try std.testing.expect(queue.push(6));
+
+    try expectEqual(3, queue.pop().?);
+    try expectEqual(4, queue.pop().?);
+    try expectEqual(5, queue.pop().?);
+    try expectEqual(6, queue.pop().?);
+    try expectEqual(null, queue.pop());
+}
+
+test "SpscQueue - concurrent producer and consumer" {
+    const n_items = 10_000;
+    var queue = try SpscQueue(usize).init(std.testing.allocator, 64);
+    defer queue.deinit();
+
+    const producer = try std.Thread.spawn(.{}, struct {
+        fn run(q: *SpscQueue(usize)) void {
+            var i: usize = 0;
+            while (i < n_items) {
+                if (q.push(i)) i += 1 else std.Thread.yield() catch {};
+            }
+        }
+    }.run, .{&queue});
+
+    var expected: usize = 0;
+
+    while (expected < n_items) {
+        const item = queue.pop() orelse continue;
+        try expectEqual(expected, item);
+        expected += 1;
+    }
+
+    producer.join();
+}
@@ -0,0 +1,383 @@
+const std = @import("std");
+
+/// Log-linear histogram of nanosecond durations, HDR style: 16 linear sub-buckets per power of two,
+/// so every recorded value is reported within 1/16 (~6%) of its true value, from 1ns up to 2^41ns (~36 minutes).
+///
+/// Fixed size, never allocates. Written by one thread (the audio loop) and read by any other through `snapshot`,
+/// the counters are atomics so a reader never blocks or slows down the writer.
+pub const Histogram = struct {
+    const sub_bits = 4;
+    const sub_count = 1 << sub_bits;
+    const max_exponent = 40;
+
+    pub const n_buckets = sub_count + (max_exponent - sub_bits + 1) * sub_count;
+
+    const Counter = std.atomic.Value(u64);
+
+    counts: [n_buckets]Counter = [_]Counter{Counter.init(0)} ** n_buckets,
+    total: Counter = Counter.init(0),
+    max: Counter = Counter.init(0),
+
+    pub const Snapshot = struct {
+        count: u64 = 0,
+        p50: u64 = 0,
+        p99: u64 = 0,
+        p999: u64 = 0,
+        max: u64 = 0,
+    };
+
+    /// Writer side.
+    pub fn record(self: *Histogram, value: u64) void {
+        // single writer, a plain load and store avoids the locked read-modify-write
+        const counter = &self.counts[bucketIndex(value)];
+        counter.store(counter.load(.monotonic) + 1, .monotonic);
+
+        self.total.store(self.total.load(.monotonic) + 1, .release);
+
+        if (value > self.max.load(.monotonic)) self.max.store(value, .monotonic);
+    }
+
+    /// Reader side, any thread. Percentiles are bucket upper bounds, capped by the max.
+    pub fn snapshot(self: *const Histogram) Snapshot {
+        var counts: [n_buckets]u64 = undefined;
+        var count: u64 = 0;
+
+        _ = self.total.load(.acquire);
+
+        for (&counts, &self.counts) |*dst, *src| {
+            dst.* = src.load(.monotonic);
+            count += dst.*;
+        }
+
+        const max = self.max.load(.monotonic);
+
+        return .{
+            .count = count,
+            .p50 = @min(percentile(&counts, count, 0.5), max),
+            .p99 = @min(percentile(&counts, count, 0.99), max),
+            .p999 = @min(percentile(&counts, count, 0.999), max),
+            .max = max,
+        };
+    }
+
+    /// Writer side, or while nothing records.
+    pub fn reset(self: *Histogram) void {
+        for (&self.counts) |*counter| counter.store(0, .monotonic);
+
+        self.total.store(0, .release);
+        self.max.store(0, .monotonic);
+    }
+
+    fn percentile(counts: []const u64, count: u64, q: f64) u64 {
+        if (count == 0) return 0;
+
+        const rank: u64 = @max(1, @as(u64, @intFromFloat(@ceil(q * @as(f64, @floatFromInt(count))))));
+        var seen: u64 = 0;
+
+        for (counts, 0..) |n, i| {
+            seen += n;
+            if (seen >= rank) return bucketUpper(i);
+        }
+
+        return bucketUpper(counts.len - 1);
+    }
+
+    fn bucketIndex(value: u64) usize {
+        if (value < sub_count) return @intCast(value);
+
+        const exponent: u64 = 63 - @clz(value);
+        if (exponent > max_exponent) return n_buckets - 1;
+
+        const shift: u6 = @intCast(exponent - sub_bits);
+        const mantissa = (value >> shift) & (sub_count - 1);
+
+        return @intCast(sub_count + (exponent - sub_bits) * sub_count + mantissa);
+    }
+
+    // largest value falling into `index`
+    fn bucketUpper(index: usize) u64 {
+        if (index < sub_count) return index;
+
+        const i = index - sub_count;
+        const shift: u6 = @intCast(i / sub_count);
+        const lower = @as(u64, sub_count + i % sub_count) << shift;
+
+        return lower + (@as(u64, 1) << shift) - 1;
+    }
+};
+
+/// Per device health, bumped by the audio loop with plain atomic stores (one writer, no locked instructions)
+/// and readable from any thread, e.g. by `metrics.Exporter`. Devices always count their own, the
+/// `LoopTelemetry.health` they were given mirrors it, see `mirroring`.
+pub const HealthCounters = struct {
+    const Counter = std.atomic.Value(u64);
+
+    xruns: Counter = Counter.init(0),
+    suspends: Counter = Counter.init(0),
+    /// Transfers that moved fewer frames than requested.
+    short_transfers: Counter = Counter.init(0),
+    /// Xruns and suspends the stream came back from.
+    recoveries: Counter = Counter.init(0),
+    failed_recoveries: Counter = Counter.init(0),
+    /// `monotonicNs` time of the last event, 0 when none happened.
+    last_xrun_ns: Counter = Counter.init(0),
+    last_suspend_ns: Counter = Counter.init(0),
+    /// Bumped along with these counters.
+    mirror: ?*HealthCounters = null,
+
+    pub const Snapshot = struct {
+        xruns: u64,
+        suspends: u64,
+        short_transfers: u64,
+        recoveries: u64,
+        failed_recoveries: u64,
+        last_xrun_ns: u64,
+        last_suspend_ns: u64,
+    };
+
+    /// Counters of a device, mirrored to the health of its telemetry when it has one.
+    pub fn mirroring(loop_telemetry: ?*LoopTelemetry) HealthCounters {
+        return .{ .mirror = if (loop_telemetry) |t| &t.health else null };
+    }
+
+    pub fn xrun(self: *HealthCounters) void {
+        bump(&self.xruns);
+        self.last_xrun_ns.store(monotonicNs(), .monotonic);
+        if (self.mirror) |m| m.xrun();
+    }
+
+    pub fn suspended(self: *HealthCounters) void {
+        bump(&self.suspends);
+        self.last_suspend_ns.store(monotonicNs(), .monotonic);
+        if (self.mirror) |m| m.suspended();
+    }
+
+    pub fn shortTransfer(self: *HealthCounters) void {
+        bump(&self.short_transfers);
+        if (self.mirror) |m| m.shortTransfer();
+    }
+
+    pub fn recovered(self: *HealthCounters, ok: bool) void {
+        bump(if (ok) &self.recoveries else &self.failed_recoveries);
+        if (self.mirror) |m| m.recovered(ok);
+    }
+
+    pub fn snapshot(self: *const HealthCounters) Snapshot {
+        return .{
+            .xruns = self.xruns.load(.monotonic),
+            .suspends = self.suspends.load(.monotonic),
+            .short_transfers = self.short_transfers.load(.monotonic),
+            .recoveries = self.recoveries.load(.monotonic),
+            .failed_recoveries = self.failed_recoveries.load(.monotonic),
+            .last_xrun_ns = self.last_xrun_ns.load(.monotonic),
+            .last_suspend_ns = self.last_suspend_ns.load(.monotonic),
+        };
+    }
+
+    fn bump(counter: *Counter) void {
+        counter.store(counter.load(.monotonic) + 1, .monotonic);
+    }
+};
+
+/// Continuous timing of an audio loop, one per loop thread.
+/// Unlike `latency.Probe` averages, the histograms keep the tail, so xruns can be matched with load spikes.
+///
+///     loop thread:    telemetry.wake(period_start); telemetry.callbackStart(); callback(); telemetry.callbackEnd();
+///     any thread:     const s = telemetry.snapshot(); log.info("{}", .{s});
+pub const LoopTelemetry = struct {
+    /// From the period boundary (or the wakeup when the backend has no timestamp) to the callback.
+    wakeup_delay: Histogram = .{},
+    /// Time spent in the callback.
+    callback_duration: Histogram = .{},
+    /// Time left before the cycle deadline when the callback returns. Missed deadlines record 0.
+    deadline_slack: Histogram = .{},
+    missed_deadlines: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    /// Total time spent in the callback, the DSP load over an interval is its increase divided by the interval.
+    busy_ns: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    /// Hardware buffering plus processing latency of the device, set by the loop.
+    latency_ns: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    health: HealthCounters = .{},
+
+    // loop thread only
+    period_ns: u64 = 0,
+    woke_at: u64 = 0,
+    deadline: u64 = 0,
+    callback_start: u64 = 0,
+    pending_wake: bool = false,
+
+    pub const Snapshot = struct {
+        wakeup_delay: Histogram.Snapshot,
+        callback_duration: Histogram.Snapshot,
+        deadline_slack: Histogram.Snapshot,
+        missed_deadlines: u64,
+        busy_ns: u64,
+        latency_ns: u64,
+        health: HealthCounters.Snapshot,
+
+        pub fn format(self: Snapshot, comptime fmt: []const u8, options: std.fmt.FormatOptions, writer: anytype) !void {
+            _ = fmt;
+            _ = options;
+
+            const cycles = @max(self.wakeup_delay.count, self.callback_duration.count);
+            try writer.print("\nLoop Telemetry ({d} cycles, {d} missed deadlines)\n", .{ cycles, self.missed_deadlines });
+            try writeRow(writer, "Wakeup Delay:   ", self.wakeup_delay);
+            try writeRow(writer, "Callback:       ", self.callback_duration);
+            try writeRow(writer, "Deadline Slack: ", self.deadline_slack);
+            try writer.print("  Xruns {d}  Suspends {d}  Short Transfers {d}  Recoveries {d} ({d} failed)\n", .{
+                self.health.xruns,
+                self.health.suspends,
+                self.health.short_transfers,
+                self.health.recoveries,
+                self.health.failed_recoveries,
+            });
+        }
+
+        fn writeRow(writer: anytype, name: []const u8, s: Histogram.Snapshot) !void {
+            try writer.print("  {s} p50 {d}us  p99 {d}us  p99.9 {d}us  max {d}us\n", .{
+                name,
+                s.p50 / std.time.ns_per_us,
+                s.p99 / std.time.ns_per_us,
+                s.p999 / std.time.ns_per_us,
+                s.max / std.time.ns_per_us,
+            });
+        }
+    };
+
+    /// The deadline of a cycle, one period after its start.
+    pub fn setPeriod(self: *LoopTelemetry, frames: usize, sample_rate: u32) void {
+        self.period_ns = @intCast(@as(u128, frames) * std.time.ns_per_s / sample_rate);
+    }
+
+    pub fn setLatency(self: *LoopTelemetry, frames: usize, sample_rate: u32) void {
+        self.latency_ns.store(@intCast(@as(u128, frames) * std.time.ns_per_s / sample_rate), .monotonic);
+    }
+
+    /// A new cycle started at `at_ns` (`monotonicNs` clock).
+    pub fn wake(self: *LoopTelemetry, at_ns: u64) void {
+        self.woke_at = at_ns;
+        self.deadline = at_ns + self.period_ns;
+        self.pending_wake = true;
+    }
+
+    pub fn callbackStart(self: *LoopTelemetry) void {
+        self.callback_start = monotonicNs();
+        self.recordWakeup(self.callback_start);
+    }
+
+    /// The loop thread runs at `at_ns` for the cycle of the last `wake`. Only needed by backends that do not time a
+    /// callback of their own, e.g. JACK where the processing happens in the other clients of the graph.
+    pub fn recordWakeup(self: *LoopTelemetry, at_ns: u64) void {
+        // only the first callback of a cycle, the next ones waited for the previous callbacks
+        if (!self.pending_wake) return;
+
+        self.wakeup_delay.record(at_ns -| self.woke_at);
+        self.pending_wake = false;
+    }
+
+    pub fn callbackEnd(self: *LoopTelemetry) void {
+        const now = monotonicNs();
+
+        self.callback_duration.record(now -| self.callback_start);
+        self.busy_ns.store(self.busy_ns.load(.monotonic) + (now -| self.callback_start), .monotonic);
+
+        if (self.period_ns == 0 or self.deadline == 0) return;
+
+        if (now > self.deadline) {
+            self.missed_deadlines.store(self.missed_deadlines.load(.monotonic) + 1, .monotonic);
+        }
+
+        self.deadline_slack.record(self.deadline -| now);
+    }
+
+    /// Any thread.
+    pub fn snapshot(self: *const LoopTelemetry) Snapshot {
+        return .{
+            .wakeup_delay = self.wakeup_delay.snapshot(),
+            .callback_duration = self.callback_duration.snapshot(),
+            .deadline_slack = self.deadline_slack.snapshot(),
+            .missed_deadlines = self.missed_deadlines.load(.monotonic),
+            .busy_ns = self.busy_ns.load(.monotonic),
+            .latency_ns = self.latency_ns.load(.monotonic),
+            .health = self.health.snapshot(),
+        };
+    }
+};
+
+/// CLOCK_MONOTONIC in nanoseconds, the clock of ALSA monotonic timestamps.
+/// Goes through the vDSO, no syscall.
+pub fn monotonicNs() u64 {
+    var ts: std.posix.timespec = undefined;
+    // CLOCK_MONOTONIC is always there on linux
+    std.posix.clock_gettime(std.posix.CLOCK.MONOTONIC, &ts) catch unreachable;
+
+    return @as(u64, @intCast(ts.tv_sec)) * std.time.ns_per_s + @as(u64, @intCast(ts.tv_nsec));
+}
+
+const expectEqual = std.testing.expectEqual;
+
+test "Histogram - buckets stay within 1/16 of the value" {
+    var value: u64 = 1;
+
+    while (value < 1 << 40) : (value = value * 3 / 2 + 1) {
+        const upper = Histogram.bucketUpper(Histogram.bucketIndex(value));
+
+        try std.testing.expect(upper >= value);
+        try std.testing.expect(upper - value <= value / 16);
+    }
+
+    try expectEqual(Histogram.n_buckets - 1, Histogram.bucketIndex(std.math.maxInt(u64)));
+}
+
+test "Histogram - percentiles and max" {
+    var histogram = Histogram{};
+
+    for (1..1001) |us| histogram.record(us * std.time.ns_per_us);
+
+    const s = histogram.snapshot();
+
+    try expectEqual(1000, s.count);
+    try expectEqual(1000 * std.time.ns_per_us, s.max);
+
+    try std.testing.expectApproxEqRel(@as(f64, 500 * std.time.ns_per_us), @as(f64, @floatFromInt(s.p50)), 1.0 / 16.0);
+    try std.testing.expectApproxEqRel(@as(f64, 990 * std.time.ns_per_us), @as(f64, @floatFromInt(s.p99)), 1.0 / 16.0);
+
+    histogram.reset();
+    try expectEqual(0, histogram.snapshot().count);
+}
+
+test "LoopTelemetry - one wakeup per cycle, callbacks timed on their own" {
+    var t = LoopTelemetry{};
+
+    t.wake(monotonicNs());
+    t.recordWakeup(monotonicNs());
+    t.callbackStart();
+    t.callbackEnd();
+
+    const s = t.snapshot();
+
+    try expectEqual(1, s.wakeup_delay.count);
+    try expectEqual(1, s.callback_duration.count);
+    try std.testing.expect(monotonicNs() >= t.woke_at);
+}
+
+test "HealthCounters - counted without telemetry, mirrored to it when there is one" {
+    var alone = HealthCounters.mirroring(null);
+    alone.xrun();
+    alone.recovered(true);
+
+    try expectEqual(1, alone.snapshot().xruns);
+    try expectEqual(1, alone.snapshot().recoveries);
+
+    var t = LoopTelemetry{};
+    var health = HealthCounters.mirroring(&t);
+    health.suspended();
+    health.shortTransfer();
+    health.recovered(false);
+
+    const mirrored = t.health.snapshot();
+
+    try expectEqual(health.snapshot().suspends, mirrored.suspends);
+    try expectEqual(1, mirrored.short_transfers);
+    try expectEqual(1, mirrored.failed_recoveries);
+    try std.testing.expect(mirrored.last_suspend_ns > 0);
+}
@@ -4,3 +4,4 @@ pub const utils = @import("utils.zig");
 pub const analysis = @import("analysis.zig");
 pub const complex_matrix = @import("complex_matrix.zig");
 pub const complex_list = @import("complex_list.zig");
+pub const resampler = @import("resampler.zig");
@@ -0,0 +1,274 @@
+const std = @import("std");
+const waves = @import("waves.zig");
+
+/// Streaming variable ratio resampler for interleaved frames, meant for ratios close to 1 such as clock drift
+/// compensation: the anti aliasing cutoff is fixed relative to the input rate.
+/// Windowed sinc (Kaiser) with `taps` taps, evaluated on a table of `phases` fractional positions with linear
+/// interpolation between two phases, so the ratio can change on every call without clicks.
+/// Everything is allocated by `init`, `process` never allocates.
+pub fn Resampler(comptime T: type) type {
+    if (T != f32 and T != f64) {
+        @compileError("Resampler operates on f32 or f64");
+    }
+
+    return struct {
+        const Self = @This();
+
+        const half_taps = 32;
+        const taps = 2 * half_taps;
+        const phases = 256;
+        // fraction of the input nyquist frequency kept, and the kaiser window shape, around 80dB stop band
+        const cutoff = 0.9;
+        const beta = 8.0;
+
+        /// Ratios are clamped to this range, output frames per input frame.
+        pub const min_ratio = 0.5;
+        pub const max_ratio = 2.0;
+
+        /// Input frames buffered before the first output frame.
+        pub const latency_frames = half_taps;
+
+        pub const Options = struct {
+            channels: usize,
+            /// Largest `output.len` in frames passed to `process`.
+            max_block_frames: usize,
+        };
+
+        pub const Result = struct {
+            /// Input frames taken, always all of them when the input comes from `inputFramesFor`.
+            consumed: usize,
+            produced: usize,
+        };
+
+        allocator: std.mem.Allocator,
+        channels: usize,
+        // (phases + 1) rows of taps, the last row is the first one shifted by one frame
+        table: []T,
+        // interleaved input frames still needed, starting with `half_taps` frames of silence
+        history: []T,
+        capacity: usize,
+        len: usize,
+        // read position in `history`, in frames
+        pos: f64,
+
+        pub fn init(allocator: std.mem.Allocator, opts: Options) !Self {
+            const table = try allocator.alloc(T, (phases + 1) * taps);
+            errdefer allocator.free(table);
+
+            // a block at the lowest ratio, plus the filter span
+            const capacity = @as(usize, @intFromFloat(@ceil(@as(f64, @floatFromInt(opts.max_block_frames)) / min_ratio))) + taps + 1;
+            const history = try allocator.alloc(T, capacity * opts.channels);
+
+            fillTable(table);
+
+            var self = Self{
+                .allocator = allocator,
+                .channels = opts.channels,
+                .table = table,
+                .history = history,
+                .capacity = capacity,
+                .len = 0,
+                .pos = 0,
+            };
+
+            self.reset();
+            return self;
+        }
+
+        pub fn deinit(self: *Self) void {
+            self.allocator.free(self.table);
+            self.allocator.free(self.history);
+        }
+
+        /// Drops the buffered input, the next output starts from silence.
+        pub fn reset(self: *Self) void {
+            @memset(self.history[0 .. half_taps * self.channels], 0);
+            self.len = half_taps;
+            self.pos = half_taps;
+        }
+
+        /// Input frames `process` needs to produce exactly `out_frames` frames at `ratio`.
+        pub fn inputFramesFor(self: Self, out_frames: usize, ratio: f64) usize {
+            if (out_frames == 0) return 0;
+
+            const last = self.pos + @as(f64, @floatFromInt(out_frames - 1)) * step(ratio);
+            const needed = @as(usize, @intFromFloat(@floor(last))) + half_taps + 1;
+
+            return needed -| self.len;
+        }
+
+        /// Input frames buffered and not yet consumed, fractional part included. Part of the latency.
+        pub fn bufferedFrames(self: Self) f64 {
+            return @as(f64, @floatFromInt(self.len)) - self.pos;
+        }
+
+        /// Takes the input that fits in the history and writes output frames until the input runs out or `output` is
+        /// full. `ratio` is output over input frames, e.g. 1.0001 stretches the input by 100ppm.
+        pub fn process(self: *Self, input: []const T, output: []T, ratio: f64) Result {
+            std.debug.assert(input.len % self.channels == 0);
+            std.debug.assert(output.len % self.channels == 0);
+
+            const channels = self.channels;
+            const consumed = @min(input.len / channels, self.capacity - self.len);
+
+            @memcpy(self.history[self.len * channels ..][0 .. consumed * channels], input[0 .. consumed * channels]);
+            self.len += consumed;
+
+            const inc = step(ratio);
+            const start = self.pos;
+            const out_frames = output.len / channels;
+            var produced: usize = 0;
+
+            // positions are computed from the start, the same way as `inputFramesFor`
+            while (produced < out_frames) : (produced += 1) {
+                const p = start + @as(f64, @floatFromInt(produced)) * inc;
+                const base = @floor(p);
+                const frame: usize = @intFromFloat(base);
+
+                if (frame + half_taps >= self.len) break;
+
+                self.interpolate(frame, p - base, output[produced * channels ..][0..channels]);
+            }
+
+            self.pos = start + @as(f64, @floatFromInt(produced)) * inc;
+            self.discard();
+
+            return .{ .consumed = consumed, .produced = produced };
+        }
+
+        // one output frame at `frame + frac`, from the input frames `frame - half_taps + 1 .. frame + half_taps`
+        fn interpolate(self: *Self, frame: usize, frac: f64, out: []T) void {
+            const phase_pos = frac * phases;
+            const phase: usize = @intFromFloat(@floor(phase_pos));
+            const t: T = @floatCast(phase_pos - @floor(phase_pos));
+
+            const row_a = self.table[phase * taps ..][0..taps];
+            const row_b = self.table[(phase + 1) * taps ..][0..taps];
+
+            var coefficients: [taps]T = undefined;
+            for (&coefficients, row_a, row_b) |*c, a, b| c.* = a + (b - a) * t;
+
+            const first = frame + 1 - half_taps;
+
+            for (out, 0..) |*sample, ch| {
+                var acc: T = 0;
+
+                for (coefficients, 0..) |c, k| acc += c * self.history[(first + k) * self.channels + ch];
+                sample.* = acc;
+            }
+        }
+
+        // shifts out the frames before the filter span of the next output
+        fn discard(self: *Self) void {
+            const first = @as(usize, @intFromFloat(@floor(self.pos))) + 1 -| half_taps;
+            if (first == 0) return;
+
+            const drop = @min(first, self.len);
+            std.mem.copyForwards(T, self.history[0 .. (self.len - drop) * self.channels], self.history[drop * self.channels .. self.len * self.channels]);
+
+            self.len -= drop;
+            self.pos -= @floatFromInt(drop);
+        }
+
+        fn step(ratio: f64) f64 {
+            return 1.0 / std.math.clamp(ratio, min_ratio, max_ratio);
+        }
+
+        fn fillTable(table: []T) void {
+            for (0..phases + 1) |phase| {
+                const row = table[phase * taps ..][0..taps];
+                const frac = @as(f64, @floatFromInt(phase)) / phases;
+
+                var sum: f64 = 0;
+                var values: [taps]f64 = undefined;
+
+                for (&values, 0..) |*v, k| {
+                    // distance from the output position to the input frame k
+                    const x = frac + @as(f64, half_taps - 1) - @as(f64, @floatFromInt(k));
+                    v.* = kernel(x);
+                    sum += v.*;
+                }
+
+                // unity gain at DC for every phase
+                for (row, values) |*c, v| c.* = @floatCast(v / sum);
+            }
+        }
+
+        fn kernel(x: f64) f64 {
+            const u = x / half_taps;
+            if (@abs(u) >= 1) return 0;
+
+            const window = besselI0(beta * @sqrt(1 - u * u)) / besselI0(beta);
+            return cutoff * sinc(cutoff * x) * window;
+        }
+
+        fn sinc(x: f64) f64 {
+            if (x == 0) return 1;
+            return @sin(std.math.pi * x) / (std.math.pi * x);
+        }
+
+        // power series of the modified Bessel function of the first kind, order zero
+        fn besselI0(x: f64) f64 {
+            var sum: f64 = 1;
+            var term: f64 = 1;
+            var k: f64 = 1;
+
+            while (term > sum * 1e-12) : (k += 1) {
+                const half_x = x / (2 * k);
+                term *= half_x * half_x;
+                sum += term;
+            }
+
+            return sum;
+        }
+    };
+}
+
+test "Resampler: a ratio of 1 passes a sine through" {
+    const R = Resampler(f32);
+    var resampler = try R.init(std.testing.allocator, .{ .channels = 1, .max_block_frames = 4800 });
+    defer resampler.deinit();
+
+    var sine = waves.Wave(f32).init(1000, 0.5, 48_000);
+    var input: [4800]f32 = undefined;
+    _ = sine.sine(&input);
+
+    var output: [4800]f32 = undefined;
+    const result = resampler.process(&input, &output, 1);
+
+    try std.testing.expectEqual(4800, result.consumed);
+    try std.testing.expectEqual(4800 - R.latency_frames, result.produced);
+
+    // output frame k sits on input frame k, skip the start up from silence
+    for (R.latency_frames * 2..result.produced) |k| {
+        try std.testing.expectApproxEqAbs(input[k], output[k], 1e-3);
+    }
+}
+
+test "Resampler: inputFramesFor yields exact blocks at any ratio" {
+    const R = Resampler(f64);
+    var resampler = try R.init(std.testing.allocator, .{ .channels = 2, .max_block_frames = 256 });
+    defer resampler.deinit();
+
+    var input: [2 * 1024]f64 = undefined;
+    for (&input, 0..) |*s, i| s.* = @floatFromInt(i % 7);
+
+    var output: [2 * 256]f64 = undefined;
+    var total_in: usize = 0;
+
+    for (0..2000) |i| {
+        const ratio: f64 = if (i % 2 == 0) 0.999 else 1.0013;
+        const needed = resampler.inputFramesFor(256, ratio);
+
+        const result = resampler.process(input[0 .. needed * 2], &output, ratio);
+
+        try std.testing.expectEqual(needed, result.consumed);
+        try std.testing.expectEqual(256, result.produced);
+
+        total_in += needed;
+    }
+
+    // the input covered by the output, give or take the frames still buffered
+    const expected_in = 1000.0 * 256.0 / 0.999 + 1000.0 * 256.0 / 1.0013;
+    try std.testing.expectApproxEqAbs(expected_in, @as(f64, @floatFromInt(total_in)), R.latency_frames + 2);
+}
@@ -27,6 +27,12 @@ pub fn Wave(comptime T: type) type {
             self.inc = two * std.math.pi * self.freq / sr;
         }
 
+        // phase is kept so frequency changes are click free
+        pub inline fn setFrequency(self: *Self, freq: T) void {
+            self.freq = freq;
+            self.inc = two * std.math.pi * freq / self.sr;
+        }
+
         pub fn bufferSizeFor(self: Self, seconds: T) usize {
             return @intFromFloat(self.sr * seconds);
         }
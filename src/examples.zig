@@ -40,6 +40,8 @@ pub const Example = struct {
             .stream_type = .playback,
             .buffer_size = .buf_512,
             .ident = "hw:3,0",
+            // degrades to the default scheduling without rtprio/memlock limits
+            .realtime = .{ .priority = 80, .lock_memory = true, .prefault_stack_bytes = 256 * 1024 },
         });
 
         return Example{
@@ -63,6 +65,12 @@ pub const Example = struct {
             .access_pattern = .interleaved,
         });
 
+        // lets the device report the graph latency along with the hardware latency
+        self.device.setProcessingLatency(self.scheduler.latency());
+
+        // the graph buffers are touched on the audio thread along with the device buffers
+        if (self.device.realtime_options) |*opts| opts.prefault = alsa.driver.RealtimeOptions.PrefaultHook.of(&self.scheduler);
+
         try self.device.prepare();
     }
 
@@ -74,6 +82,22 @@ pub const Example = struct {
         const iterations = @divFloor(buffer_size, process_block_size);
 
         for (iterations) |_| {
+            // float devices matching the graph layout are rendered in place, no copy or conversion.
+            // Non interleaved devices map onto non interleaved graphs the same way
+            if (data.nativeView(process_block_size)) |view| {
+                if (ctx.scheduler.processGraphIntoView(view)) {
+                    data.advance(process_block_size * data.channels) catch unreachable;
+                    continue;
+                } else |err| switch (err) {
+                    // layout differs from the device, fall back to copying
+                    error.invalid_buffer_length => {},
+                    else => {
+                        log.err("Failed to process data: {!}", .{err});
+                        return;
+                    },
+                }
+            }
+
             ctx.scheduler.processGraph() catch |err| {
                 log.err("Failed to process data: {!}", .{err});
                 return;
@@ -85,7 +109,8 @@ pub const Example = struct {
                 return;
             };
 
-            data.write(audio_buffer.buffer) catch |err| {
+            // converts the layout too when the device and the graph differ
+            data.writeView(audio_buffer) catch |err| {
                 log.err("Failed to write data: {!}", .{err});
                 return;
             };
@@ -0,0 +1,103 @@
+const std = @import("std");
+const audio_buffer = @import("../common/audio_buffer.zig");
+
+/// Fixed multichannel delay used by the scheduler to compensate latency between parallel branches.
+/// Memory is allocated once at prepare, `process` never allocates.
+pub fn DelayLine(comptime T: type) type {
+    if (T != f32 and T != f64) {
+        @compileError("DelayLine only supports f32 and f64");
+    }
+
+    return struct {
+        const Self = @This();
+        const View = audio_buffer.UnmanagedChannelView(T);
+
+        // channel major, each channel holds `delay` frames
+        buffer: []T,
+        n_channels: usize,
+        delay: usize,
+        position: usize = 0,
+        allocator: std.mem.Allocator,
+
+        pub fn init(allocator: std.mem.Allocator, n_channels: usize, delay: usize) !Self {
+            std.debug.assert(delay > 0);
+
+            const buffer = try allocator.alloc(T, n_channels * delay);
+            @memset(buffer, 0);
+
+            return .{
+                .buffer = buffer,
+                .n_channels = n_channels,
+                .delay = delay,
+                .allocator = allocator,
+            };
+        }
+
+        /// Writes `src` delayed by `delay` frames into `dst`, adding to its contents when `accumulate` is set.
+        /// `src` and `dst` may be the same view.
+        pub fn process(self: *Self, src: View, dst: View, accumulate: bool) void {
+            for (0..src.block_size) |frame| {
+                for (0..self.n_channels) |ch| {
+                    const slot = ch * self.delay + self.position;
+                    const delayed = self.buffer[slot];
+
+                    self.buffer[slot] = src.readSample(ch, frame);
+
+                    const out = if (accumulate) dst.readSample(ch, frame) + delayed else delayed;
+                    dst.writeSample(ch, frame, out);
+                }
+
+                self.position += 1;
+                if (self.position == self.delay) self.position = 0;
+            }
+        }
+
+        /// Same as `process` with a silent input, flushes the delayed samples into `dst`.
+        pub fn processSilence(self: *Self, dst: View, accumulate: bool) void {
+            for (0..dst.block_size) |frame| {
+                for (0..self.n_channels) |ch| {
+                    const slot = ch * self.delay + self.position;
+                    const delayed = self.buffer[slot];
+
+                    self.buffer[slot] = 0;
+
+                    const out = if (accumulate) dst.readSample(ch, frame) + delayed else delayed;
+                    dst.writeSample(ch, frame, out);
+                }
+
+                self.position += 1;
+                if (self.position == self.delay) self.position = 0;
+            }
+        }
+
+        pub fn reset(self: *Self) void {
+            @memset(self.buffer, 0);
+            self.position = 0;
+        }
+
+        pub fn deinit(self: *Self) void {
+            self.allocator.free(self.buffer);
+        }
+    };
+}
+
+test "DelayLine: delays in place and accumulates" {
+    const allocator = std.testing.allocator;
+
+    var line = try DelayLine(f64).init(allocator, 1, 3);
+    defer line.deinit();
+
+    var data = [_]f64{ 1, 2, 3, 4 };
+    const view = try audio_buffer.UnmanagedChannelView(f64).init(&data, .{
+        .n_channels = 1,
+        .block_size = .blk_4,
+        .access = .interleaved,
+    });
+
+    line.process(view, view, false);
+    try std.testing.expectEqualSlices(f64, &.{ 0, 0, 0, 1 }, &data);
+
+    data = .{ 10, 10, 10, 10 };
+    line.process(view, view, true);
+    try std.testing.expectEqualSlices(f64, &.{ 12, 13, 14, 20 }, &data);
+}
@@ -2,6 +2,9 @@ const std = @import("std");
 const bitmap = @import("bitmap.zig");
 pub const nodes = @import("nodes/nodes.zig");
 pub const scheduler = @import("scheduler.zig");
+pub const delay_line = @import("delay_line.zig");
+pub const offline = @import("offline.zig");
+pub const subgraph = @import("subgraph.zig");
 
 /// Audio processing graph containing nodes, edges, and graph processing logic.
 /// Designed to manage the execution order of nodes based on their dependencies.
@@ -28,6 +31,9 @@ pub fn Graph(comptime T: type) type {
         /// Graph configuration options, such as static buffer size limits.
         options: GraphOptions,
 
+        /// Single block holding the state of every node in processing order. Built at prepare.
+        node_arena: ?[]align(std.atomic.cache_line) u8 = null,
+
         /// Configuration options for graph initialization.
         pub const GraphOptions = struct {
             comptime max_static_size: usize = 1024,
@@ -42,10 +48,13 @@ pub fn Graph(comptime T: type) type {
         const Edges = struct {
             from: usize,
             to: usize,
+            /// Feedback edges are left out of the processing order, `to` reads the output of `from`
+            /// from the previous block. They may close cycles.
+            feedback: bool = false,
         };
 
         /// Handle to a graph node, enabling operations like connecting nodes.
-        const NodeHandle = struct {
+        pub const NodeHandle = struct {
             index: usize,
             graph: *Self,
 
@@ -54,6 +63,11 @@ pub fn Graph(comptime T: type) type {
             pub fn connect(self: NodeHandle, to: NodeHandle) !void {
                 try self.graph.connect(self, to);
             }
+
+            /// Connects the output of the current node to `to` one block later, see `Graph.connectFeedback`.
+            pub fn connectFeedback(self: NodeHandle, to: NodeHandle) !void {
+                try self.graph.connectFeedback(self, to);
+            }
         };
 
         pub fn init(allocator: std.mem.Allocator, opts: GraphOptions) Self {
@@ -70,6 +84,10 @@ pub fn Graph(comptime T: type) type {
                 node.destroy();
             }
 
+            if (self.node_arena) |arena| {
+                self.allocator.free(arena);
+            }
+
             self.nodes.deinit();
             self.edges.deinit();
         }
@@ -80,6 +98,13 @@ pub fn Graph(comptime T: type) type {
             try self.edges.append(.{ .from = from.index, .to = to.index });
         }
 
+        /// Creates a feedback connection, allowed to close a cycle (e.g. feedback delay networks).
+        /// The `to` node receives the output `from` produced in the previous block,
+        /// so every feedback loop has an implied delay of one block, see `Scheduler.setFeedbackBlockSize`.
+        pub fn connectFeedback(self: *Self, from: NodeHandle, to: NodeHandle) !void {
+            try self.edges.append(.{ .from = from.index, .to = to.index, .feedback = true });
+        }
+
         /// Adds a new node to the graph and returns a handle to it.
         /// The node type must implement the `GenericNode` interface.
         pub fn addNode(self: *Self, node: anytype) !NodeHandle {
@@ -96,6 +121,53 @@ pub fn Graph(comptime T: type) type {
             self.nodes.items[index].status.store(status, .seq_cst);
         }
 
+        /// Moves the state of every node into one contiguous block, in `order` (graph indices, usually topological).
+        /// Each node starts on its own cache line so processing walks memory linearly without false sharing.
+        /// Node state is moved with a memcpy, nodes must not hold pointers to themselves.
+        /// Allocates. Do not use in real-time contexts.
+        pub fn packNodesAlloc(self: *Self, order: []const usize) !void {
+            // every node must move, a previous arena is freed at the end
+            std.debug.assert(order.len == self.nodes.items.len);
+
+            const cache_line = std.atomic.cache_line;
+
+            var arena_size: usize = 0;
+
+            for (order) |graph_index| {
+                const vtable = self.nodes.items[graph_index].vtable;
+                const alignment = @max(vtable.state_alignment, cache_line);
+
+                arena_size = std.mem.alignForward(usize, arena_size, alignment) + vtable.state_size;
+            }
+
+            const arena = try self.allocator.alignedAlloc(u8, cache_line, arena_size);
+
+            var offset: usize = 0;
+
+            for (order) |graph_index| {
+                const node = &self.nodes.items[graph_index];
+                const alignment = @max(node.vtable.state_alignment, cache_line);
+
+                offset = std.mem.alignForward(usize, offset, alignment);
+
+                const old_state: [*]const u8 = @ptrCast(node.ptr);
+                @memcpy(arena[offset..][0..node.vtable.state_size], old_state[0..node.vtable.state_size]);
+
+                if (!node.in_arena) node.vtable.destroy(node.ptr, node.allocator);
+
+                node.ptr = @ptrCast(arena.ptr + offset);
+                node.in_arena = true;
+
+                offset += node.vtable.state_size;
+            }
+
+            if (self.node_arena) |old_arena| {
+                self.allocator.free(old_arena);
+            }
+
+            self.node_arena = arena;
+        }
+
         /// Exports the graph to a DOT format file for visualization.
         /// The output is compatible with tools like Graphviz.
         pub fn debugGraph(self: Self, path: []const u8) !void {
@@ -117,7 +189,7 @@ pub fn Graph(comptime T: type) type {
             errdefer results.deinit();
 
             if (node_count <= self.options.max_static_size) {
-                try self.topologicalStatic(&results);
+                try self.topologicalStatic(allocator, &results);
             } else unreachable; // TODO, dynamic version for very long graphs
 
             return results;
@@ -125,9 +197,10 @@ pub fn Graph(comptime T: type) type {
 
         /// Static topological sorting optimized for smaller graphs.
         /// Uses preallocated arrays based on the static size limit defined in `GraphOptions`.
-        fn topologicalStatic(self: Self, results: *TopologyQueue) !void {
+        /// Edges are indexed once into adjacency lists so the sort runs in O(V + E). Feedback edges are not ordered.
+        /// The FIFO queue emits nodes sorted by level, see `TopologyQueueNode.level`.
+        fn topologicalStatic(self: Self, allocator: std.mem.Allocator, results: *TopologyQueue) !void {
             var in_degrees: [self.options.max_static_size]u32 = .{0} ** self.options.max_static_size;
-            var visited = bitmap.StaticBitMap(self.options.max_static_size).init();
             var queue: [self.options.max_static_size]usize = undefined;
 
             var queue_len: usize = 0;
@@ -135,16 +208,18 @@ pub fn Graph(comptime T: type) type {
 
             const node_count = self.nodes.items.len;
 
-            var inputs: [self.options.max_static_size]usize = undefined;
-            var inputs_count: usize = 0;
+            const outputs = try self.adjacencyAlloc(allocator, .outgoing, false);
+            defer outputs.deinit(allocator);
 
-            for (self.edges.items) |edge| {
-                if (edge.to >= node_count) return GraphError.invalid_node;
-                in_degrees[edge.to] += 1;
-            }
+            const inputs = try self.adjacencyAlloc(allocator, .incoming, false);
+            defer inputs.deinit(allocator);
+
+            const feedback_inputs = try self.adjacencyAlloc(allocator, .incoming, true);
+            defer feedback_inputs.deinit(allocator);
 
-            for (in_degrees[0..node_count], 0..) |deg, i| {
-                if (deg != 0) continue;
+            for (0..node_count) |i| {
+                in_degrees[i] = @intCast(inputs.neighbours(i).len);
+                if (in_degrees[i] != 0) continue;
 
                 queue[queue_len] = i;
                 queue_len += 1;
@@ -154,26 +229,16 @@ pub fn Graph(comptime T: type) type {
                 const node_index = queue[queue_start];
                 queue_start += 1;
 
-                if (visited.isSet(node_index)) continue;
-                try visited.set(node_index);
+                try results.append(node_index, inputs.neighbours(node_index), feedback_inputs.neighbours(node_index));
 
-                inputs_count = 0;
+                for (outputs.neighbours(node_index)) |to| {
+                    in_degrees[to] -= 1;
 
-                for (self.edges.items) |edge| {
-                    if (edge.to == node_index) {
-                        inputs[inputs_count] = edge.from;
-                        inputs_count += 1;
-                    }
-                }
-
-                try results.append(node_index, inputs[0..inputs_count]);
+                    // only enqueue once every input has been sorted
+                    if (in_degrees[to] != 0) continue;
 
-                for (self.edges.items) |edge| {
-                    if (edge.from == node_index) {
-                        in_degrees[edge.to] -= 1;
-                        queue[queue_len] = edge.to;
-                        queue_len += 1;
-                    }
+                    queue[queue_len] = to;
+                    queue_len += 1;
                 }
             }
 
@@ -182,6 +247,63 @@ pub fn Graph(comptime T: type) type {
             }
         }
 
+        // compressed adjacency lists, the neighbours of node i are items[offsets[i]..offsets[i + 1]]
+        const Adjacency = struct {
+            offsets: []usize,
+            items: []usize,
+
+            fn neighbours(self: Adjacency, node_index: usize) []usize {
+                return self.items[self.offsets[node_index]..self.offsets[node_index + 1]];
+            }
+
+            fn deinit(self: Adjacency, allocator: std.mem.Allocator) void {
+                allocator.free(self.offsets);
+                allocator.free(self.items);
+            }
+        };
+
+        // indexes either the regular or the feedback edges by source (outgoing) or destination (incoming).
+        // Neighbours keep the order the edges were connected in
+        fn adjacencyAlloc(self: Self, allocator: std.mem.Allocator, direction: enum { outgoing, incoming }, feedback: bool) !Adjacency {
+            const node_count = self.nodes.items.len;
+
+            const offsets = try allocator.alloc(usize, node_count + 1);
+            errdefer allocator.free(offsets);
+            @memset(offsets, 0);
+
+            var n_edges: usize = 0;
+
+            for (self.edges.items) |edge| {
+                if (edge.from >= node_count or edge.to >= node_count) return GraphError.invalid_node;
+                if (edge.feedback != feedback) continue;
+
+                const key = if (direction == .outgoing) edge.from else edge.to;
+                offsets[key + 1] += 1;
+                n_edges += 1;
+            }
+
+            for (1..node_count + 1) |i| offsets[i] += offsets[i - 1];
+
+            const items = try allocator.alloc(usize, n_edges);
+            errdefer allocator.free(items);
+
+            // offsets[i] is used as the insertion cursor of node i, shifting them one slot down.
+            // Restored below
+            for (self.edges.items) |edge| {
+                if (edge.feedback != feedback) continue;
+
+                const key = if (direction == .outgoing) edge.from else edge.to;
+                items[offsets[key]] = if (direction == .outgoing) edge.to else edge.from;
+                offsets[key] += 1;
+            }
+
+            var i = node_count;
+            while (i > 0) : (i -= 1) offsets[i] = offsets[i - 1];
+            offsets[0] = 0;
+
+            return .{ .offsets = offsets, .items = items };
+        }
+
         // for debugging purposes
         fn exportDot(self: Self, writer: anytype) !void {
             try writer.writeAll("digraph AudioGraph {\n");
@@ -212,8 +334,17 @@ pub const TopologyQueueNode = struct {
     graph_index: usize,
     /// Indices of the nodes that this node depends on
     inputs: []usize,
+    /// Indices of the nodes connected through feedback edges, read from the previous block
+    feedback_inputs: []usize = &.{},
     /// Index of the buffer assigned to this node. Assigned during graph analysis
     buffer_index: ?usize = null,
+    /// Frames of latency accumulated from the graph sources up to this node's output. Assigned during latency analysis
+    latency: usize = 0,
+    /// Compensation delay in frames for each entry in `inputs`. Assigned during latency analysis
+    input_delays: []usize = &.{},
+    /// Longest path from a source node. Nodes on the same level do not depend on each other
+    /// and the queue is sorted by level, so each level can be processed in parallel.
+    level: usize = 0,
 
     pub fn hasSameBuffer(self: TopologyQueueNode, other: TopologyQueueNode) bool {
         return self.buffer_index == other.buffer_index;
@@ -250,18 +381,38 @@ pub const TopologyQueue = struct {
         return self.nodes.get(self.nodes.len - 1);
     }
 
-    /// Appends node and its dependencies to queue, taking ownership of inputs slice
-    pub fn append(self: *TopologyQueue, graph_index: usize, inputs: []usize) !void {
+    /// Appends node and its dependencies to queue, copying the inputs slices
+    pub fn append(self: *TopologyQueue, graph_index: usize, inputs: []const usize, feedback_inputs: []const usize) !void {
         const node_inputs = try self.allocator.alloc(usize, inputs.len);
+        errdefer self.allocator.free(node_inputs);
 
         // we want execution queue to own the node_inputs memory
         @memcpy(node_inputs, inputs);
 
+        const node_feedback_inputs = try self.allocator.alloc(usize, feedback_inputs.len);
+        errdefer self.allocator.free(node_feedback_inputs);
+
+        @memcpy(node_feedback_inputs, feedback_inputs);
+
+        const input_delays = try self.allocator.alloc(usize, inputs.len);
+        @memset(input_delays, 0);
+
+        // inputs are always appended first
+        var level: usize = 0;
+
+        for (inputs) |input_graph_idx| {
+            const input_level = self.nodes.items(.level)[self.graph_to_queue_index[input_graph_idx]];
+            level = @max(level, input_level + 1);
+        }
+
         self.graph_to_queue_index[graph_index] = self.nodes.len;
 
         self.nodes.appendAssumeCapacity(.{
             .graph_index = graph_index,
             .inputs = node_inputs,
+            .feedback_inputs = node_feedback_inputs,
+            .input_delays = input_delays,
+            .level = level,
         });
     }
 
@@ -321,9 +472,36 @@ pub const TopologyQueue = struct {
         return next_buffer_idx;
     }
 
+    /// Computes the latency of every path through the graph given each node's own latency, indexed by graph index.
+    /// Inputs arriving earlier than the slowest input of the same node get a compensation delay in `input_delays`
+    /// so parallel branches stay aligned where they reconvene. Returns the latency at the output (last) node.
+    pub fn analyzeLatency(queue: *TopologyQueue, node_latencies: []const usize) usize {
+        const path_latencies = queue.nodes.items(.latency);
+
+        for (queue.nodes.items(.graph_index), queue.nodes.items(.inputs), queue.nodes.items(.input_delays), 0..) |graph_idx, inputs, input_delays, queue_idx| {
+            var slowest_input: usize = 0;
+
+            for (inputs) |input_graph_idx| {
+                slowest_input = @max(slowest_input, path_latencies[queue.graph_to_queue_index[input_graph_idx]]);
+            }
+
+            for (inputs, input_delays) |input_graph_idx, *delay| {
+                delay.* = slowest_input - path_latencies[queue.graph_to_queue_index[input_graph_idx]];
+            }
+
+            path_latencies[queue_idx] = slowest_input + node_latencies[graph_idx];
+        }
+
+        if (queue.nodes.len == 0) return 0;
+
+        return path_latencies[queue.nodes.len - 1];
+    }
+
     pub fn deinit(self: *TopologyQueue) void {
-        for (self.nodes.items(.inputs)) |inputs| {
+        for (self.nodes.items(.inputs), self.nodes.items(.feedback_inputs), self.nodes.items(.input_delays)) |inputs, feedback_inputs, input_delays| {
             self.allocator.free(inputs);
+            self.allocator.free(feedback_inputs);
+            self.allocator.free(input_delays);
         }
 
         self.nodes.deinit(self.allocator);
@@ -398,6 +576,32 @@ test "Graph: detect cycles" {
     try std.testing.expectError(Graph(f64).GraphError.cycle_detected, graph.topologicalSortAlloc(allocator));
 }
 
+test "Graph: feedback edges may close cycles" {
+    const allocator = std.testing.allocator;
+    var graph = Graph(f64).init(allocator, .{});
+    defer graph.deinit();
+
+    const node_a = try graph.addNode(GainNode{ .gain = 0.2 });
+    const node_b = try graph.addNode(GainNode{ .gain = 0.5 });
+    const node_c = try graph.addNode(GainNode{ .gain = 0.5 });
+
+    try node_a.connect(node_b);
+    try node_b.connect(node_c);
+    try node_c.connectFeedback(node_a);
+    try node_b.connectFeedback(node_b);
+
+    var result = try graph.topologicalSortAlloc(allocator);
+    defer result.deinit();
+
+    try std.testing.expectEqualSlices(usize, &.{ 0, 1, 2 }, result.nodes.items(.graph_index));
+    try std.testing.expectEqualSlices(usize, &.{node_c.index}, result.getFromGraphIndex(node_a.index).feedback_inputs);
+    try std.testing.expectEqualSlices(usize, &.{node_b.index}, result.getFromGraphIndex(node_b.index).feedback_inputs);
+    try std.testing.expectEqual(0, result.getFromGraphIndex(node_a.index).inputs.len);
+
+    // feedback edges do not hold buffers
+    try std.testing.expectEqual(1, try result.analyzeBufferRequirementsAlloc());
+}
+
 test "Graph: complex DAG" {
     const allocator = std.testing.allocator;
     var graph = Graph(f64).init(allocator, .{});
@@ -421,6 +625,9 @@ test "Graph: complex DAG" {
     // Verify node 0 comes first and node 3 comes last
     try std.testing.expectEqual(result.nodes.items(.graph_index)[0], nds[0].index);
     try std.testing.expectEqual(result.nodes.items(.graph_index)[3], nds[3].index);
+
+    // the two branches can run in parallel
+    try std.testing.expectEqualSlices(usize, &.{ 0, 1, 1, 2 }, result.nodes.items(.level));
 }
 
 test "TopologyQueue: Linear Graph" {
@@ -602,3 +809,79 @@ test "TopologyQueue: Complex Graph" {
     try std.testing.expect(buff_idx_f == buff_idx_d); // F reuses buffer 2 from D
     try std.testing.expect(buff_idx_d != buff_idx_b); // D should not share buffer with B
 }
+
+test "TopologyQueue: Latency Compensation" {
+    // Graph structure:
+    //       B (64 frames)
+    //     /   \
+    //   A       D (16 frames)
+    //     \   /
+    //       C
+    const allocator = std.testing.allocator;
+    var graph = Graph(f64).init(allocator, .{});
+    defer graph.deinit();
+
+    const node_a = try graph.addNode(GainNode{ .gain = 1.0 });
+    const node_b = try graph.addNode(GainNode{ .gain = 1.0 });
+    const node_c = try graph.addNode(GainNode{ .gain = 1.0 });
+    const node_d = try graph.addNode(GainNode{ .gain = 1.0 });
+
+    try node_a.connect(node_b);
+    try node_a.connect(node_c);
+    try node_b.connect(node_d);
+    try node_c.connect(node_d);
+
+    var queue = try graph.topologicalSortAlloc(allocator);
+    defer queue.deinit();
+
+    const total = queue.analyzeLatency(&.{ 0, 64, 0, 16 });
+    try std.testing.expectEqual(80, total);
+
+    const item_d = queue.getFromGraphIndex(node_d.index);
+
+    for (item_d.inputs, item_d.input_delays) |input, delay| {
+        // the branch through C is delayed to line up with B
+        const expected: usize = if (input == node_c.index) 64 else 0;
+        try std.testing.expectEqual(expected, delay);
+    }
+
+    try std.testing.expectEqual(64, queue.getFromGraphIndex(node_b.index).latency);
+    try std.testing.expectEqual(0, queue.getFromGraphIndex(node_c.index).latency);
+}
+
+test "Graph: pack nodes into arena" {
+    const allocator = std.testing.allocator;
+    var graph = Graph(f64).init(allocator, .{});
+    defer graph.deinit();
+
+    const node_a = try graph.addNode(GainNode{ .gain = 0.1 });
+    const node_b = try graph.addNode(GainNode{ .gain = 0.2 });
+    const node_c = try graph.addNode(GainNode{ .gain = 0.3 });
+
+    try node_a.connect(node_c);
+    try node_c.connect(node_b);
+
+    var queue = try graph.topologicalSortAlloc(allocator);
+    defer queue.deinit();
+
+    try graph.packNodesAlloc(queue.nodes.items(.graph_index));
+    // packing again moves nodes from the old arena to the new one
+    try graph.packNodesAlloc(queue.nodes.items(.graph_index));
+
+    const expected = [_]f64{ 0.1, 0.2, 0.3 };
+    var previous: usize = 0;
+
+    for (queue.nodes.items(.graph_index)) |graph_index| {
+        const node = graph.nodes.items[graph_index];
+        const address = @intFromPtr(node.ptr);
+
+        try std.testing.expect(node.in_arena);
+        try std.testing.expect(std.mem.isAligned(address, std.atomic.cache_line));
+        // laid out in processing order
+        try std.testing.expect(address > previous);
+        previous = address;
+
+        const state: *GainNode = @ptrCast(@alignCast(node.ptr));
+        try std.testing.expectEqual(expected[graph_index], state.gain);
+    }
+}
@@ -1,6 +1,7 @@
 const std = @import("std");
 const audio_buffer = @import("../../common/audio_buffer.zig");
 const specs = @import("../../common/audio_specs.zig");
+const params = @import("params.zig");
 
 pub const NodeStatus = enum(u8) {
     init,
@@ -10,6 +11,7 @@ pub const NodeStatus = enum(u8) {
 
 pub const NodeError = error{
     allocation_error,
+    invalid_configuration,
 };
 
 pub fn GenericNode(comptime T: type) type {
@@ -20,7 +22,18 @@ pub fn GenericNode(comptime T: type) type {
     return struct {
         const Self = @This();
 
+        pub const Event = params.ParamEvent(T);
+        pub const EventQueue = params.ParamQueue(T);
+
+        // nodes may override with a `pub const event_capacity: usize` declaration
+        pub const default_event_capacity: usize = 128;
+
+        // tail length for nodes that keep ringing forever, e.g. feedback loops. They are never skipped
+        pub const infinite_tail: usize = std.math.maxInt(usize);
+
         pub const PrepareContext = struct {
+            // frames of every process call: the feedback sub block when the scheduler splits feedback loops,
+            // see `Scheduler.setFeedbackBlockSize`. Only sample accurate nodes get shorter spans, at event frames
             block_size: specs.BlockSize,
             n_channels: usize,
             sample_rate: T,
@@ -30,6 +43,13 @@ pub fn GenericNode(comptime T: type) type {
         // ProcessContext does not own the buffer
         pub const ProcessContext = struct {
             buffer: audio_buffer.UnmanagedChannelView(T),
+            // sorted by frame, frames are relative to the start of `buffer`.
+            // for sample accurate nodes the scheduler splits the block so every event lands on frame 0
+            events: []const Event = &.{},
+            // true when every input of the node is silent. Nodes without inputs are never considered silent
+            inputs_silent: bool = false,
+            // nodes may set it to tell consumers the buffer holds only zeros. The scheduler resets it before each block
+            output_silent: ?*bool = null,
         };
 
         pub const VTable = struct {
@@ -37,18 +57,45 @@ pub fn GenericNode(comptime T: type) type {
             prepare: *const fn (*anyopaque, PrepareContext) NodeError!void,
             process: *const fn (*anyopaque, ProcessContext) void,
             destroy: *const fn (*anyopaque, std.mem.Allocator) void,
+            deinit: *const fn (*anyopaque) void,
+            latency: *const fn (*anyopaque) usize,
+            tail_length: *const fn (*anyopaque) usize,
+            // layout of the concrete node state, used to pack nodes into the graph arena
+            state_size: usize,
+            state_alignment: usize,
         };
 
         ptr: *anyopaque,
         vtable: *const VTable,
         allocator: std.mem.Allocator,
         status: std.atomic.Value(NodeStatus),
+        // only allocated for nodes declaring a `Param` enum
+        events: ?*EventQueue = null,
+        // nodes declaring `pub const sample_accurate = true` get their block split at event frames
+        sample_accurate: bool = false,
+        // node state lives in the graph arena and is freed with it, see Graph.packNodesAlloc
+        in_arena: bool = false,
 
         pub fn createNode(allocator: std.mem.Allocator, node: anytype) !Self {
-            const ptr = try allocator.create(@TypeOf(node));
+            const NodeType = @TypeOf(node);
+
+            const ptr = try allocator.create(NodeType);
+            errdefer allocator.destroy(ptr);
             ptr.* = node;
 
-            return init(allocator, ptr);
+            var self = init(allocator, ptr);
+
+            if (@hasDecl(NodeType, "Param")) {
+                const capacity: usize = if (@hasDecl(NodeType, "event_capacity")) NodeType.event_capacity else default_event_capacity;
+
+                const queue = try allocator.create(EventQueue);
+                errdefer allocator.destroy(queue);
+
+                queue.* = try EventQueue.init(allocator, capacity);
+                self.events = queue;
+            }
+
+            return self;
         }
 
         pub fn init(allocator: std.mem.Allocator, ptr: anytype) Self {
@@ -85,16 +132,45 @@ pub fn GenericNode(comptime T: type) type {
                     alloc.destroy(self);
                 }
 
+                // releases resources owned by the node, the state itself is freed by destroy or the graph arena
+                fn deinitFn(ctx: *anyopaque) void {
+                    if (!@hasDecl(StructType, "deinit")) return;
+
+                    const self = @as(PtrType, @ptrCast(@alignCast(ctx)));
+                    self.deinit();
+                }
+
                 fn nameFn(ctx: *anyopaque) []const u8 {
                     const self = @as(PtrType, @ptrCast(@alignCast(ctx)));
                     return self.name();
                 }
 
+                // latency is optional, nodes without a `latency` method report none
+                fn latencyFn(ctx: *anyopaque) usize {
+                    if (!@hasDecl(StructType, "latency")) return 0;
+
+                    const self = @as(PtrType, @ptrCast(@alignCast(ctx)));
+                    return self.latency();
+                }
+
+                // frames the node keeps producing output after its inputs went silent, none by default
+                fn tailLengthFn(ctx: *anyopaque) usize {
+                    if (!@hasDecl(StructType, "tailLength")) return 0;
+
+                    const self = @as(PtrType, @ptrCast(@alignCast(ctx)));
+                    return self.tailLength();
+                }
+
                 const vtable: VTable = .{
                     .process = processFn,
                     .destroy = destroyFn,
+                    .deinit = deinitFn,
                     .prepare = prepareFn,
                     .name = nameFn,
+                    .latency = latencyFn,
+                    .tail_length = tailLengthFn,
+                    .state_size = @sizeOf(StructType),
+                    .state_alignment = @alignOf(StructType),
                 };
             };
 
@@ -103,6 +179,7 @@ pub fn GenericNode(comptime T: type) type {
                 .vtable = &gen.vtable,
                 .allocator = allocator,
                 .status = std.atomic.Value(NodeStatus).init(.init),
+                .sample_accurate = if (@hasDecl(StructType, "sample_accurate")) StructType.sample_accurate else false,
             };
         }
 
@@ -110,6 +187,18 @@ pub fn GenericNode(comptime T: type) type {
             return self.vtable.name(self.ptr);
         }
 
+        /// Delay in frames between the node's input and output. Queried after prepare,
+        /// so nodes may compute it from the sample rate or block size.
+        pub inline fn latency(self: Self) usize {
+            return self.vtable.latency(self.ptr);
+        }
+
+        /// Frames of output after the inputs go silent. Once elapsed the scheduler skips the node
+        /// until an input becomes active again.
+        pub inline fn tailLength(self: Self) usize {
+            return self.vtable.tail_length(self.ptr);
+        }
+
         pub inline fn prepare(self: *Self, ctx: PrepareContext) NodeError!void {
             try self.vtable.prepare(self.ptr, ctx);
 
@@ -123,7 +212,55 @@ pub fn GenericNode(comptime T: type) type {
         }
 
         pub inline fn destroy(self: *Self) void {
-            self.vtable.destroy(self.ptr, self.allocator);
+            self.vtable.deinit(self.ptr);
+
+            if (!self.in_arena) self.vtable.destroy(self.ptr, self.allocator);
+
+            if (self.events) |queue| {
+                queue.deinit();
+                self.allocator.destroy(queue);
+                self.events = null;
+            }
+        }
+
+        /// Producer side, call from a single control thread. Returns false when the node
+        /// takes no parameters or its queue is full.
+        pub fn pushEvent(self: Self, event: Event) bool {
+            const queue = self.events orelse return false;
+            return queue.push(event);
+        }
+
+        /// Consumer side, audio thread only. True if an event is due before `block_end`.
+        pub fn hasPendingEvents(self: Self, block_end: u64) bool {
+            const queue = self.events orelse return false;
+            const event = queue.peek() orelse return false;
+
+            return event.frame < block_end;
+        }
+
+        /// Consumer side, audio thread only. Moves events scheduled before `block_end` into `out`,
+        /// rebased to `block_start`. Late events are delivered at frame 0 and
+        /// out of order events are clamped so the returned slice is always sorted.
+        pub fn drainEvents(self: Self, block_start: u64, block_end: u64, out: []Event) []Event {
+            const queue = self.events orelse return out[0..0];
+
+            var count: usize = 0;
+            var last_frame: u64 = 0;
+
+            while (count < out.len) {
+                const event = queue.peek() orelse break;
+                if (event.frame >= block_end) break;
+
+                _ = queue.pop();
+
+                const relative = if (event.frame > block_start) event.frame - block_start else 0;
+                last_frame = @max(last_frame, relative);
+
+                out[count] = .{ .frame = last_frame, .param = event.param, .value = event.value };
+                count += 1;
+            }
+
+            return out[0..count];
         }
 
         pub inline fn nodeStatus(self: Self) NodeStatus {
@@ -166,6 +303,10 @@ test "Test Node Initialization" {
     defer node.destroy();
 
     try std.testing.expectEqual(node.nodeStatus(), .init);
+
+    // optional declarations default to zero
+    try std.testing.expectEqual(0, node.latency());
+    try std.testing.expectEqual(0, node.tailLength());
 }
 
 test "Test Processing Functionality" {
@@ -212,3 +353,46 @@ test "Test Atomic Node Status Transitions" {
     node.setStatus(.processed);
     try std.testing.expectEqual(node.nodeStatus(), .processed);
 }
+
+test "Test Event Draining" {
+    const allocator = std.testing.allocator;
+
+    const ParamNode = struct {
+        const Self = @This();
+        pub const Param = enum(u32) { gain };
+
+        pub fn name(_: *Self) []const u8 {
+            return "ParamNode";
+        }
+
+        pub fn process(_: *Self, _: GenNode.ProcessContext) void {}
+        pub fn prepare(_: *Self, _: GenNode.PrepareContext) NodeError!void {}
+    };
+
+    var node = try GenNode.createNode(allocator, ParamNode{});
+    defer node.destroy();
+
+    try std.testing.expect(node.pushEvent(.{ .frame = 90, .param = 0, .value = 0.1 }));
+    try std.testing.expect(node.pushEvent(.{ .frame = 130, .param = 0, .value = 0.2 }));
+    try std.testing.expect(node.pushEvent(.{ .frame = 120, .param = 0, .value = 0.3 }));
+    try std.testing.expect(node.pushEvent(.{ .frame = 300, .param = 0, .value = 0.4 }));
+
+    var scratch: [8]GenNode.Event = undefined;
+    const events = node.drainEvents(100, 228, &scratch);
+
+    try std.testing.expectEqual(3, events.len);
+    // late event lands on the first frame
+    try std.testing.expectEqual(0, events[0].frame);
+    try std.testing.expectEqual(30, events[1].frame);
+    // out of order event is clamped
+    try std.testing.expectEqual(30, events[2].frame);
+
+    // the event for a future block stays queued
+    try std.testing.expectEqual(0, node.drainEvents(100, 228, &scratch).len);
+    try std.testing.expectEqual(1, node.drainEvents(228, 356, &scratch).len);
+
+    // nodes without parameters do not accept events
+    var gain = try GenNode.createNode(allocator, GainNode{ .gain = 1.0 });
+    defer gain.destroy();
+    try std.testing.expect(!gain.pushEvent(.{ .param = 0, .value = 1.0 }));
+}
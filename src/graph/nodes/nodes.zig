@@ -1,3 +1,5 @@
 pub const utils = @import("util_nodes.zig");
 pub const wave = @import("wave_nodes.zig");
 pub const interface = @import("node_interface.zig");
+pub const params = @import("params.zig");
+pub const poly = @import("poly_nodes.zig");
@@ -0,0 +1,87 @@
+const std = @import("std");
+const spsc = @import("../../common/spsc_queue.zig");
+
+/// A timestamped parameter change sent from a control thread to a node.
+/// `frame` is absolute (see `Scheduler.currentFrame`) when pushed and is rebased
+/// to the start of the (sub)block before it reaches `ProcessContext.events`.
+pub fn ParamEvent(comptime T: type) type {
+    return struct {
+        frame: u64 = 0,
+        param: u32,
+        value: T,
+    };
+}
+
+pub fn ParamQueue(comptime T: type) type {
+    return spsc.SpscQueue(ParamEvent(T));
+}
+
+/// Linear per sample ramp towards a target value.
+/// Avoids zipper noise when a parameter jumps between blocks or sub blocks.
+pub fn SmoothedValue(comptime T: type) type {
+    if (T != f32 and T != f64) {
+        @compileError("SmoothedValue only supports f32 and f64");
+    }
+
+    return struct {
+        const Self = @This();
+
+        current: T,
+        target: T,
+        step: T = 0,
+        remaining: usize = 0,
+        ramp_length: usize = 0,
+
+        pub fn init(value: T) Self {
+            return .{ .current = value, .target = value };
+        }
+
+        /// Must be called when the sample rate is known. A zero ramp makes `setTarget` jump immediately.
+        pub fn prepare(self: *Self, sample_rate: T, ramp_seconds: T) void {
+            self.ramp_length = @intFromFloat(@max(0, sample_rate * ramp_seconds));
+            self.current = self.target;
+            self.remaining = 0;
+        }
+
+        pub fn setTarget(self: *Self, target: T) void {
+            self.target = target;
+
+            if (self.ramp_length == 0) {
+                self.current = target;
+                self.remaining = 0;
+                return;
+            }
+
+            self.remaining = self.ramp_length;
+            self.step = (target - self.current) / @as(T, @floatFromInt(self.ramp_length));
+        }
+
+        pub inline fn next(self: *Self) T {
+            if (self.remaining == 0) return self.current;
+
+            self.remaining -= 1;
+            self.current = if (self.remaining == 0) self.target else self.current + self.step;
+
+            return self.current;
+        }
+
+        pub inline fn isSmoothing(self: Self) bool {
+            return self.remaining > 0;
+        }
+    };
+}
+
+test "SmoothedValue - ramps linearly and settles on target" {
+    var value = SmoothedValue(f64).init(0.0);
+    value.prepare(4.0, 1.0);
+
+    value.setTarget(1.0);
+    try std.testing.expect(value.isSmoothing());
+
+    try std.testing.expectApproxEqAbs(0.25, value.next(), 1e-12);
+    try std.testing.expectApproxEqAbs(0.5, value.next(), 1e-12);
+    try std.testing.expectApproxEqAbs(0.75, value.next(), 1e-12);
+    try std.testing.expectEqual(1.0, value.next());
+    try std.testing.expect(!value.isSmoothing());
+    try std.testing.expectEqual(1.0, value.next());
+}
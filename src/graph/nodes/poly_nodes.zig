@@ -0,0 +1,375 @@
+const std = @import("std");
+const node_interface = @import("node_interface.zig");
+const simd = @import("../../common/simd.zig");
+
+/// Voices processed per SIMD operation. Narrower targets split the vectors, wider ones run several lanes groups.
+pub fn laneCount(comptime T: type) comptime_int {
+    return std.math.clamp(simd.vectorLength(T), 4, 8);
+}
+
+pub fn Note(comptime T: type) type {
+    return struct {
+        frequency: T,
+        velocity: T,
+    };
+}
+
+/// Runs many identical voices in a single graph node. Voice state is laid out in SoA groups of `laneCount(T)` voices,
+/// so each call to `Voice.next` renders one sample of a whole group with vector operations.
+///
+/// `Voice` builds the lane aware voice template for a lane count, e.g. `SineVoice`. It must declare:
+///
+///     prepare(self: *Voice, sample_rate: T) void
+///     noteOn(self: *Voice, lane: usize, note: Note(T)) void
+///     noteOff(self: *Voice, lane: usize) void
+///     next(self: *Voice) @Vector(lanes, T)
+///     isActive(self: *Voice, lane: usize) bool   // false once a released voice has decayed
+///
+/// Notes are sent as parameter events carrying the MIDI note number. Voices are summed on top of the node input.
+/// `n_voices` is rounded up to a multiple of the lane count.
+pub fn PolyNode(comptime T: type, comptime Voice: fn (comptime type, comptime usize) type, comptime n_voices: usize) type {
+    if (T != f32 and T != f64) {
+        @compileError("PolyNode operates on f32 or f64");
+    }
+
+    const GenericNode = node_interface.GenericNode(T);
+
+    return struct {
+        pub const lanes = laneCount(T);
+        pub const n_groups = std.math.divCeil(usize, n_voices, lanes) catch unreachable;
+        pub const voice_count = n_groups * lanes;
+        pub const Template = Voice(T, lanes);
+
+        const no_note: i16 = -1;
+
+        groups: [n_groups]Template,
+        // voice allocation, indexed by voice: group * lanes + lane
+        notes: [voice_count]i16 = .{no_note} ** voice_count,
+        started: [voice_count]u64 = .{0} ** voice_count,
+        released: [voice_count]bool = .{false} ** voice_count,
+        // groups with at least one sounding voice, the others are not rendered
+        group_active: [n_groups]bool = .{false} ** n_groups,
+        note_counter: u64 = 0,
+        velocity: T = 1,
+
+        const Self = @This();
+        const PrepareContext = GenericNode.PrepareContext;
+        const ProcessContext = GenericNode.ProcessContext;
+        const Error = node_interface.NodeError;
+
+        /// `note_on` and `note_off` take a MIDI note number. `velocity` applies to the following notes.
+        pub const Param = enum(u32) { note_on, note_off, velocity, all_notes_off };
+        pub const sample_accurate = true;
+
+        /// Every voice starts as a copy of `template`.
+        pub fn init(template: Template) Self {
+            return .{ .groups = .{template} ** n_groups };
+        }
+
+        pub fn name(_: *Self) []const u8 {
+            return "PolyNode";
+        }
+
+        pub fn prepare(self: *Self, ctx: PrepareContext) Error!void {
+            for (&self.groups) |*group| group.prepare(ctx.sample_rate);
+        }
+
+        // held notes sustain without input
+        pub fn tailLength(_: *Self) usize {
+            return GenericNode.infinite_tail;
+        }
+
+        pub fn process(self: *Self, ctx: ProcessContext) void {
+            for (ctx.events) |event| self.handleEvent(event);
+
+            const buffer = ctx.buffer;
+            var any_active = false;
+
+            for (self.group_active) |active| any_active = any_active or active;
+
+            if (!any_active) {
+                if (ctx.inputs_silent) {
+                    if (ctx.output_silent) |silent| silent.* = true;
+                }
+
+                return;
+            }
+
+            for (0..buffer.block_size) |frame_index| {
+                var sum: T = 0;
+
+                for (&self.groups, self.group_active) |*group, active| {
+                    if (active) sum += @reduce(.Add, group.next());
+                }
+
+                switch (buffer.access) {
+                    .interleaved => for (buffer.frame(frame_index)) |*sample| {
+                        sample.* += sum;
+                    },
+                    .non_interleaved => for (0..buffer.n_channels) |ch_index| {
+                        buffer.writeSample(ch_index, frame_index, buffer.readSample(ch_index, frame_index) + sum);
+                    },
+                }
+            }
+
+            self.releaseFinished();
+        }
+
+        /// Starts a note on a free voice, or steals one: the oldest released voice first, then the oldest held voice.
+        /// A note that is already sounding is retriggered on its own voice.
+        pub fn noteOn(self: *Self, note: u8, velocity: T) void {
+            const voice = self.findVoice(note);
+            const group = voice / lanes;
+
+            self.notes[voice] = note;
+            self.started[voice] = self.note_counter;
+            self.released[voice] = false;
+            self.note_counter += 1;
+
+            self.groups[group].noteOn(voice % lanes, .{ .frequency = noteFrequency(note), .velocity = velocity });
+            self.group_active[group] = true;
+        }
+
+        /// Releases every voice playing `note`. Voices keep sounding until their release decays.
+        pub fn noteOff(self: *Self, note: u8) void {
+            for (self.notes, &self.released, 0..) |voice_note, *released, voice| {
+                if (voice_note != note or released.*) continue;
+
+                self.groups[voice / lanes].noteOff(voice % lanes);
+                released.* = true;
+            }
+        }
+
+        pub fn allNotesOff(self: *Self) void {
+            for (self.notes, &self.released, 0..) |voice_note, *released, voice| {
+                if (voice_note == no_note or released.*) continue;
+
+                self.groups[voice / lanes].noteOff(voice % lanes);
+                released.* = true;
+            }
+        }
+
+        pub fn activeVoices(self: Self) usize {
+            var count: usize = 0;
+            for (self.notes) |voice_note| count += @intFromBool(voice_note != no_note);
+
+            return count;
+        }
+
+        fn findVoice(self: *Self, note: u8) usize {
+            var free: ?usize = null;
+            var oldest_released: ?usize = null;
+            var oldest: usize = 0;
+
+            for (self.notes, self.released, self.started, 0..) |voice_note, released, started, voice| {
+                if (voice_note == note) return voice;
+
+                if (voice_note == no_note) {
+                    if (free == null) free = voice;
+                    continue;
+                }
+
+                if (released and (oldest_released == null or started < self.started[oldest_released.?])) oldest_released = voice;
+                if (started < self.started[oldest]) oldest = voice;
+            }
+
+            return free orelse oldest_released orelse oldest;
+        }
+
+        // frees the released voices that have decayed and deactivates silent groups
+        fn releaseFinished(self: *Self) void {
+            for (&self.groups, &self.group_active, 0..) |*group, *active, group_index| {
+                if (!active.*) continue;
+
+                var sounding = false;
+
+                for (0..lanes) |lane| {
+                    const voice = group_index * lanes + lane;
+                    if (self.notes[voice] == no_note) continue;
+
+                    if (self.released[voice] and !group.isActive(lane)) {
+                        self.notes[voice] = no_note;
+                        self.released[voice] = false;
+                        continue;
+                    }
+
+                    sounding = true;
+                }
+
+                active.* = sounding;
+            }
+        }
+
+        fn handleEvent(self: *Self, event: GenericNode.Event) void {
+            const param = std.meta.intToEnum(Param, event.param) catch return;
+            const note: u8 = @intFromFloat(std.math.clamp(@round(event.value), 0, 127));
+
+            switch (param) {
+                .note_on => self.noteOn(note, self.velocity),
+                .note_off => self.noteOff(note),
+                .velocity => self.velocity = std.math.clamp(event.value, 0, 1),
+                .all_notes_off => self.allNotesOff(),
+            }
+        }
+
+        fn noteFrequency(note: u8) T {
+            return 440.0 * std.math.pow(T, 2.0, (@as(T, @floatFromInt(note)) - 69.0) / 12.0);
+        }
+    };
+}
+
+/// Sine oscillator for `lanes` voices.
+pub fn SineLanes(comptime T: type, comptime lanes: usize) type {
+    return struct {
+        const Self = @This();
+        const V = @Vector(lanes, T);
+
+        // normalized [0, 1)
+        phase: V = @splat(0),
+        increment: V = @splat(0),
+        sample_rate: T = 48_000,
+
+        pub fn prepare(self: *Self, sample_rate: T) void {
+            self.sample_rate = sample_rate;
+        }
+
+        pub fn setFrequency(self: *Self, lane: usize, frequency: T) void {
+            self.increment[lane] = frequency / self.sample_rate;
+        }
+
+        pub fn reset(self: *Self, lane: usize) void {
+            self.phase[lane] = 0;
+        }
+
+        pub inline fn next(self: *Self) V {
+            const out = @sin(self.phase * @as(V, @splat(2.0 * std.math.pi)));
+
+            self.phase += self.increment;
+            self.phase -= @floor(self.phase);
+
+            return out;
+        }
+    };
+}
+
+/// Attack release envelope for `lanes` voices, one pole segments.
+/// A retriggered lane attacks from its current level so stolen voices do not click.
+pub fn EnvelopeLanes(comptime T: type, comptime lanes: usize) type {
+    return struct {
+        const Self = @This();
+        const V = @Vector(lanes, T);
+
+        // below this a released lane is considered silent
+        const silence_threshold: T = 1e-4;
+
+        attack_seconds: T = 0.005,
+        release_seconds: T = 0.2,
+
+        level: V = @splat(0),
+        target: V = @splat(0),
+        attack_coeff: T = 1,
+        release_coeff: T = 1,
+
+        pub fn prepare(self: *Self, sample_rate: T) void {
+            self.attack_coeff = segmentCoeff(self.attack_seconds, sample_rate);
+            self.release_coeff = segmentCoeff(self.release_seconds, sample_rate);
+        }
+
+        pub fn gateOn(self: *Self, lane: usize, velocity: T) void {
+            self.target[lane] = velocity;
+        }
+
+        pub fn gateOff(self: *Self, lane: usize) void {
+            self.target[lane] = 0;
+        }
+
+        pub fn isActive(self: Self, lane: usize) bool {
+            return self.target[lane] > 0 or self.level[lane] > silence_threshold;
+        }
+
+        /// Applies the envelope to `input`.
+        pub inline fn next(self: *Self, input: V) V {
+            const attack: V = @splat(self.attack_coeff);
+            const release: V = @splat(self.release_coeff);
+            const coeff = @select(T, self.target > self.level, attack, release);
+
+            self.level += (self.target - self.level) * coeff;
+
+            return input * self.level;
+        }
+
+        fn segmentCoeff(seconds: T, sample_rate: T) T {
+            if (seconds <= 0) return 1;
+            return 1.0 - @exp(-1.0 / (seconds * sample_rate));
+        }
+    };
+}
+
+/// Minimal voice template: a sine through an attack release envelope.
+pub fn SineVoice(comptime T: type, comptime lanes: usize) type {
+    return struct {
+        const Self = @This();
+
+        oscillator: SineLanes(T, lanes) = .{},
+        envelope: EnvelopeLanes(T, lanes) = .{},
+
+        pub fn prepare(self: *Self, sample_rate: T) void {
+            self.oscillator.prepare(sample_rate);
+            self.envelope.prepare(sample_rate);
+        }
+
+        pub fn noteOn(self: *Self, lane: usize, note: Note(T)) void {
+            // keep the phase of a sounding lane, only silent lanes restart at zero
+            if (!self.envelope.isActive(lane)) self.oscillator.reset(lane);
+
+            self.oscillator.setFrequency(lane, note.frequency);
+            self.envelope.gateOn(lane, note.velocity);
+        }
+
+        pub fn noteOff(self: *Self, lane: usize) void {
+            self.envelope.gateOff(lane);
+        }
+
+        pub inline fn next(self: *Self) @Vector(lanes, T) {
+            return self.envelope.next(self.oscillator.next());
+        }
+
+        pub fn isActive(self: *Self, lane: usize) bool {
+            return self.envelope.isActive(lane);
+        }
+    };
+}
+
+test "PolyNode: allocates, steals and frees voices" {
+    const Poly = PolyNode(f32, SineVoice, 4);
+
+    var poly = Poly.init(.{ .envelope = .{ .attack_seconds = 0, .release_seconds = 0 } });
+    try poly.prepare(.{ .block_size = .blk_64, .n_channels = 1, .sample_rate = 48_000, .access_pattern = .interleaved });
+
+    for (0..Poly.voice_count) |i| poly.noteOn(@intCast(60 + i), 1);
+    try std.testing.expectEqual(Poly.voice_count, poly.activeVoices());
+
+    // the oldest released voice is stolen before any held voice
+    poly.noteOff(61);
+    poly.noteOn(100, 1);
+    try std.testing.expectEqual(100, poly.notes[1]);
+
+    // every voice held, the oldest note is stolen
+    poly.noteOn(101, 1);
+    try std.testing.expectEqual(101, poly.notes[0]);
+
+    var data = [_]f32{0} ** 64;
+    const view = try @import("../../common/audio_buffer.zig").UnmanagedChannelView(f32).init(&data, .{
+        .n_channels = 1,
+        .block_size = .blk_64,
+        .access = .interleaved,
+    });
+
+    poly.process(.{ .buffer = view });
+    try std.testing.expect(std.mem.max(f32, &data) > 0);
+
+    // with no release the voices are freed at the end of the block
+    poly.allNotesOff();
+    poly.process(.{ .buffer = view });
+    try std.testing.expectEqual(0, poly.activeVoices());
+}
@@ -1,4 +1,5 @@
 const node_interface = @import("node_interface.zig");
+const params = @import("params.zig");
 const std = @import("std");
 
 pub fn GainNode(comptime T: type) type {
@@ -9,26 +10,95 @@ pub fn GainNode(comptime T: type) type {
     const GenericNode = node_interface.GenericNode(T);
 
     return struct {
+        /// Target gain, set directly as in `GainNode(T){ .gain = 0.5 }` or through `init`. Changes sent as `gain`
+        /// parameter events are ramped.
         gain: T,
+        // ramp towards `gain`, restarted on it by prepare
+        smoothed: params.SmoothedValue(T) = params.SmoothedValue(T).init(1),
 
         const Self = @This();
         const PrepareContext = GenericNode.PrepareContext;
         const ProcessContext = GenericNode.ProcessContext;
         const Error = node_interface.NodeError;
 
+        pub const Param = enum(u32) { gain };
+        // the scheduler splits the block at event frames so events always arrive at frame 0
+        pub const sample_accurate = true;
+
+        const ramp_seconds: T = 0.02;
+
+        pub fn init(gain: T) Self {
+            return .{ .gain = gain, .smoothed = params.SmoothedValue(T).init(gain) };
+        }
+
         pub fn name(_: *Self) []const u8 {
             return "GainNode";
         }
 
         pub fn process(self: *Self, ctx: ProcessContext) void {
-            for (0..ctx.buffer.block_size) |frame_index| {
-                for (0..ctx.buffer.n_channels) |ch_index| {
-                    const sample = ctx.buffer.readSample(ch_index, frame_index);
-                    ctx.buffer.writeSample(ch_index, frame_index, sample * self.gain);
+            for (ctx.events) |event| {
+                const param = std.meta.intToEnum(Param, event.param) catch continue;
+
+                switch (param) {
+                    .gain => {
+                        self.gain = event.value;
+                        self.smoothed.setTarget(event.value);
+                    },
                 }
             }
+
+            const buffer = ctx.buffer;
+
+            if (!self.smoothed.isSmoothing()) {
+                buffer.scale(self.gain);
+            } else switch (buffer.access) {
+                .interleaved => for (0..buffer.block_size) |frame_index| {
+                    const gain = self.smoothed.next();
+                    for (buffer.frame(frame_index)) |*sample| sample.* *= gain;
+                },
+                // every channel runs the same ramp from the same starting point
+                .non_interleaved => {
+                    const start = self.smoothed;
+
+                    for (0..buffer.n_channels) |ch_index| {
+                        self.smoothed = start;
+                        for (buffer.channel(ch_index)) |*sample| sample.* *= self.smoothed.next();
+                    }
+                },
+            }
+
+            // gain is memoryless, silence in means silence out
+            if (ctx.inputs_silent) {
+                if (ctx.output_silent) |silent| silent.* = true;
+            }
         }
 
-        pub fn prepare(_: *Self, _: PrepareContext) Error!void {}
+        pub fn prepare(self: *Self, ctx: PrepareContext) Error!void {
+            self.smoothed = params.SmoothedValue(T).init(self.gain);
+            self.smoothed.prepare(ctx.sample_rate, ramp_seconds);
+        }
     };
 }
+
+test "GainNode - a struct literal still works and channels share the ramp" {
+    const audio_buffer = @import("../../common/audio_buffer.zig");
+    const Node = GainNode(f32);
+
+    var node = Node{ .gain = 0.5 };
+    try node.prepare(.{ .block_size = .blk_64, .n_channels = 2, .sample_rate = 1000, .access_pattern = .non_interleaved });
+
+    var samples = [_]f32{1} ** 128;
+    const view = try audio_buffer.UnmanagedChannelView(f32).init(&samples, .{ .n_channels = 2, .block_size = .blk_64, .access = .non_interleaved });
+
+    node.process(.{ .buffer = view });
+    for (samples) |sample| try std.testing.expectEqual(0.5, sample);
+
+    // a 20 frame ramp at 1kHz towards 1, the same on both channels
+    @memset(&samples, 1);
+    node.process(.{ .buffer = view, .events = &.{.{ .frame = 0, .param = @intFromEnum(Node.Param.gain), .value = 1 }} });
+
+    try std.testing.expectEqualSlices(f32, view.channel(0), view.channel(1));
+    try std.testing.expect(samples[0] > 0.5 and samples[0] < 1);
+    try std.testing.expectEqual(1, samples[63]);
+    try std.testing.expectEqual(1, node.gain);
+}
@@ -1,4 +1,6 @@
+const std = @import("std");
 const node_interface = @import("node_interface.zig");
+const params = @import("params.zig");
 const dsp = @import("../../dsp/dsp.zig");
 
 pub fn SineNode(comptime T: type) type {
@@ -6,15 +8,23 @@ pub fn SineNode(comptime T: type) type {
 
     return struct {
         wave: dsp.waves.Wave(T),
+        frequency: params.SmoothedValue(T),
+        amplitude: params.SmoothedValue(T),
 
         const Self = @This();
         const PrepareContext = GenericNode.PrepareContext;
         const ProcessContext = GenericNode.ProcessContext;
         const Error = node_interface.NodeError;
 
+        pub const Param = enum(u32) { frequency, amplitude };
+
+        const ramp_seconds: T = 0.02;
+
         pub fn init(freq: T, amp: T, sr: T) Self {
             return .{
                 .wave = dsp.waves.Wave(T).init(freq, amp, sr),
+                .frequency = params.SmoothedValue(T).init(freq),
+                .amplitude = params.SmoothedValue(T).init(amp),
             };
         }
 
@@ -22,18 +32,61 @@ pub fn SineNode(comptime T: type) type {
             return "SineNode";
         }
 
+        // events are applied on their own frame, no need for the scheduler to split the block
         pub fn process(self: *Self, ctx: ProcessContext) void {
-            for (0..ctx.buffer.block_size) |frame_index| {
-                const sample = self.wave.sineSample();
+            const buffer = ctx.buffer;
+            var next_event: usize = 0;
+
+            switch (buffer.access) {
+                .interleaved => for (0..buffer.block_size) |frame_index| {
+                    @memset(buffer.frame(frame_index), self.nextSample(ctx.events, frame_index, &next_event));
+                },
+                .non_interleaved => {
+                    if (buffer.n_channels == 0) return;
+
+                    // render once, then copy to the remaining channels
+                    const first = buffer.channel(0);
+
+                    for (first, 0..) |*sample, frame_index| {
+                        sample.* = self.nextSample(ctx.events, frame_index, &next_event);
+                    }
+
+                    for (1..buffer.n_channels) |ch_index| @memcpy(buffer.channel(ch_index), first);
+                },
+            }
+        }
 
-                for (0..ctx.buffer.n_channels) |ch_index| {
-                    ctx.buffer.writeSample(ch_index, frame_index, sample);
-                }
+        inline fn nextSample(self: *Self, events: []const GenericNode.Event, frame_index: usize, next_event: *usize) T {
+            while (next_event.* < events.len and events[next_event.*].frame <= frame_index) : (next_event.* += 1) {
+                self.handleEvent(events[next_event.*]);
             }
+
+            if (self.frequency.isSmoothing()) self.wave.setFrequency(self.frequency.next());
+            if (self.amplitude.isSmoothing()) self.wave.amp = self.amplitude.next();
+
+            return self.wave.sineSample();
         }
 
         pub fn prepare(self: *Self, ctx: PrepareContext) Error!void {
             self.wave.setSampleRate(ctx.sample_rate);
+            self.frequency.prepare(ctx.sample_rate, ramp_seconds);
+            self.amplitude.prepare(ctx.sample_rate, ramp_seconds);
+        }
+
+        fn handleEvent(self: *Self, event: GenericNode.Event) void {
+            const param = std.meta.intToEnum(Param, event.param) catch return;
+
+            // without a ramp the target is reached right away, nextSample only follows ramps
+            switch (param) {
+                .frequency => {
+                    self.frequency.setTarget(event.value);
+                    if (!self.frequency.isSmoothing()) self.wave.setFrequency(event.value);
+                },
+                .amplitude => {
+                    self.amplitude.setTarget(event.value);
+                    if (!self.amplitude.isSmoothing()) self.wave.amp = event.value;
+                },
+            }
         }
     };
 }
@@ -0,0 +1,327 @@
+const std = @import("std");
+const scheduler = @import("scheduler.zig");
+const specs = @import("../common/audio_specs.zig");
+const audio_buffer = @import("../common/audio_buffer.zig");
+const node_interface = @import("nodes/node_interface.zig");
+
+const log = std.log.scoped(.graph);
+
+pub const OfflineError = error{
+    not_prepared,
+};
+
+pub const RenderOptions = struct {
+    /// Frames to render. When null renders until the graph output goes silent, capped by `max_frames`.
+    n_frames: ?usize = null,
+    /// Upper bound when rendering until silence, graphs with free running sources never go silent.
+    max_frames: usize = 48_000 * 60 * 10,
+};
+
+pub const OfflineOptions = struct {
+    sample_rate: specs.SampleRate = .sr_48000,
+    n_channels: usize = 2,
+    /// Large blocks amortize the per block overhead, there is no device deadline to meet.
+    block_size: specs.BlockSize = .blk_2048,
+    /// Worker threads for parallel graph levels. Null uses every CPU, 1 processes serially.
+    n_threads: ?usize = null,
+};
+
+pub const RenderStats = struct {
+    frames: usize,
+    /// Wall clock time spent rendering
+    elapsed_ns: u64,
+    /// Audio seconds rendered per wall clock second.
+    realtime_multiple: f64,
+};
+
+/// Drives a `Scheduler` without a device clock, as fast as the CPU allows.
+/// Nodes on the same graph level are processed in parallel.
+/// Needs no audio hardware, output goes to memory or a 32 bit float WAV file.
+pub fn OfflineRenderer(comptime T: type) type {
+    return struct {
+        const Self = @This();
+        const Scheduler = scheduler.Scheduler(T);
+
+        pub const Rendered = struct {
+            /// interleaved, owned by the caller
+            samples: []T,
+            stats: RenderStats,
+        };
+
+        scheduler: *Scheduler,
+        allocator: std.mem.Allocator,
+        opts: OfflineOptions,
+        pool: ?*std.Thread.Pool = null,
+
+        pub fn init(allocator: std.mem.Allocator, sched: *Scheduler, opts: OfflineOptions) !Self {
+            var self = Self{
+                .scheduler = sched,
+                .allocator = allocator,
+                .opts = opts,
+            };
+
+            const n_threads = opts.n_threads orelse (std.Thread.getCpuCount() catch 1);
+
+            if (n_threads > 1) {
+                const pool = try allocator.create(std.Thread.Pool);
+                errdefer allocator.destroy(pool);
+
+                try pool.init(.{ .allocator = allocator, .n_jobs = @intCast(n_threads) });
+                self.pool = pool;
+            }
+
+            return self;
+        }
+
+        /// Prepares the scheduler with the offline block size. Output is interleaved.
+        pub fn prepare(self: *Self) !void {
+            try self.scheduler.prepare(.{
+                .block_size = self.opts.block_size,
+                .n_channels = self.opts.n_channels,
+                .sample_rate = self.opts.sample_rate.toFloat(T),
+                .access_pattern = .interleaved,
+            });
+        }
+
+        /// Renders into a newly allocated interleaved buffer owned by the caller.
+        pub fn renderAlloc(self: *Self, opts: RenderOptions) !Rendered {
+            var samples = std.ArrayList(T).init(self.allocator);
+            errdefer samples.deinit();
+
+            if (opts.n_frames) |n_frames| try samples.ensureTotalCapacity(n_frames * self.opts.n_channels);
+
+            const stats = try self.render(opts, &samples, appendBlock);
+
+            return .{ .samples = try samples.toOwnedSlice(), .stats = stats };
+        }
+
+        /// Renders into a 32 bit float WAV file. Blocks are streamed to disk as they are rendered.
+        pub fn renderToWav(self: *Self, path: []const u8, opts: RenderOptions) !RenderStats {
+            var file = try std.fs.cwd().createFile(path, .{});
+            defer file.close();
+
+            // sizes are patched once the frame count is known
+            try writeWavHeader(file.writer(), self.opts, 0);
+
+            var buffered = std.io.bufferedWriter(file.writer());
+            const stats = try self.render(opts, &buffered, writeBlock);
+            try buffered.flush();
+
+            try file.seekTo(0);
+            try writeWavHeader(file.writer(), self.opts, stats.frames);
+
+            return stats;
+        }
+
+        fn render(self: *Self, opts: RenderOptions, sink: anytype, comptime consume: anytype) !RenderStats {
+            if (self.scheduler.topology_queue == null) return OfflineError.not_prepared;
+
+            const target = opts.n_frames orelse opts.max_frames;
+            const block_size = self.scheduler.blockSize();
+
+            var timer = try std.time.Timer.start();
+            var frames: usize = 0;
+
+            while (frames < target) {
+                if (self.pool) |pool| try self.scheduler.processGraphParallel(pool) else try self.scheduler.processGraph();
+
+                const silent = self.scheduler.isOutputSilent();
+                const view = self.scheduler.getOutputBuffer() orelse return OfflineError.not_prepared;
+
+                if (opts.n_frames == null and silent) break;
+
+                const n = @min(block_size, target - frames);
+                try consume(sink, view, n);
+                frames += n;
+            }
+
+            const elapsed_ns = timer.read();
+            const rendered_seconds = @as(f64, @floatFromInt(frames)) / self.opts.sample_rate.toFloat(f64);
+            const elapsed_seconds = @as(f64, @floatFromInt(@max(elapsed_ns, 1))) / std.time.ns_per_s;
+
+            const stats = RenderStats{
+                .frames = frames,
+                .elapsed_ns = elapsed_ns,
+                .realtime_multiple = rendered_seconds / elapsed_seconds,
+            };
+
+            log.info("Offline render: {d} frames in {d:.3}ms, {d:.1}x real time", .{
+                frames,
+                elapsed_seconds * std.time.ms_per_s,
+                stats.realtime_multiple,
+            });
+
+            return stats;
+        }
+
+        fn appendBlock(samples: *std.ArrayList(T), view: audio_buffer.UnmanagedChannelView(T), n_frames: usize) !void {
+            for (0..n_frames) |frame| {
+                for (0..view.n_channels) |ch| try samples.append(view.readSample(ch, frame));
+            }
+        }
+
+        fn writeBlock(writer: anytype, view: audio_buffer.UnmanagedChannelView(T), n_frames: usize) !void {
+            for (0..n_frames) |frame| {
+                for (0..view.n_channels) |ch| {
+                    const sample: f32 = @floatCast(view.readSample(ch, frame));
+                    try writer.writer().writeInt(u32, @bitCast(sample), .little);
+                }
+            }
+        }
+
+        pub fn deinit(self: *Self) void {
+            if (self.pool) |pool| {
+                pool.deinit();
+                self.allocator.destroy(pool);
+            }
+        }
+    };
+}
+
+// canonical 44 byte header, WAVE_FORMAT_IEEE_FLOAT
+fn writeWavHeader(writer: anytype, opts: OfflineOptions, frames: usize) !void {
+    const bytes_per_sample = 4;
+    const n_channels: u32 = @intCast(opts.n_channels);
+    const sample_rate: u32 = @intCast(@intFromEnum(opts.sample_rate));
+    const data_size: u32 = @intCast(frames * n_channels * bytes_per_sample);
+
+    try writer.writeAll("RIFF");
+    try writer.writeInt(u32, 36 + data_size, .little);
+    try writer.writeAll("WAVE");
+
+    try writer.writeAll("fmt ");
+    try writer.writeInt(u32, 16, .little);
+    try writer.writeInt(u16, 3, .little);
+    try writer.writeInt(u16, @intCast(n_channels), .little);
+    try writer.writeInt(u32, sample_rate, .little);
+    try writer.writeInt(u32, sample_rate * n_channels * bytes_per_sample, .little);
+    try writer.writeInt(u16, @intCast(n_channels * bytes_per_sample), .little);
+    try writer.writeInt(u16, bytes_per_sample * 8, .little);
+
+    try writer.writeAll("data");
+    try writer.writeInt(u32, data_size, .little);
+}
+
+test "OfflineRenderer: renders a fixed number of frames" {
+    const allocator = std.testing.allocator;
+    const graph = @import("graph.zig");
+
+    var sched = scheduler.Scheduler(f32).init(allocator);
+    defer sched.deinit();
+
+    const sine = try sched.audio_graph.addNode(graph.nodes.wave.SineNode(f32).init(440, 1, 48_000));
+    const gain = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f32).init(0.5));
+    const other_gain = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f32).init(0.5));
+    const mix = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f32).init(1.0));
+
+    // two parallel branches reconvene at the mix node
+    try sine.connect(gain);
+    try sine.connect(other_gain);
+    try gain.connect(mix);
+    try other_gain.connect(mix);
+
+    var renderer = try OfflineRenderer(f32).init(allocator, &sched, .{ .block_size = .blk_256, .n_threads = 2 });
+    defer renderer.deinit();
+
+    try renderer.prepare();
+
+    const result = try renderer.renderAlloc(.{ .n_frames = 1000 });
+    defer allocator.free(result.samples);
+
+    try std.testing.expectEqual(1000, result.stats.frames);
+    try std.testing.expectEqual(2000, result.samples.len);
+
+    // both branches at half gain sum back to the sine on every frame: across the block boundaries at 256, 512 and
+    // 768, and through the last block cut at 1000
+    for (0..1000) |frame| {
+        const expected = @sin(2 * std.math.pi * 440.0 * @as(f32, @floatFromInt(frame)) / 48_000.0);
+
+        try std.testing.expectApproxEqAbs(expected, result.samples[2 * frame], 1e-3);
+        try std.testing.expectEqual(result.samples[2 * frame], result.samples[2 * frame + 1]);
+    }
+}
+
+// test source, `frames` frames of ones then silence
+const TestBurst = struct {
+    frames: usize,
+    position: usize = 0,
+
+    const GenericNode = node_interface.GenericNode(f32);
+
+    pub fn name(_: *TestBurst) []const u8 {
+        return "TestBurst";
+    }
+
+    pub fn prepare(_: *TestBurst, _: GenericNode.PrepareContext) node_interface.NodeError!void {}
+
+    pub fn process(self: *TestBurst, ctx: GenericNode.ProcessContext) void {
+        const sounding = self.position < self.frames;
+
+        for (0..ctx.buffer.block_size) |frame| {
+            ctx.buffer.writeSample(0, frame, if (self.position < self.frames) 1 else 0);
+            self.position += 1;
+        }
+
+        if (!sounding) {
+            if (ctx.output_silent) |silent| silent.* = true;
+        }
+    }
+};
+
+// test delay line, mono, its tail is its length
+const TestDelay = struct {
+    line: [200]f32 = .{0} ** 200,
+    at: usize = 0,
+
+    const GenericNode = node_interface.GenericNode(f32);
+
+    pub fn name(_: *TestDelay) []const u8 {
+        return "TestDelay";
+    }
+
+    pub fn prepare(_: *TestDelay, _: GenericNode.PrepareContext) node_interface.NodeError!void {}
+
+    pub fn process(self: *TestDelay, ctx: GenericNode.ProcessContext) void {
+        for (0..ctx.buffer.block_size) |frame| {
+            const delayed = self.line[self.at];
+            self.line[self.at] = ctx.buffer.readSample(0, frame);
+            self.at = (self.at + 1) % self.line.len;
+
+            ctx.buffer.writeSample(0, frame, delayed);
+        }
+    }
+
+    pub fn tailLength(self: *TestDelay) usize {
+        return self.line.len;
+    }
+};
+
+test "OfflineRenderer: renders until silence, the tail included" {
+    const allocator = std.testing.allocator;
+
+    var sched = scheduler.Scheduler(f32).init(allocator);
+    defer sched.deinit();
+
+    const burst = try sched.audio_graph.addNode(TestBurst{ .frames = 100 });
+    const delay = try sched.audio_graph.addNode(TestDelay{});
+    try burst.connect(delay);
+
+    var renderer = try OfflineRenderer(f32).init(allocator, &sched, .{ .n_channels = 1, .block_size = .blk_256, .n_threads = 1 });
+    defer renderer.deinit();
+
+    try renderer.prepare();
+
+    const result = try renderer.renderAlloc(.{});
+    defer allocator.free(result.samples);
+
+    // the burst is over after the first block, the delay rings 200 frames into the second one. The third block is
+    // silent and ends the render, whole blocks only
+    try std.testing.expectEqual(512, result.stats.frames);
+    try std.testing.expectEqual(512, result.samples.len);
+
+    // delayed by 200 frames, across the block boundary at 256
+    for (result.samples, 0..) |sample, frame| {
+        const expected: f32 = if (frame >= 200 and frame < 300) 1 else 0;
+        try std.testing.expectEqual(expected, sample);
+    }
+}
@@ -2,6 +2,8 @@ const std = @import("std");
 const graph = @import("graph.zig");
 const specs = @import("../common/audio_specs.zig");
 const audio_buffer = @import("../common/audio_buffer.zig");
+const realtime = @import("../common/realtime.zig");
+const dsp = @import("../dsp/dsp.zig");
 
 const log = std.log.scoped(.graph);
 
@@ -19,16 +21,98 @@ pub fn Scheduler(comptime T: type) type {
 
         const PrepareContext = GenericNode.PrepareContext;
         const ProcessContext = GenericNode.ProcessContext;
+        const Event = GenericNode.Event;
+        const DelayLine = graph.delay_line.DelayLine(T);
 
         audio_graph: graph.Graph(T),
         allocator: std.mem.Allocator,
         topology_queue: ?graph.TopologyQueue = null,
         buffers: ?audio_buffer.UniformChannelViews(T) = null,
+        // frames rendered since the scheduler started. Written by the audio thread only
+        frame_time: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+        // holds the events drained in a block, `max_events` per queue index. Sized at prepare
+        event_scratch: []Event = &.{},
+        max_events: usize = 0,
+        // nodes ready to run on the current level, used by processGraphParallel
+        jobs: []NodeJob = &.{},
+        // compensates the latency between parallel branches, one per delayed input in queue order
+        delay_lines: std.ArrayList(DelayLine),
+        // frames between the graph input and the output node, computed at prepare
+        graph_latency: usize = 0,
+        // one flag per buffer, a silent buffer is read as zeros regardless of its content
+        buffer_silent: []bool = &.{},
+        // per queue index, tracks how long the node inputs have been silent
+        node_silence: []SilenceState = &.{},
+        // one per node feeding a feedback edge
+        histories: []FeedbackHistory = &.{},
+        // per graph index, the history recording the node output
+        history_index: []?usize = &.{},
+        // frames processed per pass when the graph has feedback edges, null processes whole blocks
+        feedback_block_size: ?specs.BlockSize = null,
+        // frames processed per pass, the block size or `feedback_block_size`. Set at prepare
+        span_size: usize = 0,
+        // replaces the output node buffer while processing, see processGraphInto
+        output_target: ?audio_buffer.UnmanagedChannelView(T) = null,
+        output_buffer_index: usize = 0,
+
+        // node ready to be processed, see beginNode
+        const NodeJob = struct {
+            graph_index: usize,
+            node: *GenericNode,
+            view: audio_buffer.UnmanagedChannelView(T),
+            events: []Event,
+            inputs_silent: bool,
+            output_silent: *bool,
+        };
+
+        // frames [offset, offset + len) of the current block, processed in one pass over the graph
+        const Span = struct {
+            // absolute frame of the first frame
+            start: u64,
+            offset: usize,
+            len: usize,
+        };
+
+        // output of a node feeding a feedback edge. Double buffered: consumers read the previous pass
+        // while the node writes the current one, whatever their order in the queue
+        const FeedbackHistory = struct {
+            views: [2]audio_buffer.UnmanagedChannelView(T),
+            silent: [2]bool = .{ true, true },
+            read: u1 = 0,
+
+            fn readView(self: FeedbackHistory) ?audio_buffer.UnmanagedChannelView(T) {
+                return if (self.silent[self.read]) null else self.views[self.read];
+            }
+
+            fn record(self: *FeedbackHistory, view: audio_buffer.UnmanagedChannelView(T), silent: bool) void {
+                if (silent) return self.recordSilence();
+
+                const write = self.read ^ 1;
+
+                self.silent[write] = false;
+                self.views[write].copyFrom(view) catch unreachable;
+            }
+
+            fn recordSilence(self: *FeedbackHistory) void {
+                self.silent[self.read ^ 1] = true;
+            }
+
+            fn swap(self: *FeedbackHistory) void {
+                self.read ^= 1;
+            }
+        };
+
+        const SilenceState = struct {
+            // node tail plus the longest compensation delay on its inputs
+            tail_length: usize,
+            silent_frames: usize = 0,
+        };
 
         pub fn init(allocator: std.mem.Allocator) Self {
             return .{
                 .audio_graph = graph.Graph(T).init(allocator, .{}),
                 .allocator = allocator,
+                .delay_lines = std.ArrayList(DelayLine).init(allocator),
             };
         }
 
@@ -36,31 +120,73 @@ pub fn Scheduler(comptime T: type) type {
         pub fn build_graph(self: *Self, sample_rate: specs.SampleRate) !void {
             var sine_node = try self.audio_graph.addNode(SineNode.init(540.0, 1.0, sample_rate.toFloat(T)));
 
-            const gain_node = try self.audio_graph.addNode(GainNode{ .gain = 0.5 });
+            const gain_node = try self.audio_graph.addNode(GainNode.init(0.5));
             try sine_node.connect(gain_node);
         }
 
         pub fn prepare(self: *Self, ctx: PrepareContext) !void {
+            var max_events: usize = 0;
+
+            // nodes are processed one pass at a time, e.g. a Subgraph sizes its inner block after it
+            var node_ctx = ctx;
+            if (self.splitsFeedback(ctx.block_size)) node_ctx.block_size = self.feedback_block_size.?;
+
             for (self.audio_graph.nodes.items) |*node| {
-                try node.prepare(ctx);
+                try node.prepare(node_ctx);
+
+                if (node.events) |queue| max_events = @max(max_events, queue.capacity());
             }
 
-            var queue = try self.audio_graph.topologicalSortAlloc(self.allocator);
+            const n_nodes = self.audio_graph.nodes.items.len;
+            self.max_events = max_events;
+
+            if (self.event_scratch.len < max_events * n_nodes) {
+                self.allocator.free(self.event_scratch);
+                self.event_scratch = &.{};
+                self.event_scratch = try self.allocator.alloc(Event, max_events * n_nodes);
+            }
 
-            if (self.topology_queue) |*q| {
-                q.deinit();
+            if (self.jobs.len < n_nodes) {
+                self.allocator.free(self.jobs);
+                self.jobs = &.{};
+                self.jobs = try self.allocator.alloc(NodeJob, n_nodes);
             }
 
-            self.topology_queue = queue;
+            const n_views = blk: {
+                var sorted = try self.audio_graph.topologicalSortAlloc(self.allocator);
+                errdefer sorted.deinit();
+
+                // node state is laid out in the order it will be processed
+                try self.audio_graph.packNodesAlloc(sorted.nodes.items(.graph_index));
+
+                // assigns buffer index to each node and returns the number of buffers required
+                const required = try sorted.analyzeBufferRequirementsAlloc();
+
+                try self.prepareLatencyCompensation(&sorted, ctx.n_channels);
+
+                if (self.topology_queue) |*q| {
+                    q.deinit();
+                }
+
+                self.topology_queue = sorted;
+                break :blk required;
+            };
+
+            try self.prepareSilenceTracking(n_views);
+            try self.prepareFeedback(ctx);
 
-            // assigns buffer index to each node and returns the number of buffers required
-            const n_views = try queue.analyzeBufferRequirementsAlloc();
+            if (self.topology_queue.?.nodes.len > 0) self.output_buffer_index = self.topology_queue.?.getLast().buffer_index.?;
 
             if (self.buffers) |*buffers| {
+                const same_layout = buffers.opts.n_channels == ctx.n_channels and
+                    buffers.opts.block_size == ctx.block_size and
+                    buffers.opts.access == ctx.access_pattern;
+
                 // we already have enough buffers
-                if (buffers.opts.n_views >= n_views) buffers.deinit()
-                // we have enough buffers
-                else return;
+                if (same_layout and buffers.opts.n_views >= n_views) return;
+
+                buffers.deinit();
+                self.buffers = null;
             }
 
             self.buffers = try audio_buffer.UniformChannelViews(T).init(self.allocator, .{
@@ -71,63 +197,490 @@ pub fn Scheduler(comptime T: type) type {
             });
         }
 
+        // queries every node latency, computes the compensation needed on each input
+        // and preallocates one delay line per compensated input in queue order
+        fn prepareLatencyCompensation(self: *Self, queue: *graph.TopologyQueue, n_channels: usize) !void {
+            const node_latencies = try self.allocator.alloc(usize, self.audio_graph.nodes.items.len);
+            defer self.allocator.free(node_latencies);
+
+            for (self.audio_graph.nodes.items, node_latencies) |node, *node_latency| {
+                node_latency.* = node.latency();
+            }
+
+            self.graph_latency = queue.analyzeLatency(node_latencies);
+
+            self.deinitDelayLines();
+
+            for (queue.nodes.items(.input_delays)) |input_delays| {
+                for (input_delays) |delay| {
+                    if (delay == 0) continue;
+
+                    var line = try DelayLine.init(self.allocator, n_channels, delay);
+                    errdefer line.deinit();
+
+                    try self.delay_lines.append(line);
+                }
+            }
+
+            if (self.graph_latency > 0) {
+                log.debug("Graph latency: {d} frames, {d} compensating delay lines", .{ self.graph_latency, self.delay_lines.items.len });
+            }
+        }
+
+        fn prepareSilenceTracking(self: *Self, n_views: usize) !void {
+            const queue = self.topology_queue.?;
+
+            self.allocator.free(self.buffer_silent);
+            self.buffer_silent = &.{};
+            self.buffer_silent = try self.allocator.alloc(bool, n_views);
+            @memset(self.buffer_silent, false);
+
+            self.allocator.free(self.node_silence);
+            self.node_silence = &.{};
+            self.node_silence = try self.allocator.alloc(SilenceState, queue.nodes.len);
+
+            for (queue.nodes.items(.graph_index), queue.nodes.items(.input_delays), self.node_silence) |graph_index, input_delays, *silence| {
+                var max_delay: usize = 0;
+                for (input_delays) |delay| max_delay = @max(max_delay, delay);
+
+                silence.* = .{ .tail_length = self.audio_graph.nodes.items[graph_index].tailLength() +| max_delay };
+            }
+        }
+
+        /// Shortens the implied delay of feedback loops from one block to `block_size` frames
+        /// by processing the graph several times per block. Costs one graph pass per sub block,
+        /// takes effect at the next prepare. Null processes whole blocks.
+        pub fn setFeedbackBlockSize(self: *Self, block_size: ?specs.BlockSize) void {
+            self.feedback_block_size = block_size;
+        }
+
+        // whether the passes are shorter than the block, validated by prepareFeedback
+        fn splitsFeedback(self: *Self, block_size: specs.BlockSize) bool {
+            const sub_block = self.feedback_block_size orelse return false;
+            if (@intFromEnum(sub_block) >= @intFromEnum(block_size)) return false;
+
+            for (self.audio_graph.edges.items) |edge| {
+                if (edge.feedback) return true;
+            }
+
+            return false;
+        }
+
+        // allocates one history per feedback source, sized for one pass
+        fn prepareFeedback(self: *Self, ctx: PrepareContext) !void {
+            const queue = self.topology_queue.?;
+            const block_size: usize = @intFromEnum(ctx.block_size);
+
+            self.deinitHistories();
+
+            self.span_size = block_size;
+
+            self.history_index = try self.allocator.alloc(?usize, self.audio_graph.nodes.items.len);
+            @memset(self.history_index, null);
+
+            var n_histories: usize = 0;
+
+            for (queue.nodes.items(.feedback_inputs)) |feedback_inputs| {
+                for (feedback_inputs) |source| {
+                    if (self.history_index[source] != null) continue;
+
+                    self.history_index[source] = n_histories;
+                    n_histories += 1;
+                }
+            }
+
+            if (n_histories == 0) return;
+
+            var span_block = ctx.block_size;
+
+            if (self.feedback_block_size) |sub_block| {
+                if (block_size % @intFromEnum(sub_block) != 0 or @intFromEnum(sub_block) > block_size) {
+                    log.err("Feedback block size {d} does not divide block size {d}", .{ @intFromEnum(sub_block), block_size });
+                    return error.invalid_configuration;
+                }
+
+                span_block = sub_block;
+                self.span_size = @intFromEnum(sub_block);
+            }
+
+            const span_samples = ctx.n_channels * self.span_size;
+
+            // both halves of every history in one allocation
+            const data = try self.allocator.alloc(T, n_histories * 2 * span_samples);
+            @memset(data, 0);
+
+            self.histories = self.allocator.alloc(FeedbackHistory, n_histories) catch |err| {
+                self.allocator.free(data);
+                return err;
+            };
+
+            for (self.histories, 0..) |*history, i| {
+                var views: [2]audio_buffer.UnmanagedChannelView(T) = undefined;
+
+                for (&views, 0..) |*view, half| {
+                    view.* = audio_buffer.UnmanagedChannelView(T).init(data[(i * 2 + half) * span_samples ..][0..span_samples], .{
+                        .n_channels = ctx.n_channels,
+                        .block_size = span_block,
+                        .access = ctx.access_pattern,
+                    }) catch unreachable;
+                }
+
+                history.* = .{ .views = views };
+            }
+
+            log.debug("{d} feedback sources, loop delay of {d} frames", .{ n_histories, self.span_size });
+        }
+
         pub fn processGraph(self: *Self) !void {
-            // WORK IN PROGRESS NOT READY TODO
             const queue = self.topology_queue orelse return;
             var buffers = self.buffers orelse return;
+            const block_start = self.frame_time.load(.monotonic);
+            const block_size = self.blockSize();
 
-            var processed_count: usize = 0;
-            const total_nodes = queue.nodes.len;
+            var offset: usize = 0;
 
-            while (processed_count < total_nodes) {
-                const queue_items = queue.nodes.slice();
+            while (offset < block_size) : (offset += self.span_size) {
+                const span = Span{ .start = block_start + offset, .offset = offset, .len = self.span_size };
 
-                for (0..queue_items.len) |idx| {
-                    // queue_item has information about the index of nodes in the graph
-                    // the inputs/dependencies of the node
-                    // which buffer to use when processing the node
-                    const queue_item = queue_items.get(idx);
-                    var graph_node = self.audio_graph.nodes.items[queue_item.graph_index];
+                // delay lines are consumed in queue order, see prepareLatencyCompensation
+                var delay_cursor: usize = 0;
 
-                    if (graph_node.nodeStatus() == .processed) continue;
+                // the topology queue is sorted by dependencies so a single pass processes the whole graph
+                for (0..queue.nodes.len) |idx| {
+                    const job = try self.beginNode(queue, idx, &buffers, span, &delay_cursor) orelse continue;
+                    processNode(job);
+                    self.recordHistory(job);
+                }
 
-                    const all_inputs_ready: bool = blk: {
-                        for (queue_item.inputs) |input_index| {
-                            const input_node = self.audio_graph.nodes.items[input_index];
-                            if (input_node.nodeStatus() != .processed) break :blk false;
-                        }
+                self.swapHistories();
+            }
+
+            self.frame_time.store(block_start + block_size, .release);
+        }
+
+        /// Same as `processGraph` but the nodes sharing the output buffer render straight into `samples`,
+        /// e.g. a float mmap area from the device. Saves copying the output into the device buffer and zeroing it.
+        /// `samples` must hold one block in the graph layout: `n_channels * blockSize()` samples with the graph access pattern.
+        /// Returns `invalid_buffer_length` without processing anything when it does not, use `processGraph` then.
+        pub fn processGraphInto(self: *Self, samples: []T) !void {
+            const buffers = self.buffers orelse return;
+
+            const target = try audio_buffer.UnmanagedChannelView(T).init(samples, .{
+                .n_channels = buffers.opts.n_channels,
+                .block_size = buffers.opts.block_size,
+                .access = buffers.opts.access,
+            });
+
+            try self.processGraphIntoView(target);
+        }
+
+        /// Same as `processGraphInto` with a view, e.g. non interleaved mmap areas where channels are further
+        /// apart than one block. The view must match the graph channel count, block size and access pattern.
+        pub fn processGraphIntoView(self: *Self, target: audio_buffer.UnmanagedChannelView(T)) !void {
+            const buffers = self.buffers orelse return;
+
+            if (target.n_channels != buffers.opts.n_channels or
+                target.block_size != self.blockSize() or
+                target.access != buffers.opts.access)
+            {
+                return audio_buffer.ChannelViewError.invalid_buffer_length;
+            }
+
+            self.output_target = target;
+            defer self.output_target = null;
 
-                        break :blk true;
-                    };
+            try self.processGraph();
 
-                    if (!all_inputs_ready) continue;
+            // a skipped output node leaves whatever the target held
+            if (self.isOutputSilent()) target.zero();
+        }
+
+        /// Same as `processGraph` but nodes on the same level run on the thread pool.
+        /// Input gathering stays serial, in queue order, so buffer reuse is the same as in the serial path.
+        /// Meant for offline rendering, the pool must not be shared with real-time threads.
+        pub fn processGraphParallel(self: *Self, pool: *std.Thread.Pool) !void {
+            const queue = self.topology_queue orelse return;
+            var buffers = self.buffers orelse return;
+            const block_start = self.frame_time.load(.monotonic);
+            const block_size = self.blockSize();
+
+            const levels = queue.nodes.items(.level);
+            var offset: usize = 0;
+
+            while (offset < block_size) : (offset += self.span_size) {
+                const span = Span{ .start = block_start + offset, .offset = offset, .len = self.span_size };
 
-                    for (queue_item.inputs) |input_index| {
-                        const parent_queue_item = queue.getFromGraphIndex(input_index);
-                        const parent_buffer_index = parent_queue_item.buffer_index;
+                var delay_cursor: usize = 0;
+                var level_start: usize = 0;
 
-                        if (parent_buffer_index != queue_item.buffer_index) {
-                            // todo check for nulls here
-                            var parent_view = buffers.getView(parent_buffer_index.?);
-                            var child_view = buffers.getView(queue_item.buffer_index.?);
+                while (level_start < queue.nodes.len) {
+                    var n_jobs: usize = 0;
+                    var idx = level_start;
 
-                            try child_view.copyFrom(parent_view);
-                            parent_view.zero();
+                    while (idx < queue.nodes.len and levels[idx] == levels[level_start]) : (idx += 1) {
+                        const job = try self.beginNode(queue, idx, &buffers, span, &delay_cursor) orelse continue;
+
+                        self.jobs[n_jobs] = job;
+                        n_jobs += 1;
+                    }
+
+                    level_start = idx;
+
+                    if (n_jobs == 1) {
+                        processNode(self.jobs[0]);
+                    } else {
+                        var wait_group = std.Thread.WaitGroup{};
+
+                        for (self.jobs[0..n_jobs]) |job| {
+                            pool.spawnWg(&wait_group, processNode, .{job});
                         }
+
+                        wait_group.wait();
+                    }
+
+                    // consumers of the level outputs run on later levels, their buffers are still intact
+                    for (self.jobs[0..n_jobs]) |job| self.recordHistory(job);
+                }
+
+                self.swapHistories();
+            }
+
+            self.frame_time.store(block_start + block_size, .release);
+        }
+
+        // serial part of processing a node: silence tracking, input gathering and event draining.
+        // Returns null when the node is skipped
+        fn beginNode(
+            self: *Self,
+            queue: graph.TopologyQueue,
+            idx: usize,
+            buffers: *audio_buffer.UniformChannelViews(T),
+            span: Span,
+            delay_cursor: *usize,
+        ) !?NodeJob {
+            // queue_item has information about the index of nodes in the graph
+            // the inputs/dependencies of the node
+            // which buffer to use when processing the node
+            const queue_item = queue.nodes.get(idx);
+            const graph_node = &self.audio_graph.nodes.items[queue_item.graph_index];
+            const buffer_index = queue_item.buffer_index.?;
+
+            const inputs_silent = self.inputsSilent(queue, queue_item);
+            const silence = &self.node_silence[idx];
+
+            defer silence.silent_frames = if (inputs_silent) silence.silent_frames +| span.len else 0;
+
+            // the tail has decayed, skip the node and its input copies. Consumers read the buffer as zeros
+            if (inputs_silent and silence.silent_frames >= silence.tail_length and !graph_node.hasPendingEvents(span.start + span.len)) {
+                for (queue_item.input_delays) |delay| {
+                    if (delay > 0) delay_cursor.* += 1;
+                }
+
+                self.buffer_silent[buffer_index] = true;
+                self.audio_graph.updateNodeStatus(queue_item.graph_index, .processed);
+
+                if (self.history_index[queue_item.graph_index]) |history| {
+                    self.histories[history].recordSilence();
+                }
+
+                return null;
+            }
+
+            const node_buffer_view = self.spanView(buffers, buffer_index, span);
+
+            try self.gatherInputs(queue, queue_item, buffers, node_buffer_view, span, delay_cursor);
+
+            self.buffer_silent[buffer_index] = false;
+
+            // each node drains into its own scratch region so jobs can run concurrently
+            const scratch = self.event_scratch[idx * self.max_events ..][0..self.max_events];
+
+            return NodeJob{
+                .graph_index = queue_item.graph_index,
+                .node = graph_node,
+                .view = node_buffer_view,
+                .events = graph_node.drainEvents(span.start, span.start + span.len, scratch),
+                .inputs_silent = inputs_silent,
+                .output_silent = &self.buffer_silent[buffer_index],
+            };
+        }
+
+        fn inputsSilent(self: *Self, queue: graph.TopologyQueue, queue_item: graph.TopologyQueueNode) bool {
+            // nodes fed only by feedback edges are sources
+            if (queue_item.inputs.len == 0) return false;
+
+            for (queue_item.inputs) |input_index| {
+                if (!self.buffer_silent[queue.getFromGraphIndex(input_index).buffer_index.?]) return false;
+            }
+
+            for (queue_item.feedback_inputs) |source| {
+                if (self.histories[self.history_index[source].?].readView() != null) return false;
+            }
+
+            return true;
+        }
+
+        // frames of the current pass in one of the graph buffers
+        fn spanView(self: *Self, buffers: *audio_buffer.UniformChannelViews(T), buffer_index: usize, span: Span) audio_buffer.UnmanagedChannelView(T) {
+            const view = if (self.output_target != null and buffer_index == self.output_buffer_index) self.output_target.? else buffers.getView(buffer_index);
+            if (span.len == view.block_size) return view;
+
+            return view.subView(span.offset, span.len);
+        }
+
+        fn recordHistory(self: *Self, job: NodeJob) void {
+            const history = self.history_index[job.graph_index] orelse return;
+            self.histories[history].record(job.view, job.output_silent.*);
+        }
+
+        fn swapHistories(self: *Self) void {
+            for (self.histories) |*history| history.swap();
+        }
+
+        // sums every input into the node buffer, delaying the inputs that arrive early.
+        // A node may reuse the buffer of one of its inputs, that input is already in place and the others are added to it.
+        // Silent inputs are not copied, their buffers may hold stale data and are read as zeros.
+        fn gatherInputs(
+            self: *Self,
+            queue: graph.TopologyQueue,
+            queue_item: graph.TopologyQueueNode,
+            buffers: *audio_buffer.UniformChannelViews(T),
+            view: audio_buffer.UnmanagedChannelView(T),
+            span: Span,
+            delay_cursor: *usize,
+        ) !void {
+            if (queue_item.inputs.len == 0 and queue_item.feedback_inputs.len == 0) {
+                view.zero();
+                return;
+            }
+
+            const node_buffer = queue_item.buffer_index.?;
+            var in_place: ?usize = null;
+
+            for (queue_item.inputs, 0..) |input_index, i| {
+                if (queue.getFromGraphIndex(input_index).buffer_index == node_buffer) in_place = i;
+            }
+
+            // whether the view already holds valid input data
+            var accumulate = false;
+
+            if (in_place) |place| {
+                const in_place_silent = self.buffer_silent[node_buffer];
+
+                // the in place input must be delayed before anything is added on top of it
+                if (queue_item.input_delays[place] > 0) {
+                    var line_index = delay_cursor.*;
+
+                    for (queue_item.input_delays[0..place]) |delay| {
+                        if (delay > 0) line_index += 1;
                     }
 
-                    const node_buffer_view = buffers.getView(queue_item.buffer_index.?);
+                    const line = &self.delay_lines.items[line_index];
+
+                    if (in_place_silent) line.processSilence(view, false) else line.process(view, view, false);
+                    accumulate = true;
+                } else accumulate = !in_place_silent;
+            }
+
+            for (queue_item.inputs, queue_item.input_delays, 0..) |input_index, delay, i| {
+                defer {
+                    if (delay > 0) delay_cursor.* += 1;
+                }
+
+                if (in_place == i) continue;
+
+                const parent_buffer = queue.getFromGraphIndex(input_index).buffer_index.?;
+                const parent_silent = self.buffer_silent[parent_buffer];
+
+                if (delay > 0) {
+                    const line = &self.delay_lines.items[delay_cursor.*];
+
+                    if (parent_silent) line.processSilence(view, accumulate) else line.process(self.spanView(buffers, parent_buffer, span), view, accumulate);
+                } else if (parent_silent) {
+                    continue;
+                } else if (accumulate) {
+                    try view.addFrom(self.spanView(buffers, parent_buffer, span));
+                } else {
+                    try view.copyFrom(self.spanView(buffers, parent_buffer, span));
+                }
+
+                accumulate = true;
+            }
+
+            // previous pass output of the feedback sources
+            for (queue_item.feedback_inputs) |source| {
+                const history = self.histories[self.history_index[source].?].readView() orelse continue;
+
+                if (accumulate) try view.addFrom(history) else try view.copyFrom(history);
+                accumulate = true;
+            }
+
+            if (!accumulate) view.zero();
+        }
+
+        // delivers the drained events to the node. Sample accurate nodes are processed in sub blocks
+        // starting at each event frame so that parameter changes land exactly where they were scheduled.
+        fn processNode(job: NodeJob) void {
+            const node = job.node;
+            const view = job.view;
+            const events = job.events;
+
+            if (!node.sample_accurate or events.len == 0) {
+                node.process(ProcessContext{
+                    .buffer = view,
+                    .events = events,
+                    .inputs_silent = job.inputs_silent,
+                    .output_silent = job.output_silent,
+                });
+                return;
+            }
 
-                    // when to copy and when to share?
-                    const ctx = ProcessContext{ .buffer = node_buffer_view };
-                    graph_node.process(ctx);
+            var frame: usize = 0;
+            var first: usize = 0;
 
-                    self.audio_graph.updateNodeStatus(queue_item.graph_index, .processed);
-                    processed_count += 1;
+            while (frame < view.block_size) {
+                var last = first;
+                while (last < events.len and events[last].frame <= frame) : (last += 1) {
+                    events[last].frame = 0;
                 }
+
+                const next_frame: usize = if (last < events.len) @intCast(events[last].frame) else view.block_size;
+
+                node.process(ProcessContext{
+                    .buffer = view.subView(frame, next_frame - frame),
+                    .events = events[first..last],
+                    .inputs_silent = job.inputs_silent,
+                    .output_silent = job.output_silent,
+                });
+
+                frame = next_frame;
+                first = last;
             }
         }
 
+        /// Schedules a parameter change on a node at an absolute frame (see `currentFrame`).
+        /// Frames already in the past are applied at the start of the next block.
+        /// Lock free, call from a single control thread. Returns false if the node takes no parameters or its queue is full.
+        pub fn sendParam(self: *Self, node_index: usize, param: anytype, value: T, at_frame: u64) bool {
+            const param_id: u32 = switch (@typeInfo(@TypeOf(param))) {
+                .Enum => @intFromEnum(param),
+                else => @intCast(param),
+            };
+
+            if (node_index >= self.audio_graph.nodes.items.len) return false;
+
+            return self.audio_graph.nodes.items[node_index].pushEvent(.{
+                .frame = at_frame,
+                .param = param_id,
+                .value = value,
+            });
+        }
+
+        /// First frame of the next block to be rendered.
+        pub fn currentFrame(self: *Self) u64 {
+            return self.frame_time.load(.acquire);
+        }
+
         pub fn getOutputBuffer(self: Self) ?audio_buffer.UnmanagedChannelView(T) {
             const queue = self.topology_queue orelse return null;
 
@@ -139,7 +692,26 @@ pub fn Scheduler(comptime T: type) type {
                 node.setStatus(.ready);
             }
 
-            return buffers.getView(buffer_index);
+            const view = buffers.getView(buffer_index);
+
+            // a skipped output node leaves stale data behind
+            if (self.buffer_silent[buffer_index]) view.zero();
+
+            return view;
+        }
+
+        /// True when the output of the last processed block is silent, e.g. every tail has decayed.
+        pub fn isOutputSilent(self: Self) bool {
+            const queue = self.topology_queue orelse return true;
+            const buffer_index = queue.getLast().buffer_index orelse return true;
+
+            return self.buffer_silent[buffer_index];
+        }
+
+        /// Latency in frames introduced by the graph. Valid after prepare.
+        /// Pass it to the backend (e.g. `HalfDuplexDevice.setProcessingLatency`) to keep capture and playback aligned.
+        pub fn latency(self: Self) usize {
+            return self.graph_latency;
         }
 
         pub fn blockSize(self: *Self) usize {
@@ -169,8 +741,51 @@ pub fn Scheduler(comptime T: type) type {
         //     }
         // }
 
+        /// Touches the graph buffers, node state, delay lines and feedback histories, so the first blocks do not
+        /// page fault. Valid after prepare, pass it to the backend with `RealtimeOptions.PrefaultHook.of(&scheduler)`.
+        pub fn prefault(self: *Self) void {
+            if (self.buffers) |buffers| realtime.prefault(std.mem.sliceAsBytes(buffers.buffer));
+            if (self.audio_graph.node_arena) |arena| realtime.prefault(arena);
+
+            realtime.prefault(std.mem.sliceAsBytes(self.event_scratch));
+            realtime.prefault(std.mem.sliceAsBytes(self.jobs));
+
+            for (self.delay_lines.items) |line| realtime.prefault(std.mem.sliceAsBytes(line.buffer));
+
+            for (self.histories) |history| {
+                for (history.views) |view| realtime.prefault(std.mem.sliceAsBytes(view.buffer));
+            }
+        }
+
+        fn deinitHistories(self: *Self) void {
+            if (self.histories.len > 0) {
+                // the views of every history share one allocation, see prepareFeedback
+                const first = self.histories[0].views[0].buffer;
+                self.allocator.free(first.ptr[0 .. self.histories.len * 2 * first.len]);
+            }
+
+            self.allocator.free(self.histories);
+            self.allocator.free(self.history_index);
+
+            self.histories = &.{};
+            self.history_index = &.{};
+        }
+
+        fn deinitDelayLines(self: *Self) void {
+            for (self.delay_lines.items) |*line| line.deinit();
+            self.delay_lines.clearRetainingCapacity();
+        }
+
         pub fn deinit(self: *Self) void {
             self.audio_graph.deinit();
+            self.allocator.free(self.event_scratch);
+            self.allocator.free(self.jobs);
+            self.allocator.free(self.buffer_silent);
+            self.allocator.free(self.node_silence);
+
+            self.deinitDelayLines();
+            self.delay_lines.deinit();
+            self.deinitHistories();
 
             if (self.buffers) |*buffer| {
                 buffer.deinit();
@@ -182,3 +797,471 @@ pub fn Scheduler(comptime T: type) type {
         }
     };
 }
+
+test "Scheduler: feedback edges read the previous pass" {
+    const allocator = std.testing.allocator;
+    const Node = graph.nodes.interface.GenericNode(f64);
+
+    const OneNode = struct {
+        pub fn name(_: *@This()) []const u8 {
+            return "One";
+        }
+
+        pub fn process(_: *@This(), ctx: Node.ProcessContext) void {
+            for (0..ctx.buffer.block_size) |frame| {
+                for (0..ctx.buffer.n_channels) |ch| ctx.buffer.writeSample(ch, frame, 1);
+            }
+        }
+
+        pub fn prepare(_: *@This(), _: Node.PrepareContext) graph.nodes.interface.NodeError!void {}
+    };
+
+    var sched = Scheduler(f64).init(allocator);
+    defer sched.deinit();
+
+    // y = 0.5 * (1 + y delayed)
+    const one = try sched.audio_graph.addNode(OneNode{});
+    const mix = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f64).init(0.5));
+    try one.connect(mix);
+    try mix.connectFeedback(mix);
+
+    sched.setFeedbackBlockSize(.blk_4);
+
+    try sched.prepare(.{
+        .block_size = .blk_16,
+        .n_channels = 1,
+        .sample_rate = 48_000,
+        .access_pattern = .interleaved,
+    });
+
+    try sched.processGraph();
+
+    const out = sched.getOutputBuffer().?;
+    const expected = [_]f64{ 0.5, 0.75, 0.875, 0.9375 };
+
+    // the loop delay is one sub block
+    for (expected, 0..) |value, pass| {
+        try std.testing.expectApproxEqAbs(value, out.readSample(0, pass * 4), 1e-12);
+        try std.testing.expectApproxEqAbs(value, out.readSample(0, pass * 4 + 3), 1e-12);
+    }
+}
+
+test "Scheduler: a subgraph runs on the feedback sub block" {
+    const allocator = std.testing.allocator;
+    const Node = graph.nodes.interface.GenericNode(f64);
+
+    const RampNode = struct {
+        t: f64 = 0,
+
+        pub fn name(_: *@This()) []const u8 {
+            return "Ramp";
+        }
+
+        pub fn process(self: *@This(), ctx: Node.ProcessContext) void {
+            for (0..ctx.buffer.block_size) |frame| {
+                ctx.buffer.writeSample(0, frame, self.t);
+                self.t += 1;
+            }
+        }
+
+        pub fn prepare(_: *@This(), _: Node.PrepareContext) graph.nodes.interface.NodeError!void {}
+    };
+
+    var sched = Scheduler(f64).init(allocator);
+    defer sched.deinit();
+
+    var domain = try graph.subgraph.Subgraph(f64).init(allocator, .{ .divisor = 4 });
+    const gain = try domain.innerGraph().addNode(graph.nodes.utils.GainNode(f64).init(2.0));
+    try domain.input().connect(gain);
+
+    // the ramp ignores its feedback input, the edge only splits the block in passes of 16 frames
+    const ramp = try sched.audio_graph.addNode(RampNode{});
+    const sub = try sched.audio_graph.addNode(domain);
+    try ramp.connect(sub);
+    try sub.connectFeedback(ramp);
+
+    sched.setFeedbackBlockSize(.blk_16);
+
+    try sched.prepare(.{
+        .block_size = .blk_64,
+        .n_channels = 1,
+        .sample_rate = 48_000,
+        .access_pattern = .interleaved,
+    });
+
+    try std.testing.expectEqual(4, domain.inner.blockSize());
+
+    for (0..3) |block| {
+        try sched.processGraph();
+
+        const out = sched.getOutputBuffer().?;
+
+        // same output as whole blocks once the interpolation starts from a real inner frame
+        for (0..out.block_size) |frame| {
+            const t: f64 = @floatFromInt(block * 64 + frame);
+            if (t < 4) continue;
+
+            try std.testing.expectApproxEqAbs(2 * (t - domain.exactLatency()), out.readSample(0, frame), 1e-9);
+        }
+    }
+}
+
+// sine into two gains mixed by a third, intermediate nodes share the output buffer
+fn testDiamond(sched: *Scheduler(f64), access: audio_buffer.AccessPattern) !void {
+    const sine = try sched.audio_graph.addNode(graph.nodes.wave.SineNode(f64).init(440, 1.0, 48_000));
+    const left = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f64).init(0.5));
+    const right = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f64).init(0.25));
+    const mix = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f64).init(2.0));
+
+    try sine.connect(left);
+    try sine.connect(right);
+    try left.connect(mix);
+    try right.connect(mix);
+
+    try sched.prepare(.{ .block_size = .blk_64, .n_channels = 2, .sample_rate = 48_000, .access_pattern = access });
+}
+
+test "Scheduler: processGraphInto renders the same samples as processGraph" {
+    const allocator = std.testing.allocator;
+    const View = audio_buffer.UnmanagedChannelView(f64);
+
+    for ([_]audio_buffer.AccessPattern{ .interleaved, .non_interleaved }) |access| {
+        var reference = Scheduler(f64).init(allocator);
+        defer reference.deinit();
+
+        var sched = Scheduler(f64).init(allocator);
+        defer sched.deinit();
+
+        try testDiamond(&reference, access);
+        try testDiamond(&sched, access);
+
+        // the output buffer is reused along the way, those nodes render into the target as well
+        const queue = sched.topology_queue.?;
+        var aliased: usize = 0;
+
+        for (queue.nodes.items(.buffer_index)[0 .. queue.nodes.len - 1]) |buffer_index| {
+            if (buffer_index == sched.output_buffer_index) aliased += 1;
+        }
+
+        try std.testing.expect(aliased > 0);
+
+        var samples: [2 * 64]f64 = undefined;
+        // channels further apart than one block, as in a non interleaved mmap area
+        var wide: [96 + 64]f64 = undefined;
+
+        for (0..4) |block| {
+            @memset(&samples, 7);
+            @memset(&wide, 7);
+
+            try reference.processGraph();
+
+            var target = try View.init(&samples, .{ .n_channels = 2, .block_size = .blk_64, .access = access });
+
+            if (block % 2 == 0) {
+                try sched.processGraphInto(&samples);
+            } else {
+                if (access == .non_interleaved) {
+                    target.buffer = &wide;
+                    target.channel_stride = 96;
+                }
+
+                try sched.processGraphIntoView(target);
+            }
+
+            const expected = reference.getOutputBuffer().?;
+
+            for (0..64) |frame| {
+                for (0..2) |ch| try std.testing.expectEqual(expected.readSample(ch, frame), target.readSample(ch, frame));
+            }
+        }
+    }
+}
+
+test "Scheduler: processGraphInto zeroes the target of a silent output" {
+    const allocator = std.testing.allocator;
+    const Node = graph.nodes.interface.GenericNode(f64);
+
+    // a source that reports silence without touching its buffer
+    const QuietNode = struct {
+        pub fn name(_: *@This()) []const u8 {
+            return "Quiet";
+        }
+
+        pub fn process(_: *@This(), ctx: Node.ProcessContext) void {
+            if (ctx.output_silent) |silent| silent.* = true;
+        }
+
+        pub fn prepare(_: *@This(), _: Node.PrepareContext) graph.nodes.interface.NodeError!void {}
+    };
+
+    var sched = Scheduler(f64).init(allocator);
+    defer sched.deinit();
+
+    const quiet = try sched.audio_graph.addNode(QuietNode{});
+    const gain = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f64).init(2.0));
+    try quiet.connect(gain);
+
+    try sched.prepare(.{ .block_size = .blk_64, .n_channels = 2, .sample_rate = 48_000, .access_pattern = .interleaved });
+
+    var samples = [_]f64{7} ** (2 * 64);
+
+    // the gain is skipped, the target keeps what it held unless the scheduler clears it
+    try sched.processGraphInto(&samples);
+
+    try std.testing.expect(sched.isOutputSilent());
+    for (samples) |sample| try std.testing.expectEqual(0, sample);
+}
+
+test "Scheduler: processGraphInto rejects a target of another layout" {
+    const allocator = std.testing.allocator;
+
+    var sched = Scheduler(f64).init(allocator);
+    defer sched.deinit();
+
+    try testDiamond(&sched, .interleaved);
+
+    var samples = [_]f64{7} ** (2 * 64);
+
+    try std.testing.expectError(audio_buffer.ChannelViewError.invalid_buffer_length, sched.processGraphInto(samples[0 .. 2 * 32]));
+
+    const mono = try audio_buffer.UnmanagedChannelView(f64).init(&samples, .{ .n_channels = 1, .block_size = .blk_128, .access = .interleaved });
+    try std.testing.expectError(audio_buffer.ChannelViewError.invalid_buffer_length, sched.processGraphIntoView(mono));
+
+    const planar = try audio_buffer.UnmanagedChannelView(f64).init(&samples, .{ .n_channels = 2, .block_size = .blk_64, .access = .non_interleaved });
+    try std.testing.expectError(audio_buffer.ChannelViewError.invalid_buffer_length, sched.processGraphIntoView(planar));
+
+    // nothing was processed
+    try std.testing.expectEqual(0, sched.currentFrame());
+    for (samples) |sample| try std.testing.expectEqual(7, sample);
+}
+
+test "Scheduler: a parameter event changes the output from its frame on" {
+    const allocator = std.testing.allocator;
+    const Node = graph.nodes.interface.GenericNode(f64);
+
+    const OneNode = struct {
+        pub fn name(_: *@This()) []const u8 {
+            return "One";
+        }
+
+        pub fn process(_: *@This(), ctx: Node.ProcessContext) void {
+            for (0..ctx.buffer.block_size) |frame| ctx.buffer.writeSample(0, frame, 1);
+        }
+
+        pub fn prepare(_: *@This(), _: Node.PrepareContext) graph.nodes.interface.NodeError!void {}
+    };
+
+    var sched = Scheduler(f64).init(allocator);
+    defer sched.deinit();
+
+    const one = try sched.audio_graph.addNode(OneNode{});
+    const gain = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f64).init(1.0));
+    try one.connect(gain);
+
+    try sched.prepare(.{ .block_size = .blk_64, .n_channels = 1, .sample_rate = 48_000, .access_pattern = .interleaved });
+
+    const at = 64 + 37;
+    try std.testing.expect(sched.sendParam(gain.index, graph.nodes.utils.GainNode(f64).Param.gain, 0.5, at));
+
+    // the gain ramps over 960 frames at 48kHz
+    const step = 0.5 / 960.0;
+
+    for (0..2) |block| {
+        try sched.processGraph();
+        const out = sched.getOutputBuffer().?;
+
+        for (0..64) |frame| {
+            const t = block * 64 + frame;
+            const expected: f64 = if (t < at) 1 else 1 - step * @as(f64, @floatFromInt(t - at + 1));
+
+            try std.testing.expectApproxEqAbs(expected, out.readSample(0, frame), 1e-12);
+        }
+    }
+}
+
+test "Scheduler: a sine without ramp applies frequency changes on the event frame" {
+    const allocator = std.testing.allocator;
+    const sample_rate = 40;
+
+    var sched = Scheduler(f64).init(allocator);
+    defer sched.deinit();
+
+    // 20ms are less than a frame at this rate, parameters jump
+    const sine = try sched.audio_graph.addNode(graph.nodes.wave.SineNode(f64).init(1, 1, sample_rate));
+
+    try sched.prepare(.{ .block_size = .blk_64, .n_channels = 1, .sample_rate = sample_rate, .access_pattern = .interleaved });
+
+    const at = 10;
+    try std.testing.expect(sched.sendParam(sine.index, graph.nodes.wave.SineNode(f64).Param.frequency, 5, at));
+
+    var reference = dsp.waves.Wave(f64).init(1, 1, sample_rate);
+
+    try sched.processGraph();
+    const out = sched.getOutputBuffer().?;
+
+    for (0..64) |frame| {
+        if (frame == at) reference.setFrequency(5);
+        try std.testing.expectApproxEqAbs(reference.sineSample(), out.readSample(0, frame), 1e-12);
+    }
+}
+
+test "Scheduler: branches of different latency are aligned where they are mixed" {
+    const allocator = std.testing.allocator;
+    const Node = graph.nodes.interface.GenericNode(f64);
+
+    const ImpulseNode = struct {
+        at: usize,
+        t: usize = 0,
+
+        pub fn name(_: *@This()) []const u8 {
+            return "Impulse";
+        }
+
+        pub fn process(self: *@This(), ctx: Node.ProcessContext) void {
+            for (0..ctx.buffer.block_size) |frame| {
+                ctx.buffer.writeSample(0, frame, if (self.t == self.at) 1 else 0);
+                self.t += 1;
+            }
+        }
+
+        pub fn prepare(_: *@This(), _: Node.PrepareContext) graph.nodes.interface.NodeError!void {}
+    };
+
+    // delays by its reported latency
+    const LatentNode = struct {
+        history: [5]f64 = [_]f64{0} ** 5,
+        cursor: usize = 0,
+
+        pub fn name(_: *@This()) []const u8 {
+            return "Latent";
+        }
+
+        pub fn process(self: *@This(), ctx: Node.ProcessContext) void {
+            for (0..ctx.buffer.block_size) |frame| {
+                const delayed = self.history[self.cursor];
+                self.history[self.cursor] = ctx.buffer.readSample(0, frame);
+                self.cursor = (self.cursor + 1) % self.history.len;
+
+                ctx.buffer.writeSample(0, frame, delayed);
+            }
+        }
+
+        pub fn prepare(_: *@This(), _: Node.PrepareContext) graph.nodes.interface.NodeError!void {}
+
+        pub fn latency(_: *@This()) usize {
+            return 5;
+        }
+    };
+
+    var sched = Scheduler(f64).init(allocator);
+    defer sched.deinit();
+
+    // the impulse crosses the block boundary on the latent branch only
+    const impulse = try sched.audio_graph.addNode(ImpulseNode{ .at = 62 });
+    const latent = try sched.audio_graph.addNode(LatentNode{});
+    const direct = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f64).init(0.25));
+    const mix = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f64).init(1.0));
+
+    try impulse.connect(latent);
+    try impulse.connect(direct);
+    try latent.connect(mix);
+    try direct.connect(mix);
+
+    try sched.prepare(.{ .block_size = .blk_64, .n_channels = 1, .sample_rate = 48_000, .access_pattern = .interleaved });
+
+    try std.testing.expectEqual(5, sched.latency());
+
+    for (0..3) |block| {
+        try sched.processGraph();
+        const out = sched.getOutputBuffer().?;
+
+        // both copies land on the same frame, the direct one delayed by the compensation
+        for (0..64) |frame| {
+            const expected: f64 = if (block * 64 + frame == 62 + 5) 1.25 else 0;
+            try std.testing.expectEqual(expected, out.readSample(0, frame));
+        }
+    }
+}
+
+test "Scheduler: a silent subtree is skipped after its tail and resumes with its input" {
+    const allocator = std.testing.allocator;
+    const Node = graph.nodes.interface.GenericNode(f64);
+
+    // ones while the gate is open, reports silence otherwise
+    const GateNode = struct {
+        open: *const bool,
+
+        pub fn name(_: *@This()) []const u8 {
+            return "Gate";
+        }
+
+        pub fn process(self: *@This(), ctx: Node.ProcessContext) void {
+            if (!self.open.*) {
+                if (ctx.output_silent) |silent| silent.* = true;
+                return;
+            }
+
+            for (0..ctx.buffer.block_size) |frame| ctx.buffer.writeSample(0, frame, 1);
+        }
+
+        pub fn prepare(_: *@This(), _: Node.PrepareContext) graph.nodes.interface.NodeError!void {}
+    };
+
+    // passes its input through, rings for one block
+    const TailNode = struct {
+        calls: *usize,
+
+        pub fn name(_: *@This()) []const u8 {
+            return "Tail";
+        }
+
+        pub fn process(self: *@This(), _: Node.ProcessContext) void {
+            self.calls.* += 1;
+        }
+
+        pub fn prepare(_: *@This(), _: Node.PrepareContext) graph.nodes.interface.NodeError!void {}
+
+        pub fn tailLength(_: *@This()) usize {
+            return 64;
+        }
+    };
+
+    var open = true;
+    var calls: usize = 0;
+
+    var sched = Scheduler(f64).init(allocator);
+    defer sched.deinit();
+
+    const gate = try sched.audio_graph.addNode(GateNode{ .open = &open });
+    const gain = try sched.audio_graph.addNode(graph.nodes.utils.GainNode(f64).init(2.0));
+    const tail = try sched.audio_graph.addNode(TailNode{ .calls = &calls });
+
+    try gate.connect(gain);
+    try gain.connect(tail);
+
+    try sched.prepare(.{ .block_size = .blk_64, .n_channels = 1, .sample_rate = 48_000, .access_pattern = .interleaved });
+
+    // gate state per block and what follows: tail calls so far, output silent, output value
+    const steps = [_]struct { open: bool, calls: usize, silent: bool, value: f64 }{
+        .{ .open = true, .calls = 1, .silent = false, .value = 2 },
+        // the gain is skipped right away, the tail node still runs on zeros for its tail
+        .{ .open = false, .calls = 2, .silent = false, .value = 0 },
+        .{ .open = false, .calls = 2, .silent = true, .value = 0 },
+        .{ .open = false, .calls = 2, .silent = true, .value = 0 },
+        // the whole subtree resumes with its input
+        .{ .open = true, .calls = 3, .silent = false, .value = 2 },
+        .{ .open = false, .calls = 4, .silent = false, .value = 0 },
+        .{ .open = false, .calls = 4, .silent = true, .value = 0 },
+    };
+
+    for (steps) |step| {
+        open = step.open;
+        try sched.processGraph();
+
+        try std.testing.expectEqual(step.calls, calls);
+        try std.testing.expectEqual(step.silent, sched.isOutputSilent());
+
+        const out = sched.getOutputBuffer().?;
+        for (0..64) |frame| try std.testing.expectEqual(step.value, out.readSample(0, frame));
+    }
+}
@@ -0,0 +1,377 @@
+const std = @import("std");
+const graph = @import("graph.zig");
+const scheduler = @import("scheduler.zig");
+const specs = @import("../common/audio_specs.zig");
+const audio_buffer = @import("../common/audio_buffer.zig");
+const node_interface = @import("nodes/node_interface.zig");
+
+const log = std.log.scoped(.graph);
+
+pub const SubgraphOptions = struct {
+    /// Rate reduction of the subgraph domain, must be a power of two.
+    /// The inner block size is the outer block size divided by it.
+    divisor: usize = 4,
+};
+
+/// Node running an inner graph at a fraction of the outer sample rate, e.g. control rate modulators or analysis.
+/// The node input is decimated into the inner domain and the inner output is interpolated back,
+/// so the inner graph processes `block_size / divisor` frames once per outer block.
+///
+///     var lfo_domain = try Subgraph(f32).init(allocator, .{ .divisor = 16 });
+///     const lfo = try lfo_domain.innerGraph().addNode(...);
+///     try lfo_domain.input().connect(lfo);
+///     const node = try outer_graph.addNode(lfo_domain);
+///
+/// The inner output is the last node in processing order. Its latency is reported to the outer graph.
+/// The outer block is the prepared block size, the feedback sub block in graphs splitting their feedback loops,
+/// so the divisor must divide that one. The node is not sample accurate and never gets shorter spans.
+pub fn Subgraph(comptime T: type) type {
+    if (T != f32 and T != f64) {
+        @compileError("Subgraph only supports f32 and f64");
+    }
+
+    return struct {
+        const Self = @This();
+        const Scheduler = scheduler.Scheduler(T);
+        const GenericNode = node_interface.GenericNode(T);
+        const View = audio_buffer.UnmanagedChannelView(T);
+        const Error = node_interface.NodeError;
+
+        const PrepareContext = GenericNode.PrepareContext;
+        const ProcessContext = GenericNode.ProcessContext;
+
+        // decimated input shared with the inner input node.
+        // Heap allocated so the node state can be moved into the graph arena
+        const Boundary = struct {
+            input: ?View = null,
+        };
+
+        /// First node of the inner graph, outputs the decimated subgraph input.
+        pub const InputNode = struct {
+            boundary: *Boundary,
+
+            pub fn name(_: *InputNode) []const u8 {
+                return "SubgraphInput";
+            }
+
+            pub fn process(self: *InputNode, ctx: ProcessContext) void {
+                const decimated = self.boundary.input orelse return ctx.buffer.zero();
+                ctx.buffer.copyFrom(decimated) catch ctx.buffer.zero();
+            }
+
+            pub fn prepare(_: *InputNode, _: PrepareContext) Error!void {}
+        };
+
+        inner: *Scheduler,
+        boundary: *Boundary,
+        divisor: usize,
+        allocator: std.mem.Allocator,
+        input_buffer: []T = &.{},
+        // last inner output frame of the previous block, per channel. Start point of the interpolation
+        last_output: []T = &.{},
+
+        pub fn init(allocator: std.mem.Allocator, opts: SubgraphOptions) !Self {
+            if (!std.math.isPowerOfTwo(opts.divisor)) return Error.invalid_configuration;
+
+            const inner = try allocator.create(Scheduler);
+            errdefer allocator.destroy(inner);
+
+            inner.* = Scheduler.init(allocator);
+            errdefer inner.deinit();
+
+            const boundary = try allocator.create(Boundary);
+            errdefer allocator.destroy(boundary);
+
+            boundary.* = .{};
+
+            _ = try inner.audio_graph.addNode(InputNode{ .boundary = boundary });
+
+            return .{
+                .inner = inner,
+                .boundary = boundary,
+                .divisor = opts.divisor,
+                .allocator = allocator,
+            };
+        }
+
+        /// Graph of the reduced rate domain.
+        pub fn innerGraph(self: Self) *graph.Graph(T) {
+            return &self.inner.audio_graph;
+        }
+
+        /// Handle to the inner input node, connect it to the nodes consuming the subgraph input.
+        pub fn input(self: Self) graph.Graph(T).NodeHandle {
+            return .{ .index = 0, .graph = &self.inner.audio_graph };
+        }
+
+        pub fn name(_: *Self) []const u8 {
+            return "Subgraph";
+        }
+
+        pub fn prepare(self: *Self, ctx: PrepareContext) Error!void {
+            const outer_block: usize = @intFromEnum(ctx.block_size);
+
+            if (outer_block % self.divisor != 0) {
+                log.err("Subgraph divisor {d} does not divide block size {d}", .{ self.divisor, outer_block });
+                return Error.invalid_configuration;
+            }
+
+            const inner_block = std.meta.intToEnum(specs.BlockSize, outer_block / self.divisor) catch {
+                log.err("Subgraph block size {d} is not supported", .{outer_block / self.divisor});
+                return Error.invalid_configuration;
+            };
+
+            self.freeBuffers();
+
+            self.input_buffer = self.allocator.alloc(T, ctx.n_channels * @intFromEnum(inner_block)) catch return Error.allocation_error;
+            self.last_output = self.allocator.alloc(T, ctx.n_channels) catch return Error.allocation_error;
+
+            @memset(self.input_buffer, 0);
+            @memset(self.last_output, 0);
+
+            self.boundary.input = View.init(self.input_buffer, .{
+                .n_channels = ctx.n_channels,
+                .block_size = inner_block,
+                .access = ctx.access_pattern,
+            }) catch unreachable;
+
+            self.inner.prepare(.{
+                .block_size = inner_block,
+                .n_channels = ctx.n_channels,
+                .sample_rate = ctx.sample_rate / @as(T, @floatFromInt(self.divisor)),
+                .access_pattern = ctx.access_pattern,
+            }) catch |err| {
+                log.err("Failed to prepare subgraph: {!}", .{err});
+                return if (err == error.OutOfMemory) Error.allocation_error else Error.invalid_configuration;
+            };
+        }
+
+        pub fn process(self: *Self, ctx: ProcessContext) void {
+            const in_view = self.boundary.input orelse return ctx.buffer.zero();
+            const buffer = ctx.buffer;
+            const d = self.divisor;
+            const d_float: T = @floatFromInt(d);
+
+            // the scheduler processes nodes in spans of the prepared block size, see `PrepareContext.block_size`
+            std.debug.assert(buffer.block_size == in_view.block_size * d);
+
+            // decimate with a boxcar average, a cheap anti aliasing filter good enough for control signals
+            for (0..in_view.block_size) |inner_frame| {
+                for (0..buffer.n_channels) |ch| {
+                    var sum: T = 0;
+                    for (0..d) |k| sum += buffer.readSample(ch, inner_frame * d + k);
+
+                    in_view.writeSample(ch, inner_frame, sum / d_float);
+                }
+            }
+
+            self.inner.processGraph() catch return buffer.zero();
+            const out_view = self.inner.getOutputBuffer() orelse return buffer.zero();
+
+            // linear interpolation from the previous inner frame
+            for (0..buffer.n_channels) |ch| {
+                var previous = self.last_output[ch];
+
+                for (0..out_view.block_size) |inner_frame| {
+                    const current = out_view.readSample(ch, inner_frame);
+                    const step = (current - previous) / d_float;
+
+                    for (0..d) |k| {
+                        buffer.writeSample(ch, inner_frame * d + k, previous + step * @as(T, @floatFromInt(k + 1)));
+                    }
+
+                    previous = current;
+                }
+
+                self.last_output[ch] = previous;
+            }
+        }
+
+        /// `exactLatency` rounded to whole outer frames, half a frame up for even divisors.
+        pub fn latency(self: *Self) usize {
+            return @intFromFloat(@round(self.exactLatency()));
+        }
+
+        /// Group delay of the rate conversion plus the inner graph latency, in outer frames. Inner frame `j` averages
+        /// outer frames `j*d` to `j*d + d-1`, centred on `j*d + (d-1)/2`, and the interpolation reaches it on the last
+        /// of them, `j*d + d-1`: the rate conversion delays by `(d-1)/2`. Each inner frame of latency adds `d`.
+        pub fn exactLatency(self: *Self) T {
+            const d: T = @floatFromInt(self.divisor);
+            return (d - 1) / 2 + @as(T, @floatFromInt(self.inner.latency())) * d;
+        }
+
+        pub fn tailLength(self: *Self) usize {
+            var longest: usize = 0;
+
+            for (self.inner.audio_graph.nodes.items) |node| {
+                const tail = node.tailLength();
+                if (tail == GenericNode.infinite_tail) return GenericNode.infinite_tail;
+
+                longest = @max(longest, tail);
+            }
+
+            return (longest + 1) * self.divisor;
+        }
+
+        fn freeBuffers(self: *Self) void {
+            self.allocator.free(self.input_buffer);
+            self.allocator.free(self.last_output);
+
+            self.input_buffer = &.{};
+            self.last_output = &.{};
+            self.boundary.input = null;
+        }
+
+        pub fn deinit(self: *Self) void {
+            self.freeBuffers();
+
+            self.inner.deinit();
+            self.allocator.destroy(self.inner);
+            self.allocator.destroy(self.boundary);
+        }
+    };
+}
+
+test "Subgraph: runs the inner graph at a reduced rate" {
+    const allocator = std.testing.allocator;
+
+    var outer = scheduler.Scheduler(f64).init(allocator);
+    defer outer.deinit();
+
+    var domain = try Subgraph(f64).init(allocator, .{ .divisor = 4 });
+    const inner_gain = try domain.innerGraph().addNode(graph.nodes.utils.GainNode(f64).init(2.0));
+    try domain.input().connect(inner_gain);
+
+    const sine = try outer.audio_graph.addNode(graph.nodes.wave.SineNode(f64).init(10, 0.5, 48_000));
+    const sub = try outer.audio_graph.addNode(domain);
+    try sine.connect(sub);
+
+    try outer.prepare(.{
+        .block_size = .blk_64,
+        .n_channels = 1,
+        .sample_rate = 48_000,
+        .access_pattern = .interleaved,
+    });
+
+    // 1.5 frames for the rate conversion rounded up, the inner gain adds none
+    try std.testing.expectEqual(2, outer.latency());
+    try std.testing.expectEqual(16, domain.inner.blockSize());
+
+    for (0..8) |_| try outer.processGraph();
+
+    // a slow sine survives the round trip at twice the amplitude, the peak stays bounded
+    const out = outer.getOutputBuffer().?;
+    for (0..out.block_size) |frame| {
+        try std.testing.expect(@abs(out.readSample(0, frame)) <= 1.0 + 1e-9);
+    }
+
+    try std.testing.expect(!outer.isOutputSilent());
+}
+
+// one inner frame of latency, mono
+const TestDelay = struct {
+    previous: f64 = 0,
+
+    pub fn name(_: *TestDelay) []const u8 {
+        return "TestDelay";
+    }
+
+    pub fn prepare(_: *TestDelay, _: node_interface.GenericNode(f64).PrepareContext) node_interface.NodeError!void {}
+
+    pub fn process(self: *TestDelay, ctx: node_interface.GenericNode(f64).ProcessContext) void {
+        for (0..ctx.buffer.block_size) |frame| {
+            const current = ctx.buffer.readSample(0, frame);
+            ctx.buffer.writeSample(0, frame, self.previous);
+            self.previous = current;
+        }
+    }
+
+    pub fn latency(_: *TestDelay) usize {
+        return 1;
+    }
+};
+
+// a mono domain of `divisor` running an inner gain of 2, and `TestDelay` when `delayed`
+fn testDomain(allocator: std.mem.Allocator, divisor: usize, delayed: bool) !Subgraph(f64) {
+    var domain = try Subgraph(f64).init(allocator, .{ .divisor = divisor });
+    errdefer domain.deinit();
+
+    const gain = try domain.innerGraph().addNode(graph.nodes.utils.GainNode(f64).init(2.0));
+    try domain.input().connect(gain);
+
+    if (delayed) {
+        const delay = try domain.innerGraph().addNode(TestDelay{});
+        try gain.connect(delay);
+    }
+
+    try domain.prepare(.{ .block_size = .blk_64, .n_channels = 1, .sample_rate = 48_000, .access_pattern = .interleaved });
+    return domain;
+}
+
+test "Subgraph: a ramp comes out scaled and delayed by exactly the latency" {
+    const allocator = std.testing.allocator;
+
+    for ([_]bool{ false, true }) |delayed| {
+        var domain = try testDomain(allocator, 4, delayed);
+        defer domain.deinit();
+
+        const delay = domain.exactLatency();
+        try std.testing.expectEqual(@as(f64, if (delayed) 5.5 else 1.5), delay);
+        try std.testing.expectEqual(@as(usize, if (delayed) 6 else 2), domain.latency());
+
+        var samples: [64]f64 = undefined;
+        const view = try audio_buffer.UnmanagedChannelView(f64).init(&samples, .{ .n_channels = 1, .block_size = .blk_64, .access = .interleaved });
+
+        for (0..3) |block| {
+            for (&samples, 0..) |*sample, frame| sample.* = @floatFromInt(block * 64 + frame);
+
+            domain.process(.{ .buffer = view });
+
+            // steady state once the interpolation starts from a real inner frame
+            if (block == 0) continue;
+
+            for (samples, 0..) |sample, frame| {
+                const t: f64 = @floatFromInt(block * 64 + frame);
+                try std.testing.expectApproxEqAbs(2 * (t - delay), sample, 1e-9);
+            }
+        }
+    }
+}
+
+test "Subgraph: the impulse response is centred on the latency, averaged over the divisor phases" {
+    const allocator = std.testing.allocator;
+    const divisor = 8;
+
+    for ([_]bool{ false, true }) |delayed| {
+        var centroids: f64 = 0;
+
+        for (0..divisor) |phase| {
+            var domain = try testDomain(allocator, divisor, delayed);
+            defer domain.deinit();
+
+            var samples = [_]f64{0} ** 64;
+            const view = try audio_buffer.UnmanagedChannelView(f64).init(&samples, .{ .n_channels = 1, .block_size = .blk_64, .access = .interleaved });
+
+            const at = 2 * divisor + phase;
+            samples[at] = 1;
+
+            domain.process(.{ .buffer = view });
+
+            var energy: f64 = 0;
+            var moment: f64 = 0;
+
+            for (samples, 0..) |sample, frame| {
+                energy += sample;
+                moment += sample * @as(f64, @floatFromInt(frame));
+            }
+
+            // the gain of 2 survives, spread over a triangle of 2d-1 frames
+            try std.testing.expectApproxEqAbs(2, energy, 1e-9);
+            centroids += moment / energy - @as(f64, @floatFromInt(at));
+
+            if (phase == divisor - 1) {
+                try std.testing.expectApproxEqAbs(domain.exactLatency(), centroids / divisor, 1e-9);
+            }
+        }
+    }
+}
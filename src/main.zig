@@ -37,6 +37,7 @@ pub fn main() !void {
     // backends.alsa.examples.fullDuplexCallbackWithLatencyProbe();
     // backends.alsa.examples.fullDuplexCallbackWithLatencyProbe();
     // backends.alsa.examples.halfDuplexCapture();
+    // backends.alsa.examples.halfDuplexCaptureToWorker();
     // backends.alsa.examples.fullDuplexCallbackUnlinkedDevices();
     // backends.alsa.examples.playbackSineWave();
 
@@ -49,4 +50,15 @@ test {
     std.testing.refAllDeclsRecursive(backends);
     std.testing.refAllDeclsRecursive(dsp);
     std.testing.refAllDeclsRecursive(graph);
+
+    _ = @import("common/audio_buffer.zig");
+    _ = @import("common/spsc_queue.zig");
+    _ = @import("common/audio_ring.zig");
+    _ = @import("common/simd.zig");
+    _ = @import("common/realtime.zig");
+    _ = @import("common/telemetry.zig");
+    _ = @import("common/metrics.zig");
+    _ = @import("backends/alsa/tsched.zig");
+    _ = @import("backends/alsa/drift.zig");
+    _ = @import("bench_alsa.zig");
 }